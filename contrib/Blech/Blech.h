@@ -48,7 +48,8 @@ Using Blech:
         printf("MyEvent(%d,%X,%X)",ID,pData,pValues);
         while(pValues)
         {
-            printf("'%s'=>'%s'",pValues->Name,pValues->Value);
+            printf("'%.*s'=>'%.*s'",(int)pValues->Name.length(),pValues->Name.data(),
+                (int)pValues->Value.length(),pValues->Value.data());
             pValues=pValues->pNext;
         }
     }
@@ -60,14 +61,20 @@ Using Blech:
     MyEvent(1,0,(pointer))
     'variable'=>'some'
 
+    Names and values are views into the fed text and into memory owned by the
+    Blech instance. Copy them if they are needed after the callback returns.
+
 ******************************************************************************/
 
 #pragma once
 
-#define BLECHVERSION "Lax/Blech 1.7.4"
+#define BLECHVERSION "Lax/Blech 1.8.0"
 
+#include <memory>
 #include <unordered_map>
 #include <string>
+#include <string_view>
+#include <vector>
 
 #ifdef BLECH_DEBUG_FULL
 #define BLECH_DEBUG
@@ -118,22 +125,17 @@ enum eBlechStringType
 	BST_SCANVAR = 2,
 };
 
+// Captured values are views into the line being fed and into a buffer owned by the Blech instance.
+// They are only valid for the duration of the callback.
 struct BLECHVALUE
 {
-	std::string    Name;
-	std::string    Value;
+	std::string_view Name;
+	std::string_view Value;
 
-	BLECHVALUE*    pNext;
+	BLECHVALUE*    pNext = nullptr;
 };
 using PBLECHVALUE = BLECHVALUE *;
 
-struct BLECHLISTNODE
-{
-	BlechNode*     pNode;
-	BLECHLISTNODE* pNext;
-};
-using PBLECHLISTNODE = BLECHLISTNODE *;
-
 using fBlechVariableValue = unsigned int (CALLBACK*)(char* VarName, char* Value, size_t Valuelen);
 using fBlechCallback = void (CALLBACK*)(unsigned int ID, void* pData, PBLECHVALUE pValues);
 
@@ -148,17 +150,6 @@ struct BLECHEVENT
 };
 using PBLECHEVENT = BLECHEVENT *;
 
-struct BLECHEXECUTE
-{
-	uint32_t       ID;
-	void*          pData;
-
-	fBlechCallback Callback;
-	BLECHVALUE*    pValues;
-	BLECHEXECUTE*  pNext;
-};
-using PBLECHEXECUTE = BLECHEXECUTE *;
-
 struct BLECHEVENTNODE
 {
 	BLECHEVENT*    pEvent;
@@ -215,124 +206,180 @@ static unsigned int Equalness(const char* StringA, const char* StringB)
 	}
 }
 
+class BlechNodeArena;
+
 class BlechNode
 {
 public:
-	BlechNode(BlechNode* Parent, BlechNode** Root, const char* String, eBlechStringType NewStringType = BST_NORMAL)
-		: StringType(NewStringType)
-		, pParent(Parent)
-		, ppRoot(Root)
+	void Initialize(BlechNodeArena* Arena, BlechNode* Parent, BlechNode** Root, std::string_view String, eBlechStringType NewStringType)
 	{
-		BlechDebug("BlechNode(%X,%X,%s,%d)", Parent, Root, String, NewStringType);
-		BLECHASSERT(String && *String);
+		BlechDebug("BlechNode(%X,%X,%.*s,%d)", Parent, Root, (int)String.length(), String.data(), NewStringType);
+		BLECHASSERT(!String.empty());
 		BLECHASSERT(Root);
 
-		Length = (uint32_t)strlen(String);
+		pArena = Arena;
+		StringType = NewStringType;
+		pParent = Parent;
+		ppRoot = Root;
 
-		pString = new char[Length + 1];
-		strcpy_s(pString, Length + 1, String);
+		// a recycled node keeps its storage, so this only allocates when the string outgrows it
+		Storage.assign(String);
+		pString = Storage.data();
+		Length = StringType == BST_NORMAL ? (uint32_t)Storage.length() : 0;
+	}
 
-		if (StringType != BST_NORMAL)
-			Length = 0;
+	// Drops the first Count characters, when a new parent takes over this node's prefix.
+	void RemovePrefix(uint32_t Count)
+	{
+		Storage.erase(0, Count);
+		pString = Storage.data();
+		Length -= Count;
 	}
 
-	~BlechNode()
+	BlechNode* AddChild(const char* NewString, eBlechStringType NewStringType);
+
+	bool IsEmpty()
 	{
-		BlechDebug("~BlechNode()");
+		return (!pChildren && !pEvents);
+	}
 
-		// clean out chillins
-		while (pChildren)
+	void AddEvent(PBLECHEVENT pEvent)
+	{
+		BlechDebug("AddEvent(%X)", pEvent);
+		BLECHASSERT(pEvent);
+
+		PBLECHEVENTNODE pNode = new BLECHEVENTNODE;
+		pNode->pEvent = pEvent;
+		pNode->pNext = pEvents;
+		if (pEvents)
+			pEvents->pPrev = pNode;
+		pNode->pPrev = 0;
+		pEvent->pBlechNode = this;
+		pEvents = pNode;
+	}
+
+	eBlechStringType   StringType = BST_NORMAL;
+	char*              pString = nullptr;
+	uint32_t           Length = 0;
+	BlechNode*         pParent = nullptr;
+	BlechNode**        ppRoot = nullptr;
+	BlechNode*         pChildren = nullptr;
+	BlechNode*         pNext = nullptr;
+	BlechNode*         pPrev = nullptr;
+	BLECHEVENTNODE*    pEvents = nullptr;
+
+private:
+	std::string        Storage;
+	BlechNodeArena*    pArena = nullptr;
+};
+
+// Nodes are allocated in blocks and recycled through a free list, rather than allocated one at a
+// time. Blocks are only released when the arena is destroyed.
+class BlechNodeArena
+{
+public:
+	BlechNodeArena() = default;
+	BlechNodeArena(const BlechNodeArena&) = delete;
+	BlechNodeArena& operator=(const BlechNodeArena&) = delete;
+
+	BlechNode* Create(BlechNode* Parent, BlechNode** Root, std::string_view String, eBlechStringType StringType)
+	{
+		BlechNode* pNode = m_freeList;
+		if (pNode)
 		{
-			BlechNode* pNext = pChildren->pNext;
-			delete pChildren;
-			pChildren = pNext;
+			m_freeList = pNode->pNext;
+			pNode->pNext = nullptr;
+		}
+		else
+		{
+			if (m_blocks.empty() || m_used == BlockSize)
+			{
+				m_blocks.push_back(std::make_unique<BlechNode[]>(BlockSize));
+				m_used = 0;
+			}
+
+			pNode = &m_blocks.back()[m_used++];
 		}
 
+		pNode->Initialize(this, Parent, Root, String, StringType);
+		return pNode;
+	}
+
+	// Destroys a node and everything below it, and unlinks it from its siblings and parent.
+	void Destroy(BlechNode* pNode)
+	{
+		BlechDebug("~BlechNode()");
+
+		// clean out chillins
+		while (pNode->pChildren)
+			Destroy(pNode->pChildren);
+
 		// clean out events
-		while (pEvents)
+		while (pNode->pEvents)
 		{
-			pEvents->pEvent->pBlechNode = 0;
-			PBLECHEVENTNODE pNext = pEvents->pNext;
-			delete pEvents;
-			pEvents = pNext;
+			pNode->pEvents->pEvent->pBlechNode = 0;
+			PBLECHEVENTNODE pNext = pNode->pEvents->pNext;
+			delete pNode->pEvents;
+			pNode->pEvents = pNext;
 		}
 
 		// remove me from my siblings
-		if (pPrev)
-			pPrev->pNext = pNext;
+		if (pNode->pPrev)
+			pNode->pPrev->pNext = pNode->pNext;
 		else
 		{
 			// set parent's first child / root
-			if (pParent)
-				pParent->pChildren = pNext;
+			if (pNode->pParent)
+				pNode->pParent->pChildren = pNode->pNext;
 			else
 			{
-				if (*ppRoot == this)
-					* ppRoot = pNext;
+				if (*pNode->ppRoot == pNode)
+					*pNode->ppRoot = pNode->pNext;
 			}
 		}
-		if (pNext)
-			pNext->pPrev = pPrev;
-
-		// free string
-		delete[] pString;
+		if (pNode->pNext)
+			pNode->pNext->pPrev = pNode->pPrev;
+
+		pNode->pParent = nullptr;
+		pNode->ppRoot = nullptr;
+		pNode->pPrev = nullptr;
+		pNode->pNext = m_freeList;
+		m_freeList = pNode;
 	}
 
-	BlechNode* AddChild(const char* NewString, eBlechStringType NewStringType)
-	{
-		BlechDebug("AddChild(%s,%d)", NewString, NewStringType);
-		BLECHASSERT(NewString);
+private:
+	static constexpr size_t BlockSize = 64;
 
-		BlechNode* pChild = pChildren;
-		while (pChild)
+	std::vector<std::unique_ptr<BlechNode[]>> m_blocks;
+	size_t m_used = 0;
+	BlechNode* m_freeList = nullptr;
+};
+
+inline BlechNode* BlechNode::AddChild(const char* NewString, eBlechStringType NewStringType)
+{
+	BlechDebug("AddChild(%s,%d)", NewString, NewStringType);
+	BLECHASSERT(NewString);
+
+	BlechNode* pChild = pChildren;
+	while (pChild)
+	{
+		if (pChild->StringType == NewStringType)
 		{
-			if (pChild->StringType == NewStringType)
+			if (NewStringType == BST_NORMAL)
 			{
-				if (NewStringType == BST_NORMAL)
+				if (unsigned int Eq = Equalness(pChild->pString, NewString))
 				{
-					if (unsigned int Eq = Equalness(pChild->pString, NewString))
+					unsigned int Len = (unsigned int)strlen(NewString);
+					if (Len == Eq)
 					{
-						unsigned int Len = (unsigned int)strlen(NewString);
-						if (Len == Eq)
-						{
-							if (Eq == pChild->Length)
-							{
-								return pChild;
-							}
-							// old child needs to be child of new child!
-
-							// make new child, redo pChild as child of new child...
-							BlechNode* pNode = new BlechNode(this, ppRoot, NewString, NewStringType);
-							BLECHASSERT(pNode);
-							if (pNode->pNext = pChild->pNext)
-								pNode->pNext->pPrev = pNode;
-							if (pNode->pPrev = pChild->pPrev)
-								pNode->pPrev->pNext = pNode;
-							else
-								pChildren = pNode;
-							pChild->pNext = 0;
-							pChild->pPrev = 0;
-
-							pChild->pParent = pNode;
-							pNode->pChildren = pChild;
-							memmove(pChild->pString, &pChild->pString[Eq], pChild->Length - Eq + 1);
-							pChild->Length -= Eq;
-
-							return pNode;
-							// and return that new child
-						}
-						else if (Eq == pChild->Length)
+						if (Eq == pChild->Length)
 						{
-							// easy one
-							return pChild->AddChild(&NewString[Eq], NewStringType);
+							return pChild;
 						}
-						// both children (new and old) need to be children of a new child
+						// old child needs to be child of new child!
 
 						// make new child, redo pChild as child of new child...
-						char Temp = pChild->pString[Eq];
-						pChild->pString[Eq] = 0;
-						BlechNode* pNode = new BlechNode(this, ppRoot, pChild->pString, NewStringType);
-						pChild->pString[Eq] = Temp;
+						BlechNode* pNode = pArena->Create(this, ppRoot, NewString, NewStringType);
 						BLECHASSERT(pNode);
 						if (pNode->pNext = pChild->pNext)
 							pNode->pNext->pPrev = pNode;
@@ -343,65 +390,59 @@ public:
 						pChild->pNext = 0;
 						pChild->pPrev = 0;
 
-
 						pChild->pParent = pNode;
 						pNode->pChildren = pChild;
+						pChild->RemovePrefix(Eq);
 
-						memmove(pChild->pString, &pChild->pString[Eq], pChild->Length - Eq + 1);
-						pChild->Length -= Eq;
-						return pNode->AddChild(&NewString[Eq], NewStringType);
-						// and return a very new child!
+						return pNode;
+						// and return that new child
 					}
-				}
-				else
-				{
-					if (!strcmp(pChild->pString, NewString))
-						return pChild;
-				}
-			}
-			pChild = pChild->pNext;
-		}
+					else if (Eq == pChild->Length)
+					{
+						// easy one
+						return pChild->AddChild(&NewString[Eq], NewStringType);
+					}
+					// both children (new and old) need to be children of a new child
+
+					// make new child, redo pChild as child of new child...
+					BlechNode* pNode = pArena->Create(this, ppRoot, std::string_view(pChild->pString, Eq), NewStringType);
+					BLECHASSERT(pNode);
+					if (pNode->pNext = pChild->pNext)
+						pNode->pNext->pPrev = pNode;
+					if (pNode->pPrev = pChild->pPrev)
+						pNode->pPrev->pNext = pNode;
+					else
+						pChildren = pNode;
+					pChild->pNext = 0;
+					pChild->pPrev = 0;
 
 
-		BlechNode* pNode = new BlechNode(this, ppRoot, NewString, NewStringType);
-		BLECHASSERT(pNode);
-		pNode->pNext = pChildren;
-		if (pChildren)
-			pChildren->pPrev = pNode;
-		pChildren = pNode;
-		return pChildren;
-	}
+					pChild->pParent = pNode;
+					pNode->pChildren = pChild;
 
-	bool IsEmpty()
-	{
-		return (!pChildren && !pEvents);
+					pChild->RemovePrefix(Eq);
+					return pNode->AddChild(&NewString[Eq], NewStringType);
+					// and return a very new child!
+				}
+			}
+			else
+			{
+				if (!strcmp(pChild->pString, NewString))
+					return pChild;
+			}
+		}
+		pChild = pChild->pNext;
 	}
 
-	void AddEvent(PBLECHEVENT pEvent)
-	{
-		BlechDebug("AddEvent(%X)", pEvent);
-		BLECHASSERT(pEvent);
-
-		PBLECHEVENTNODE pNode = new BLECHEVENTNODE;
-		pNode->pEvent = pEvent;
-		pNode->pNext = pEvents;
-		if (pEvents)
-			pEvents->pPrev = pNode;
-		pNode->pPrev = 0;
-		pEvent->pBlechNode = this;
-		pEvents = pNode;
-	}
 
-	eBlechStringType   StringType;
-	char*              pString = nullptr;
-	uint32_t           Length = 0;
-	BlechNode*         pParent = nullptr;
-	BlechNode**        ppRoot = nullptr;
-	BlechNode*         pChildren = nullptr;
-	BlechNode*         pNext = nullptr;
-	BlechNode*         pPrev = nullptr;
-	BLECHEVENTNODE*    pEvents = nullptr;
-};
+	BlechNode* pNode = pArena->Create(this, ppRoot, NewString, NewStringType);
+	BLECHASSERT(pNode);
+	pNode->pNext = pChildren;
+	if (pChildren)
+		pChildren->pPrev = pNode;
+	pChildren = pNode;
+	return pChildren;
+}
 
 class Blech
 {
@@ -489,6 +530,7 @@ public:
 		Cleanup();
 		m_eventMap.clear();
 		Initialize();
+		m_revision++;
 	}
 
 	~Blech()
@@ -592,6 +634,7 @@ public:
 		rEvent.OriginalString = Text;
 
 		pNode->AddEvent(&rEvent);
+		m_revision++;
 
 		return rEvent.ID;
 	}
@@ -620,6 +663,7 @@ public:
 					pEventNode->pPrev->pNext = pEventNode->pNext;
 				else
 					pNode->pEvents = pEventNode->pNext;
+				delete pEventNode;
 				break;
 			}
 			pEventNode = pEventNode->pNext;
@@ -628,11 +672,12 @@ public:
 		while (pNode && pNode->IsEmpty())
 		{
 			BlechNode* pNext = pNode->pParent;
-			delete pNode;
+			m_nodeArena.Destroy(pNode);
 			pNode = pNext;
 		}
 
 		m_eventMap.erase(ID);
+		m_revision++;
 		return true;
 	}
 
@@ -641,52 +686,118 @@ public:
 		return m_eventMap.empty();
 	}
 
-	char Version[32];
+	// Changes whenever an event is added or removed.
+	unsigned int GetRevision() const
+	{
+		return m_revision;
+	}
 
-private:
-	inline void FreeExecution(PBLECHEXECUTE pExecute)
+	// Calls Callback(ID, Literals) for each event, where Literals is the plain text of every node on the
+	// event's path through the tree. Text can only trigger an event if it contains all of its literals.
+	template <typename Callback>
+	void EnumerateEventLiterals(Callback&& callback) const
 	{
-		if (pExecute)
+		std::vector<std::string_view> literals;
+
+		for (const auto& [ID, rEvent] : m_eventMap)
 		{
-			if (PBLECHVALUE pValue = pExecute->pValues)
+			literals.clear();
+
+			for (BlechNode* pNode = rEvent.pBlechNode; pNode; pNode = pNode->pParent)
 			{
-				while (pValue)
-				{
-					PBLECHVALUE pNext = pValue->pNext;
-					delete pValue;
-					pValue = pNext;
-				}
+				if (pNode->StringType == BST_NORMAL)
+					literals.emplace_back(pNode->pString, pNode->Length);
 			}
 
-			delete pExecute;
+			callback(ID, literals);
 		}
 	}
 
-	void ClearExecutionList(PBLECHEXECUTE* ppExecuteList)
+	char Version[32];
+
+private:
+	// Per-feed working memory. Captured values are collected here while the tree is walked and the
+	// callbacks are only made once the walk is done, as before. Everything is kept between feeds, so
+	// once the buffers have grown to fit, feeding a line does not allocate. Callbacks may feed again,
+	// so each level of nesting gets its own scratch.
+	struct FeedScratch
 	{
-		PBLECHEXECUTE pExecuteList = *ppExecuteList;
-		*ppExecuteList = nullptr;
+		struct Capture
+		{
+			size_t           NameOffset;
+			size_t           NameLength;
+			std::string_view Value;
+		};
 
-		while (pExecuteList)
+		struct Execution
+		{
+			fBlechCallback   Callback;
+			uint32_t         ID;
+			void*            pData;
+			size_t           FirstCapture;
+			size_t           CaptureCount;
+		};
+
+		std::vector<BlechNode*> Path;
+		std::vector<Capture>    Captures;
+		std::string             Names;    // copies of the variable names, a callback may remove the nodes
+		std::vector<Execution>  Executions;
+		std::vector<BLECHVALUE> Values;
+
+		void Clear()
 		{
-			PBLECHEXECUTE pExecuteNext = pExecuteList->pNext;
-			FreeExecution(pExecuteList);
-			pExecuteList = pExecuteNext;
+			Path.clear();
+			Captures.clear();
+			Names.clear();
+			Executions.clear();
+			Values.clear();
 		}
+	};
+
+	FeedScratch& AcquireScratch()
+	{
+		if (m_feedDepth == m_feedScratch.size())
+			m_feedScratch.push_back(std::make_unique<FeedScratch>());
+
+		FeedScratch& Scratch = *m_feedScratch[m_feedDepth++];
+		Scratch.Clear();
+		return Scratch;
+	}
+
+	void ReleaseScratch()
+	{
+		BLECHASSERT(m_feedDepth > 0);
+		--m_feedDepth;
 	}
 
-	unsigned int ProcessExecutionList(PBLECHEXECUTE* ppExecuteList)
+	unsigned int ProcessExecutions(FeedScratch& Scratch)
 	{
+		Scratch.Values.resize(Scratch.Captures.size());
+		for (size_t N = 0; N < Scratch.Captures.size(); ++N)
+		{
+			const FeedScratch::Capture& rCapture = Scratch.Captures[N];
+			Scratch.Values[N].Name = std::string_view(Scratch.Names.data() + rCapture.NameOffset, rCapture.NameLength);
+			Scratch.Values[N].Value = rCapture.Value;
+		}
+
+		// events were always executed in the reverse of the order they were queued in
 		unsigned int n = 0;
-		PBLECHEXECUTE pExecuteList = *ppExecuteList;
-		*ppExecuteList = nullptr;
-		while (pExecuteList)
+		for (auto iter = Scratch.Executions.rbegin(); iter != Scratch.Executions.rend(); ++iter)
 		{
 			n++;
-			PBLECHEXECUTE pExecuteNext = pExecuteList->pNext;
-			pExecuteList->Callback(pExecuteList->ID, pExecuteList->pData, pExecuteList->pValues);
-			FreeExecution(pExecuteList);
-			pExecuteList = pExecuteNext;
+			PBLECHVALUE pValues = nullptr;
+
+			// events on the same node share their values, link them up again for each one
+			if (iter->CaptureCount)
+			{
+				pValues = &Scratch.Values[iter->FirstCapture];
+				for (size_t N = 0; N < iter->CaptureCount; ++N)
+				{
+					pValues[N].pNext = N + 1 < iter->CaptureCount ? &pValues[N + 1] : nullptr;
+				}
+			}
+
+			iter->Callback(iter->ID, iter->pData, pValues);
 		}
 		return n;
 	}
@@ -695,63 +806,38 @@ private:
 	{
 		for (unsigned int N = 0; N < 256; N++)
 		{
-			if (BlechNode * pNode = m_tree[N]) {
-				delete pNode;
-				m_tree[N] = nullptr;
-			}
+			while (BlechNode* pNode = m_tree[N])
+				m_nodeArena.Destroy(pNode);
 		}
 
 		m_eventMap.clear();
 		m_lastID = 0;
 	}
 
-
-	void QueueEvent(PBLECHEXECUTE* ppExecuteList, PBLECHEVENT pEvent, PBLECHVALUE pValues)
+	void AddCapture(FeedScratch& Scratch, BlechNode* pScanVar, std::string_view Value)
 	{
-		BlechDebug("QueueEvent(%X,%X)", pEvent, pValues);
-		BLECHASSERT(pEvent);
-
-		PBLECHEXECUTE pNew = new BLECHEXECUTE;
-		pNew->Callback = pEvent->Callback;
-		pNew->ID = pEvent->ID;
-		pNew->pData = pEvent->pData;
-
-		// make a COPY of values
-		if (pValues)
-		{
-			PBLECHVALUE pNewValueTail = nullptr;
-			pNew->pValues = nullptr;
+		FeedScratch::Capture& rCapture = Scratch.Captures.emplace_back();
+		rCapture.NameOffset = Scratch.Names.size();
+		rCapture.NameLength = strlen(pScanVar->pString);
+		rCapture.Value = Value;
 
-			while (pValues)
-			{
-				PBLECHVALUE pNewValue = new BLECHVALUE;
-				pNewValue->Name = pValues->Name;
-				pNewValue->Value = pValues->Value;
-				pNewValue->pNext = nullptr;
+		Scratch.Names.append(pScanVar->pString, rCapture.NameLength);
+	}
 
-				if (pNew->pValues)
-				{
-					pNewValueTail->pNext = pNewValue;
-					pNewValueTail = pNewValue;
-				}
-				else
-				{
-					pNewValueTail = pNew->pValues = pNewValue;
+	void QueueEvents(FeedScratch& Scratch, BlechNode* pNode, size_t FirstCapture)
+	{
+		BlechDebug("QueueEvents(%X,%d)", pNode, FirstCapture);
 
-				}
-				pValues = pValues->pNext;
-			}
-		}
-		else
+		PBLECHEVENTNODE pEventNode = pNode->pEvents;
+		while (pEventNode)
 		{
-			pNew->pValues = nullptr;
+			PBLECHEVENT pEvent = pEventNode->pEvent;
+			Scratch.Executions.push_back({ pEvent->Callback, pEvent->ID, pEvent->pData, FirstCapture, Scratch.Captures.size() - FirstCapture });
+			pEventNode = pEventNode->pNext;
 		}
-
-		pNew->pNext = *ppExecuteList;
-		*ppExecuteList = pNew;
 	}
 
-	void QueueEvents(PBLECHEXECUTE* ppExecuteList, BlechNode* pNode, const char* Input, unsigned int InputLength, size_t BufferSize)
+	void QueueEvents(FeedScratch& Scratch, BlechNode* pNode, const char* Input, unsigned int InputLength, size_t BufferSize)
 	{
 		BlechDebug("QueueEvents(%X,%s,%d)", pNode, Input, InputLength);
 		BLECHASSERT(pNode);
@@ -759,22 +845,21 @@ private:
 		BLECHASSERT(InputLength);
 		// ASSUME we have a complete match
 
-		// Get forward traversal list (reverse the links, into a new list)
-		PBLECHEVENTNODE pEventNode = nullptr;
-		PBLECHLISTNODE pList = nullptr;
+		// Get forward traversal list (the path is collected leaf first, and walked backwards)
+		Scratch.Path.clear();
 		BlechNode* pCurrent = pNode;
 		int nVariableNodes = 0;
 		while (pCurrent)
 		{
-			PBLECHLISTNODE pNewHead = new BLECHLISTNODE;
-			pNewHead->pNext = pList;
-			pNewHead->pNode = pCurrent;
-			pList = pNewHead;
+			Scratch.Path.push_back(pCurrent);
 			if (pCurrent->StringType == BST_SCANVAR)
 				nVariableNodes++;
 			pCurrent = pCurrent->pParent;
 		}
 
+		const size_t FirstCapture = Scratch.Captures.size();
+		const size_t NamesLength = Scratch.Names.size();
+
 		if (!nVariableNodes)
 		{
 			BlechDebugFull("No variable nodes");
@@ -788,20 +873,7 @@ private:
 			}
 			if (pNode && TestLength == InputLength)
 			{
-				PBLECHEVENTNODE pEventNode = pNode->pEvents;
-				while (pEventNode)
-				{
-					QueueEvent(ppExecuteList, pEventNode->pEvent, nullptr);
-					pEventNode = pEventNode->pNext;
-				}
-			}
-
-			// cleanup
-			while (pList)
-			{
-				PBLECHLISTNODE pNext = pList->pNext;
-				delete pList;
-				pList = pNext;
+				QueueEvents(Scratch, pNode, FirstCapture);
 			}
 			return;
 		}
@@ -813,13 +885,18 @@ private:
 		NonVariable[0] = 0;
 		const char* Pos = Input;
 
-		PBLECHVALUE pValues = nullptr;
-		PBLECHVALUE pValuesTail = nullptr;
+		// not a real match. goodbye!
+		// NOTE: this can be relatively normal, it is not a direct indication of an error
+		auto NoMatch = [&]()
+		{
+			Scratch.Captures.resize(FirstCapture);
+			Scratch.Names.resize(NamesLength);
+		};
 
 		BlechNode* pCurrentScanVar = nullptr;
-		while (pList)
+		for (auto iter = Scratch.Path.rbegin(); iter != Scratch.Path.rend(); ++iter)
 		{
-			pCurrent = pList->pNode;
+			pCurrent = *iter;
 			switch (pCurrent->StringType)
 			{
 			case BST_NORMAL:
@@ -837,51 +914,20 @@ private:
 					{
 						if (const char* End = STRFIND(Pos, NonVariable))
 						{
-							PBLECHVALUE pNewValue = new BLECHVALUE;
-							pNewValue->Name = pCurrentScanVar->pString;
-
-							size_t Length = End - Pos;
-							pNewValue->Value = std::string_view{ Pos, Length };
-
-							// TODO: Check this
-							pNewValue->Value[Length] = 0;
-							pNewValue->pNext = nullptr;
-
-							if (pValues)
-							{
-								pValuesTail->pNext = pNewValue;
-								pValuesTail = pNewValue;
-							}
-							else
-							{
-								pValuesTail = pValues = pNewValue;
-							}
+							AddCapture(Scratch, pCurrentScanVar, std::string_view{ Pos, (size_t)(End - Pos) });
 
 							Pos = End + strlen(NonVariable);
 							NonVariable[0] = 0;
 						}
 						else
 						{
-							// not a real match. goodbye!
-							// NOTE: this can be relatively normal, it is not a direct indication of an error
-							goto queueeventscleanup;
+							NoMatch();
+							return;
 						}
 					}
 					else
 					{
-						PBLECHVALUE pNewValue = new BLECHVALUE;
-						pNewValue->Name = pCurrentScanVar->pString;
-						pNewValue->pNext = nullptr;
-
-						if (pValues)
-						{
-							pValuesTail->pNext = pNewValue;
-							pValuesTail = pNewValue;
-						}
-						else
-						{
-							pValuesTail = pValues = pNewValue;
-						}
+						AddCapture(Scratch, pCurrentScanVar, std::string_view{});
 					}
 				}
 				else
@@ -889,9 +935,8 @@ private:
 					size_t NonVariableLength = strlen(NonVariable);
 					if (STRNCMP(NonVariable, Pos, NonVariableLength))
 					{
-						// not a real match. goodbye!
-						// NOTE: this can be relatively normal, it is not a direct indication of an error
-						goto queueeventscleanup;
+						NoMatch();
+						return;
 					}
 					Pos += NonVariableLength;
 					NonVariable[0] = 0;
@@ -899,11 +944,6 @@ private:
 				pCurrentScanVar = pCurrent;
 				break;
 			}
-
-
-			PBLECHLISTNODE pNext = pList->pNext;
-			delete pList;
-			pList = pNext;
 		}
 
 		if (pCurrentScanVar)
@@ -914,79 +954,31 @@ private:
 				size_t Length = End - Pos;
 				if (STRCMP(&Pos[Length], NonVariable))
 				{
-					goto queueeventscleanup;
+					NoMatch();
+					return;
 				}
 
-				PBLECHVALUE pNewValue = new BLECHVALUE;
-				pNewValue->Name = pCurrentScanVar->pString;
-				pNewValue->Value = std::string_view{ Pos, Length };
-				// TODO: Check this
-				pNewValue->Value[Length] = 0;
-				pNewValue->pNext = nullptr;
-
-				if (pValues)
-				{
-					pValuesTail->pNext = pNewValue;
-					pValuesTail = pNewValue;
-				}
-				else
-				{
-					pValuesTail = pValues = pNewValue;
-				}
+				AddCapture(Scratch, pCurrentScanVar, std::string_view{ Pos, Length });
 
 				Pos = End;
 				NonVariable[0] = 0;
 			}
 			else
 			{
-				PBLECHVALUE pNewValue = new BLECHVALUE;
-				pNewValue->Name = pCurrentScanVar->pString;
-				pNewValue->Value = Pos;
-				pNewValue->pNext = nullptr;
-				if (pValues)
-				{
-					pValuesTail->pNext = pNewValue;
-					pValuesTail = pNewValue;
-				}
-				else
-				{
-					pValuesTail = pValues = pNewValue;
-				}
+				AddCapture(Scratch, pCurrentScanVar, std::string_view{ Pos, (size_t)(&Input[InputLength] - Pos) });
 			}
 		}
 		else if (NonVariable[0])
 		{
 			if (STRCMP(NonVariable, Pos))
 			{
-				// not a real match. goodbye!
-				// NOTE: this can be relatively normal, it is not a direct indication of an error
-				goto queueeventscleanup;
+				NoMatch();
+				return;
 			}
 		}
 
 		// add to execution list
-		pEventNode = pNode->pEvents;
-		while (pEventNode)
-		{
-			QueueEvent(ppExecuteList, pEventNode->pEvent, pValues);
-			pEventNode = pEventNode->pNext;
-		}
-
-		// cleanup
-	queueeventscleanup:
-		while (pValues)
-		{
-			PBLECHVALUE pNext = pValues->pNext;
-			delete pValues;
-			pValues = pNext;
-		}
-
-		while (pList)
-		{
-			PBLECHLISTNODE pNext = pList->pNext;
-			delete pList;
-			pList = pNext;
-		}
+		QueueEvents(Scratch, pNode, FirstCapture);
 	}
 
 	struct MatchPos
@@ -1001,7 +993,7 @@ private:
 		BLECHASSERT(Input);
 		if (!pNode)
 			return 0;
-		PBLECHEXECUTE pExecuteList = 0;
+		FeedScratch& Scratch = AcquireScratch();
 		unsigned int Length = (unsigned int)strlen(Input);
 		const char* pEnd = &Input[Length];
 		char VarData[4096] = { 0 };
@@ -1108,7 +1100,7 @@ private:
 		feedermatchdoevents:
 			{
 				BlechDebug("feedermatchdoevents");
-				QueueEvents(&pExecuteList, pNode, Input, Length, BufferSize);
+				QueueEvents(Scratch, pNode, Input, Length, BufferSize);
 			}
 		feedermatchnoevent:
 			{
@@ -1197,7 +1189,8 @@ private:
 		}
 	chewcomplete:
 		// execute any queued events
-		unsigned int Count = ProcessExecutionList(&pExecuteList);
+		unsigned int Count = ProcessExecutions(Scratch);
+		ReleaseScratch();
 		BlechDebug("Chew returns %d", Count);
 		return Count;
 #undef Push
@@ -1233,7 +1226,7 @@ private:
 							// old child needs to be child of new child!
 
 							// make new child, redo pChild as child of new child...
-							BlechNode* pNode = new BlechNode(0, &m_tree[nRoot], String, StringType);
+							BlechNode* pNode = m_nodeArena.Create(nullptr, &m_tree[nRoot], String, StringType);
 							BLECHASSERT(pNode);
 							if (pNode->pNext = pChild->pNext)
 								pNode->pNext->pPrev = pNode;
@@ -1246,8 +1239,7 @@ private:
 
 							pChild->pParent = pNode;
 							pNode->pChildren = pChild;
-							memmove(pChild->pString, &pChild->pString[Eq], pChild->Length - Eq + 1);
-							pChild->Length -= Eq;
+							pChild->RemovePrefix(Eq);
 
 							return pNode;
 							// and return that new child
@@ -1260,10 +1252,7 @@ private:
 						// both children (new and old) need to be children of a new child
 
 						// make new child, redo pChild as child of new child...
-						char Temp = pChild->pString[Eq];
-						pChild->pString[Eq] = 0;
-						BlechNode* pNode = new BlechNode(0, &m_tree[nRoot], pChild->pString, StringType);
-						pChild->pString[Eq] = Temp;
+						BlechNode* pNode = m_nodeArena.Create(nullptr, &m_tree[nRoot], std::string_view(pChild->pString, Eq), StringType);
 						BLECHASSERT(pNode);
 						if (pNode->pNext = pChild->pNext)
 							pNode->pNext->pPrev = pNode;
@@ -1277,8 +1266,7 @@ private:
 						pChild->pParent = pNode;
 						pNode->pChildren = pChild;
 
-						memmove(pChild->pString, &pChild->pString[Eq], pChild->Length - Eq + 1);
-						pChild->Length -= Eq;
+						pChild->RemovePrefix(Eq);
 						return pNode->AddChild(&String[Eq], StringType);
 						// and return a very new child!
 					}
@@ -1292,7 +1280,7 @@ private:
 			pChild = pChild->pNext;
 		}
 
-		BlechNode* pNode = new BlechNode(nullptr, &m_tree[nRoot], String, StringType);
+		BlechNode* pNode = m_nodeArena.Create(nullptr, &m_tree[nRoot], String, StringType);
 		BLECHASSERT(pNode);
 
 		pNode->pNext = m_tree[nRoot];
@@ -1309,12 +1297,7 @@ private:
 		BLECHASSERT(StringBegin && *StringBegin);
 		BLECHASSERT(StringEnd);
 
-		unsigned int Len = (unsigned int)(StringEnd - StringBegin);
-		char* String = new char[Len + 1];
-		if (!String)
-			return nullptr;
-		memcpy(String, StringBegin, Len);
-		String[Len] = 0;
+		const std::string String(StringBegin, StringEnd);
 		if (!pNode)
 		{
 			// find and/or create new root
@@ -1323,26 +1306,21 @@ private:
 				Root = 0;
 			else
 			{
-				Root = (unsigned char)* String;
+				Root = (unsigned char)String[0];
 #ifndef BLECH_CASE_SENSITIVE
 				if (Root >= 'a' && Root <= 'z')
 					Root -= 32;
 #endif
 			}
 
-			BlechNode* pNew = AddNode(Root, String, StringType);
-			delete[] String;
-			return pNew;
+			return AddNode(Root, String.c_str(), StringType);
 		}
 		else
 		{
 			// attach to this node
 
 			// create new
-			BlechNode* pNew = pNode->AddChild(String, StringType);
-
-			delete[] String;
-			return pNew;
+			return pNode->AddChild(String.c_str(), StringType);
 		}
 	}
 
@@ -1361,9 +1339,13 @@ private:
 	}
 
 	unsigned int m_lastID = 0;
+	unsigned int m_revision = 0;
 	char m_printVarDelimiter = 0;
 	char m_scanVarDelimiter = 0;
 	fBlechVariableValue m_variableValue = nullptr;
 	BlechEventMap m_eventMap;
+	BlechNodeArena m_nodeArena;
 	BlechNode* m_tree[256];
+	std::vector<std::unique_ptr<FeedScratch>> m_feedScratch;
+	size_t m_feedDepth = 0;
 };
\ No newline at end of file
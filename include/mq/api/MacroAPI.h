@@ -161,6 +161,29 @@ MQLIB_API int EvaluateMacroDataMember(MQ2Type* Type, MQVarPtr VarPtr, MQTypeVar&
 // Returns false if the given name is neither a member nor a method of the given type.
 MQLIB_OBJECT bool FindMacroDataMember(MQ2Type* Type, const std::string& Member);
 
+// A member of a type that has been looked up ahead of time by ResolveMacroDataMember. Evaluating a
+// resolved member skips the name lookups that EvaluateMacroDataMember has to do on every call.
+struct MQResolvedMember
+{
+	MQ2Type* Type = nullptr;                // the type the member was resolved against
+	MQ2Type* Owner = nullptr;               // the type or extension whose GetMember handles it
+	MQTypeMember* Member = nullptr;         // the owner's member or method, null if it is inherited
+	uint32_t Revision = 0;
+	bool Found = false;                     // the owner has or inherits a member with this name
+	bool Exists = false;                    // same as FindMacroDataMember
+};
+
+// Incremented whenever a type, type extension, member or method is added or removed. A resolved
+// member from an earlier revision is no longer valid.
+MQLIB_API uint32_t GetMacroDataRevision();
+
+MQLIB_OBJECT bool ResolveMacroDataMember(MQ2Type* Type, const std::string& Member, MQResolvedMember& Result);
+
+// Same as EvaluateMacroDataMember. Member must be the name that was resolved. If the resolved member
+// is out of date, the member is looked up by name instead.
+MQLIB_OBJECT int EvaluateResolvedMacroDataMember(const MQResolvedMember& Resolved, MQVarPtr VarPtr, MQTypeVar& Result,
+	const char* Member, char* pIndex);
+
 //----------------------------------------------------------------------------
 // Macro Variables
 
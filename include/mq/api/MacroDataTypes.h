@@ -17,17 +17,22 @@
 #include "mq/base/Common.h"
 #include "mq/base/Deprecation.h"
 #include "mq/base/PluginHandle.h"
+#include "mq/base/SnapshotCache.h"
 
 #include "eqlib/base/Color.h"
 #include "eqlib/CXStr.h"
 #include "eqlib/Items.h"
 
+#include <atomic>
 #include <functional>
 #include <memory>
 #include <mutex>
 #include <optional>
+#include <string>
 #include <string_view>
+#include <unordered_map>
 #include <variant>
+#include <vector>
 
 #define TypeMember(name) AddMember(static_cast<int>(name), #name)
 #define ScopedTypeMember(scope, name) AddMember(static_cast<int>(scope::name), #name)
@@ -521,10 +526,36 @@ protected:
 	mutable std::mutex m_mutex;
 
 private:
+	// A read-only copy of the member and method maps. Lookups read the current table without locking.
+	// Changes invalidate it, and the next lookup builds a new one under the lock.
+	struct MemberTable
+	{
+		std::vector<std::string> Names;
+		std::unordered_map<std::string_view, MQTypeMember*> Members;
+		std::unordered_map<std::string_view, MQTypeMember*> Methods;
+	};
+
+	void BuildMemberTable(MemberTable& table) const;
+
+	template <typename ReadFunc>
+	auto ReadMemberTable(ReadFunc&& read) const
+	{
+		return m_memberTables.Read(m_mutex, [this](MemberTable& table) { BuildMemberTable(table); }, read);
+	}
+
+	void RetireMember(std::unique_ptr<MQTypeMember> member);
+	std::unique_ptr<MQTypeMember> ReviveMember(int ID, const char* Name, uint32_t Type);
+
 	std::vector<std::unique_ptr<MQTypeMember>> Members;
 	std::vector<std::unique_ptr<MQTypeMember>> Methods;
 	std::unordered_map<std::string, int> MemberMap;
 	std::unordered_map<std::string, int> MethodMap;
+
+	// Removed members and methods. Lookups that ran before the removal may still be holding them,
+	// so they live as long as the type does, and are reused if the same member is added again.
+	std::vector<std::unique_ptr<MQTypeMember>> m_removedMembers;
+
+	SnapshotCache<MemberTable> m_memberTables;
 };
 
 } // namespace datatypes
@@ -124,6 +124,21 @@ public:
 	virtual MQTopLevelObject* FindTopLevelObject(
 		const char* name) = 0;
 
+	//
+	// Plugin API
+	//
+
+	virtual MQPulseTaskId AddPulseTask(
+		std::string_view name,
+		MQPulseTaskHandler handler,
+		uint32_t intervalMS,
+		uint32_t budgetUS,
+		const MQPluginHandle& pluginHandle) = 0;
+
+	virtual bool RemovePulseTask(
+		MQPulseTaskId taskId,
+		const MQPluginHandle& pluginHandle) = 0;
+
 };
 
 MQLIB_OBJECT MainInterface* GetMainInterface();
@@ -17,6 +17,7 @@
 #include "mq/base/Common.h"
 #include "mq/base/PluginHandle.h"
 
+#include <functional>
 #include <string_view>
 #include <string>
 
@@ -186,6 +187,47 @@ public:
  */
 MQLIB_API PluginInterface* GetPluginInterface(std::string_view pluginName);
 
+//
+// Pulse Tasks
+//
+
+/**
+ * A handler function that is invoked when a pulse task runs.
+ */
+using MQPulseTaskHandler = std::function<void()>;
+
+/**
+ * Identifies a task that was registered with AddPulseTask. Zero is never a valid task id.
+ */
+using MQPulseTaskId = uint32_t;
+
+/**
+ * Register a task to be run periodically from the pulse. This is an alternative to OnPulse for
+ * work that doesn't need to happen every frame. Each pulse, the tasks that are due are run, most
+ * overdue first, until the time set aside for pulse tasks in that pulse is spent. The remaining
+ * tasks run on a later pulse. Every run is timed, and a task that repeatedly takes longer than its
+ * budget will run less often until it gets back under budget.
+ *
+ * Tasks are removed automatically when the plugin that registered them is unloaded.
+ *
+ * @param name Name of the task, used in benchmarks and reports.
+ * @param handler The function that will be called when the task runs.
+ * @param intervalMS How often the task should run, in milliseconds. Zero runs the task as often
+ * as the budget allows.
+ * @param budgetUS How long a single run of the task is expected to take, in microseconds.
+ * @return The id of the new task, or 0 if the task could not be added.
+ */
+MQPulseTaskId AddPulseTask(std::string_view name, MQPulseTaskHandler handler, uint32_t intervalMS, uint32_t budgetUS = 500);
+
+/**
+ * Remove a previously registered pulse task.
+ *
+ * @param taskId The id returned by AddPulseTask.
+ * @return True if the task was removed.
+ */
+bool RemovePulseTask(MQPulseTaskId taskId);
+
+
 
 MQLIB_API DEPRECATE("Use mq::LoadPlugin instead of LoadMQ2Plugin")
 inline int LoadMQ2Plugin(const char* pszFilename, bool bCustom = false) { return mq::LoadPlugin(pszFilename, false); }
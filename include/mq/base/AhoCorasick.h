@@ -0,0 +1,203 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-present MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace mq {
+
+// Finds every occurrence of a set of patterns in a single pass over the text. Matching ignores
+// ASCII case unless the matcher is created as case sensitive.
+class AhoCorasick
+{
+public:
+	explicit AhoCorasick(bool caseSensitive = false)
+		: m_caseSensitive(caseSensitive)
+	{
+		Clear();
+	}
+
+	// Adds a non-empty pattern and returns its index. Call Build once all patterns have been added.
+	uint32_t AddPattern(std::string_view pattern)
+	{
+		m_built = false;
+
+		uint32_t node = 0;
+		for (char ch : pattern)
+		{
+			const uint8_t c = Fold(ch);
+
+			auto iter = std::find_if(m_trie[node].children.begin(), m_trie[node].children.end(),
+				[c](const auto& child) { return child.first == c; });
+
+			if (iter != m_trie[node].children.end())
+			{
+				node = iter->second;
+				continue;
+			}
+
+			const uint32_t child = static_cast<uint32_t>(m_trie.size());
+			m_trie[node].children.emplace_back(c, child);
+			m_trie.emplace_back();
+			node = child;
+		}
+
+		const uint32_t index = m_patternCount++;
+		m_trie[node].outputs.push_back(index);
+		m_patternLengths.push_back(static_cast<uint32_t>(pattern.size()));
+
+		return index;
+	}
+
+	// Computes the failure links and the transition table.
+	void Build()
+	{
+		// characters that don't appear in any pattern all share class 0
+		std::fill(std::begin(m_classes), std::end(m_classes), static_cast<uint16_t>(0));
+		m_classCount = 1;
+
+		for (const TrieNode& trieNode : m_trie)
+		{
+			for (const auto& [c, child] : trieNode.children)
+			{
+				if (m_classes[c] == 0)
+					m_classes[c] = static_cast<uint16_t>(m_classCount++);
+			}
+		}
+
+		m_delta.assign(m_trie.size() * m_classCount, 0);
+		m_outputStart.assign(m_trie.size() + 1, 0);
+
+		std::vector<uint32_t> fail(m_trie.size(), 0);
+		std::vector<uint32_t> order;
+		order.reserve(m_trie.size());
+
+		// breadth first, so that a node's failure target is always complete before the node itself
+		std::deque<uint32_t> queue;
+		for (const auto& [c, child] : m_trie[0].children)
+		{
+			m_delta[m_classes[c]] = child;
+			queue.push_back(child);
+		}
+
+		order.push_back(0);
+		while (!queue.empty())
+		{
+			const uint32_t node = queue.front();
+			queue.pop_front();
+			order.push_back(node);
+
+			// inherit the failure target's transitions, then override with our own children
+			std::copy_n(&m_delta[fail[node] * m_classCount], m_classCount, &m_delta[node * m_classCount]);
+
+			for (const auto& [c, child] : m_trie[node].children)
+			{
+				fail[child] = m_delta[fail[node] * m_classCount + m_classes[c]];
+				m_delta[node * m_classCount + m_classes[c]] = child;
+				queue.push_back(child);
+			}
+		}
+
+		// flatten each node's outputs together with those of its failure chain
+		std::vector<std::vector<uint32_t>> outputs(m_trie.size());
+		for (uint32_t node : order)
+		{
+			outputs[node] = m_trie[node].outputs;
+			if (node != 0)
+				outputs[node].insert(outputs[node].end(), outputs[fail[node]].begin(), outputs[fail[node]].end());
+		}
+
+		m_outputs.clear();
+		for (uint32_t node = 0; node < m_trie.size(); ++node)
+		{
+			m_outputStart[node] = static_cast<uint32_t>(m_outputs.size());
+			m_outputs.insert(m_outputs.end(), outputs[node].begin(), outputs[node].end());
+		}
+		m_outputStart[m_trie.size()] = static_cast<uint32_t>(m_outputs.size());
+
+		m_built = true;
+	}
+
+	void Clear()
+	{
+		m_trie.clear();
+		m_trie.emplace_back();
+		m_patternLengths.clear();
+		m_patternCount = 0;
+		m_delta.clear();
+		m_outputs.clear();
+		m_outputStart.clear();
+		m_built = false;
+	}
+
+	bool IsBuilt() const { return m_built; }
+	uint32_t GetPatternCount() const { return m_patternCount; }
+	uint32_t GetPatternLength(uint32_t index) const { return m_patternLengths[index]; }
+
+	// Calls callback(patternIndex, offset) for every match, in the order that they end in the text.
+	// offset is the position of the first character of the match.
+	template <typename Callback>
+	void Scan(std::string_view text, Callback&& callback) const
+	{
+		if (!m_built || m_patternCount == 0)
+			return;
+
+		uint32_t node = 0;
+		for (size_t pos = 0; pos < text.size(); ++pos)
+		{
+			node = m_delta[node * m_classCount + m_classes[Fold(text[pos])]];
+
+			for (uint32_t i = m_outputStart[node]; i < m_outputStart[node + 1]; ++i)
+			{
+				const uint32_t index = m_outputs[i];
+				callback(index, pos + 1 - m_patternLengths[index]);
+			}
+		}
+	}
+
+private:
+	struct TrieNode
+	{
+		std::vector<std::pair<uint8_t, uint32_t>> children;
+		std::vector<uint32_t> outputs;
+	};
+
+	uint8_t Fold(char ch) const
+	{
+		const uint8_t c = static_cast<uint8_t>(ch);
+		if (!m_caseSensitive && c >= 'A' && c <= 'Z')
+			return static_cast<uint8_t>(c + ('a' - 'A'));
+		return c;
+	}
+
+	bool m_caseSensitive;
+	bool m_built = false;
+	uint32_t m_patternCount = 0;
+	std::vector<TrieNode> m_trie;
+	std::vector<uint32_t> m_patternLengths;
+
+	uint16_t m_classes[256] = {};
+	uint32_t m_classCount = 1;
+	std::vector<uint32_t> m_delta;
+	std::vector<uint32_t> m_outputs;
+	std::vector<uint32_t> m_outputStart;
+};
+
+} // namespace mq
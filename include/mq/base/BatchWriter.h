@@ -0,0 +1,146 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-present MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <utility>
+
+namespace mq {
+
+// Hands values to a write function on a background thread, in batches of whatever has queued up
+// since the last write. Add only takes a short lock, so the caller never waits for a write. If the
+// writer falls behind, the queue is capped by dropping the oldest values. Anything still queued is
+// written when the writer is destroyed. If the thread can't be started, or isn't wanted, values are
+// written one at a time from Add instead.
+template <typename T>
+class BatchWriter
+{
+public:
+	using WriteFunc = std::function<void(const std::deque<T>&)>;
+
+	BatchWriter(WriteFunc write, size_t maxQueued, bool threaded = true)
+		: m_write(std::move(write))
+		, m_maxQueued(maxQueued)
+	{
+		if (threaded)
+		{
+			try
+			{
+				m_running = true;
+				m_thread = std::thread([this]() { ThreadProc(); });
+			}
+			catch (const std::system_error&)
+			{
+				m_running = false;
+			}
+		}
+	}
+
+	BatchWriter(const BatchWriter&) = delete;
+	BatchWriter& operator=(const BatchWriter&) = delete;
+
+	~BatchWriter()
+	{
+		if (m_thread.joinable())
+		{
+			{
+				std::scoped_lock lock(m_mutex);
+				m_running = false;
+			}
+
+			m_wakeup.notify_one();
+			m_thread.join();
+		}
+
+		// anything left over gets written before we go
+		if (!m_queue.empty())
+			m_write(m_queue);
+	}
+
+	void Add(T value)
+	{
+		if (!m_thread.joinable())
+		{
+			std::deque<T> values;
+			values.push_back(std::move(value));
+			m_write(values);
+			return;
+		}
+
+		{
+			std::scoped_lock lock(m_mutex);
+
+			// If the writer can't keep up, drop the oldest values rather than block the caller.
+			if (m_queue.size() >= m_maxQueued)
+			{
+				m_queue.pop_front();
+				++m_dropped;
+			}
+
+			m_queue.push_back(std::move(value));
+		}
+
+		m_wakeup.notify_one();
+	}
+
+	bool IsThreaded() const
+	{
+		return m_thread.joinable();
+	}
+
+	// The number of values that were dropped because the queue was full.
+	size_t GetDroppedCount() const
+	{
+		std::scoped_lock lock(m_mutex);
+		return m_dropped;
+	}
+
+private:
+	void ThreadProc()
+	{
+		std::deque<T> values;
+
+		std::unique_lock lock(m_mutex);
+		while (m_running)
+		{
+			m_wakeup.wait(lock, [this]() { return !m_running || !m_queue.empty(); });
+
+			values.clear();
+			std::swap(values, m_queue);
+
+			lock.unlock();
+			if (!values.empty())
+				m_write(values);
+			lock.lock();
+		}
+	}
+
+	WriteFunc m_write;
+	size_t m_maxQueued;
+
+	std::thread m_thread;
+	mutable std::mutex m_mutex;
+	std::condition_variable m_wakeup;
+	std::deque<T> m_queue;
+	size_t m_dropped = 0;
+	bool m_running = false;
+};
+
+} // namespace mq
@@ -15,8 +15,11 @@
 #pragma once
 
 #include <mq/base/Color.h>
+#include <mq/base/PrivateProfileCache.h>
 #include <mq/base/String.h>
 
+#include <algorithm>
+#include <optional>
 #include <string>
 #include <vector>
 #include <filesystem>
@@ -31,12 +34,84 @@
 
 namespace mq {
 
+namespace detail {
+
+// Behaves like GetPrivateProfileStringA, but answers from PrivateProfileCache when it can.
+inline DWORD GetCachedProfileString(const char* Section, const char* Key, const char* DefaultValue, char* Return, DWORD Size, const char* iniFileName)
+{
+	std::string_view defaultValue = DefaultValue ? DefaultValue : "";
+
+	// the API drops trailing blanks from the default
+	while (!defaultValue.empty() && defaultValue.back() == ' ')
+		defaultValue.remove_suffix(1);
+
+	// leave anything unusual about the default to the API as well
+	const bool simpleDefault = defaultValue.empty() || (defaultValue.front() != '"' && defaultValue.front() != '\'');
+
+	DWORD length = 0;
+	if (Size == 0 || !simpleDefault
+		|| !PrivateProfileCache::Get().Lookup(Section, Key, iniFileName, [&](const std::string_view* value)
+			{
+				const std::string_view result = value ? *value : defaultValue;
+
+				length = static_cast<DWORD>(std::min<size_t>(result.length(), Size - 1));
+				memcpy(Return, result.data(), length);
+				Return[length] = 0;
+			}))
+	{
+		return ::GetPrivateProfileStringA(Section, Key, DefaultValue, Return, Size, iniFileName);
+	}
+
+	return length;
+}
+
+// Behaves like GetPrivateProfileIntA, but answers from PrivateProfileCache when it can. Only plain
+// decimal values are parsed here, anything else goes to the API.
+inline int GetCachedProfileInt(const char* Section, const char* Key, int DefaultValue, const char* iniFileName)
+{
+	std::optional<int> result;
+
+	PrivateProfileCache::Get().Lookup(Section, Key, iniFileName, [&](const std::string_view* value)
+		{
+			if (!value || value->empty())
+			{
+				result = DefaultValue;
+				return;
+			}
+
+			std::string_view digits = *value;
+			const bool negative = digits.front() == '-';
+			if (negative || digits.front() == '+')
+				digits.remove_prefix(1);
+
+			if (digits.empty() || digits.length() > 9)
+				return;
+
+			int parsed = 0;
+			for (char ch : digits)
+			{
+				if (ch < '0' || ch > '9')
+					return;
+				parsed = parsed * 10 + (ch - '0');
+			}
+
+			result = negative ? -parsed : parsed;
+		});
+
+	if (result)
+		return *result;
+
+	return ::GetPrivateProfileIntA(Section, Key, DefaultValue, iniFileName);
+}
+
+} // namespace detail
+
 inline float GetPrivateProfileFloat(const std::string& Section, const std::string& Key, const float DefaultValue, const std::string& iniFileName)
 {
 	const std::string strDefaultValue = std::to_string(DefaultValue);
 	const size_t Size = 100;
 	char Return[Size] = { 0 };
-	::GetPrivateProfileStringA(Section.c_str(), Key.c_str(), strDefaultValue.c_str(), Return, Size, iniFileName.c_str());
+	detail::GetCachedProfileString(Section.c_str(), Key.c_str(), strDefaultValue.c_str(), Return, Size, iniFileName.c_str());
 	return GetFloatFromString(Return, DefaultValue);
 }
 
@@ -44,7 +119,7 @@ inline bool GetPrivateProfileBool(const std::string& Section, const std::string&
 {
 	const size_t Size = 10;
 	char Return[Size] = { 0 };
-	::GetPrivateProfileStringA(Section.c_str(), Key.c_str(), DefaultValue ? "true" : "false", Return, Size, iniFileName.c_str());
+	detail::GetCachedProfileString(Section.c_str(), Key.c_str(), DefaultValue ? "true" : "false", Return, Size, iniFileName.c_str());
 	return GetBoolFromString(Return, DefaultValue);
 }
 
@@ -52,35 +127,35 @@ inline bool GetPrivateProfileBool(const char* Section, const char* Key, const bo
 {
 	const size_t Size = 10;
 	char Return[Size] = { 0 };
-	::GetPrivateProfileStringA(Section, Key, DefaultValue ? "true" : "false", Return, Size, iniFileName.c_str());
+	detail::GetCachedProfileString(Section, Key, DefaultValue ? "true" : "false", Return, Size, iniFileName.c_str());
 	return GetBoolFromString(Return, DefaultValue);
 }
 
 inline int GetPrivateProfileInt(const std::string& Section, const std::string& Key, const int DefaultValue, const std::string& iniFileName)
 {
-	return ::GetPrivateProfileIntA(Section.c_str(), Key.c_str(), DefaultValue, iniFileName.c_str());
+	return detail::GetCachedProfileInt(Section.c_str(), Key.c_str(), DefaultValue, iniFileName.c_str());
 }
 
 inline int GetPrivateProfileInt(const char* Section, const char* Key, const int DefaultValue, const char* iniFileName)
 {
-	return ::GetPrivateProfileIntA(Section, Key, DefaultValue, iniFileName);
+	return detail::GetCachedProfileInt(Section, Key, DefaultValue, iniFileName);
 }
 
 inline int GetPrivateProfileString(const std::string& Section, const std::string& Key, const std::string& DefaultValue, char* Return, const size_t Size, const std::string& iniFileName)
 {
-	return ::GetPrivateProfileStringA(Section.empty() ? nullptr : Section.c_str(), Key.empty() ? nullptr : Key.c_str(), DefaultValue.c_str(), Return, static_cast<DWORD>(Size), iniFileName.c_str());
+	return detail::GetCachedProfileString(Section.empty() ? nullptr : Section.c_str(), Key.empty() ? nullptr : Key.c_str(), DefaultValue.c_str(), Return, static_cast<DWORD>(Size), iniFileName.c_str());
 }
 
 inline int GetPrivateProfileString(const char* Section, const char* Key, const char* DefaultValue, char* Return, const size_t Size, const char* iniFileName)
 {
-	return ::GetPrivateProfileStringA(Section, Key, DefaultValue, Return, static_cast<DWORD>(Size), iniFileName);
+	return detail::GetCachedProfileString(Section, Key, DefaultValue, Return, static_cast<DWORD>(Size), iniFileName);
 }
 
 inline std::string GetPrivateProfileString(const std::string& Section, const std::string& Key, const std::string& DefaultValue, const std::string& iniFileName)
 {
 	char szBuffer[MAX_STRING] = { 0 };
 
-	const DWORD length = ::GetPrivateProfileStringA(Section.empty() ? nullptr : Section.c_str(), Key.empty() ? nullptr : Key.c_str(), DefaultValue.c_str(), szBuffer, MAX_STRING, iniFileName.c_str());
+	const DWORD length = detail::GetCachedProfileString(Section.empty() ? nullptr : Section.c_str(), Key.empty() ? nullptr : Key.c_str(), DefaultValue.c_str(), szBuffer, MAX_STRING, iniFileName.c_str());
 	return std::string{ szBuffer, length };
 }
 
@@ -88,18 +163,18 @@ inline std::string GetPrivateProfileString(const char* Section, const char* Key,
 {
 	char szBuffer[MAX_STRING] = { 0 };
 
-	const DWORD length = ::GetPrivateProfileStringA(Section, Key, DefaultValue, szBuffer, MAX_STRING, iniFileName);
+	const DWORD length = detail::GetCachedProfileString(Section, Key, DefaultValue, szBuffer, MAX_STRING, iniFileName);
 	return std::string{ szBuffer, length };
 }
 
 inline mq::MQColor GetPrivateProfileColor(const std::string& Section, const std::string& Key, mq::MQColor color, const std::string& iniFileName)
 {
-	return (uint32_t)::GetPrivateProfileIntA(Section.c_str(), Key.c_str(), (int32_t)color.ToARGB(), iniFileName.c_str());
+	return (uint32_t)detail::GetCachedProfileInt(Section.c_str(), Key.c_str(), (int32_t)color.ToARGB(), iniFileName.c_str());
 }
 
 inline mq::MQColor GetPrivateProfileColor(const char* Section, const char* Key, mq::MQColor color, const char* iniFileName)
 {
-	return (uint32_t)::GetPrivateProfileIntA(Section, Key, (int32_t)color.ToARGB(), iniFileName);
+	return (uint32_t)detail::GetCachedProfileInt(Section, Key, (int32_t)color.ToARGB(), iniFileName);
 }
 
 
@@ -203,73 +278,99 @@ inline bool PrivateProfileSectionExists(const std::string& section, const std::s
 
 inline bool WritePrivateProfileSection(const std::string& Section, const std::string& KeysAndValues, const std::string& iniFileName)
 {
-	return ::WritePrivateProfileSectionA(Section.c_str(), KeysAndValues.c_str(), iniFileName.c_str());
+	const bool result = ::WritePrivateProfileSectionA(Section.c_str(), KeysAndValues.c_str(), iniFileName.c_str());
+	PrivateProfileCache::Get().Invalidate(iniFileName.c_str());
+	return result;
 }
 
 inline bool WritePrivateProfileSection(const char* Section, const char* KeysAndValues, const char* iniFileName)
 {
-	return ::WritePrivateProfileSectionA(Section, KeysAndValues, iniFileName);
+	const bool result = ::WritePrivateProfileSectionA(Section, KeysAndValues, iniFileName);
+	PrivateProfileCache::Get().Invalidate(iniFileName);
+	return result;
 }
 
 inline bool WritePrivateProfileString(const std::string& Section, const std::string& Key, const std::string& Value, const std::string& iniFileName)
 {
-	return ::WritePrivateProfileStringA(Section.c_str(), Key.c_str(), Value.c_str(), iniFileName.c_str());
+	const bool result = ::WritePrivateProfileStringA(Section.c_str(), Key.c_str(), Value.c_str(), iniFileName.c_str());
+	PrivateProfileCache::Get().Invalidate(iniFileName.c_str());
+	return result;
 }
 
 inline bool WritePrivateProfileString(const char* Section, const char* Key, const char* Value, const char* iniFileName)
 {
-	return ::WritePrivateProfileStringA(Section, Key, Value, iniFileName);
+	const bool result = ::WritePrivateProfileStringA(Section, Key, Value, iniFileName);
+	PrivateProfileCache::Get().Invalidate(iniFileName);
+	return result;
 }
 
 inline bool WritePrivateProfileBool(const std::string& Section, const std::string& Key, bool Value, const std::string& iniFileName)
 {
-	return ::WritePrivateProfileStringA(Section.c_str(), Key.c_str(), Value ? "1" : "0", iniFileName.c_str());
+	const bool result = ::WritePrivateProfileStringA(Section.c_str(), Key.c_str(), Value ? "1" : "0", iniFileName.c_str());
+	PrivateProfileCache::Get().Invalidate(iniFileName.c_str());
+	return result;
 }
 
 inline bool WritePrivateProfileBool(const char* Section, const char* Key, bool Value, const char* iniFileName)
 {
-	return ::WritePrivateProfileStringA(Section, Key, Value ? "1" : "0", iniFileName);
+	const bool result = ::WritePrivateProfileStringA(Section, Key, Value ? "1" : "0", iniFileName);
+	PrivateProfileCache::Get().Invalidate(iniFileName);
+	return result;
 }
 
 inline bool WritePrivateProfileInt(const std::string& Section, const std::string& Key, int Value, const std::string& iniFileName)
 {
 	std::string ValueString = std::to_string(Value);
-	return ::WritePrivateProfileStringA(Section.c_str(), Key.c_str(), ValueString.c_str(), iniFileName.c_str());
+	const bool result = ::WritePrivateProfileStringA(Section.c_str(), Key.c_str(), ValueString.c_str(), iniFileName.c_str());
+	PrivateProfileCache::Get().Invalidate(iniFileName.c_str());
+	return result;
 }
 
 inline bool WritePrivateProfileInt(const char* Section, const char* Key, int Value, const char* iniFileName)
 {
 	std::string ValueString = std::to_string(Value);
-	return ::WritePrivateProfileStringA(Section, Key, ValueString.c_str(), iniFileName);
+	const bool result = ::WritePrivateProfileStringA(Section, Key, ValueString.c_str(), iniFileName);
+	PrivateProfileCache::Get().Invalidate(iniFileName);
+	return result;
 }
 
 inline bool WritePrivateProfileFloat(const std::string& Section, const std::string& Key, float Value, const std::string& iniFileName)
 {
 	std::string ValueString = std::to_string(Value);
-	return ::WritePrivateProfileStringA(Section.c_str(), Key.c_str(), ValueString.c_str(), iniFileName.c_str());
+	const bool result = ::WritePrivateProfileStringA(Section.c_str(), Key.c_str(), ValueString.c_str(), iniFileName.c_str());
+	PrivateProfileCache::Get().Invalidate(iniFileName.c_str());
+	return result;
 }
 
 inline bool WritePrivateProfileFloat(const char* Section, const char* Key, float Value, const char* iniFileName)
 {
 	std::string ValueString = std::to_string(Value);
-	return ::WritePrivateProfileStringA(Section, Key, ValueString.c_str(), iniFileName);
+	const bool result = ::WritePrivateProfileStringA(Section, Key, ValueString.c_str(), iniFileName);
+	PrivateProfileCache::Get().Invalidate(iniFileName);
+	return result;
 }
 
 inline bool WritePrivateProfileColor(const std::string& Section, const std::string& Key, mq::MQColor Value, const std::string& iniFileName)
 {
 	std::string ValueString = std::to_string(Value.ToARGB());
-	return ::WritePrivateProfileStringA(Section.c_str(), Key.c_str(), ValueString.c_str(), iniFileName.c_str());
+	const bool result = ::WritePrivateProfileStringA(Section.c_str(), Key.c_str(), ValueString.c_str(), iniFileName.c_str());
+	PrivateProfileCache::Get().Invalidate(iniFileName.c_str());
+	return result;
 }
 
 inline bool WritePrivateProfileColor(const char* Section, const char* Key, mq::MQColor Value, const char* iniFileName)
 {
 	std::string ValueString = std::to_string(Value.ToARGB());
-	return ::WritePrivateProfileStringA(Section, Key, ValueString.c_str(), iniFileName);
+	const bool result = ::WritePrivateProfileStringA(Section, Key, ValueString.c_str(), iniFileName);
+	PrivateProfileCache::Get().Invalidate(iniFileName);
+	return result;
 }
 
 inline bool DeletePrivateProfileKey(const std::string& Section, const std::string& Key, const std::string& iniFileName)
 {
-	return ::WritePrivateProfileStringA(Section.c_str(), Key.c_str(), nullptr, iniFileName.c_str());
+	const bool result = ::WritePrivateProfileStringA(Section.c_str(), Key.c_str(), nullptr, iniFileName.c_str());
+	PrivateProfileCache::Get().Invalidate(iniFileName.c_str());
+	return result;
 }
 
 // WritePrivateProfileValue provides overloads to allow dispatching by type (selected by the type of default value)
@@ -0,0 +1,116 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-present MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#pragma once
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace mq {
+
+// A bounded, thread safe, least-recently-used cache keyed by string. Values are handed out as
+// shared_ptr so that an entry may be evicted while a caller is still using it.
+template <typename T>
+class LRUCache
+{
+public:
+	using value_ptr = std::shared_ptr<const T>;
+
+	explicit LRUCache(size_t capacity)
+		: m_capacity(capacity)
+	{
+	}
+
+	LRUCache(const LRUCache&) = delete;
+	LRUCache& operator=(const LRUCache&) = delete;
+
+	value_ptr Find(std::string_view key)
+	{
+		std::scoped_lock lock(m_mutex);
+
+		auto iter = m_map.find(key);
+		if (iter == m_map.end())
+			return nullptr;
+
+		// move to front of the recently used list
+		m_list.splice(m_list.begin(), m_list, iter->second);
+		return iter->second->second;
+	}
+
+	value_ptr Insert(std::string_view key, value_ptr value)
+	{
+		std::scoped_lock lock(m_mutex);
+
+		auto iter = m_map.find(key);
+		if (iter != m_map.end())
+		{
+			iter->second->second = value;
+			m_list.splice(m_list.begin(), m_list, iter->second);
+			return value;
+		}
+
+		// the map is keyed by a view of the string owned by the list node, which never moves.
+		m_list.emplace_front(std::string(key), value);
+		m_map.emplace(m_list.front().first, m_list.begin());
+
+		while (m_list.size() > m_capacity)
+		{
+			m_map.erase(m_list.back().first);
+			m_list.pop_back();
+		}
+
+		return value;
+	}
+
+	// Finds the value for key, or creates it with the provided factory and inserts it.
+	template <typename Factory>
+	value_ptr FindOrCreate(std::string_view key, Factory&& factory)
+	{
+		if (value_ptr value = Find(key))
+			return value;
+
+		// create outside of the lock. The factory is allowed to recurse back into the cache.
+		return Insert(key, factory(key));
+	}
+
+	void Clear()
+	{
+		std::scoped_lock lock(m_mutex);
+
+		m_map.clear();
+		m_list.clear();
+	}
+
+	size_t Size() const
+	{
+		std::scoped_lock lock(m_mutex);
+		return m_list.size();
+	}
+
+	size_t Capacity() const { return m_capacity; }
+
+private:
+	using entry_type = std::pair<std::string, value_ptr>;
+
+	size_t m_capacity;
+	std::list<entry_type> m_list;
+	std::unordered_map<std::string_view, typename std::list<entry_type>::iterator> m_map;
+	mutable std::mutex m_mutex;
+};
+
+} // namespace mq
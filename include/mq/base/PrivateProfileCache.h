@@ -0,0 +1,386 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-present MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#pragma once
+
+#include <mq/base/String.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <windows.h>
+
+namespace mq {
+
+// Parsed ini files for the GetPrivateProfile* wrappers in Config.h. Every lookup checks the file's
+// last write time and size, and the file is only read and parsed again when those change, so
+// repeated lookups of the same file don't reopen it. A file that was written shortly before it was
+// read isn't trusted until it settles, because another write could still land with the same
+// timestamp and size. Each module that includes this has its own cache, so this check is what
+// picks up writes made by other modules and processes. Parsing follows the rules of the Windows
+// profile API: the first section and the first key of a given name win, names are matched without
+// regard to case, whitespace around names and values is trimmed, and one pair of matching quotes
+// around a value is removed.
+//
+// Only the common case is answered here: a named section and key in an ANSI file with an absolute
+// path. Lookup returns false for anything else and the caller goes to the Windows API instead.
+//
+// Files are read and parsed without holding the cache's lock, so a slow read doesn't hold up
+// lookups of other files. The cache holds at most maxFiles files and maxBytes of file contents,
+// and the least recently used files are dropped to stay under both.
+class PrivateProfileCache
+{
+public:
+	static constexpr size_t DefaultMaxFiles = 64;
+	static constexpr size_t DefaultMaxBytes = 8 * 1024 * 1024;
+
+	explicit PrivateProfileCache(size_t maxFiles = DefaultMaxFiles, size_t maxBytes = DefaultMaxBytes)
+		: m_maxFiles(maxFiles)
+		, m_maxBytes(maxBytes)
+	{
+	}
+
+	PrivateProfileCache(const PrivateProfileCache&) = delete;
+	PrivateProfileCache& operator=(const PrivateProfileCache&) = delete;
+
+	static PrivateProfileCache& Get()
+	{
+		static PrivateProfileCache s_instance;
+		return s_instance;
+	}
+
+	// Finds the value of a key and calls callback with a pointer to it, or with nullptr if the key
+	// doesn't exist. Returns false, without calling callback, if the lookup can't be served from
+	// the cache.
+	template <typename Callback>
+	bool Lookup(const char* section, const char* key, const char* fileName, Callback&& callback)
+	{
+		if (!section || !section[0] || !key || !key[0] || !IsAbsolutePath(fileName))
+			return false;
+
+		std::shared_ptr<const ParsedFile> file = GetFile(fileName);
+		if (!file)
+			return false;
+
+		callback(file->Find(section, key));
+		return true;
+	}
+
+	// Drops this module's cached copy of a file. Used after a write so that the module's next read
+	// sees it right away, instead of waiting for the file to settle.
+	void Invalidate(const char* fileName)
+	{
+		if (!fileName)
+			return;
+
+		std::scoped_lock lock(m_mutex);
+
+		// a read that is still in progress may have seen the file before the write
+		++m_generation;
+
+		auto iter = m_files.find(fileName);
+		if (iter != m_files.end())
+			Erase(iter);
+	}
+
+	void Clear()
+	{
+		std::scoped_lock lock(m_mutex);
+
+		++m_generation;
+		m_files.clear();
+		m_cachedBytes = 0;
+	}
+
+	size_t GetFileCount() const
+	{
+		std::scoped_lock lock(m_mutex);
+		return m_files.size();
+	}
+
+	size_t GetCachedBytes() const
+	{
+		std::scoped_lock lock(m_mutex);
+		return m_cachedBytes;
+	}
+
+private:
+	struct ParsedFile
+	{
+		struct Section
+		{
+			std::string_view name;
+			std::vector<std::pair<std::string_view, std::string_view>> keys;
+		};
+
+		FILETIME lastWriteTime = {};
+		uint64_t size = 0;
+		bool exists = false;
+		bool supported = true;
+
+		// The file was last written long enough before we read it that a later write can't
+		// share its timestamp. Until then, the file is read again on every lookup.
+		bool settled = false;
+
+		// names and values are views into contents
+		std::string contents;
+		std::vector<Section> sections;
+
+		const std::string_view* Find(std::string_view sectionName, std::string_view keyName) const
+		{
+			for (const Section& section : sections)
+			{
+				if (!ci_equals(section.name, sectionName))
+					continue;
+
+				for (const auto& [name, value] : section.keys)
+				{
+					if (ci_equals(name, keyName))
+						return &value;
+				}
+
+				// only the first section with a given name is searched
+				return nullptr;
+			}
+
+			return nullptr;
+		}
+	};
+
+	// Longer than the coarsest timestamp resolution of the file systems ini files end up on (2
+	// seconds on FAT), in FILETIME units of 100ns.
+	static constexpr uint64_t SettleTime = 3 * 10'000'000ull;
+
+	static uint64_t ToUInt64(const FILETIME& time)
+	{
+		return (static_cast<uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+	}
+
+	static bool IsAbsolutePath(const char* fileName)
+	{
+		if (!fileName || !fileName[0])
+			return false;
+
+		// drive letter paths, or UNC paths
+		return (fileName[1] == ':' && (fileName[2] == '\\' || fileName[2] == '/'))
+			|| (fileName[0] == '\\' && fileName[1] == '\\');
+	}
+
+	static bool IsProfileSpace(char ch)
+	{
+		return ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n' || ch == '\v' || ch == '\f' || ch == '\x1a';
+	}
+
+	static std::string_view TrimProfileSpace(std::string_view sv)
+	{
+		while (!sv.empty() && IsProfileSpace(sv.front()))
+			sv.remove_prefix(1);
+		while (!sv.empty() && IsProfileSpace(sv.back()))
+			sv.remove_suffix(1);
+		return sv;
+	}
+
+	static std::string_view StripQuotes(std::string_view value)
+	{
+		if (value.length() > 1 && (value.front() == '"' || value.front() == '\'') && value.back() == value.front())
+			return value.substr(1, value.length() - 2);
+
+		return value;
+	}
+
+	static void Parse(ParsedFile& file)
+	{
+		// the ANSI profile functions read unicode files differently, leave those to the API.
+		std::string_view contents = file.contents;
+		if (contents.substr(0, 2) == "\xff\xfe" || contents.substr(0, 2) == "\xfe\xff" || contents.substr(0, 3) == "\xef\xbb\xbf")
+		{
+			// only the fact that it isn't supported is cached
+			file.supported = false;
+			file.contents = std::string();
+			return;
+		}
+
+		ParsedFile::Section* currentSection = nullptr;
+
+		while (!contents.empty())
+		{
+			size_t end = contents.find('\n');
+			std::string_view line = TrimProfileSpace(contents.substr(0, end));
+			contents.remove_prefix(end == std::string_view::npos ? contents.length() : end + 1);
+
+			if (line.empty())
+				continue;
+
+			if (line.front() == '[')
+			{
+				size_t close = line.rfind(']');
+				if (close != std::string_view::npos)
+				{
+					currentSection = &file.sections.emplace_back();
+					currentSection->name = line.substr(1, close - 1);
+					continue;
+				}
+			}
+
+			// keys that appear before the first section can't be looked up by name
+			if (!currentSection)
+				continue;
+
+			size_t equals = line.find('=');
+			if (equals == std::string_view::npos)
+			{
+				currentSection->keys.emplace_back(line, std::string_view{});
+			}
+			else
+			{
+				currentSection->keys.emplace_back(TrimProfileSpace(line.substr(0, equals)),
+					StripQuotes(TrimProfileSpace(line.substr(equals + 1))));
+			}
+		}
+	}
+
+	struct CachedFile
+	{
+		std::shared_ptr<const ParsedFile> file;
+		uint64_t lastUsed = 0;
+	};
+	using FileMap = ci_unordered::map<std::string, CachedFile>;
+
+	std::shared_ptr<const ParsedFile> GetFile(const char* fileName)
+	{
+		WIN32_FILE_ATTRIBUTE_DATA attributes;
+		const bool exists = ::GetFileAttributesExA(fileName, GetFileExInfoStandard, &attributes) != 0;
+		const uint64_t size = exists ? (static_cast<uint64_t>(attributes.nFileSizeHigh) << 32) | attributes.nFileSizeLow : 0;
+
+		uint64_t generation;
+		{
+			std::scoped_lock lock(m_mutex);
+
+			auto iter = m_files.find(fileName);
+			if (iter != m_files.end())
+			{
+				const ParsedFile& cached = *iter->second.file;
+
+				if (cached.settled
+					&& cached.exists == exists
+					&& (!exists || (cached.size == size && ::CompareFileTime(&cached.lastWriteTime, &attributes.ftLastWriteTime) == 0)))
+				{
+					iter->second.lastUsed = ++m_useCount;
+					return cached.supported ? iter->second.file : nullptr;
+				}
+			}
+
+			generation = m_generation;
+		}
+
+		std::shared_ptr<const ParsedFile> file = LoadFile(fileName, exists, attributes, size);
+		if (!file)
+			return nullptr;
+
+		Publish(fileName, file, generation);
+
+		return file->supported ? file : nullptr;
+	}
+
+	static std::shared_ptr<const ParsedFile> LoadFile(const char* fileName, bool exists,
+		const WIN32_FILE_ATTRIBUTE_DATA& attributes, uint64_t size)
+	{
+		auto file = std::make_shared<ParsedFile>();
+		file->exists = exists;
+		file->settled = !exists;
+
+		if (exists)
+		{
+			if (attributes.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+				return nullptr;
+
+			file->lastWriteTime = attributes.ftLastWriteTime;
+			file->size = size;
+
+			FILETIME now;
+			::GetSystemTimeAsFileTime(&now);
+			file->settled = ToUInt64(now) > ToUInt64(file->lastWriteTime) + SettleTime;
+
+			std::ifstream stream(fileName, std::ios::binary);
+			if (!stream.is_open())
+				return nullptr;
+
+			file->contents.resize(static_cast<size_t>(size));
+			stream.read(file->contents.data(), static_cast<std::streamsize>(size));
+
+			// the file changed while we were reading it, try again next time
+			if (static_cast<uint64_t>(stream.gcount()) != size)
+				return nullptr;
+
+			Parse(*file);
+		}
+
+		return file;
+	}
+
+	// Adds a file that was loaded while the lock wasn't held. It is only kept if nothing was
+	// invalidated since the load started, and if it fits.
+	void Publish(const char* fileName, std::shared_ptr<const ParsedFile> file, uint64_t generation)
+	{
+		std::scoped_lock lock(m_mutex);
+
+		if (generation != m_generation)
+			return;
+
+		auto iter = m_files.find(fileName);
+		if (iter != m_files.end())
+			Erase(iter);
+
+		const size_t bytes = file->contents.size();
+		if (bytes > m_maxBytes || m_maxFiles == 0)
+			return;
+
+		m_files.emplace(fileName, CachedFile{ std::move(file), ++m_useCount });
+		m_cachedBytes += bytes;
+
+		// the file just added is the most recently used, so it is never the one dropped
+		while (m_files.size() > m_maxFiles || m_cachedBytes > m_maxBytes)
+		{
+			auto oldest = std::min_element(m_files.begin(), m_files.end(),
+				[](const auto& a, const auto& b) { return a.second.lastUsed < b.second.lastUsed; });
+			Erase(oldest);
+		}
+	}
+
+	void Erase(FileMap::iterator iter)
+	{
+		m_cachedBytes -= iter->second.file->contents.size();
+		m_files.erase(iter);
+	}
+
+	const size_t m_maxFiles;
+	const size_t m_maxBytes;
+
+	mutable std::mutex m_mutex;
+	FileMap m_files;
+	size_t m_cachedBytes = 0;
+	uint64_t m_useCount = 0;
+
+	// Changes whenever files are invalidated, so that loads that were already in flight don't
+	// put back what was dropped.
+	uint64_t m_generation = 0;
+};
+
+} // namespace mq
@@ -16,9 +16,10 @@
 
 #pragma once
 
+#include <algorithm>
 #include <functional>
-#include <list>
 #include <memory>
+#include <vector>
 
 namespace mq {
 
@@ -75,13 +76,18 @@ public:
 
 private:
 	using ConnectionItem = SignalConnectionItem<T...>;
-	using ConnectionList = std::list<std::shared_ptr<ConnectionItem>>;
+	using ConnectionList = std::vector<std::shared_ptr<ConnectionItem>>;
 
 	ConnectionList m_list;
 	uint32_t m_recurseCount = 0;
 
+	// Disconnected items are only removed once no emit is in progress, so that an emit can walk
+	// the list by index while callbacks connect and disconnect.
 	void ClearDisconnected()
 	{
+		if (m_recurseCount != 0)
+			return;
+
 		m_list.erase(std::remove_if(m_list.begin(), m_list.end(),
 			[](std::shared_ptr<ConnectionItem>& item)
 		{
@@ -100,18 +106,16 @@ public:
 
 	void operator()(T... args)
 	{
-		std::list<std::shared_ptr<ConnectionItem>> list;
-		for (auto& item : m_list)
-		{
-			if (item->IsConnected())
-				list.push_back(item);
-		}
+		// Items connected during the emit are appended, and aren't called until the next one.
+		const size_t count = m_list.size();
 
 		++m_recurseCount;
 
-		for (auto& item : list)
+		for (size_t i = 0; i < count; ++i)
 		{
-			(*item)(args...);
+			// the list may reallocate during the call, but the item itself stays put
+			ConnectionItem& item = *m_list[i];
+			item(args...);
 		}
 
 		if (--m_recurseCount == 0)
@@ -148,10 +152,15 @@ public:
 
 	bool DisconnectAll()
 	{
+		bool found = false;
 		for (auto& item : m_list)
+		{
+			found = found || item->IsConnected();
 			item->Disconnect();
+		}
 
 		ClearDisconnected();
+		return found;
 	}
 
 	friend class Connection;
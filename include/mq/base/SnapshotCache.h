@@ -0,0 +1,94 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-present MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace mq {
+
+// Immutable snapshots of data that is read far more often than it changes. Readers use the current
+// snapshot after a single atomic load, without locking. Writers change the data under their own
+// lock and call Invalidate, and the next read builds a new snapshot under that lock.
+//
+// A reader may still be using a snapshot after it has been replaced, so replaced snapshots are kept
+// until the cache is destroyed. Once MaxSnapshots have been published, data that keeps changing is
+// read under the lock from a private copy instead, so memory stays bounded.
+template <typename T, size_t MaxSnapshots = 16>
+class SnapshotCache
+{
+public:
+	SnapshotCache() = default;
+	SnapshotCache(const SnapshotCache&) = delete;
+	SnapshotCache& operator=(const SnapshotCache&) = delete;
+
+	// Returns read(const T&) for the current snapshot. If there is none, build(T&) fills in a new one
+	// while mutex is held. mutex must be the lock that writers hold when they call Invalidate.
+	template <typename Mutex, typename BuildFunc, typename ReadFunc>
+	auto Read(Mutex& mutex, BuildFunc&& build, ReadFunc&& read) const
+	{
+		if (const T* snapshot = m_current.load(std::memory_order_acquire))
+			return read(*snapshot);
+
+		std::scoped_lock lock(mutex);
+
+		// another thread may have built it while we were waiting
+		if (const T* snapshot = m_current.load(std::memory_order_relaxed))
+			return read(*snapshot);
+
+		if (m_snapshots.size() < MaxSnapshots)
+		{
+			auto snapshot = std::make_unique<T>();
+			build(*snapshot);
+
+			const T* result = snapshot.get();
+			m_snapshots.push_back(std::move(snapshot));
+			m_current.store(result, std::memory_order_release);
+
+			return read(*result);
+		}
+
+		// Nothing reads the private copy without the lock, so it can be rebuilt in place.
+		if (!m_locked)
+		{
+			m_locked = std::make_unique<T>();
+			build(*m_locked);
+		}
+
+		return read(*m_locked);
+	}
+
+	// Call with the writers' lock held, after changing the data that snapshots are built from.
+	void Invalidate()
+	{
+		m_current.store(nullptr, std::memory_order_release);
+		m_locked.reset();
+	}
+
+	// The number of snapshots published so far, at most MaxSnapshots. Call with the writers' lock held.
+	size_t GetSnapshotCount() const
+	{
+		return m_snapshots.size();
+	}
+
+private:
+	mutable std::atomic<const T*> m_current{ nullptr };
+	mutable std::vector<std::unique_ptr<T>> m_snapshots;
+	mutable std::unique_ptr<T> m_locked;
+};
+
+} // namespace mq
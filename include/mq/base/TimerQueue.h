@@ -0,0 +1,121 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-present MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace mq {
+
+// A queue of values that become due at a given time, in whatever unit the owner uses for time.
+// Due values are kept in a min-heap, so scheduling is O(log n) and running the queue only touches
+// the values that are due. Cancelling is O(1): cancelled entries stay in the heap and are skipped
+// when they reach the top. Values that are due at the same time run in the order they were scheduled.
+template <typename T>
+class TimerQueue
+{
+public:
+	using TimerId = uint64_t;
+	static constexpr TimerId InvalidTimerId = 0;
+
+	TimerId Schedule(uint64_t dueTime, T value)
+	{
+		const TimerId id = ++m_lastId;
+
+		m_pending.emplace(id, std::move(value));
+		m_heap.push_back({ dueTime, id });
+		std::push_heap(m_heap.begin(), m_heap.end(), std::greater<>());
+
+		return id;
+	}
+
+	bool Cancel(TimerId id)
+	{
+		if (m_pending.erase(id) == 0)
+			return false;
+
+		// don't let cancelled entries pile up if timers keep being rescheduled far into the future
+		if (m_heap.size() > 2 * m_pending.size() + 64)
+			Compact();
+
+		return true;
+	}
+
+	bool IsPending(TimerId id) const
+	{
+		return m_pending.find(id) != m_pending.end();
+	}
+
+	// Removes every value that is due at or before now and calls callback(value) for it. The
+	// callback may schedule or cancel timers. Anything it schedules that is already due runs too.
+	template <typename Callback>
+	void Run(uint64_t now, Callback&& callback)
+	{
+		while (!m_heap.empty() && m_heap.front().dueTime <= now)
+		{
+			const TimerId id = m_heap.front().id;
+
+			std::pop_heap(m_heap.begin(), m_heap.end(), std::greater<>());
+			m_heap.pop_back();
+
+			auto iter = m_pending.find(id);
+			if (iter == m_pending.end())
+				continue;
+
+			T value = std::move(iter->second);
+			m_pending.erase(iter);
+
+			callback(value);
+		}
+	}
+
+	void Clear()
+	{
+		m_heap.clear();
+		m_pending.clear();
+	}
+
+	size_t Size() const { return m_pending.size(); }
+	bool Empty() const { return m_pending.empty(); }
+
+private:
+	struct Entry
+	{
+		uint64_t dueTime;
+		TimerId id;
+
+		bool operator>(const Entry& other) const
+		{
+			return dueTime != other.dueTime ? dueTime > other.dueTime : id > other.id;
+		}
+	};
+
+	void Compact()
+	{
+		m_heap.erase(std::remove_if(m_heap.begin(), m_heap.end(),
+			[this](const Entry& entry) { return m_pending.find(entry.id) == m_pending.end(); }), m_heap.end());
+		std::make_heap(m_heap.begin(), m_heap.end(), std::greater<>());
+	}
+
+	TimerId m_lastId = InvalidTimerId;
+	std::vector<Entry> m_heap;
+	std::unordered_map<TimerId, T> m_pending;
+};
+
+} // namespace mq
@@ -22,6 +22,14 @@ namespace mq {
 // Benchmarks are used to measure the amount of time spent doing something. When
 // entering a benchmark, the current time is taken, and when leaving, the elapsed
 // time spent in the benchmark is added to the total.
+//
+// Each benchmark also keeps a histogram of its timings so that the tail latency can
+// be seen. Histograms cover a fixed window of time, and the previous window is kept
+// so that there is always a full window of data to report on. They are kept apart from
+// MQBenchmark, and only allocated once a benchmark has been timed.
+
+// Length of a benchmark histogram window.
+constexpr std::chrono::seconds MQBenchmarkWindow{ 30 };
 
 struct MQBenchmark
 {
@@ -31,10 +39,26 @@ struct MQBenchmark
 	std::chrono::microseconds TotalTime = std::chrono::microseconds::zero();
 	uint64_t Count = 0;
 
+	// Nesting depth. Only the outermost enter and exit of a benchmark is timed. An enter that
+	// is still unpaired when its window rolls over is dropped.
+	uint32_t Depth = 0;
+
+	std::chrono::steady_clock::time_point WindowStart = std::chrono::steady_clock::now();
+
 	MQBenchmark(const std::string& name) : Name(name) {}
 	MQBenchmark() {}
 };
 
+// Percentiles of a benchmark's timings over the current and previous windows.
+struct MQBenchmarkPercentiles
+{
+	uint64_t Count = 0;
+	std::chrono::microseconds P50 = std::chrono::microseconds::zero();
+	std::chrono::microseconds P90 = std::chrono::microseconds::zero();
+	std::chrono::microseconds P99 = std::chrono::microseconds::zero();
+	std::chrono::microseconds Max = std::chrono::microseconds::zero();
+};
+
 //----------------------------------------------------------------------------
 // Benchmarking API
 
@@ -53,6 +77,12 @@ MQLIB_API void EnterMQ2Benchmark(uint32_t BMHandle);
 // Leave the benchmark.
 MQLIB_API void ExitMQ2Benchmark(uint32_t BMHandle);
 
+// Get the percentiles of a benchmark's recent timings. Returns false if the benchmark doesn't exist.
+MQLIB_API bool GetMQ2BenchmarkPercentiles(uint32_t BMHandle, MQBenchmarkPercentiles& Dest);
+
+// Clear the histograms of every benchmark and start a new window.
+MQLIB_API void ResetMQ2BenchmarkHistograms();
+
 //----------------------------------------------------------------------------
 // Scoped benchmark object, enters the benchmark at creation and leaves the benchmark at the end
 // of the current scope.
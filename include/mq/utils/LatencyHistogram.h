@@ -0,0 +1,154 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-present MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+
+namespace mq {
+
+//----------------------------------------------------------------------------
+// A fixed size log-linear histogram of durations in microseconds. Each power of two range is split
+// into 16 linear buckets, so any recorded value can be recovered to within about 6%. Values up to
+// 15us are exact, and anything above ~71 minutes is clamped.
+
+class LatencyHistogram
+{
+public:
+	static constexpr uint32_t SubBucketBits = 4;
+	static constexpr uint32_t SubBucketCount = 1 << SubBucketBits;
+	static constexpr uint32_t MaxValueBits = 32;
+	static constexpr uint64_t MaxValue = (uint64_t{ 1 } << MaxValueBits) - 1;
+	static constexpr uint32_t BucketCount = (MaxValueBits - SubBucketBits + 1) * SubBucketCount;
+
+	void Record(uint64_t value)
+	{
+		value = std::min(value, MaxValue);
+
+		++m_buckets[GetBucketIndex(value)];
+		++m_count;
+		m_total += value;
+		m_min = std::min(m_min, value);
+		m_max = std::max(m_max, value);
+	}
+
+	void Merge(const LatencyHistogram& other)
+	{
+		if (other.m_count == 0)
+			return;
+
+		for (uint32_t i = 0; i < BucketCount; ++i)
+			m_buckets[i] += other.m_buckets[i];
+
+		m_count += other.m_count;
+		m_total += other.m_total;
+		m_min = std::min(m_min, other.m_min);
+		m_max = std::max(m_max, other.m_max);
+	}
+
+	void Reset()
+	{
+		*this = LatencyHistogram();
+	}
+
+	uint64_t GetCount() const { return m_count; }
+	uint64_t GetTotal() const { return m_total; }
+	uint64_t GetMin() const { return m_count ? m_min : 0; }
+	uint64_t GetMax() const { return m_max; }
+	double GetMean() const { return m_count ? static_cast<double>(m_total) / m_count : 0.0; }
+
+	// Returns the smallest value that at least percentile% of the recorded values are at or below,
+	// rounded up to the top of its bucket. percentile is in the range [0, 100].
+	uint64_t GetPercentile(double percentile) const
+	{
+		return FindPercentile(percentile, m_count, GetMin(), m_max,
+			[this](uint32_t index) { return m_buckets[index]; });
+	}
+
+	// Returns the percentile of the values recorded in both histograms, as if they had been merged,
+	// without making a merged copy.
+	static uint64_t GetPercentile(double percentile, const LatencyHistogram& first, const LatencyHistogram& second)
+	{
+		const uint64_t count = first.m_count + second.m_count;
+		const uint64_t min = std::min(first.m_min, second.m_min);
+		const uint64_t max = std::max(first.m_max, second.m_max);
+
+		return FindPercentile(percentile, count, count ? min : 0, max,
+			[&](uint32_t index) { return uint64_t{ first.m_buckets[index] } + second.m_buckets[index]; });
+	}
+
+	static uint32_t GetBucketIndex(uint64_t value)
+	{
+		if (value < SubBucketCount)
+			return static_cast<uint32_t>(value);
+
+		uint32_t magnitude = 0;
+		while ((value >> magnitude) >= SubBucketCount * 2)
+			++magnitude;
+
+		// value >> magnitude is in [SubBucketCount, 2 * SubBucketCount)
+		return (magnitude + 1) * SubBucketCount + static_cast<uint32_t>(value >> magnitude) - SubBucketCount;
+	}
+
+	static uint64_t GetBucketLowerBound(uint32_t index)
+	{
+		if (index < SubBucketCount)
+			return index;
+
+		const uint32_t magnitude = index / SubBucketCount - 1;
+		return static_cast<uint64_t>(SubBucketCount + index % SubBucketCount) << magnitude;
+	}
+
+	static uint64_t GetBucketUpperBound(uint32_t index)
+	{
+		if (index < SubBucketCount)
+			return index;
+
+		const uint32_t magnitude = index / SubBucketCount - 1;
+		return GetBucketLowerBound(index) + (uint64_t{ 1 } << magnitude) - 1;
+	}
+
+private:
+	template <typename GetBucket>
+	static uint64_t FindPercentile(double percentile, uint64_t count, uint64_t min, uint64_t max, GetBucket&& getBucket)
+	{
+		if (count == 0)
+			return 0;
+
+		percentile = std::clamp(percentile, 0.0, 100.0);
+
+		uint64_t target = static_cast<uint64_t>(percentile / 100.0 * count + 0.5);
+		target = std::clamp<uint64_t>(target, 1, count);
+
+		uint64_t seen = 0;
+		for (uint32_t i = 0; i < BucketCount; ++i)
+		{
+			seen += getBucket(i);
+			if (seen >= target)
+				return std::clamp(GetBucketUpperBound(i), min, max);
+		}
+
+		return max;
+	}
+
+	uint32_t m_buckets[BucketCount] = {};
+	uint64_t m_count = 0;
+	uint64_t m_total = 0;
+	uint64_t m_min = std::numeric_limits<uint64_t>::max();
+	uint64_t m_max = 0;
+};
+
+} // namespace mq
@@ -0,0 +1,176 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-present MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#pragma once
+
+#include "mq/base/String.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct ClientIdentification
+{
+	uint32_t pid;
+	std::string account;
+	std::string server;
+	std::string character;
+};
+
+// The identification of every connected client, indexed by account, server and character so that
+// the recipients of an address can be found without comparing it against every client. Addresses
+// are anything with has_account()/account(), has_server()/server() and has_character()/character(),
+// like proto::routing::Address.
+class ClientDirectory
+{
+public:
+	using Map = std::unordered_map<uint32_t, ClientIdentification>;
+
+	template <typename Address>
+	static bool IsRecipient(const Address& address, const ClientIdentification& id)
+	{
+		return (!address.has_account() || mq::ci_equals(address.account(), id.account)) &&
+			(!address.has_server() || mq::ci_equals(address.server(), id.server)) &&
+			(!address.has_character() || mq::ci_equals(address.character(), id.character));
+	}
+
+	// Adds or replaces a client's identification. Returns true if the client is new.
+	bool Set(ClientIdentification&& id)
+	{
+		auto iter = m_identities.find(id.pid);
+		bool added = iter == m_identities.end();
+
+		if (!added)
+		{
+			RemoveFromIndexes(iter->second);
+			iter->second = std::move(id);
+		}
+		else
+		{
+			iter = m_identities.emplace(id.pid, std::move(id)).first;
+		}
+
+		AddToIndex(m_accountIndex, iter->second.account, iter->first);
+		AddToIndex(m_serverIndex, iter->second.server, iter->first);
+		AddToIndex(m_characterIndex, iter->second.character, iter->first);
+
+		return added;
+	}
+
+	void Remove(Map::const_iterator iter)
+	{
+		RemoveFromIndexes(iter->second);
+		m_identities.erase(iter);
+	}
+
+	Map::const_iterator find(uint32_t pid) const { return m_identities.find(pid); }
+	Map::const_iterator begin() const { return m_identities.begin(); }
+	Map::const_iterator end() const { return m_identities.end(); }
+	size_t size() const { return m_identities.size(); }
+
+	// Calls callback(pid) for every client that matches the address, until the callback returns false.
+	template <typename Address, typename Callback>
+	void ForEachRecipient(const Address& address, Callback&& callback) const
+	{
+		// start from the smallest set of clients that match one part of the address
+		const std::vector<uint32_t>* candidates = nullptr;
+		auto narrow = [&](const Index& index, const std::string& key)
+			{
+				auto iter = index.find(key);
+				if (iter == index.end())
+					return false;
+
+				if (candidates == nullptr || iter->second.size() < candidates->size())
+					candidates = &iter->second;
+				return true;
+			};
+
+		if ((address.has_account() && !narrow(m_accountIndex, address.account()))
+			|| (address.has_server() && !narrow(m_serverIndex, address.server()))
+			|| (address.has_character() && !narrow(m_characterIndex, address.character())))
+		{
+			// some part of the address doesn't match anyone
+			return;
+		}
+
+		if (candidates == nullptr)
+		{
+			// nothing to narrow by, everyone is a recipient
+			for (const auto& [pid, _] : m_identities)
+			{
+				if (!callback(pid))
+					return;
+			}
+
+			return;
+		}
+
+		for (uint32_t pid : *candidates)
+		{
+			auto iter = m_identities.find(pid);
+			if (iter != m_identities.end() && IsRecipient(address, iter->second) && !callback(pid))
+				return;
+		}
+	}
+
+	// Counts the clients that match the address, stopping at two, since messages that expect a
+	// response need exactly one. recipient is set to the last one found.
+	template <typename Address>
+	int CountRecipients(const Address& address, uint32_t& recipient) const
+	{
+		int count = 0;
+		ForEachRecipient(address, [&](uint32_t pid)
+			{
+				recipient = pid;
+				return ++count < 2;
+			});
+
+		return count;
+	}
+
+private:
+	using Index = mq::ci_unordered::map<std::string, std::vector<uint32_t>>;
+
+	static void AddToIndex(Index& index, const std::string& key, uint32_t pid)
+	{
+		index[key].push_back(pid);
+	}
+
+	static void RemoveFromIndex(Index& index, const std::string& key, uint32_t pid)
+	{
+		auto iter = index.find(key);
+		if (iter == index.end())
+			return;
+
+		auto& pids = iter->second;
+		pids.erase(std::remove(pids.begin(), pids.end(), pid), pids.end());
+
+		if (pids.empty())
+			index.erase(iter);
+	}
+
+	void RemoveFromIndexes(const ClientIdentification& id)
+	{
+		RemoveFromIndex(m_accountIndex, id.account, id.pid);
+		RemoveFromIndex(m_serverIndex, id.server, id.pid);
+		RemoveFromIndex(m_characterIndex, id.character, id.pid);
+	}
+
+	Map m_identities;
+	Index m_accountIndex;
+	Index m_serverIndex;
+	Index m_characterIndex;
+};
@@ -13,6 +13,7 @@
  */
 
 #include "loader/MacroQuest.h"
+#include "loader/ClientDirectory.h"
 #include "loader/PostOffice.h"
 #include "loader/Crashpad.h"
 #include "loader/LoaderAutoLogin.h"
@@ -32,16 +33,9 @@ using namespace postoffice;
 class LauncherPostOffice : public PostOffice
 {
 private:
-	struct ClientIdentification
-	{
-		uint32_t pid;
-		std::string account;
-		std::string server;
-		std::string character;
-	};
-
-	std::unordered_map<uint32_t, ClientIdentification> m_identities;
+	ClientDirectory m_identities;
 	ci_unordered::map<std::string, uint32_t> m_names;
+
 	bool m_running = false;
 	std::thread m_thread;
 	std::thread::id m_threadId;
@@ -100,7 +94,7 @@ private:
 				{
 					// all we have to do here is route, this is the same as if an internal mailbox is
 					// attempting to route a message
-					m_postOffice->RouteMessage(std::move(message));
+					m_postOffice->RouteMessage(envelope, std::move(message));
 				}
 				break;
 			}
@@ -119,13 +113,12 @@ private:
 					}
 					else
 					{
-						auto result = m_postOffice->m_identities.insert_or_assign(id.pid(), ClientIdentification{
+						added = m_postOffice->m_identities.Set(ClientIdentification{
 							id.pid(),
 							id.has_account() ? id.account() : "",
 							id.has_server() ? id.server() : "",
 							id.has_character() ? id.character() : ""
 						});
-						added = result.second;
 
 						// only include the PID here, otherwise it's pseudonym-identifiable information from the logs
 						SPDLOG_INFO("Got identification from {}", id.pid());
@@ -343,7 +336,7 @@ private:
 
 				broadcast(std::move(id));
 
-				m_postOffice->m_identities.erase(ident_it);
+				m_postOffice->m_identities.Remove(ident_it);
 			}
 		}
 
@@ -375,20 +368,18 @@ public:
 			callback(status, std::make_unique<PipeMessage>(MQMessageId::MSG_ROUTE, &data[0], data.size()));
 	}
 
-	static bool IsRecipient(const proto::routing::Address& address, const ClientIdentification& id)
+	// Finds the single client that matches the address, for messages that expect a response.
+	int FindSingleRecipient(const proto::routing::Address& address, uint32_t& recipient) const
 	{
-		return (!address.has_account() || ci_equals(address.account(), id.account)) &&
-			(!address.has_server() || ci_equals(address.server(), id.server)) &&
-			(!address.has_character() || ci_equals(address.character(), id.character));
-	}
+		int count = m_identities.CountRecipients(address, recipient);
 
-	auto FindIdentity(
-		const proto::routing::Address& address,
-		const std::unordered_map<uint32_t, ClientIdentification>::iterator& from)
-	{
-		return std::find_if(from, m_identities.end(),
-			[&address](const std::pair<uint32_t, ClientIdentification>& pair)
-			{ return IsRecipient(address, pair.second); });
+		if (count == 0)
+			return MsgError_RoutingFailed;
+
+		if (count > 1)
+			return MsgError_AmbiguousRecipient;
+
+		return 0;
 	}
 
 	void RouteMessage(PipeMessagePtr&& message, const PipeMessageResponseCb& callback) override
@@ -428,16 +419,13 @@ public:
 			}
 			else
 			{
-				auto identity = FindIdentity(envelope.address(), m_identities.begin());
-
-				if (identity == m_identities.end())
-					RoutingFailed(envelope, MsgError_RoutingFailed, std::move(message), callback);
-				else if (FindIdentity(envelope.address(), std::next(identity)) != m_identities.end())
-					RoutingFailed(envelope, MsgError_AmbiguousRecipient, std::move(message), callback);
+				uint32_t recipient = 0;
+				if (int status = FindSingleRecipient(address, recipient); status != 0)
+					RoutingFailed(envelope, status, std::move(message), callback);
 				else
 				{
 					message->SetRequestMode(MQRequestMode::CallAndResponse);
-					SendMessageToPID(identity->first, std::move(message), single_send, routing_failed);
+					SendMessageToPID(recipient, std::move(message), single_send, routing_failed);
 				}
 			}
 		}
@@ -446,7 +434,14 @@ public:
 	void RouteMessage(
 		PipeMessagePtr&& message)
 	{
-		auto envelope = ProtoMessage::Parse<proto::routing::Envelope>(message);
+		RouteMessage(ProtoMessage::Parse<proto::routing::Envelope>(message), std::move(message));
+	}
+
+	// Routes a message whose envelope has already been parsed
+	void RouteMessage(
+		const proto::routing::Envelope& envelope,
+		PipeMessagePtr&& message)
+	{
 		const auto& address = envelope.address();
 		auto routing_failed = [&envelope](int status, PipeMessagePtr&& message)
 			{
@@ -480,30 +475,21 @@ public:
 		else if (message->GetRequestMode() == MQRequestMode::CallAndResponse)
 		{
 			// ensure that we have a singular target for an RPC message
-			auto identity = FindIdentity(envelope.address(), m_identities.begin());
-
-			if (identity == m_identities.end())
-				RoutingFailed(envelope, MsgError_RoutingFailed, std::move(message), nullptr);
-			else if (FindIdentity(envelope.address(), std::next(identity)) != m_identities.end())
-				RoutingFailed(envelope, MsgError_AmbiguousRecipient, std::move(message), nullptr);
+			uint32_t recipient = 0;
+			if (int status = FindSingleRecipient(address, recipient); status != 0)
+				RoutingFailed(envelope, status, std::move(message), nullptr);
 			else
-				SendMessageToPID(identity->first, std::move(message), single_send, routing_failed);
+				SendMessageToPID(recipient, std::move(message), single_send, routing_failed);
 		}
 		else
 		{
-			// we don't have a PID or a name and this is not an RPC, so we will send this message to 
-			// all clients that match the address -- it's important to copy these messages
-			for (const auto& identity : m_identities)
-			{
-				if (IsRecipient(address, identity.second))
+			// we don't have a PID or a name and this is not an RPC, so we will send this message to
+			// all clients that match the address. They all share the same read-only buffer.
+			m_identities.ForEachRecipient(address, [&](uint32_t pid)
 				{
-					SendMessageToPID(
-						identity.first,
-						std::make_unique<PipeMessage>(*message->GetHeader(), message->get(), message->size()),
-						single_send,
-						routing_failed);
-				}
-			}
+					SendMessageToPID(pid, message->Share(), single_send, routing_failed);
+					return true;
+				});
 		}
 	}
 
@@ -16,10 +16,11 @@
 #include "MQ2Main.h"
 #include "MQDataAPI.h"
 
+#include "mq/base/AhoCorasick.h"
 #include "mq/utils/Args.h"
 
-#include <regex>
 #include <memory>
+#include <optional>
 #include <Yaml.hpp>
 
 namespace mq {
@@ -115,6 +116,9 @@ static Anonymization anon_guild;
 static Anonymization anon_raid;
 static Anonymization anon_self;
 
+// Incremented whenever the set of names that replacers match might have changed.
+static uint32_t anon_revision = 0;
+
 class anon_replacer {
 public:
 	const std::string name;
@@ -123,24 +127,12 @@ private:
 	Anonymization strategy;
 	std::string target;
 	std::set<std::string> alternates;
-	std::regex search_string;
-
-private:
-	void build_regex()
-	{
-		search_string = std::regex(
-			fmt::format("\\b({}{})\\b", name, std::accumulate(alternates.cbegin(), alternates.cend(), std::string(),
-				[](const std::string& text, std::string_view alt) -> std::string {
-					return fmt::format("{}|{}", text, alt);
-				})),
-			std::regex_constants::icase);
-	}
 
 public:
 	anon_replacer(std::string_view name, Anonymization strategy, std::string_view target = "")
 		: name(name), strategy(strategy), target(target)
 	{
-		build_regex();
+		++anon_revision;
 	}
 
 	anon_replacer(Yaml::Node& node)
@@ -154,7 +146,7 @@ public:
 				alternates.emplace((*alt).second.As<std::string>());
 		}
 
-		build_regex();
+		++anon_revision;
 	}
 
 	anon_replacer(SPAWNINFO* pSpawn, Anonymization strategy, std::string_view target = "")
@@ -165,19 +157,44 @@ public:
 		if (pSpawn->Lastname[0])
 			add_alternate(pSpawn->Name);
 
-		build_regex();
+		++anon_revision;
+	}
+
+	~anon_replacer()
+	{
+		++anon_revision;
 	}
 
 	void add_alternate(std::string_view alternate)
 	{
 		alternates.emplace(std::string(alternate));
-		build_regex();
+		++anon_revision;
 	}
 
 	void drop_alternate(std::string_view alternate)
 	{
 		alternates.erase(std::string(alternate));
-		build_regex();
+		++anon_revision;
+	}
+
+	// Calls callback(text) for the name and each alternate that this replacer matches.
+	template <typename Callback>
+	void for_each_pattern(Callback&& callback) const
+	{
+		auto add_pattern = [&callback](std::string_view pattern)
+		{
+			// names built from spawns separate the last name with a regex whitespace
+			std::string text(pattern);
+			for (size_t pos = text.find("\\s"); pos != std::string::npos; pos = text.find("\\s", pos))
+				text.replace(pos, 2, " ");
+
+			if (!text.empty())
+				callback(std::string_view(text));
+		};
+
+		add_pattern(name);
+		for (const std::string& alternate : alternates)
+			add_pattern(alternate);
 	}
 
 	void update_strategy(Anonymization strategy)
@@ -264,13 +281,6 @@ public:
 		}
 	}
 
-	std::string replace_text(std::string_view text) const
-	{
-		std::string result;
-		std::regex_replace(std::back_inserter(result), std::cbegin(text), std::cend(text), search_string, anonymize());
-		return result;
-	}
-
 	Yaml::Node Serialize()
 	{
 		Yaml::Node node;
@@ -295,8 +305,115 @@ static ci_unordered::map<std::string_view, std::unique_ptr<anon_replacer>> guild
 static ci_unordered::map<std::string_view, std::unique_ptr<anon_replacer>> raid_memoization;
 static std::unique_ptr<anon_replacer> self_replacer;
 
-// the source string_view here will be used to index
-// creating a regex that looks like `(source|all|the|alternates)`
+// Every active replacer compiled into a single case insensitive automaton, so that a line can be
+// anonymized in one pass. When matches overlap, the one that starts first wins, then the one whose
+// replacer comes first, then the longest.
+class anon_matcher
+{
+	AhoCorasick automaton;
+	std::vector<const anon_replacer*> active_replacers;
+	std::vector<uint32_t> pattern_replacers;
+	uint32_t revision = 0;
+
+	struct match
+	{
+		size_t start;
+		size_t length;
+		uint32_t replacer;
+	};
+
+	// these are per line, but kept around to avoid allocating them every time
+	mutable std::vector<match> matches;
+	mutable std::vector<std::optional<std::string>> replacements;
+
+	static bool is_word_char(char c)
+	{
+		return isalnum(static_cast<unsigned char>(c)) || c == '_';
+	}
+
+	// same as \b on both ends of the match
+	static bool is_whole_word(std::string_view text, size_t start, size_t length)
+	{
+		const size_t end = start + length;
+
+		return (start == 0 || is_word_char(text[start - 1]) != is_word_char(text[start]))
+			&& (end == text.length() || is_word_char(text[end - 1]) != is_word_char(text[end]));
+	}
+
+public:
+	// Rebuilds the automaton if the active replacers have changed. When it does, the list is
+	// swapped in rather than copied, and the caller gets the previous list back.
+	void update(std::vector<const anon_replacer*>& replacers)
+	{
+		if (revision == anon_revision && replacers == active_replacers && automaton.IsBuilt())
+			return;
+
+		std::swap(active_replacers, replacers);
+		revision = anon_revision;
+
+		automaton.Clear();
+		pattern_replacers.clear();
+
+		for (uint32_t index = 0; index < active_replacers.size(); ++index)
+		{
+			active_replacers[index]->for_each_pattern([&](std::string_view pattern)
+				{
+					automaton.AddPattern(pattern);
+					pattern_replacers.push_back(index);
+				});
+		}
+
+		automaton.Build();
+	}
+
+	std::string replace_text(std::string_view text) const
+	{
+		matches.clear();
+		automaton.Scan(text, [&](uint32_t index, size_t offset)
+			{
+				const size_t length = automaton.GetPatternLength(index);
+				if (is_whole_word(text, offset, length))
+					matches.push_back({ offset, length, pattern_replacers[index] });
+			});
+
+		if (matches.empty())
+			return std::string(text);
+
+		std::sort(matches.begin(), matches.end(), [](const match& a, const match& b)
+			{
+				if (a.start != b.start)
+					return a.start < b.start;
+				if (a.replacer != b.replacer)
+					return a.replacer < b.replacer;
+				return a.length > b.length;
+			});
+
+		replacements.assign(active_replacers.size(), std::nullopt);
+
+		std::string result;
+		result.reserve(text.length());
+
+		size_t pos = 0;
+		for (const match& m : matches)
+		{
+			if (m.start < pos)
+				continue;
+
+			auto& replacement = replacements[m.replacer];
+			if (!replacement)
+				replacement = active_replacers[m.replacer]->anonymize();
+
+			result.append(text.substr(pos, m.start - pos));
+			result.append(*replacement);
+			pos = m.start + m.length;
+		}
+
+		result.append(text.substr(pos));
+		return result;
+	}
+};
+
+static anon_matcher matcher;
 
 // helper function to find a replacer by name
 static std::vector<std::unique_ptr<anon_replacer>>::iterator FindReplacer(std::string_view Name)
@@ -549,6 +666,23 @@ bool IsAnonymized()
 }
 
 
+// Finds or creates the replacer for a name that comes from the game, like a group member.
+static const anon_replacer* GetMemoizedReplacer(ci_unordered::map<std::string_view, std::unique_ptr<anon_replacer>>& memoization,
+	const char* name, Anonymization strategy)
+{
+	auto memoized = memoization.find(name);
+	if (memoized == memoization.end())
+	{
+		auto replacer = std::make_unique<anon_replacer>(name, strategy);
+
+		// key on our own copy of the name, the game's copy can change out from under us
+		std::string_view key = replacer->name;
+		memoized = memoization.emplace(key, std::move(replacer)).first;
+	}
+
+	return memoized->second.get();
+}
+
 // process string to anonymize
 CXStr& PluginAnonymize(CXStr& Text)
 {
@@ -568,98 +702,52 @@ CXStr Anonymize(const CXStr& Text)
 
 	EnterMQ2Benchmark(bmAnonymizer);
 
-	auto new_text = std::accumulate(std::cbegin(replacers), std::cend(replacers), std::string(Text),
-		[](std::string& text, const std::unique_ptr<anon_replacer>& r) -> std::string {
-			return r ? r->replace_text(text) : text;
-		});
+	// collect the replacers that apply right now, in order of priority
+	static std::vector<const anon_replacer*> active;
+	active.clear();
+
+	for (const auto& r : replacers)
+	{
+		if (r)
+			active.push_back(r.get());
+	}
 
 	if (anon_self != Anonymization::None)
 	{
 		if (!self_replacer || ci_find_substr(self_replacer->name, pLocalPlayer->Name) != 0)
 			self_replacer = std::make_unique<anon_replacer>(pLocalPlayer, anon_self);
 
-		new_text = self_replacer->replace_text(new_text);
+		active.push_back(self_replacer.get());
 	}
 
 	if (anon_group != Anonymization::None && pLocalPC->Group)
 	{
-		new_text = std::accumulate(
-			std::cbegin(*pLocalPC->Group),
-			std::cend(*pLocalPC->Group),
-			new_text,
-			[](std::string& text, const CGroupMember* pMember) -> std::string
-			{
-				if (pMember && pMember->Name[0] != '\0' && ci_equals(text, pMember->Name, false))
-				{
-					auto memoized = group_memoization.find(pMember->Name);
-					if (memoized == group_memoization.end())
-						memoized = group_memoization.emplace(
-							pMember->Name,
-							std::make_unique<anon_replacer>(pMember->Name, anon_group)
-						).first;
-
-					return memoized->second->replace_text(text);
-				}
-
-				return text;
-			}
-		);
+		for (const CGroupMember* pMember : *pLocalPC->Group)
+		{
+			if (pMember && pMember->Name[0] != '\0')
+				active.push_back(GetMemoizedReplacer(group_memoization, pMember->Name.c_str(), anon_group));
+		}
 	}
 
 	if (anon_fellowship != Anonymization::None)
 	{
-		auto& fellowship = pLocalPlayer->Fellowship;
-		new_text = std::accumulate(
-			std::cbegin(fellowship.FellowshipMember),
-			std::cend(fellowship.FellowshipMember),
-			new_text,
-			[](std::string& text, const SFellowshipMember& f) -> std::string
-			{
-				if (f.Name[0] != '\0' && ci_equals(text, f.Name, false))
-				{
-					auto memoized = fellowship_memoization.find(f.Name);
-					if (memoized == fellowship_memoization.end())
-						memoized = fellowship_memoization.emplace(
-							f.Name,
-							std::make_unique<anon_replacer>(f.Name, anon_fellowship)
-						).first;
-
-					return memoized->second->replace_text(text);
-				}
-
-				return text;
-			}
-		);
+		for (const SFellowshipMember& f : pLocalPlayer->Fellowship.FellowshipMember)
+		{
+			if (f.Name[0] != '\0')
+				active.push_back(GetMemoizedReplacer(fellowship_memoization, f.Name, anon_fellowship));
+		}
 	}
 
 	if (anon_guild != Anonymization::None && pGuild)
 	{
 		const char* guild_name = pGuild->GetGuildName(pLocalPC->GuildID);
-		if (guild_name[0] != '\0' && ci_equals(new_text, guild_name, false))
-		{
-			auto memoized = guild_memoization.find(guild_name);
-			if (memoized == guild_memoization.end())
-				memoized = guild_memoization.emplace(
-					guild_name,
-					std::make_unique<anon_replacer>(guild_name, Anonymization::Asterisk)
-				).first;
-
-			new_text = memoized->second->replace_text(new_text);
-		}
+		if (guild_name[0] != '\0')
+			active.push_back(GetMemoizedReplacer(guild_memoization, guild_name, Anonymization::Asterisk));
 
 		for (GuildMember* pMember = pGuild->pFirstGuildMember; pMember; pMember = pMember->pNext)
 		{
-			if (pMember->Name[0] != '\0' && ci_equals(new_text, pMember->Name, false))
-			{
-				auto memoized = guild_memoization.find(pMember->Name);
-				if (memoized == guild_memoization.end())
-					memoized = guild_memoization.emplace(
-						pMember->Name,
-						std::make_unique<anon_replacer>(pMember->Name, anon_guild)
-					).first;
-
-				new_text = memoized->second->replace_text(new_text);
-			}
+			if (pMember->Name[0] != '\0')
+				active.push_back(GetMemoizedReplacer(guild_memoization, pMember->Name, anon_guild));
 		}
 	}
 
@@ -667,20 +755,14 @@ CXStr Anonymize(const CXStr& Text)
 	{
 		for (RaidMember& pMember : pRaid->RaidMember)
 		{
-			if (pMember.Name[0] != '\0' && ci_equals(new_text, pMember.Name, false))
-			{
-				auto memoized = raid_memoization.find(pMember.Name);
-				if (memoized == raid_memoization.end())
-					memoized = raid_memoization.emplace(
-						pMember.Name,
-						std::make_unique<anon_replacer>(pMember.Name, anon_raid)
-					).first;
-
-				new_text = memoized->second->replace_text(new_text);
-			}
+			if (pMember.Name[0] != '\0')
+				active.push_back(GetMemoizedReplacer(raid_memoization, pMember.Name, anon_raid));
 		}
 	}
 
+	matcher.update(active);
+	std::string new_text = matcher.replace_text(Text);
+
 	ExitMQ2Benchmark(bmAnonymizer);
 
 	return CXStr(new_text);
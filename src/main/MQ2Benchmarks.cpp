@@ -15,10 +15,22 @@
 #include "pch.h"
 #include "MQ2Main.h"
 
+#include <mq/utils/LatencyHistogram.h>
+
 namespace mq {
 
 std::vector<std::unique_ptr<MQBenchmark>> gBenchmarks;
 
+// Timings of a benchmark in the current window and the one before it.
+struct MQBenchmarkHistograms
+{
+	LatencyHistogram Current;
+	LatencyHistogram Previous;
+};
+
+// Indexed by benchmark handle, and only allocated once a benchmark has been timed.
+static std::vector<std::unique_ptr<MQBenchmarkHistograms>> s_benchmarkHistograms;
+
 uint32_t AddMQ2Benchmark(const char* Name)
 {
 	DebugSpew("AddMQ2Benchmark(%s)", Name);
@@ -41,6 +53,9 @@ uint32_t AddMQ2Benchmark(const char* Name)
 	}
 
 	gBenchmarks[index] = std::make_unique<MQBenchmark>(Name);
+
+	s_benchmarkHistograms.resize(gBenchmarks.size());
+	s_benchmarkHistograms[index].reset();
 	return index;
 }
 
@@ -51,6 +66,7 @@ void RemoveMQ2Benchmark(uint32_t BMHandle)
 	if (BMHandle < gBenchmarks.size() && gBenchmarks[BMHandle])
 	{
 		gBenchmarks[BMHandle].reset();
+		s_benchmarkHistograms[BMHandle].reset();
 	}
 	else
 	{
@@ -58,11 +74,44 @@ void RemoveMQ2Benchmark(uint32_t BMHandle)
 	}
 }
 
+// Moves the histogram to the previous window once the current window has elapsed.
+static void UpdateBenchmarkWindow(uint32_t BMHandle, MQBenchmark& benchmark, std::chrono::steady_clock::time_point now)
+{
+	if (now - benchmark.WindowStart < MQBenchmarkWindow)
+		return;
+
+	// An enter that has gone a whole window without its exit was never paired with one, and would
+	// keep every later exit from being timed.
+	if (benchmark.Depth > 0 && benchmark.Entry < benchmark.WindowStart)
+		benchmark.Depth = 0;
+
+	if (MQBenchmarkHistograms* histograms = s_benchmarkHistograms[BMHandle].get())
+	{
+		if (now - benchmark.WindowStart < 2 * MQBenchmarkWindow)
+			std::swap(histograms->Previous, histograms->Current);
+		else
+			histograms->Previous.Reset();
+
+		histograms->Current.Reset();
+	}
+
+	benchmark.WindowStart = now;
+}
+
 void EnterMQ2Benchmark(uint32_t BMHandle)
 {
 	if (BMHandle < gBenchmarks.size() && gBenchmarks[BMHandle])
 	{
-		gBenchmarks[BMHandle]->Entry = std::chrono::steady_clock::now();
+		MQBenchmark& benchmark = *gBenchmarks[BMHandle];
+
+		auto now = std::chrono::steady_clock::now();
+		UpdateBenchmarkWindow(BMHandle, benchmark, now);
+
+		// re-entering a benchmark keeps timing from the outermost entry
+		if (benchmark.Depth++ == 0)
+		{
+			benchmark.Entry = now;
+		}
 	}
 }
 
@@ -72,8 +121,18 @@ void ExitMQ2Benchmark(uint32_t BMHandle)
 	{
 		MQBenchmark& benchmark = *gBenchmarks[BMHandle];
 
-		std::chrono::microseconds Time = std::chrono::duration_cast<std::chrono::microseconds>(
-			std::chrono::steady_clock::now() - benchmark.Entry);
+		if (benchmark.Depth == 0 || --benchmark.Depth > 0)
+			return;
+
+		auto now = std::chrono::steady_clock::now();
+		std::chrono::microseconds Time = std::chrono::duration_cast<std::chrono::microseconds>(now - benchmark.Entry);
+
+		UpdateBenchmarkWindow(BMHandle, benchmark, now);
+
+		auto& pHistograms = s_benchmarkHistograms[BMHandle];
+		if (!pHistograms)
+			pHistograms = std::make_unique<MQBenchmarkHistograms>();
+		pHistograms->Current.Record(Time.count());
 
 		benchmark.LastTime += Time;
 		if (benchmark.Count > 4000000000)
@@ -93,6 +152,8 @@ bool GetMQ2Benchmark(uint32_t BMHandle, MQBenchmark& Dest)
 {
 	if (BMHandle < gBenchmarks.size() && gBenchmarks[BMHandle])
 	{
+		UpdateBenchmarkWindow(BMHandle, *gBenchmarks[BMHandle], std::chrono::steady_clock::now());
+
 		Dest = *gBenchmarks[BMHandle]; // give them a copy of the data.
 		return true;
 	}
@@ -100,6 +161,63 @@ bool GetMQ2Benchmark(uint32_t BMHandle, MQBenchmark& Dest)
 	return false;
 }
 
+bool GetMQ2BenchmarkPercentiles(uint32_t BMHandle, MQBenchmarkPercentiles& Dest)
+{
+	if (BMHandle >= gBenchmarks.size() || !gBenchmarks[BMHandle])
+		return false;
+
+	UpdateBenchmarkWindow(BMHandle, *gBenchmarks[BMHandle], std::chrono::steady_clock::now());
+
+	Dest = MQBenchmarkPercentiles();
+
+	// read in place, a merged copy of the two windows would be several KB per benchmark
+	if (const MQBenchmarkHistograms* pHistograms = s_benchmarkHistograms[BMHandle].get())
+	{
+		const LatencyHistogram& current = pHistograms->Current;
+		const LatencyHistogram& previous = pHistograms->Previous;
+
+		Dest.Count = current.GetCount() + previous.GetCount();
+		Dest.P50 = std::chrono::microseconds(LatencyHistogram::GetPercentile(50, previous, current));
+		Dest.P90 = std::chrono::microseconds(LatencyHistogram::GetPercentile(90, previous, current));
+		Dest.P99 = std::chrono::microseconds(LatencyHistogram::GetPercentile(99, previous, current));
+		Dest.Max = std::chrono::microseconds(std::max(current.GetMax(), previous.GetMax()));
+	}
+
+	return true;
+}
+
+void ResetMQ2BenchmarkHistograms()
+{
+	auto now = std::chrono::steady_clock::now();
+
+	for (uint32_t index = 0; index < gBenchmarks.size(); ++index)
+	{
+		if (gBenchmarks[index])
+		{
+			gBenchmarks[index]->WindowStart = now;
+			s_benchmarkHistograms[index].reset();
+		}
+	}
+}
+
+// Formats the percentiles of the benchmark's recent timings, in milliseconds.
+static std::string FormatBenchmarkPercentiles(uint32_t BMHandle, bool color)
+{
+	MQBenchmarkPercentiles percentiles;
+	if (!GetMQ2BenchmarkPercentiles(BMHandle, percentiles) || percentiles.Count == 0)
+		return {};
+
+	double p50 = percentiles.P50.count() / 1000.;
+	double p90 = percentiles.P90.count() / 1000.;
+	double p99 = percentiles.P99.count() / 1000.;
+	double max = percentiles.Max.count() / 1000.;
+
+	if (color)
+		return fmt::format("p50 \at{:.3f}\ax p90 \at{:.3f}\ax p99 \at{:.3f}\ax max \at{:.3f}\axms", p50, p90, p99, max);
+
+	return fmt::format("p50 {:.3f} p90 {:.3f} p99 {:.3f} max {:.3f}ms", p50, p90, p99, max);
+}
+
 void Cmd_DumpBenchmarks(SPAWNINFO* pChar, char* szLine)
 {
 	if (szLine && szLine[0] == '/')
@@ -110,13 +228,19 @@ void Cmd_DumpBenchmarks(SPAWNINFO* pChar, char* szLine)
 		uint64_t Time = MQGetTickCount64() - Start;
 		WriteChatf("\ay%s\ax completed in \at%.2f\axs", szLine, static_cast<double>(Time) / 1000.);
 	}
+	else if (szLine && ci_equals(szLine, "reset"))
+	{
+		ResetMQ2BenchmarkHistograms();
+		WriteChatColor("Benchmark histograms have been reset.");
+	}
 	else
 	{
 		WriteChatColor("MQ2 Benchmarks");
 		WriteChatColor("--------------");
 
-		for (auto& pBenchmark : gBenchmarks)
+		for (uint32_t index = 0; index < gBenchmarks.size(); ++index)
 		{
+			const auto& pBenchmark = gBenchmarks[index];
 			if (pBenchmark)
 			{
 				float AvgMS = 0;
@@ -124,8 +248,9 @@ void Cmd_DumpBenchmarks(SPAWNINFO* pChar, char* szLine)
 					AvgMS = static_cast<float>(pBenchmark->TotalTime.count()) / static_cast<float>(pBenchmark->Count) / 1000.f;
 				float TotalMS = static_cast<float>(pBenchmark->TotalTime.count()) / 1000.f;
 
-				WriteChatf("[\ay%s\ax] \at%I64u\ax for \at%.3fu\axms, \at%.3f\axms avg",
-					pBenchmark->Name.c_str(), pBenchmark->Count, TotalMS, AvgMS);
+				WriteChatf("[\ay%s\ax] \at%I64u\ax for \at%.3fu\axms, \at%.3f\axms avg %s",
+					pBenchmark->Name.c_str(), pBenchmark->Count, TotalMS, AvgMS,
+					FormatBenchmarkPercentiles(index, true).c_str());
 			}
 		}
 
@@ -139,8 +264,9 @@ void DumpBenchmarks()
 	DebugSpewAlways("MQ2 Benchmarks");
 	DebugSpewAlways("--------------");
 
-	for (auto& pBenchmark : gBenchmarks)
+	for (uint32_t index = 0; index < gBenchmarks.size(); ++index)
 	{
+		const auto& pBenchmark = gBenchmarks[index];
 		if (pBenchmark)
 		{
 			float AvgMS = 0;
@@ -148,8 +274,9 @@ void DumpBenchmarks()
 				AvgMS = static_cast<float>(pBenchmark->TotalTime.count()) / static_cast<float>(pBenchmark->Count) / 1000.f;
 			float TotalMS = static_cast<float>(pBenchmark->TotalTime.count()) / 1000.f;
 
-			DebugSpewAlways("%-40s  %d for %.3fms, %.3fms avg",
-				pBenchmark->Name.c_str(), pBenchmark->Count, TotalMS, AvgMS);
+			DebugSpewAlways("%-40s  %d for %.3fms, %.3fms avg %s",
+				pBenchmark->Name.c_str(), pBenchmark->Count, TotalMS, AvgMS,
+				FormatBenchmarkPercentiles(index, false).c_str());
 		}
 	}
 
@@ -172,6 +299,7 @@ void ShutdownMQ2Benchmarks()
 	RemoveCommand("/benchmark");
 
 	gBenchmarks.clear();
+	s_benchmarkHistograms.clear();
 }
 
 } // namespace mq
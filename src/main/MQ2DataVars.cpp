@@ -14,8 +14,11 @@
 
 #include "pch.h"
 #include "MQ2Main.h"
+#include "MQChatLineMatcher.h"
 #include "MQDataAPI.h"
 
+#include "mq/base/TimerQueue.h"
+
 #include <variant>
 
 using namespace mq::datatypes;
@@ -23,12 +26,38 @@ namespace mq {
 
 static std::recursive_mutex s_dataVarMutex;
 
+// Returns the stack frame that owns the given Parameters or LocalVariables list, if any.
+static MQMacroStack* FindVariableFrame(MQDataVar** ppHead)
+{
+	for (MQMacroStack* pStack = gMacroStack; pStack; pStack = pStack->pNext)
+	{
+		if (ppHead == &pStack->Parameters || ppHead == &pStack->LocalVariables)
+			return pStack;
+	}
+
+	return nullptr;
+}
+
+void IndexFrameVariables(MQMacroStack* pStack)
+{
+	std::scoped_lock lock(s_dataVarMutex);
+
+	pStack->VariableIndex.Rebuild(pStack->Parameters, pStack->LocalVariables);
+}
+
 void DeleteMQ2DataVariable(MQDataVar* pVar)
 {
 	std::scoped_lock lock(s_dataVarMutex);
 
 	if (pVar->ppHead == &pMacroVariables || pVar->ppHead == &pGlobalVariables)
+	{
 		VariableMap.erase(pVar->szName);
+	}
+	else if (MQMacroStack* pStack = FindVariableFrame(pVar->ppHead))
+	{
+		pStack->VariableIndex.Remove(pVar, pStack->Parameters, pStack->LocalVariables);
+	}
+
 	if (pVar->pNext)
 		pVar->pNext->pPrev = pVar->pPrev;
 	if (pVar->pPrev)
@@ -54,21 +83,7 @@ MQDataVar* FindMacroVariable(const char* Name)
 	// local?
 	if (gMacroStack)
 	{
-		MQDataVar* pVar = gMacroStack->Parameters;
-		while (pVar)
-		{
-			if (!strcmp(pVar->szName, Name))
-				return pVar;
-			pVar = pVar->pNext;
-		}
-
-		pVar = gMacroStack->LocalVariables;
-		while (pVar)
-		{
-			if (!strcmp(pVar->szName, Name))
-				return pVar;
-			pVar = pVar->pNext;
-		}
+		return gMacroStack->VariableIndex.Find(Name);
 	}
 
 	return nullptr;
@@ -235,7 +250,11 @@ static bool AddMQ2DataVariableBy(const char* Name, const char* Index, MQ2Type* p
 		InitVariableValue(pVar->Var, defaultValue);
 	}
 
-	if (!(gMacroStack && (ppHead == &gMacroStack->LocalVariables || ppHead == &gMacroStack->Parameters)))
+	if (MQMacroStack* pStack = FindVariableFrame(ppHead))
+	{
+		pStack->VariableIndex.Add(pVar, ppHead == &pStack->Parameters);
+	}
+	else
 	{
 		VariableMap[Name] = pVar;
 	}
@@ -284,6 +303,13 @@ bool DeleteMQ2DataVariable(const char* Name)
 
 void ClearMQ2DataVariables(MQDataVar** ppHead)
 {
+	std::scoped_lock lock(s_dataVarMutex);
+
+	// drop the frame's index up front rather than repairing it for every variable
+	MQMacroStack* pStack = FindVariableFrame(ppHead);
+	if (pStack)
+		pStack->VariableIndex.Clear();
+
 	MQDataVar* pVar = *ppHead;
 	while (pVar)
 	{
@@ -294,6 +320,9 @@ void ClearMQ2DataVariables(MQDataVar** ppHead)
 	}
 
 	*ppHead = nullptr;
+
+	if (pStack)
+		IndexFrameVariables(pStack);
 }
 
 void DeclareVar(PlayerClient* pChar, const char* szLine)
@@ -666,22 +695,14 @@ static void AddEvent(MQEventType Event, const char* FirstArg, ...)
 
 		while (CurrentArg)
 		{
-			char szParamName[MAX_STRING] = { 0 };
-			char szParamType[MAX_STRING] = { 0 };
 			int index = gEventFunc[Event];
 
 			auto iter = gMacroBlock->Line.find(index);
 			if (iter != gMacroBlock->Line.end())
 			{
-				MQMacroLine& line = iter->second;
-
-				GetFuncParam(&line.Command[0], i, szParamName, MAX_STRING, szParamType, MAX_STRING);
-
-				MQ2Type* pType = pDataAPI->FindDataType(szParamType);
-				if (!pType)
-					pType = pStringType;
+				const MQSubParameter& param = GetSubParameter(iter->second, i);
 
-				AddMQ2DataEventVariable(szParamName, "", pType, &pEvent->Parameters, CurrentArg);
+				AddMQ2DataEventVariable(param.Name.c_str(), "", param.GetType(), &pEvent->Parameters, CurrentArg);
 				i++;
 				CurrentArg = va_arg(marker, const char*);
 			}
@@ -721,39 +742,25 @@ void CALLBACK EventBlechCallback(unsigned int ID, void* pData, PBLECHVALUE pValu
 	ZeroMemory(pEvent, sizeof(MQEventQueue));
 	pEvent->Type = EVENT_CUSTOM;
 	pEvent->pEventList = pEList;
-	char szParamName[MAX_STRING] = { 0 };
-	char szParamType[MAX_STRING] = { 0 };
 
 	auto eventIter = gMacroBlock->Line.find(pEList->pEventFunc);
 	if (eventIter != gMacroBlock->Line.end())
 	{
-		GetFuncParam(&eventIter->second.Command[0], 0, szParamName, MAX_STRING, szParamType, MAX_STRING);
-	}
-
-	MQ2Type* pType = pDataAPI->FindDataType(szParamType);
-	if (!pType)
-		pType = pStringType;
+		MQMacroLine& eventLine = eventIter->second;
 
-	AddMQ2DataEventVariable(szParamName, "", pType, &pEvent->Parameters, EventMsg);
+		const MQSubParameter& param = GetSubParameter(eventLine, 0);
+		AddMQ2DataEventVariable(param.Name.c_str(), "", param.GetType(), &pEvent->Parameters, EventMsg);
 
-	while (pValues)
-	{
-		if (pValues->Name[0] != '*')
+		while (pValues)
 		{
-			auto eventIter2 = gMacroBlock->Line.find(pEList->pEventFunc);
-			if (eventIter2 != gMacroBlock->Line.end())
+			if (pValues->Name[0] != '*')
 			{
-				GetFuncParam(&eventIter2->second.Command[0], GetIntFromString(pValues->Name, 0), szParamName, MAX_STRING, szParamType, MAX_STRING);
+				const MQSubParameter& valueParam = GetSubParameter(eventLine, GetIntFromString(pValues->Name, 0));
+				AddMQ2DataEventVariable(valueParam.Name.c_str(), "", valueParam.GetType(), &pEvent->Parameters, std::string(pValues->Value).c_str());
 			}
 
-			MQ2Type* pType2 = pDataAPI->FindDataType(szParamType);
-			if (!pType2)
-				pType2 = pStringType;
-
-			AddMQ2DataEventVariable(szParamName, "", pType2, &pEvent->Parameters, pValues->Value.c_str());
+			pValues = pValues->pNext;
 		}
-
-		pValues = pValues->pNext;
 	}
 
 	if (!gEventQueue)
@@ -775,7 +782,9 @@ static DWORD CALLBACK BeepOnTellThread(void* pData)
 	return 0;
 }
 
-static void TellCheck(const char* szClean)
+static MQChatLineMatcher s_chatLineMatcher;
+
+static void TellCheck(const char* szClean, const MQChatLineMatch& match)
 {
 	if (!gbFlashOnTells && !gbBeepOnTells)
 		return;
@@ -784,12 +793,12 @@ static void TellCheck(const char* szClean)
 
 	char name[MAX_STRING] = { 0 };
 	bool isTell = false;
-	if (const char* pDest = strstr(szClean, " tells you, "))
+	if (const char* pDest = match.Find(ChatLiteral_TellsYou))
 	{
 		strncpy_s(name, szClean, static_cast<int>(pDest - szClean));
 		isTell = true;
 	}
-	else if (pDest = strstr(szClean, " told you, "))
+	else if (pDest = match.Find(ChatLiteral_ToldYou))
 	{
 		strncpy_s(name, szClean, static_cast<int>(pDest - szClean));
 		isTell = true;
@@ -878,12 +887,18 @@ void CheckChatForEvent(const char* szMsg)
 		strcpy_s(szClean, len + 64, out.c_str());
 	}
 
-	strncpy_s(EventMsg, szClean, MAX_STRING - 1);
-	EventMsg[MAX_STRING - 1] = 0;
-	if (pMQ2Blech)
+	MQChatLineMatch match;
+	s_chatLineMatcher.Scan(szClean, match, pMQ2Blech, pEventBlech);
+
+	if (match.feedMQ2Blech)
+	{
+		strncpy_s(EventMsg, szClean, MAX_STRING - 1);
+		EventMsg[MAX_STRING - 1] = 0;
 		pMQ2Blech->Feed(EventMsg);
-	EventMsg[0] = 0;
-	TellCheck(szClean);
+		EventMsg[0] = 0;
+	}
+
+	TellCheck(szClean, match);
 
 	MQMacroBlockPtr pBlock = GetCurrentMacroBlock();
 	if ((pBlock && !pBlock->Line.empty()) && (!pBlock->Paused) && (!gbUnload) && (!gZoning))
@@ -891,57 +906,57 @@ void CheckChatForEvent(const char* szMsg)
 		char SpeakerName[MAX_STRING] = { 0 };
 		char Content[MAX_STRING] = { 0 };
 		char Channel[MAX_STRING] = { 0 };
-		char* pDest = nullptr;
+		const char* pDest = nullptr;
 
 		int StartCopyAt = 0;
 
-		if ((CHATEVENT(CHAT_GUILD)) && (pDest = strstr(szClean, " tells the guild, ")))
+		if ((CHATEVENT(CHAT_GUILD)) && (pDest = match.Find(ChatLiteral_TellsGuild)))
 		{
 			strcpy_s(Channel, "guild");
 		}
-		else if ((CHATEVENT(CHAT_GROUP)) && (pDest = strstr(szClean, " tells the group, ")))
+		else if ((CHATEVENT(CHAT_GROUP)) && (pDest = match.Find(ChatLiteral_TellsGroup)))
 		{
 			strcpy_s(Channel, "group");
 		}
-		else if ((CHATEVENT(CHAT_TELL)) && (pDest = strstr(szClean, " tells you, ")))
+		else if ((CHATEVENT(CHAT_TELL)) && (pDest = match.Find(ChatLiteral_TellsYou)))
 		{
 			strcpy_s(Channel, "tell");
 		}
-		else if ((CHATEVENT(CHAT_TELL)) && (pDest = strstr(szClean, " told you, ")))
+		else if ((CHATEVENT(CHAT_TELL)) && (pDest = match.Find(ChatLiteral_ToldYou)))
 		{
 			strcpy_s(Channel, "tell");
 		}
 		// Cannot be said in another language, so we can match through the single quote here
-		else if ((CHATEVENT(CHAT_OOC)) && (pDest = strstr(szClean, " says out of character, '")))
+		else if ((CHATEVENT(CHAT_OOC)) && (pDest = match.Find(ChatLiteral_OutOfCharacter)))
 		{
 			strcpy_s(Channel, "ooc");
 		}
-		else if ((CHATEVENT(CHAT_SHOUT)) && (pDest = strstr(szClean, " shouts, ")))
+		else if ((CHATEVENT(CHAT_SHOUT)) && (pDest = match.Find(ChatLiteral_Shouts)))
 		{
 			strcpy_s(Channel, "shout");
 		}
-		else if ((CHATEVENT(CHAT_AUC)) && (pDest = strstr(szClean, " auctions, ")))
+		else if ((CHATEVENT(CHAT_AUC)) && (pDest = match.Find(ChatLiteral_Auctions)))
 		{
 			strcpy_s(Channel, "auc");
 		}
 		// What scenario misses the comma?  This is the only reason we require the StartCopyAt check
-		else if ((CHATEVENT(CHAT_SAY)) && (pDest = strstr(szClean, " says '")))
+		else if ((CHATEVENT(CHAT_SAY)) && (pDest = match.Find(ChatLiteral_SaysQuote)))
 		{
 			StartCopyAt = 7;
 			strcpy_s(Channel, "say");
 		}
-		else if ((CHATEVENT(CHAT_SAY)) && (pDest = strstr(szClean, " says, ")))
+		else if ((CHATEVENT(CHAT_SAY)) && (pDest = match.Find(ChatLiteral_SaysComma)))
 		{
 			strcpy_s(Channel, "say");
 		}
-		else if ((CHATEVENT(CHAT_RAID)) && (pDest = strstr(szClean, " tells the raid, ")))
+		else if ((CHATEVENT(CHAT_RAID)) && (pDest = match.Find(ChatLiteral_TellsRaid)))
 		{
 			strcpy_s(Channel, "raid");
 		}
-		else if ((CHATEVENT(CHAT_CHAT)) && (strstr(szClean, "You told ") == nullptr)
-			&& (pDest = strstr(szClean, " tells "))
-			&& (strstr(szClean, ":"))
-			&& (strstr(szClean, ", '")))
+		else if ((CHATEVENT(CHAT_CHAT)) && (match.Find(ChatLiteral_YouTold) == nullptr)
+			&& (pDest = match.Find(ChatLiteral_Tells))
+			&& (match.Find(ChatLiteral_Colon))
+			&& (match.Find(ChatLiteral_CommaQuote)))
 		{
 			strcpy_s(Channel, pDest + 7);
 			Channel[strlen(Channel) - 1] = 0;
@@ -988,32 +1003,61 @@ void CheckChatForEvent(const char* szMsg)
 			AddEvent(EVENT_CHAT, Channel, SpeakerName, Content, NULL);
 		}
 
-		strncpy_s(EventMsg, szClean, MAX_STRING - 1);
-		EventMsg[MAX_STRING - 1] = 0;
-		pEventBlech->Feed(EventMsg);
-		EventMsg[0] = '\0';
+		if (match.feedEventBlech)
+		{
+			strncpy_s(EventMsg, szClean, MAX_STRING - 1);
+			EventMsg[MAX_STRING - 1] = 0;
+			pEventBlech->Feed(EventMsg);
+			EventMsg[0] = '\0';
+		}
 	}
 }
 
+// Macro timers count in ticks of a tenth of a second, advanced by DropTimers.
+static uint64_t s_timerTick = 0;
+static TimerQueue<MQTimer*> s_runningTimers;
+
+MQTimer::~MQTimer()
+{
+	SetCurrent(0);
+}
+
+uint32_t MQTimer::GetCurrent() const
+{
+	return m_dueTick > s_timerTick ? static_cast<uint32_t>(m_dueTick - s_timerTick) : 0;
+}
+
+void MQTimer::SetCurrent(uint32_t value)
+{
+	if (m_timerId != 0)
+	{
+		s_runningTimers.Cancel(m_timerId);
+		m_timerId = 0;
+	}
+
+	m_dueTick = s_timerTick + value;
+
+#pragma warning(suppress: 4996)
+	Current = value;
+
+	if (value != 0)
+		m_timerId = s_runningTimers.Schedule(m_dueTick, this);
+}
+
 void DropTimers()
 {
-	MQTimer* pTimer = gTimer;
+	++s_timerTick;
 
 	char szOrig[MAX_STRING] = { 0 };
 
-	while (pTimer)
-	{
-		if (pTimer->Current)
+	s_runningTimers.Run(s_timerTick, [&](MQTimer* pTimer)
 		{
-			pTimer->Current--;
-			if (!pTimer->Current)
-			{
-				_itoa_s(pTimer->Original, szOrig, 10);
-				AddEvent(EVENT_TIMER, pTimer->Name.c_str(), szOrig, NULL);
-			}
-		}
-		pTimer = pTimer->pNext;
-	}
+#pragma warning(suppress: 4996)
+			pTimer->Current = 0;
+
+			_itoa_s(pTimer->Original, szOrig, 10);
+			AddEvent(EVENT_TIMER, pTimer->Name.c_str(), szOrig, NULL);
+		});
 }
 
 namespace detail
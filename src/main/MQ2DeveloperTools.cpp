@@ -4768,23 +4768,43 @@ public:
 
 	void DrawTable()
 	{
-		if (ImGui::BeginTable("##BenchmarksTable", 4))
+		if (ImGui::Button("Reset Histograms"))
+		{
+			ResetMQ2BenchmarkHistograms();
+		}
+
+		if (ImGui::BeginTable("##BenchmarksTable", 8))
 		{
 			ImGui::TableSetupColumn("Name");
 			ImGui::TableSetupColumn("Count");
 			ImGui::TableSetupColumn("Total");
 			ImGui::TableSetupColumn("Last");
+			ImGui::TableSetupColumn("p50");
+			ImGui::TableSetupColumn("p90");
+			ImGui::TableSetupColumn("p99");
+			ImGui::TableSetupColumn("Max");
 			ImGui::TableHeadersRow();
 
-			for (const auto& bm : gBenchmarks)
+			for (uint32_t index = 0; index < gBenchmarks.size(); ++index)
 			{
+				const auto& bm = gBenchmarks[index];
+
+				// percentiles are over the recent windows, see MQBenchmark
+				MQBenchmarkPercentiles percentiles;
+				if (!bm || !GetMQ2BenchmarkPercentiles(index, percentiles))
+					continue;
+
 				ImGui::TableNextRow();
 				ImGui::TableNextColumn();
 
 				ImGui::Text(bm->Name.c_str()); ImGui::TableNextColumn();
 				ImGui::Text("%d", bm->Count); ImGui::TableNextColumn();
 				ImGui::Text("%.3f ms", static_cast<float>(bm->TotalTime.count() / 1000.f)); ImGui::TableNextColumn();
-				ImGui::Text("%.3f ms", static_cast<float>(bm->LastTime.count() / 1000.f));
+				ImGui::Text("%.3f ms", static_cast<float>(bm->LastTime.count() / 1000.f)); ImGui::TableNextColumn();
+				ImGui::Text("%.3f ms", percentiles.P50.count() / 1000.f); ImGui::TableNextColumn();
+				ImGui::Text("%.3f ms", percentiles.P90.count() / 1000.f); ImGui::TableNextColumn();
+				ImGui::Text("%.3f ms", percentiles.P99.count() / 1000.f); ImGui::TableNextColumn();
+				ImGui::Text("%.3f ms", percentiles.Max.count() / 1000.f);
 			}
 
 			ImGui::EndTable();
@@ -16,6 +16,7 @@
 
 #include "../eqlib/EQLib.h"
 #include "MQ2Internal.h"
+#include "MQSpatialGrid.h"
 #include "mq/base/GlobalBuffer.h"
 
 #include <memory>
@@ -309,6 +310,7 @@ MQLIB_VAR int gSpawnCount;
 
 // internal to mq2 only
 extern std::vector<MQSpawnArrayItem> gSpawnsArray;
+const MQSpatialGrid<PlayerClient*>& GetSpawnGrid();
 #if HAS_CHAT_TIMESTAMPS
 extern bool gbTimeStampChat;
 #endif
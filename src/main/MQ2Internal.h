@@ -14,6 +14,8 @@
 
 #pragma once
 
+#include "MQFrameVariableIndex.h"
+
 #include "mq/api/MacroAPI.h"
 #include "mq/api/Main.h"
 #include "mq/api/PluginAPI.h"
@@ -22,6 +24,7 @@
 #include <map>
 #include <memory>
 #include <mutex>
+#include <string_view>
 #include <vector>
 #include <variant>
 
@@ -230,10 +233,31 @@ struct MQWhoSort
 using WHOSORT DEPRECATE("Use MQWhoSort instead of WHOSORT") = MQWhoSort;
 using PWHOSORT DEPRECATE("Use MQWhoSort* instead PWHOSORT") = MQWhoSort*;
 
+// A parameter from a Sub's signature, parsed once when the macro is loaded.
+struct MQSubParameter
+{
+	std::string Name;
+	std::string TypeName;
+
+	// Looks up the parameter's type, falling back to string. The result is cached until the set
+	// of registered data types changes.
+	MQ2Type* GetType() const;
+
+private:
+	mutable MQ2Type* m_type = nullptr;
+	mutable uint32_t m_typeRevision = 0;
+};
+
 struct MQMacroLine
 {
 	std::string Command;
 
+	// Set for "Sub" lines. SubParameters holds the parameters in the signature, and is only
+	// written when the macro is loaded. See GetSubParameter for arguments past the end of it.
+	bool IsSub = false;
+	int SubParameterCount = 0;
+	std::vector<MQSubParameter> SubParameters;
+
 	int LoopStart = 0;
 	// used for loops/while if its 0 no action is taken, otherwise it will jump to the line indicated.
 	int LoopEnd = 0;
@@ -254,10 +278,107 @@ struct MQMacroLine
 
 	MQMacroLine(const MQMacroLine&) = delete;
 	MQMacroLine& operator=(const MQMacroLine&) = delete;
+
+	MQMacroLine(MQMacroLine&&) = default;
+	MQMacroLine& operator=(MQMacroLine&&) = default;
 };
 using MACROLINE DEPRECATE("Use MQMacroLine instead MACROLINE") = MQMacroLine;
 using PMACROLINE DEPRECATE("Use MQMacroLine* instead of PMACROLINE") = MQMacroLine;
 
+// The lines of a loaded macro, stored contiguously in load order. Lines are keyed by their load
+// index, which is sparse because comments and blank lines are skipped. A dense table maps each key
+// to its position, so finding a line and stepping to the next one are both constant time.
+class MQMacroLines
+{
+public:
+	using value_type = std::pair<const int, MQMacroLine>;
+	using container_type = std::vector<value_type>;
+	using iterator = container_type::iterator;
+	using const_iterator = container_type::const_iterator;
+	using reverse_iterator = container_type::reverse_iterator;
+	using const_reverse_iterator = container_type::const_reverse_iterator;
+
+	// Lines must be added in increasing key order.
+	template <typename... Args>
+	std::pair<iterator, bool> emplace(int key, Args&&... args)
+	{
+		if (key < 0 || (!m_lines.empty() && key <= m_lines.back().first))
+			return { end(), false };
+
+		if (static_cast<size_t>(key) >= m_positions.size())
+			m_positions.resize(static_cast<size_t>(key) + 1, -1);
+
+		m_positions[key] = static_cast<int>(m_lines.size());
+		m_lines.emplace_back(std::piecewise_construct,
+			std::forward_as_tuple(key),
+			std::forward_as_tuple(std::forward<Args>(args)...));
+
+		return { std::prev(m_lines.end()), true };
+	}
+
+	iterator find(int key)
+	{
+		const int position = GetPosition(key);
+		return position == -1 ? m_lines.end() : m_lines.begin() + position;
+	}
+
+	const_iterator find(int key) const
+	{
+		const int position = GetPosition(key);
+		return position == -1 ? m_lines.end() : m_lines.begin() + position;
+	}
+
+	MQMacroLine& at(int key)
+	{
+		const int position = GetPosition(key);
+		if (position == -1)
+			throw std::out_of_range("invalid macro line");
+
+		return m_lines[position].second;
+	}
+
+	const MQMacroLine& at(int key) const
+	{
+		const int position = GetPosition(key);
+		if (position == -1)
+			throw std::out_of_range("invalid macro line");
+
+		return m_lines[position].second;
+	}
+
+	MQMacroLine& operator[](int key) { return at(key); }
+
+	iterator begin() { return m_lines.begin(); }
+	iterator end() { return m_lines.end(); }
+	const_iterator begin() const { return m_lines.begin(); }
+	const_iterator end() const { return m_lines.end(); }
+	reverse_iterator rbegin() { return m_lines.rbegin(); }
+	reverse_iterator rend() { return m_lines.rend(); }
+	const_reverse_iterator rbegin() const { return m_lines.rbegin(); }
+	const_reverse_iterator rend() const { return m_lines.rend(); }
+
+	bool empty() const { return m_lines.empty(); }
+	size_t size() const { return m_lines.size(); }
+
+	void clear()
+	{
+		m_lines.clear();
+		m_positions.clear();
+	}
+
+private:
+	int GetPosition(int key) const
+	{
+		if (key < 0 || static_cast<size_t>(key) >= m_positions.size())
+			return -1;
+
+		return m_positions[key];
+	}
+
+	container_type m_lines;
+	std::vector<int> m_positions;
+};
+
 struct MQMacroBlock
 {
 	std::string Name;                           // our macro Name
@@ -265,7 +386,7 @@ struct MQMacroBlock
 	int CurrIndex = 0;                          // the current macro line we are on
 	int BindStackIndex = -1;                    // where we were at before calling the bind.
 	std::string BindCmd;                        // the actual command including parameters
-	std::map<int, MQMacroLine> Line;
+	MQMacroLines Line;
 	bool Removed = false;
 
 	MQMacroBlock(std::string name) : Name(std::move(name)) {}
@@ -282,9 +403,29 @@ struct MQTimer
 {
 	std::string Name;
 	uint32_t Original = 0;
+
+	// The value the timer was last set to, or 0 once it has fired. It is no longer counted down
+	// every tick, and is only kept so that the layout stays the same for existing plugins.
+	DEPRECATE("Use GetCurrent() to read the remaining time of a timer")
 	uint32_t Current = 0;
+
 	MQTimer* pNext = nullptr;
 	MQTimer* pPrev = nullptr;
+
+	MQTimer() = default;
+	MQLIB_OBJECT ~MQTimer();
+
+	MQTimer(const MQTimer&) = delete;
+	MQTimer& operator=(const MQTimer&) = delete;
+
+	// Remaining time in tenths of a second. Running timers are scheduled on a queue that
+	// DropTimers advances, rather than each being counted down every tick.
+	MQLIB_OBJECT uint32_t GetCurrent() const;
+	MQLIB_OBJECT void SetCurrent(uint32_t value);
+
+private:
+	uint64_t m_dueTick = 0;
+	uint64_t m_timerId = 0;
 };
 using MQTIMER DEPRECATE("Use MQTimer instead of MQTIMER") = MQTimer;
 using PMQTIMER DEPRECATE("Use MQTimer* instead of PMQTIMER") = MQTimer*;
@@ -670,6 +811,10 @@ struct MQMacroStack
 	int LocationIndex = 0;
 	MQDataVar* Parameters = nullptr;
 	MQDataVar* LocalVariables = nullptr;
+
+	// Parameters and LocalVariables by name. Maintained by the variable functions in MQ2DataVars.
+	MQFrameVariableIndex<MQDataVar> VariableIndex;
+
 	std::vector<MQLoop> loopStack;
 	std::string Return;
 
@@ -681,6 +826,19 @@ struct MQMacroStack
 
 	MQMacroStack(const MQMacroStack&) = delete;
 	MQMacroStack& operator=(const MQMacroStack&) = delete;
+
+	// Prepares a recycled frame for reuse. Its variables must already have been cleared.
+	void Reset(int locationIndex)
+	{
+		bIsBind = false;
+		LocationIndex = locationIndex;
+		Parameters = nullptr;
+		LocalVariables = nullptr;
+		VariableIndex.Clear();
+		loopStack.clear();
+		Return.clear();
+		pNext = nullptr;
+	}
 };
 using PMACROSTACK DEPRECATE("Use MQMacroStack* instead of PMACROSTACK") = MQMacroStack *;
 using MACROSTACK DEPRECATE("Use MQMacroStack instead of MACROSTACK") = MQMacroStack;
@@ -961,6 +1119,17 @@ public:
 		const MQPluginHandle& pluginHandle) override;
 	bool CreateDetour(uintptr_t address, size_t width, std::string_view name, const MQPluginHandle& pluginHandle) override;
 	bool RemoveDetour(uintptr_t address, const MQPluginHandle& pluginHandle) override;
+
+	// Pulse Tasks
+	MQPulseTaskId AddPulseTask(
+		std::string_view name,
+		MQPulseTaskHandler handler,
+		uint32_t intervalMS,
+		uint32_t budgetUS,
+		const MQPluginHandle& pluginHandle) override;
+	bool RemovePulseTask(
+		MQPulseTaskId taskId,
+		const MQPluginHandle& pluginHandle) override;
 };
 
 extern MainImpl* gpMainAPI;
@@ -19,7 +19,10 @@
 #include "MQDataAPI.h"
 #include "MQPluginHandler.h"
 #include "MQ2KeyBinds.h"
+#include "CrashHandler.h"
+#include "mq/base/ScopeExit.h"
 
+#include <deque>
 #include <fstream>
 #include <regex>
 
@@ -356,6 +359,93 @@ void FailIf(SPAWNINFO* pChar, const char* szCommand, int StartLine, bool All = f
 	}
 }
 
+// The condition of the current /delay. It is compiled when the delay starts and evaluated from the
+// compiled form on every pulse until it passes or the delay runs out. gDelayCondition remains the
+// source of the condition, since plugins can set it directly, and the compiled form is rebuilt
+// whenever the two no longer match.
+struct MQDelayCondition
+{
+	std::string Source;
+	std::shared_ptr<const MQCompiledMacroString> Compiled;
+
+	// A condition without any variables can't change, so it only needs to be evaluated once.
+	bool Constant = false;
+	bool ConstantResult = false;
+};
+static MQDelayCondition s_delayCondition;
+
+static void CompileDelayCondition()
+{
+	s_delayCondition.Source = gDelayCondition;
+	s_delayCondition.Compiled = nullptr;
+	s_delayCondition.Constant = false;
+
+	if (s_delayCondition.Source.find("${") == std::string::npos)
+		s_delayCondition.Constant = true;
+	else if (gParserVersion == 2)
+		s_delayCondition.Compiled = pDataAPI->GetCompiledMacroString(s_delayCondition.Source);
+}
+
+static bool CalculateDelayCondition(const char* szCond, bool& conditionMet)
+{
+	double Result;
+	if (!Calculate(szCond, Result))
+	{
+		FatalError("Failed to parse /delay condition '%s', non-numeric encountered", szCond);
+		return false;
+	}
+
+	// TODO:  Determine the bounds on what "0" should be here since this is a double.
+	conditionMet = Result != 0;
+	return true;
+}
+
+bool EvaluateDelayCondition(bool& conditionMet)
+{
+	conditionMet = false;
+
+	if (!gDelayCondition[0])
+		return true;
+
+	if (s_delayCondition.Source != gDelayCondition)
+	{
+		CompileDelayCondition();
+
+		if (s_delayCondition.Constant)
+		{
+			if (!CalculateDelayCondition(gDelayCondition, s_delayCondition.ConstantResult))
+			{
+				s_delayCondition.Source.clear();
+				return false;
+			}
+		}
+	}
+
+	if (s_delayCondition.Constant)
+	{
+		conditionMet = s_delayCondition.ConstantResult;
+		return true;
+	}
+
+	if (!s_delayCondition.Compiled || gParserVersion != 2)
+	{
+		char szCond[MAX_STRING];
+		strcpy_s(szCond, gDelayCondition);
+
+		ParseMacroData(szCond, MAX_STRING);
+		return CalculateDelayCondition(szCond, conditionMet);
+	}
+
+	CrashHandler_SetLastMacroData(gDelayCondition);
+	SCOPE_EXIT(CrashHandler_SetLastMacroData(nullptr));
+
+	std::string strCond = pDataAPI->EvaluateCompiledMacroString(*s_delayCondition.Compiled, false);
+	if (strCond.length() >= MAX_STRING)
+		strCond.resize(MAX_STRING - 1);
+
+	return CalculateDelayCondition(strCond.c_str(), conditionMet);
+}
+
 // ***************************************************************************
 // Function:    Delay
 // Description: Our '/delay' command
@@ -392,27 +482,43 @@ void Delay(PlayerClient* pChar, const char* szLine)
 	gDelay = VarValue;
 	bRunNextCommand = false;
 
-	if (gDelayCondition[0])
+	bool conditionMet;
+	if (!EvaluateDelayCondition(conditionMet))
+		return;
+
+	if (conditionMet)
 	{
-		char szCond[MAX_STRING];
-		strcpy_s(szCond, gDelayCondition);
+		gDelay = 0;
+		bRunNextCommand = true;
+	}
+}
 
-		ParseMacroData(szCond, MAX_STRING);
+// Stack frames are recycled rather than freed, since a macro that calls small subs in a loop
+// would otherwise allocate and free a frame for every call.
+static std::vector<std::unique_ptr<MQMacroStack>> s_macroStackPool;
+static constexpr size_t MaxPooledMacroStacks = 32;
 
-		double Result;
-		if (!Calculate(szCond, Result))
-		{
-			FatalError("Failed to parse /delay condition '%s', non-numeric encountered", szCond);
-			return;
-		}
+static MQMacroStack* AcquireMacroStack(int locationIndex)
+{
+	if (s_macroStackPool.empty())
+		return new MQMacroStack(locationIndex);
 
-		// TODO:  Determine the bounds on what "0" should be here since this is a double.
-		if (Result != 0)
-		{
-			gDelay = 0;
-			bRunNextCommand = true;
-		}
+	MQMacroStack* pStack = s_macroStackPool.back().release();
+	s_macroStackPool.pop_back();
+
+	pStack->Reset(locationIndex);
+	return pStack;
+}
+
+static void ReleaseMacroStack(MQMacroStack* pStack)
+{
+	if (s_macroStackPool.size() >= MaxPooledMacroStacks)
+	{
+		delete pStack;
+		return;
 	}
+
+	s_macroStackPool.emplace_back(pStack);
 }
 
 char* GetFuncParam(const char* szMacroLine, int ParamNum, char* szParamName, size_t ParamNameLen, char* szParamType, size_t ParamTypeLen)
@@ -466,6 +572,77 @@ char* GetFuncParam(const char* szMacroLine, int ParamNum, char* szParamName, siz
 	return szParamName;
 }
 
+static int GetNumArgsFromSub(const std::string& Sub)
+{
+	if (size_t hasparams = std::count(Sub.begin(), Sub.end(), '('))
+	{
+		size_t n = std::count(Sub.begin(), Sub.end(), ',');
+		return static_cast<int>(n) + 1;
+	}
+	return 0;
+}
+
+// Parses the signature of a Sub line into its parameter descriptors, so that calls and events
+// don't have to tokenize it every time they bind arguments.
+static void ParseSubSignature(MQMacroLine& line)
+{
+	line.IsSub = true;
+	line.SubParameterCount = GetNumArgsFromSub(line.Command);
+	line.SubParameters.clear();
+	line.SubParameters.reserve(line.SubParameterCount);
+
+	char szParamName[MAX_STRING] = { 0 };
+	char szParamType[MAX_STRING] = { 0 };
+
+	for (int i = 0; i < line.SubParameterCount; ++i)
+	{
+		GetFuncParam(line.Command.c_str(), i, szParamName, MAX_STRING, szParamType, MAX_STRING);
+
+		MQSubParameter& param = line.SubParameters.emplace_back();
+		param.Name = szParamName;
+		param.TypeName = szParamType;
+	}
+}
+
+const MQSubParameter& GetSubParameter(const MQMacroLine& line, int index)
+{
+	static const MQSubParameter s_noParameter;
+
+	// Arguments past the end of a signature get the same defaults that GetFuncParam gives them. They
+	// are the same for every sub, and a deque keeps references to the ones made so far valid as it grows.
+	static std::deque<MQSubParameter> s_defaultParameters;
+
+	if (!line.IsSub || index < 0)
+		return s_noParameter;
+
+	if (index < static_cast<int>(line.SubParameters.size()))
+		return line.SubParameters[index];
+
+	while (static_cast<int>(s_defaultParameters.size()) <= index)
+	{
+		MQSubParameter& param = s_defaultParameters.emplace_back();
+		param.Name = fmt::format("Param{}", s_defaultParameters.size() - 1);
+		param.TypeName = "string";
+	}
+
+	return s_defaultParameters[index];
+}
+
+MQ2Type* MQSubParameter::GetType() const
+{
+	const uint32_t revision = GetMacroDataRevision();
+
+	if (!m_type || m_typeRevision != revision)
+	{
+		m_type = pDataAPI->FindDataType(TypeName.c_str());
+		if (!m_type)
+			m_type = datatypes::pStringType;
+		m_typeRevision = revision;
+	}
+
+	return m_type;
+}
+
 /* VAR SYSTEM INDEPENDENT */
 // in-place cleanup of tabs, leading/trailing space
 void CleanMacroLine(char* szLine)
@@ -837,10 +1014,7 @@ bool AddMacroLine(const char* FileName, char* szLine, size_t Linelen, int* LineN
 		}
 	}
 
-	auto [iter, success] = gMacroBlock->Line.emplace(
-		std::piecewise_construct,
-		std::forward_as_tuple(*LineNumber),
-		std::forward_as_tuple(szLine, FileName, localLine));
+	auto [iter, success] = gMacroBlock->Line.emplace(*LineNumber, szLine, FileName, localLine);
 	if (!success)
 	{
 		MacroError("Duplicate line number detected! %s@%d", FileName, localLine);
@@ -856,6 +1030,9 @@ bool AddMacroLine(const char* FileName, char* szLine, size_t Linelen, int* LineN
 	if (std::regex_search(szLine, submatch, subrx))
 	{
 		gMacroSubLookupMap[submatch.str(1)] = *LineNumber;
+
+		if (success)
+			ParseSubSignature(iter->second);
 	}
 
 	return true;
@@ -1090,6 +1267,8 @@ void Macro(PlayerClient* pChar, const char* szLine)
 
 	fclose(fMacro);
 
+	ResolveMacroJumps(*gMacroBlock);
+
 	while (pDefines)
 	{
 		MQDefine* pDef = pDefines->pNext;
@@ -1194,32 +1373,17 @@ void Cleanup(PlayerClient* pChar, const char* szLine)
 }
 
 // ***************************************************************************
-// Function:    Goto
-// Description: Our '/goto' command
-// Usage:       /goto :label
+// Function:    FindGotoLabel
+// Description: Finds the line of a /goto label. Searches up to the start of
+//              the current sub first, then forward until the next sub.
+//              Returns 0 if the label wasn't found.
 // ***************************************************************************
-void Goto(PlayerClient* pChar, const char* szLine)
+static int FindGotoLabel(MQMacroLines& lines, MQMacroLines::iterator from, const char* szLabel)
 {
-	if (!gMacroBlock)
-	{
-		MacroError("Cannot goto when a macro isn't running.");
-		return;
-	}
-
-	bRunNextCommand = true;
-	int FromIndex = gMacroBlock->CurrIndex;
-
-	const auto goto_line = gMacroBlock->Line.find(FromIndex);
-	if (goto_line->second.LoopEnd)
-	{
-		gMacroBlock->CurrIndex = goto_line->second.LoopEnd;
-		return;
-	}
-
-	std::map<int, MQMacroLine>::reverse_iterator ri(goto_line);
+	int FromIndex = from->first;
 
 	// search up first we only search until we find a "Sub "
-	for (; ri != gMacroBlock->Line.rend(); ri++)
+	for (MQMacroLines::reverse_iterator ri(from); ri != lines.rend(); ri++)
 	{
 		if (!_strnicmp(ri->second.Command.c_str(), "Sub ", 4))
 		{
@@ -1228,38 +1392,174 @@ void Goto(PlayerClient* pChar, const char* szLine)
 			break;
 		}
 
-		if (!_stricmp(szLine, ri->second.Command.c_str()))
-		{
-			// Label found....
-			gMacroBlock->CurrIndex = ri->first;
-			goto_line->second.LoopEnd = ri->first;
-			return;
-		}
+		if (!_stricmp(szLabel, ri->second.Command.c_str()))
+			return ri->first;
 	}
 
 	// now that we found our start lets look forward for the goto label:
-	for (auto iter = gMacroBlock->Line.find(FromIndex); iter != gMacroBlock->Line.end(); iter++)
+	for (auto iter = lines.find(FromIndex); iter != lines.end(); iter++)
 	{
 		if (!_strnicmp(iter->second.Command.c_str(), "Sub ", 4))
+			break;
+
+		if (!_stricmp(szLabel, iter->second.Command.c_str()))
+			return iter->first;
+	}
+
+	return 0;
+}
+
+// ***************************************************************************
+// Function:    FindLoopNext
+// Description: Finds the /next for the given loop variable, searching forward
+//              from the line after 'from' until the next sub.
+//              Returns 0 if there is no matching /next.
+// ***************************************************************************
+static int FindLoopNext(MQMacroLines& lines, MQMacroLines::iterator from, const char* szForVariable)
+{
+	auto i = from;
+	while (++i != lines.end())
+	{
+		const char* line = i->second.Command.c_str();
+		if (!_strnicmp(line, "/next", 5))
+		{
+			char for_var[MAX_STRING];
+
+			GetArg(for_var, line, 2);
+
+			if (!_stricmp(for_var, szForVariable))
+				return i->first;
+		}
+		else if (!_strnicmp(line, "Sub ", 4))
 		{
 			break;
 		}
+	}
+
+	return 0;
+}
+
+// ***************************************************************************
+// Function:    MarkWhileBlock
+// Description: Marks the extent of the /while block starting on whileLine.
+//              LoopStart of the /while is the line before it (execution
+//              resumes on the line after a jump) and LoopEnd is the closing
+//              brace. Returns an error message if the block is malformed.
+// ***************************************************************************
+static const char* MarkWhileBlock(MQMacroLines& lines, MQMacroLines::iterator whileLine)
+{
+	if (whileLine == lines.begin())
+		return "/while found outside of a subroutine";
+
+	const int firstLine = std::prev(whileLine)->first;
+	int Scope = 1;
 
-		if (!_stricmp(szLine, iter->second.Command.c_str()))
+	auto lineIter = whileLine;
+	while (++lineIter != lines.end())
+	{
+		const std::string& command = lineIter->second.Command;
+
+		if (command[0] == '}')
 		{
-			// Label found
-			gMacroBlock->CurrIndex = iter->first;
-			goto_line->second.LoopEnd = iter->first;
-			return;
+			--Scope;
+			if (Scope == 0) break;
+		}
+
+		if (command[command.size() - 1] == '{')
+		{
+			++Scope;
+		}
+		else if (!_strnicmp(command.c_str(), "sub ", 4))
+		{
+			return "{} pairing ran into anther subroutine";
 		}
 	}
 
+	if (Scope != 0)
+		return "No } found for /while";
+
+	whileLine->second.LoopStart = firstLine;
+	whileLine->second.LoopEnd = lineIter->first;
+	return nullptr;
+}
+
+// ***************************************************************************
+// Function:    ResolveMacroJumps
+// Description: Resolves the jump targets of /goto, /while and /for lines once
+//              a macro is loaded, so executing them doesn't have to search the
+//              macro. Anything that can't be resolved up front (labels built
+//              from variables, malformed blocks) is left for the commands to
+//              resolve at runtime, where errors can be reported.
+// ***************************************************************************
+static void ResolveMacroJumps(MQMacroBlock& block)
+{
+	MQMacroLines& lines = block.Line;
+
+	for (auto iter = lines.begin(); iter != lines.end(); ++iter)
+	{
+		MQMacroLine& line = iter->second;
+		const char* szCommand = line.Command.c_str();
+
+		if (!_strnicmp(szCommand, "/goto ", 6))
+		{
+			const char* szLabel = &szCommand[6];
+			while (*szLabel == ' ')
+				++szLabel;
+
+			if (*szLabel && !strpbrk(szLabel, "$@"))
+				line.LoopEnd = FindGotoLabel(lines, iter, szLabel);
+		}
+		else if (!_strnicmp(szCommand, "/while ", 7) && line.Command.back() == '{')
+		{
+			MarkWhileBlock(lines, iter);
+		}
+		else if (!_strnicmp(szCommand, "/for ", 5))
+		{
+			char szForVariable[MAX_STRING];
+			GetArg(szForVariable, szCommand, 2);
+
+			if (szForVariable[0] && !strpbrk(szForVariable, "$@"))
+				line.LoopEnd = FindLoopNext(lines, iter, szForVariable);
+		}
+	}
+}
+
+// ***************************************************************************
+// Function:    Goto
+// Description: Our '/goto' command
+// Usage:       /goto :label
+// ***************************************************************************
+void Goto(PlayerClient* pChar, const char* szLine)
+{
+	if (!gMacroBlock)
+	{
+		MacroError("Cannot goto when a macro isn't running.");
+		return;
+	}
+
+	bRunNextCommand = true;
+
+	const auto goto_line = gMacroBlock->Line.find(gMacroBlock->CurrIndex);
+	if (goto_line->second.LoopEnd)
+	{
+		gMacroBlock->CurrIndex = goto_line->second.LoopEnd;
+		return;
+	}
+
+	if (int labelLine = FindGotoLabel(gMacroBlock->Line, goto_line, szLine))
+	{
+		// Label found....
+		gMacroBlock->CurrIndex = labelLine;
+		goto_line->second.LoopEnd = labelLine;
+		return;
+	}
+
 	FatalError("Couldn't find label %s", szLine);
 }
 
 char* GetSubFromLine(int Line, char* szSub, size_t Sublen)
 {
-	std::map<int, MQMacroLine>::reverse_iterator ri(gMacroBlock->Line.find(Line));
+	MQMacroLines::reverse_iterator ri(gMacroBlock->Line.find(Line));
 
 	for (; ri != gMacroBlock->Line.rend(); ri++)
 	{
@@ -1372,7 +1672,7 @@ void EndMacro(PlayerClient* pChar, const char* szLine)
 					MQMacroStack* pNext = gMacroStack->pNext;
 
 					// Delete the current stack item
-					delete gMacroStack;
+					ReleaseMacroStack(gMacroStack);
 
 					// Move to the next item in the stack
 					gMacroStack = pNext;
@@ -1459,7 +1759,7 @@ void EndMacro(PlayerClient* pChar, const char* szLine)
 		if (gMacroStack->Parameters)
 			ClearMQ2DataVariables(&gMacroStack->Parameters);
 
-		delete gMacroStack;
+		ReleaseMacroStack(gMacroStack);
 		gMacroStack = pStack;
 	}
 
@@ -1501,6 +1801,7 @@ void EndMacro(PlayerClient* pChar, const char* szLine)
 	gFaceAngle = 10000.0f;
 	gLookAngle = 10000.0f;
 	gDelay = 0;
+	s_delayCondition = {};
 	gTurbo = false;
 	SetSwitchTarget(nullptr);
 	gszMacroName[0] = 0;
@@ -1546,16 +1847,6 @@ void EndMacro(PlayerClient* pChar, const char* szLine)
 	}
 }
 
-static int GetNumArgsFromSub(const std::string& Sub)
-{
-	if (size_t hasparams = std::count(Sub.begin(), Sub.end(), '('))
-	{
-		size_t n = std::count(Sub.begin(), Sub.end(), ',');
-		return static_cast<int>(n) + 1;
-	}
-	return 0;
-}
-
 // ***************************************************************************
 // Function:    Call
 // Description: Our '/call' command
@@ -1592,7 +1883,7 @@ void Call(PlayerClient*, const char* szLine)
 	int MacroLine = iter->second;
 
 	// Prep to call the Sub
-	MQMacroStack* pStack = new MQMacroStack(MacroLine);
+	MQMacroStack* pStack = AcquireMacroStack(MacroLine);
 
 	gMacroBlock->CurrIndex = MacroLine;
 	if (gMacroStack && gMacroBlock->BindStackIndex != -1)
@@ -1621,28 +1912,20 @@ void Call(PlayerClient*, const char* szLine)
 	pStack->pNext = gMacroStack;
 	gMacroStack = pStack;
 
-	MQMacroLine& ml = gMacroBlock->Line.at(MacroLine);
-	int numsubargs = GetNumArgsFromSub(ml.Command);
+	const MQMacroLine& ml = gMacroBlock->Line.at(MacroLine);
+	int numsubargs = ml.SubParameterCount;
 
 	if (SubParam[0] != 0 || numsubargs)
 	{
-		// FIXME: These don't need to all be 2k bytes long...
-		char szParamName[MAX_STRING] = { 0 };
-		char szParamType[MAX_STRING] = { 0 };
 		char szNewValue[MAX_STRING] = { 0 };
-		auto name = &ml.Command[0];
 
 		for (int StackNum = 0; StackNum < numsubargs || SubParam[0] != '\0'; StackNum++)
 		{
 			GetArg(szNewValue, SubParam, 1);
 
-			GetFuncParam(name, StackNum, szParamName, MAX_STRING, szParamType, MAX_STRING);
+			const MQSubParameter& param = GetSubParameter(ml, StackNum);
 
-			MQ2Type* pType = pDataAPI->FindDataType(szParamType);
-			if (!pType)
-				pType = datatypes::pStringType;
-
-			AddMQ2DataVariable(szParamName, "", pType, &gMacroStack->Parameters, szNewValue);
+			AddMQ2DataVariable(param.Name.c_str(), "", param.GetType(), &gMacroStack->Parameters, szNewValue);
 			SubParam = GetNextArg(SubParam);
 		}
 	}
@@ -1743,6 +2026,21 @@ void PopMacroLoop()
 	gMacroStack->loopStack.pop_back();
 }
 
+// Returns the line that the closing brace on closingLine jumps back to, or 0 if it isn't the end of
+// the /while loop that is running. A brace that is reached some other way, such as by a /goto into
+// the block, doesn't loop.
+int GetWhileLoopStart(int closingLine)
+{
+	if (!gMacroStack || gMacroStack->loopStack.empty())
+		return 0;
+
+	const MQLoop& loop = gMacroStack->loopStack.back();
+	if (loop.type != MQLoop::Type::While || loop.lastLine != closingLine)
+		return 0;
+
+	return loop.firstLine;
+}
+
 static void PushMacroLoop(const MQLoop& loop)
 {
 	auto size = gMacroStack->loopStack.size();
@@ -1764,49 +2062,19 @@ static void MarkWhile(const char* szCommand, MQLoop& loop)
 	{
 		loop.type = MQLoop::Type::While;
 
+		// The block is normally marked when the macro is loaded
 		auto lineIter = gMacroBlock->Line.find(gMacroBlock->CurrIndex);
-		if (lineIter->second.LoopStart && lineIter->second.LoopEnd)
+		if (!lineIter->second.LoopStart || !lineIter->second.LoopEnd)
 		{
-			loop.firstLine = lineIter->second.LoopStart;
-			loop.lastLine = lineIter->second.LoopEnd;
-			return;
-		}
-
-		const auto currentLine = lineIter;
-		--lineIter;
-		currentLine->second.LoopStart = lineIter->first;
-		loop.firstLine = lineIter->first;
-		++lineIter;
-		int Scope = 1;
-
-		while (++lineIter != gMacroBlock->Line.end())
-		{
-			if (lineIter->second.Command[0] == '}')
+			if (const char* szError = MarkWhileBlock(gMacroBlock->Line, lineIter))
 			{
-				--Scope;
-				if (Scope == 0) break;
-			}
-
-			if (lineIter->second.Command[lineIter->second.Command.size() - 1] == '{')
-			{
-				++Scope;
-			}
-			else if (!_strnicmp(lineIter->second.Command.c_str(), "sub ", 4))
-			{
-				FatalError("{} pairing ran into anther subroutine");
+				FatalError("%s", szError);
 				return;
 			}
 		}
 
-		if (Scope != 0)
-		{
-			FatalError("No } found for /while");
-			return;
-		}
-
-		lineIter->second.LoopStart = loop.firstLine;
-		loop.lastLine = lineIter->first;
-		currentLine->second.LoopEnd = lineIter->first;
+		loop.firstLine = lineIter->second.LoopStart;
+		loop.lastLine = lineIter->second.LoopEnd;
 	}
 	else
 	{
@@ -2003,7 +2271,7 @@ void DoEvents(PlayerClient* pChar, const char* szLine)
 		locationIndex = lineIter->first;
 	}
 
-	MQMacroStack* pStack = new MQMacroStack(locationIndex);
+	MQMacroStack* pStack = AcquireMacroStack(locationIndex);
 	pStack->Parameters = pEvent->Parameters;
 
 	MQDataVar* pParam = pStack->Parameters;
@@ -2012,6 +2280,7 @@ void DoEvents(PlayerClient* pChar, const char* szLine)
 		pParam->ppHead = &pStack->Parameters;
 		pParam = pParam->pNext;
 	}
+	IndexFrameVariables(pStack);
 	pStack->pNext = gMacroStack;
 	gMacroStack = pStack;
 
@@ -2110,7 +2379,7 @@ void Return(PlayerClient* pChar, const char* szLine)
 	gMacroBlock->CurrIndex = pStack->pNext->LocationIndex;
 	gMacroStack = pStack->pNext;
 
-	delete pStack;
+	ReleaseMacroStack(pStack);
 
 	if (g_pProfile)
 	{
@@ -2286,6 +2555,23 @@ void Next(PlayerClient* pChar, const char* szLine)
 	}
 }
 
+// Finds the /next of a /for loop that hasn't reached its /next yet, searching forward from the
+// current line.
+static int FindForLoopNext(const MQLoop& loop)
+{
+	// The /for line knows its matching /next from when the macro was loaded. Searching forward
+	// from anywhere inside the loop body finds the same line.
+	const MQMacroLine& forLine = gMacroBlock->Line.at(loop.firstLine);
+	if (ci_starts_with(forLine.Command, "/for ")
+		&& loop.firstLine < gMacroBlock->CurrIndex
+		&& forLine.LoopEnd > gMacroBlock->CurrIndex)
+	{
+		return forLine.LoopEnd;
+	}
+
+	return FindLoopNext(gMacroBlock->Line, gMacroBlock->Line.find(gMacroBlock->CurrIndex), loop.forVariable.c_str());
+}
+
 // ***************************************************************************
 // Function:    Continue
 // Description: Our '/continue' command
@@ -2320,30 +2606,14 @@ void Continue(PlayerClient* pChar, const char* szLine)
 		return;
 	}
 
-	auto i = gMacroBlock->Line.find(gMacroBlock->CurrIndex);
-	while (++i != gMacroBlock->Line.end())
+	if (int nextLine = FindForLoopNext(loop))
 	{
-		const char* line = i->second.Command.c_str();
-		if (!_strnicmp(line, "/next", 5))
-		{
-			char for_var[MAX_STRING];
-
-			GetArg(for_var, line, 2);
-
-			if (_stricmp(for_var, loop.forVariable.c_str()))
-				continue;
-
-			loop.lastLine = i->first;
-			--i;
+		loop.lastLine = nextLine;
 
-			gMacroBlock->CurrIndex = i->first;
-			return;
-		}
-
-		if (!_strnicmp(line, "Sub ", 4))
-		{
-			break;
-		}
+		auto i = gMacroBlock->Line.find(nextLine);
+		--i;
+		gMacroBlock->CurrIndex = i->first;
+		return;
 	}
 
 	FatalError("/continue without matching /for ... /next block");
@@ -2377,29 +2647,13 @@ void Break(PlayerClient* pChar, const char* szLine)
 		return;
 	}
 
-	auto i = gMacroBlock->Line.find(gMacroBlock->CurrIndex);
-	while (++i != gMacroBlock->Line.end())
+	if (int nextLine = FindForLoopNext(loop))
 	{
-		const char* line = i->second.Command.c_str();
-		if (!_strnicmp(line, "/next", 5))
-		{
-			char for_var[MAX_STRING];
-
-			GetArg(for_var, line, 2);
-
-			if (_stricmp(for_var, loop.forVariable.c_str()))
-				continue;
-
-			gMacroBlock->CurrIndex = i->first;
-			loop.lastLine = i->first;;
-			PopMacroLoop();
+		gMacroBlock->CurrIndex = nextLine;
+		loop.lastLine = nextLine;
+		PopMacroLoop();
 
-			return;
-		}
-		if (!_strnicmp(line, "Sub ", 4))
-		{
-			break;
-		}
+		return;
 	}
 
 	FatalError("/break without matching /for ... /next (or while) block");
@@ -1309,6 +1309,16 @@ bool MainImpl::RemoveDetour(uintptr_t address, const MQPluginHandle& pluginHandl
 	return pDetourAPI->RemoveDetour(address, pluginHandle);
 }
 
+MQPulseTaskId MainImpl::AddPulseTask(std::string_view name, MQPulseTaskHandler handler, uint32_t intervalMS, uint32_t budgetUS, const MQPluginHandle& pluginHandle)
+{
+	return mq::AddPulseTask(name, std::move(handler), intervalMS, budgetUS, pluginHandle);
+}
+
+bool MainImpl::RemovePulseTask(MQPulseTaskId taskId, const MQPluginHandle& pluginHandle)
+{
+	return mq::RemovePulseTask(taskId, pluginHandle);
+}
+
 MainImpl* gpMainAPI = nullptr;
 
 MainInterface* GetMainInterface()
@@ -323,6 +323,8 @@ MQLIB_API ECombatState GetCombatState();
 
 /* MQ2DATAVARS */
 MQLIB_API char* GetFuncParam(const char* szMacroLine, int ParamNum, char* szParamName, size_t ParamNameLen, char* szParamType, size_t ParamTypeLen);
+const MQSubParameter& GetSubParameter(const MQMacroLine& line, int index);
+bool EvaluateDelayCondition(bool& conditionMet);
 
 MQLIB_API void DropTimers();
 
@@ -96,19 +96,11 @@ static bool DoNextCommand(MQMacroBlockPtr pBlock)
 
 	if (gDelay && gDelayCondition[0])
 	{
-		char szCond[MAX_STRING];
-		strcpy_s(szCond, gDelayCondition);
-
-		ParseMacroData(szCond, MAX_STRING);
-
-		double Result;
-		if (!Calculate(szCond, Result))
-		{
-			FatalError("Failed to parse /delay condition '%s', non-numeric encountered", szCond);
+		bool conditionMet;
+		if (!EvaluateDelayCondition(conditionMet))
 			return false;
-		}
 
-		if (Result != 0)
+		if (conditionMet)
 		{
 			DebugSpewNoFile("/delay ending early, conditions met");
 			gDelay = 0;
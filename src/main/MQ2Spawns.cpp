@@ -24,7 +24,8 @@ static void Spawns_Shutdown();
 static void Spawns_Pulse();
 static void Spawns_BeginZone();
 static void Spawns_SpawnAdded(PlayerClient* pSpawn);
-static void Spawns_SpawnRemoved(PlayerClient* pSpawn);
+static void ForgetSpawn(PlayerClient* pSpawn);
+static void ForgetAllSpawns();
 
 static MQModule gSpawnsModule = {
 	"Spawns",                     // Name
@@ -37,7 +38,7 @@ static MQModule gSpawnsModule = {
 	nullptr,                      // Zoned
 	nullptr,                      // WriteChatColor
 	Spawns_SpawnAdded,            // SpawnAdded
-	Spawns_SpawnRemoved,          // SpawnRemoved
+	nullptr,                      // SpawnRemoved
 	Spawns_BeginZone,             // BeginZone
 };
 MQModule* GetSpawnsModule() { return &gSpawnsModule; }
@@ -45,6 +46,18 @@ MQModule* GetSpawnsModule() { return &gSpawnsModule; }
 // Global spawn array, sorted by distance.
 std::vector<MQSpawnArrayItem> gSpawnsArray;
 
+// Spatial index of the spawns. Membership follows the spawn create/destroy hooks, and is checked
+// against the spawn list along with refreshing positions the first time the grid is used after
+// each pulse. Use GetSpawnGrid to read it.
+static MQSpatialGrid<PlayerClient*> s_spawnGrid;
+static bool s_spawnGridStale = false;
+
+// Spawns that existed before we were hooked up are picked up once from the spawn list.
+static bool s_spawnsSeeded = false;
+
+// Spawns added since the last sort, waiting to be put into gSpawnsArray.
+static std::vector<PlayerClient*> s_newSpawns;
+
 // Our last known combat state
 static ECombatState s_combatState = eCombatState_Standing;
 
@@ -435,6 +448,9 @@ public:
 	DETOUR_TRAMPOLINE_DEF(PlayerClient*, PrepForDestroyPlayer_Trampoline, (PlayerClient*, bool b))
 		PlayerClient* PrepForDestroyPlayer_Detour(PlayerClient* spawn, bool b)
 	{
+		// The spawn index has to let go of the spawn even if plugins aren't told about it.
+		ForgetSpawn(spawn);
+
 		// PrepForDestroyPlayer can be called twice through the same code path
 		if (lastRemovedSpawnID != spawn->GetId())
 		{
@@ -447,6 +463,9 @@ public:
 	DETOUR_TRAMPOLINE_DEF(PlayerClient*, PrepForDestroyPlayer_Trampoline, (PlayerClient*))
 	PlayerClient* PrepForDestroyPlayer_Detour(PlayerClient* spawn)
 	{
+		// The spawn index has to let go of the spawn even if plugins aren't told about it.
+		ForgetSpawn(spawn);
+
 		// PrepForDestroyPlayer can be called twice through the same code path
 		if (lastRemovedSpawnID != spawn->GetId())
 		{
@@ -461,6 +480,8 @@ public:
 	DETOUR_TRAMPOLINE_DEF(void, DestroyAllPlayers_Trampoline, ())
 		void DestroyAllPlayers_Detour()
 	{
+		ForgetAllSpawns();
+
 		PlayerClient* pSpawn = FirstSpawn;
 		while (pSpawn)
 		{
@@ -899,13 +920,113 @@ static void ProcessPendingGroundItems()
 
 #pragma endregion
 
+// Sorts the spawns by distance, assuming they are mostly in order already. Gives up and does a
+// full sort if that turns out not to be the case.
+static void SortSpawnsArray()
+{
+	size_t budget = gSpawnsArray.size() * 8;
+
+	for (size_t i = 1; i < gSpawnsArray.size(); ++i)
+	{
+		if (!MQRankFloatCompare(gSpawnsArray[i], gSpawnsArray[i - 1]))
+			continue;
+
+		MQSpawnArrayItem item = gSpawnsArray[i];
+		size_t j = i;
+
+		for (; j > 0 && MQRankFloatCompare(item, gSpawnsArray[j - 1]); --j)
+		{
+			gSpawnsArray[j] = gSpawnsArray[j - 1];
+		}
+
+		gSpawnsArray[j] = item;
+
+		budget -= std::min(budget, i - j);
+		if (budget == 0)
+		{
+			std::sort(std::begin(gSpawnsArray), std::end(gSpawnsArray), MQRankFloatCompare);
+			return;
+		}
+	}
+}
+
+static void SeedSpawns()
+{
+	// we need to make sure the spawn manager is valid here because this can get called from login pulse before the spawn manager is valid
+	if (s_spawnsSeeded || !pSpawnManager)
+		return;
+
+	s_spawnGrid.Clear();
+	gSpawnsArray.clear();
+	s_newSpawns.clear();
+
+	PlayerClient* pSpawn = pSpawnManager->FirstSpawn;
+	while (pSpawn)
+	{
+		s_spawnGrid.Update(pSpawn, pSpawn->X, pSpawn->Y);
+		s_newSpawns.push_back(pSpawn);
+
+		pSpawn = pSpawn->pNext;
+	}
+
+	s_spawnsSeeded = true;
+	s_spawnGridStale = false;
+}
+
+// The hooks should keep the grid in step with the spawn list, but a spawn that is destroyed without
+// going through them would be left behind as a dangling pointer. Before anything reads spawns out of
+// the grid or gSpawnsArray, make sure that it holds exactly the spawns in the list, and start over
+// from the list if it doesn't. This only compares pointers, so nothing stale is dereferenced.
+static void ValidateSpawns()
+{
+	if (!s_spawnsSeeded || !pSpawnManager)
+		return;
+
+	size_t count = 0;
+	for (PlayerClient* pSpawn = pSpawnManager->FirstSpawn; pSpawn; pSpawn = pSpawn->pNext)
+	{
+		if (!s_spawnGrid.Contains(pSpawn))
+		{
+			count = SIZE_MAX;
+			break;
+		}
+
+		++count;
+	}
+
+	if (count != s_spawnGrid.Size())
+	{
+		ForgetAllSpawns();
+		SeedSpawns();
+	}
+}
+
+const MQSpatialGrid<PlayerClient*>& GetSpawnGrid()
+{
+	SeedSpawns();
+
+	if (s_spawnGridStale)
+	{
+		ValidateSpawns();
+
+		s_spawnGrid.Refresh([](PlayerClient* pSpawn, float& x, float& y)
+			{
+				x = pSpawn->X;
+				y = pSpawn->Y;
+			});
+
+		s_spawnGridStale = false;
+	}
+
+	return s_spawnGrid;
+}
+
 void UpdateMQ2SpawnSort()
 {
 	EnterMQ2Benchmark(bmUpdateSpawnSort);
 
 	EQP_DistArray = nullptr;
 	gSpawnCount = 0;
-	gSpawnsArray.clear();
 
 	float myX = 0, myY = 0;
 	if (pControlledPlayer)
@@ -914,20 +1035,27 @@ void UpdateMQ2SpawnSort()
 		myY = pControlledPlayer->Y;
 	}
 
-	// we need to make sure the spawn manager is valid here because this can get called from login pulse before the spawn manager is valid
-	if (pSpawnManager)
+	SeedSpawns();
+	ValidateSpawns();
+
+	// Spawns have moved since the last pulse. The grid catches up the next time someone asks for it.
+	s_spawnGridStale = true;
+
+	// Refresh the distances of the spawns we already have, keeping them in last pulse's order.
+	// Removed spawns were already taken out by the destroy hooks, or by ValidateSpawns.
+	for (MQSpawnArrayItem& item : gSpawnsArray)
 	{
-		PlayerClient* pSpawn = pSpawnManager->FirstSpawn;
-		while (pSpawn)
-		{
-			float distSq = GetDistanceSquared(myX, myY, pSpawn->X, pSpawn->Y);
+		PlayerClient* pSpawn = item.GetSpawn();
+		item = MQSpawnArrayItem(pSpawn, GetDistanceSquared(myX, myY, pSpawn->X, pSpawn->Y));
+	}
 
-			gSpawnsArray.emplace_back(pSpawn, distSq);
-			pSpawn = pSpawn->pNext;
-		}
+	for (PlayerClient* pSpawn : s_newSpawns)
+	{
+		gSpawnsArray.emplace_back(pSpawn, GetDistanceSquared(myX, myY, pSpawn->X, pSpawn->Y));
 	}
+	s_newSpawns.clear();
 
-	std::sort(std::begin(gSpawnsArray), std::end(gSpawnsArray), MQRankFloatCompare);
+	SortSpawnsArray();
 
 	gSpawnCount = static_cast<int>(gSpawnsArray.size());
 	EQP_DistArray = gSpawnCount > 0 ? &gSpawnsArray[0] : nullptr;
@@ -971,6 +1099,7 @@ static void Spawns_Initialize()
 	EQP_DistArray = nullptr;
 	gSpawnCount = 0;
 	gSpawnsArray.reserve(4096);
+	s_spawnsSeeded = false;
 
 	char Temp[MAX_STRING] = { 0 };
 	char Name[MAX_STRING] = { 0 };
@@ -1053,6 +1182,9 @@ static void Spawns_Shutdown()
 	EQP_DistArray = nullptr;
 	gSpawnCount = 0;
 	gSpawnsArray.clear();
+	s_spawnGrid.Clear();
+	s_newSpawns.clear();
+	s_spawnsSeeded = false;
 
 	RemoveMQ2Benchmark(bmUpdateSpawnSort);
 	RemoveMQ2Benchmark(bmUpdateSpawnCaptions);
@@ -1060,6 +1192,10 @@ static void Spawns_Shutdown()
 
 static void Spawns_Pulse()
 {
+	// The client runs between pulses, and can move or destroy spawns before the next sort. Anything
+	// that uses the grid before then has it checked against the spawn list again.
+	s_spawnGridStale = true;
+
 	UpdateCombatState();
 
 	if (gGameState != GAMESTATE_INGAME)
@@ -1104,18 +1240,31 @@ static void Spawns_Pulse()
 static void Spawns_BeginZone()
 {
 	gSpawnsArray.clear();
+	s_spawnGrid.Clear();
+	s_newSpawns.clear();
 }
 
 void Spawns_SpawnAdded(PlayerClient* pNewSpawn)
 {
+	// until we've seeded, the spawn list is still going to be read in full
+	if (s_spawnsSeeded && s_spawnGrid.Update(pNewSpawn, pNewSpawn->X, pNewSpawn->Y))
+	{
+		s_newSpawns.push_back(pNewSpawn);
+	}
+
 	if (!gMQCaptions)
 		return;
 
 	UpdateNameSpriteState(pNewSpawn, true);
 }
 
-static void Spawns_SpawnRemoved(PlayerClient* pSpawn)
+static void ForgetSpawn(PlayerClient* pSpawn)
 {
+	if (!s_spawnGrid.Remove(pSpawn))
+		return;
+
+	s_newSpawns.erase(std::remove(std::begin(s_newSpawns), std::end(s_newSpawns), pSpawn), std::end(s_newSpawns));
+
 	if (gSpawnsArray.empty())
 		return;
 
@@ -1123,6 +1272,20 @@ static void Spawns_SpawnRemoved(PlayerClient* pSpawn)
 		std::remove_if(std::begin(gSpawnsArray), std::end(gSpawnsArray),
 			[pSpawn](const MQSpawnArrayItem& item) { return item.GetSpawn() == pSpawn; }),
 		std::end(gSpawnsArray));
+
+	gSpawnCount = static_cast<int>(gSpawnsArray.size());
+	EQP_DistArray = gSpawnCount > 0 ? &gSpawnsArray[0] : nullptr;
+}
+
+// Drops every spawn, to be read again in full from the spawn list.
+static void ForgetAllSpawns()
+{
+	EQP_DistArray = nullptr;
+	gSpawnCount = 0;
+	gSpawnsArray.clear();
+	s_spawnGrid.Clear();
+	s_newSpawns.clear();
+	s_spawnsSeeded = false;
 }
 
 //----------------------------------------------------------------------------
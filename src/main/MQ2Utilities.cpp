@@ -17,6 +17,7 @@
 
 #include "MQ2Mercenaries.h"
 #include "MQ2Utilities.h"
+#include "MQCalculator.h"
 
 #include <mq/api/Items.h>
 #include <mq/base/WString.h>
@@ -1990,489 +1991,18 @@ bool LoadCfgFile(const char* Filename, bool Delayed)
 	return false;
 }
 
-enum eCalcOp
-{
-	CO_NUMBER = 0,
-	CO_OPENPARENS = 1,
-	CO_CLOSEPARENS = 2,
-	CO_ADD = 3,
-	CO_SUBTRACT = 4,
-	CO_MULTIPLY = 5,
-	CO_DIVIDE = 6,
-	CO_IDIVIDE = 7,
-	CO_LAND = 8,
-	CO_AND = 9,
-	CO_LOR = 10,
-	CO_OR = 11,
-	CO_XOR = 12,
-	CO_EQUAL = 13,
-	CO_NOTEQUAL = 14,
-	CO_GREATER = 15,
-	CO_NOTGREATER = 16,
-	CO_LESS = 17,
-	CO_NOTLESS = 18,
-	CO_MODULUS = 19,
-	CO_POWER = 20,
-	CO_LNOT = 21,
-	CO_NOT = 22,
-	CO_SHL = 23,
-	CO_SHR = 24,
-	CO_NEGATE = 25,
-	CO_TOTAL = 26,
-};
-
-int CalcOpPrecedence[CO_TOTAL] =
-{
-	0,
-	0,
-	0,
-	9,    // add
-	9,    // subtract
-	10,   // multiply
-	10,   // divide
-	10,   // integer divide
-	2,    // logical and
-	5,    // bitwise and
-	1,    // logical or
-	3,    // bitwise or
-	4,    // bitwise xor
-	6,    // equal
-	6,    // not equal
-	7,    // greater
-	7,    // not greater
-	7,    // less
-	7,    // not less
-	10,   // modulus
-	11,   // power
-	12,   // logical not
-	12,   // bitwise not
-	8,    // shl
-	8,    // shr
-	12,   // negate
-};
-
-struct CalcOp
-{
-	eCalcOp Op;
-	double Value;
-};
-
-bool EvaluateRPN(CalcOp* pList, int Size, double& Result)
-{
-	if (!Size)
-		return false;
-
-	std::unique_ptr<double[]> stackPtr = std::make_unique<double[]>(Size / 2 + 2);
-	double* pStack = stackPtr.get();
-
-	int nStack = 0;
-
-#define StackEmpty()           (nStack==0)
-#define StackTop()             (pStack[nStack])
-#define StackSetTop(do_assign) {pStack[nStack]##do_assign;}
-#define StackPush(val)         {nStack++;pStack[nStack]=val;}
-#define StackPop()             {if (!nStack) {FatalError("Illegal arithmetic in calculation"); return 0;}; nStack--;}
-
-#define BinaryIntOp(op)        {int RightSide=(int)StackTop();StackPop();StackSetTop(=(double)(((int)StackTop())##op##RightSide));}
-#define BinaryOp(op)           {double RightSide=StackTop();StackPop();StackSetTop(=StackTop()##op##RightSide);}
-#define BinaryAssign(op)       {double RightSide=StackTop();StackPop();StackSetTop(##op##=RightSide);}
-
-#define UnaryIntOp(op)         {StackSetTop(=op##((int)StackTop()));}
-#define UnaryOp(op)            {StackSetTop(=op##(StackTop()));}
-
-	for (int i = 0; i < Size; i++)
-	{
-		switch (pList[i].Op)
-		{
-		case CO_NUMBER:
-			StackPush(pList[i].Value);
-			break;
-		case CO_ADD:
-			BinaryAssign(+);
-			break;
-		case CO_MULTIPLY:
-			BinaryAssign(*);
-			break;
-		case CO_SUBTRACT:
-			BinaryAssign(-);
-			break;
-		case CO_NEGATE:
-			UnaryOp(-);
-			break;
-		case CO_DIVIDE:
-			if (StackTop())
-			{
-				BinaryAssign(/ );
-			}
-			else
-			{
-				//printf("Divide by zero error\n");
-				FatalError("Divide by zero in calculation");
-				return false;
-			}
-			break;
-
-		case CO_IDIVIDE://TODO: SPECIAL HANDLING
-		{
-			int Right = (int)StackTop();
-			if (Right)
-			{
-				StackPop();
-				int Left = (int)StackTop();
-				Left /= Right;
-				StackSetTop(= Left);
-			}
-			else
-			{
-				//printf("Integer divide by zero error\n");
-				FatalError("Divide by zero in calculation");
-				return false;
-			}
-		}
-		break;
-
-		case CO_MODULUS://TODO: SPECIAL HANDLING
-		{
-			int Right = (int)StackTop();
-			if (Right)
-			{
-				StackPop();
-				int Left = (int)StackTop();
-				Left %= Right;
-				StackSetTop(= Left);
-			}
-			else
-			{
-				//printf("Modulus by zero error\n");
-				FatalError("Modulus by zero in calculation");
-				return false;
-			}
-		}
-		break;
-
-		case CO_LAND:
-			BinaryOp(&&);
-			break;
-		case CO_LOR:
-			BinaryOp(|| );
-			break;
-		case CO_EQUAL:
-			BinaryOp(== );
-			break;
-		case CO_NOTEQUAL:
-			BinaryOp(!= );
-			break;
-		case CO_GREATER:
-			BinaryOp(> );
-			break;
-		case CO_NOTGREATER:
-			BinaryOp(<= );
-			break;
-		case CO_LESS:
-			BinaryOp(< );
-			break;
-		case CO_NOTLESS:
-			BinaryOp(>= );
-			break;
-		case CO_SHL:
-			BinaryIntOp(<< );
-			break;
-		case CO_SHR:
-			BinaryIntOp(>> );
-			break;
-		case CO_AND:
-			BinaryIntOp(&);
-			break;
-		case CO_OR:
-			BinaryIntOp(| );
-			break;
-		case CO_XOR:
-			BinaryIntOp(^);
-			break;
-		case CO_LNOT:
-			UnaryIntOp(!);
-			break;
-		case CO_NOT:
-			UnaryIntOp(~);
-			break;
-		case CO_POWER:
-		{
-			double RightSide = StackTop();
-			StackPop();
-			StackSetTop(= pow(StackTop(), RightSide));
-		}
-		break;
-		}
-	}
-
-	Result = StackTop();
-
-#undef StackEmpty
-#undef StackTop
-#undef StackPush
-#undef StackPop
-
-	return true;
-}
-
-bool FastCalculate(char* szFormula, double& Result)
-{
-	//DebugSpew("FastCalculate(%s)",szFormula);
-	if (!szFormula || !szFormula[0])
-		return false;
-
-	int Length = (int)strlen(szFormula);
-	int MaxOps = (Length + 1);
-
-	std::unique_ptr<CalcOp[]> OpsList = std::make_unique<CalcOp[]>(MaxOps);
-	CalcOp* pOpList = OpsList.get();
-	memset(pOpList, 0, sizeof(CalcOp) * MaxOps);
-
-	std::unique_ptr<eCalcOp[]> Stack = std::make_unique<eCalcOp[]>(MaxOps);
-	eCalcOp* pStack = Stack.get();
-	memset(pStack, 0, sizeof(eCalcOp) * MaxOps);
-
-	int nOps = 0;
-	int nStack = 0;
-	char* pEnd = szFormula + Length;
-	char CurrentToken[MAX_STRING] = { 0 };
-	char* pToken = &CurrentToken[0];
-
-#define OpToList(op)         { pOpList[nOps].Op = op; nOps++; }
-#define ValueToList(val)     { pOpList[nOps].Value = val; nOps++; }
-#define StackEmpty()         (nStack == 0)
-#define StackTop()           (pStack[nStack])
-#define StackPush(op)        { nStack++; pStack[nStack] = op; }
-#define StackPop()           { if (!nStack) { FatalError("Illegal arithmetic in calculation"); return 0; } nStack--;}
-#define HasPrecedence(a,b)   ( CalcOpPrecedence[a] >= CalcOpPrecedence[b])
-#define MoveStack(op) {                                                                        \
-	while (!StackEmpty() && StackTop() != CO_OPENPARENS && HasPrecedence(StackTop(), op)) {    \
-		OpToList(StackTop());                                                                  \
-		StackPop();                                                                            \
-	}                                                                                          \
-}
-#define FinishString()       { if (pToken != &CurrentToken[0]) { *pToken = 0; ValueToList(GetDoubleFromString(CurrentToken, 0)); pToken = &CurrentToken[0]; *pToken=0; }}
-#define NewOp(op)            { FinishString(); MoveStack(op); StackPush(op); }
-#define NextChar(ch)         { *pToken = ch; pToken++; }
-
-	bool WasParen = false;
-	for (char* pCur = szFormula; pCur < pEnd; pCur++)
-	{
-		switch (*pCur)
-		{
-		case ' ':
-			continue;
-		case '(':
-			FinishString();
-			StackPush(CO_OPENPARENS);
-			break;
-		case ')':
-			FinishString();
-			while (StackTop() != CO_OPENPARENS)
-			{
-				OpToList(StackTop());
-				StackPop();
-			}
-			StackPop();
-			WasParen = true;
-			continue;
-		case '+':
-			if (pCur[1] != '+')
-				NewOp(CO_ADD);
-			break;
-		case '-':
-			if (pCur[1] == '-')
-			{
-				pCur++;
-				NewOp(CO_ADD);
-			}
-			else
-			{
-				if (CurrentToken[0] || WasParen)
-				{
-					NewOp(CO_SUBTRACT);
-				}
-				else
-					NewOp(CO_NEGATE);
-			}
-			break;
-		case '*':
-			NewOp(CO_MULTIPLY);
-			break;
-		case '\\':
-			NewOp(CO_IDIVIDE);
-			break;
-		case '/':
-			NewOp(CO_DIVIDE);
-			break;
-		case '|':
-			if (pCur[1] == '|')
-			{
-				// Logical OR
-				++pCur;
-				NewOp(CO_LOR);
-			}
-			else
-			{
-				// Bitwise OR
-				NewOp(CO_OR);
-			}
-			break;
-		case '%':
-			NewOp(CO_MODULUS);
-			break;
-		case '~':
-			NewOp(CO_NOT);
-			break;
-		case '&':
-			if (pCur[1] == '&')
-			{
-				// Logical AND
-				++pCur;
-				NewOp(CO_LAND);
-			}
-			else
-			{
-				// Bitwise AND
-				NewOp(CO_AND);
-			}
-			break;
-		case '^':
-			if (pCur[1] == '^')
-			{
-				// XOR
-				++pCur;
-				NewOp(CO_XOR);
-			}
-			else
-			{
-				// POWER
-				NewOp(CO_POWER);
-			}
-			break;
-		case '!':
-			if (pCur[1] == '=')
-			{
-				++pCur;
-				NewOp(CO_NOTEQUAL);
-			}
-			else
-			{
-				NewOp(CO_LNOT);
-			}
-			break;
-		case '=':
-			if (pCur[1] == '=')
-			{
-				++pCur;
-				NewOp(CO_EQUAL);
-			}
-			else
-			{
-				//printf("Unparsable: '%c'\n",*pCur);
-				// error
-				return false;
-			}
-			break;
-		case '<':
-			if (pCur[1] == '=')
-			{
-				++pCur;
-				NewOp(CO_NOTGREATER);
-			}
-			else if (pCur[1] == '<')
-			{
-				++pCur;
-				NewOp(CO_SHL);
-			}
-			else
-			{
-				NewOp(CO_LESS);
-			}
-			break;
-		case '>':
-			if (pCur[1] == '=')
-			{
-				++pCur;
-				NewOp(CO_NOTLESS);
-			}
-			else if (pCur[1] == '>')
-			{
-				++pCur;
-				NewOp(CO_SHR);
-			}
-			else
-			{
-				NewOp(CO_GREATER);
-			}
-			break;
-		case '.':
-		case '1':
-		case '2':
-		case '3':
-		case '4':
-		case '5':
-		case '6':
-		case '7':
-		case '8':
-		case '9':
-		case '0':
-			NextChar(*pCur);
-			break;
-		default:
-		{
-			//printf("Unparsable: '%c'\n",*pCur);
-			FatalError("Unparsable in Calculation: '%c'", *pCur);
-			// unparsable
-			return false;
-		}
-		}
-		WasParen = false;
-	}
-	FinishString();
-
-	while (!StackEmpty())
-	{
-		OpToList(StackTop());
-		StackPop();
-	}
-
-	return EvaluateRPN(pOpList, nOps, Result);
-}
+// Formulas reach Calculate after their variables have been substituted, so the same condition is
+// seen again and again with different numbers. Its program is kept by shape and only compiled once.
+static CalcProgramCache s_calcPrograms{ 1024 };
 
 bool Calculate(const char* szFormula, double& Result)
 {
 	char Buffer[MAX_STRING] = { 0 };
 	strcpy_s(Buffer, szFormula);
-	_strupr_s(Buffer);
-
-	while (char* pNull = strstr(Buffer, "NULL"))
-	{
-		pNull[0] = '0';
-		pNull[1] = '.';
-		pNull[2] = '0';
-		pNull[3] = '0';
-	}
-
-	while (char* pTrue = strstr(Buffer, "TRUE"))
-	{
-		pTrue[0] = '1';
-		pTrue[1] = '.';
-		pTrue[2] = '0';
-		pTrue[3] = '0';
-	}
-
-	while (char* pFalse = strstr(Buffer, "FALSE"))
-	{
-		pFalse[0] = '0';
-		pFalse[1] = '.';
-		pFalse[2] = '0';
-		pFalse[3] = '0';
-		pFalse[4] = '0';
-	}
+	PrepareCalcFormula(Buffer);
 
 	bool Ret;
-	Benchmark(bmCalculate, Ret = FastCalculate(Buffer, Result));
+	Benchmark(bmCalculate, Ret = s_calcPrograms.Calculate(Buffer, Result, FatalError));
 	return Ret;
 }
 
@@ -2955,38 +2485,51 @@ char* FormatSearchSpawn(char* Buffer, size_t BufferSize, MQSpawnSearch* pSearchS
 
 SPAWNINFO* NthNearestSpawn(MQSpawnSearch* pSearchSpawn, int Nth, SPAWNINFO* pOrigin, bool IncludeOrigin)
 {
-	if (!pSearchSpawn || Nth == 0 || !pOrigin)
+	if (!pSearchSpawn || Nth <= 0 || !pOrigin)
 		return nullptr;
 
+	// if the search radius is centered on the origin, nothing outside of it can match.
+	const bool radiusFromOrigin = !pSearchSpawn->bKnownLocation && pSearchSpawn->FRadius < 10000.0f;
+
 	std::vector<MQSpawnArrayItem> spawnSet;
-	spawnSet.reserve(gSpawnsArray.size());
 
-	for (const MQSpawnArrayItem& item : gSpawnsArray)
-	{
-		SPAWNINFO* pSpawn = item.GetSpawn();
+	// GetSpawnGrid brings the grid up to date with where the spawns are now before we search it.
+	// Walk outwards from the origin and stop as soon as we have Nth matches that are closer than
+	// anything we haven't looked at yet.
+	GetSpawnGrid().VisitNearest(pOrigin->X, pOrigin->Y,
+		[&](PlayerClient* pSpawn)
+		{
+			if (!IncludeOrigin && pSpawn == pOrigin)
+				return;
 
-		if (!IncludeOrigin && pSpawn == pOrigin)
-			continue;
+			if (SpawnMatchesSearch(pSearchSpawn, pOrigin, pSpawn))
+			{
+				float distSq = Get3DDistanceSquared(pOrigin->X, pOrigin->Y, pOrigin->Z,
+					pSpawn->X, pSpawn->Y, pSpawn->Z);
 
-		if (SpawnMatchesSearch(pSearchSpawn, pOrigin, pSpawn))
+				// Spawn matches our search, add it to our set.
+				spawnSet.emplace_back(pSpawn, distSq);
+			}
+		},
+		[&](float minDistance)
 		{
-			float distSq = Get3DDistanceSquared(pOrigin->X, pOrigin->Y, pOrigin->Z,
-				pSpawn->X, pSpawn->Y, pSpawn->Z);
+			if (radiusFromOrigin && minDistance > pSearchSpawn->FRadius)
+				return true;
 
-			// Spawn matches our search, add it to our set.
-			spawnSet.emplace_back(pSpawn, distSq);
-		}
-	}
+			if (Nth > static_cast<int>(spawnSet.size()))
+				return false;
+
+			std::nth_element(std::begin(spawnSet), std::begin(spawnSet) + (Nth - 1), std::end(spawnSet), MQRankFloatCompare);
+			return spawnSet[Nth - 1].GetDistanceSquared() <= minDistance * minDistance;
+		});
 
 	if (Nth > static_cast<int>(spawnSet.size()))
 	{
 		return nullptr;
 	}
 
-	// sort our list
-	std::sort(std::begin(spawnSet), std::end(spawnSet), MQRankFloatCompare);
-
 	// get our Nth nearest
+	std::nth_element(std::begin(spawnSet), std::begin(spawnSet) + (Nth - 1), std::end(spawnSet), MQRankFloatCompare);
 	return spawnSet[Nth - 1].GetSpawn();
 }
 
@@ -2996,6 +2539,27 @@ int CountMatchingSpawns(MQSpawnSearch* pSearchSpawn, SPAWNINFO* pOrigin, bool In
 		return 0;
 
 	int TotalMatching = 0;
+
+	// With a radius, only the spawns near the center of the search need to be checked. The grid is
+	// refreshed to the current spawn positions before it is returned.
+	const MQSpatialGrid<PlayerClient*>& spawnGrid = GetSpawnGrid();
+	if (pSearchSpawn->FRadius < 10000.0f && !spawnGrid.Empty())
+	{
+		float x = pSearchSpawn->bKnownLocation ? pSearchSpawn->xLoc : pOrigin->X;
+		float y = pSearchSpawn->bKnownLocation ? pSearchSpawn->yLoc : pOrigin->Y;
+
+		spawnGrid.ForEachInRadius(x, y, pSearchSpawn->FRadius,
+			[&](PlayerClient* pSpawn, float, float)
+			{
+				if ((IncludeOrigin || pSpawn != pOrigin) && SpawnMatchesSearch(pSearchSpawn, pOrigin, pSpawn))
+				{
+					TotalMatching++;
+				}
+			});
+
+		return TotalMatching;
+	}
+
 	SPAWNINFO* pSpawn = pSpawnList;
 
 	if (IncludeOrigin)
@@ -0,0 +1,669 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-present MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#pragma once
+
+#include "mq/base/Common.h"
+#include "mq/base/LRUCache.h"
+#include "mq/base/String.h"
+
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+// The math evaluator behind Calculate: formulas are tokenized and converted to RPN with
+// shunting-yard, then evaluated on a stack.
+
+namespace mq {
+
+enum eCalcOp
+{
+	CO_NUMBER = 0,
+	CO_OPENPARENS = 1,
+	CO_CLOSEPARENS = 2,
+	CO_ADD = 3,
+	CO_SUBTRACT = 4,
+	CO_MULTIPLY = 5,
+	CO_DIVIDE = 6,
+	CO_IDIVIDE = 7,
+	CO_LAND = 8,
+	CO_AND = 9,
+	CO_LOR = 10,
+	CO_OR = 11,
+	CO_XOR = 12,
+	CO_EQUAL = 13,
+	CO_NOTEQUAL = 14,
+	CO_GREATER = 15,
+	CO_NOTGREATER = 16,
+	CO_LESS = 17,
+	CO_NOTLESS = 18,
+	CO_MODULUS = 19,
+	CO_POWER = 20,
+	CO_LNOT = 21,
+	CO_NOT = 22,
+	CO_SHL = 23,
+	CO_SHR = 24,
+	CO_NEGATE = 25,
+	CO_TOTAL = 26,
+};
+
+inline constexpr int CalcOpPrecedence[CO_TOTAL] =
+{
+	0,
+	0,
+	0,
+	9,    // add
+	9,    // subtract
+	10,   // multiply
+	10,   // divide
+	10,   // integer divide
+	2,    // logical and
+	5,    // bitwise and
+	1,    // logical or
+	3,    // bitwise or
+	4,    // bitwise xor
+	6,    // equal
+	6,    // not equal
+	7,    // greater
+	7,    // not greater
+	7,    // less
+	7,    // not less
+	10,   // modulus
+	11,   // power
+	12,   // logical not
+	12,   // bitwise not
+	8,    // shl
+	8,    // shr
+	12,   // negate
+};
+
+struct CalcOp
+{
+	eCalcOp Op;
+	double Value;
+};
+
+// Errors are reported with a printf style function, which is FatalError in MacroQuest.
+using CalcErrorFunc = void (*)(const char* szFormat, ...);
+
+// Evaluates a formula compiled by CompileRPN. If pValues is provided, numbers take their values from
+// it in order, instead of from the program.
+inline bool EvaluateRPN(const CalcOp* pList, int Size, double& Result, CalcErrorFunc ReportError,
+	const double* pValues = nullptr)
+{
+	if (!Size)
+		return false;
+
+	// Slot 0 is never pushed to, and stays zero unless a malformed expression underflows into it.
+	// Every op can push at most one value, so Size + 1 slots is always enough.
+	constexpr int LocalStackSize = 64;
+	double localStack[LocalStackSize];
+	std::unique_ptr<double[]> heapStack;
+
+	double* pStack = localStack;
+	if (Size + 1 > LocalStackSize)
+	{
+		heapStack = std::make_unique<double[]>(Size + 1);
+		pStack = heapStack.get();
+	}
+	std::fill_n(pStack, Size + 1, 0.0);
+
+	int nStack = 0;
+
+#define StackEmpty()           (nStack==0)
+#define StackTop()             (pStack[nStack])
+#define StackSetTop(do_assign) {pStack[nStack] do_assign;}
+#define StackPush(val)         {nStack++;pStack[nStack]=val;}
+#define StackPop()             {if (!nStack) {ReportError("Illegal arithmetic in calculation"); return 0;}; nStack--;}
+
+#define BinaryIntOp(op)        {int RightSide=(int)StackTop();StackPop();StackSetTop(=(double)(((int)StackTop()) op RightSide));}
+#define BinaryOp(op)           {double RightSide=StackTop();StackPop();StackSetTop(=StackTop() op RightSide);}
+#define BinaryAssign(op)       {double RightSide=StackTop();StackPop();StackSetTop(op##=RightSide);}
+
+#define UnaryIntOp(op)         {StackSetTop(=op((int)StackTop()));}
+#define UnaryOp(op)            {StackSetTop(=op(StackTop()));}
+
+	for (int i = 0; i < Size; i++)
+	{
+		switch (pList[i].Op)
+		{
+		case CO_NUMBER:
+			StackPush(pValues ? *pValues++ : pList[i].Value);
+			break;
+		case CO_ADD:
+			BinaryAssign(+);
+			break;
+		case CO_MULTIPLY:
+			BinaryAssign(*);
+			break;
+		case CO_SUBTRACT:
+			BinaryAssign(-);
+			break;
+		case CO_NEGATE:
+			UnaryOp(-);
+			break;
+		case CO_DIVIDE:
+			if (StackTop())
+			{
+				BinaryAssign(/ );
+			}
+			else
+			{
+				//printf("Divide by zero error\n");
+				ReportError("Divide by zero in calculation");
+				return false;
+			}
+			break;
+
+		case CO_IDIVIDE://TODO: SPECIAL HANDLING
+		{
+			int Right = (int)StackTop();
+			if (Right)
+			{
+				StackPop();
+				int Left = (int)StackTop();
+				Left /= Right;
+				StackSetTop(= Left);
+			}
+			else
+			{
+				//printf("Integer divide by zero error\n");
+				ReportError("Divide by zero in calculation");
+				return false;
+			}
+		}
+		break;
+
+		case CO_MODULUS://TODO: SPECIAL HANDLING
+		{
+			int Right = (int)StackTop();
+			if (Right)
+			{
+				StackPop();
+				int Left = (int)StackTop();
+				Left %= Right;
+				StackSetTop(= Left);
+			}
+			else
+			{
+				//printf("Modulus by zero error\n");
+				ReportError("Modulus by zero in calculation");
+				return false;
+			}
+		}
+		break;
+
+		case CO_LAND:
+			BinaryOp(&&);
+			break;
+		case CO_LOR:
+			BinaryOp(|| );
+			break;
+		case CO_EQUAL:
+			BinaryOp(== );
+			break;
+		case CO_NOTEQUAL:
+			BinaryOp(!= );
+			break;
+		case CO_GREATER:
+			BinaryOp(> );
+			break;
+		case CO_NOTGREATER:
+			BinaryOp(<= );
+			break;
+		case CO_LESS:
+			BinaryOp(< );
+			break;
+		case CO_NOTLESS:
+			BinaryOp(>= );
+			break;
+		case CO_SHL:
+			BinaryIntOp(<< );
+			break;
+		case CO_SHR:
+			BinaryIntOp(>> );
+			break;
+		case CO_AND:
+			BinaryIntOp(&);
+			break;
+		case CO_OR:
+			BinaryIntOp(| );
+			break;
+		case CO_XOR:
+			BinaryIntOp(^);
+			break;
+		case CO_LNOT:
+			UnaryIntOp(!);
+			break;
+		case CO_NOT:
+			UnaryIntOp(~);
+			break;
+		case CO_POWER:
+		{
+			double RightSide = StackTop();
+			StackPop();
+			StackSetTop(= pow(StackTop(), RightSide));
+		}
+		break;
+		}
+	}
+
+	Result = StackTop();
+
+#undef StackEmpty
+#undef StackTop
+#undef StackSetTop
+#undef StackPush
+#undef StackPop
+#undef BinaryIntOp
+#undef BinaryOp
+#undef BinaryAssign
+#undef UnaryIntOp
+#undef UnaryOp
+
+	return true;
+}
+
+// Tokenizes a formula and converts it to RPN with shunting-yard.
+inline bool CompileRPN(const char* szFormula, std::vector<CalcOp>& ops, CalcErrorFunc ReportError)
+{
+	ops.clear();
+
+	//DebugSpew("FastCalculate(%s)",szFormula);
+	if (!szFormula || !szFormula[0])
+		return false;
+
+	int Length = (int)strlen(szFormula);
+	int MaxOps = (Length + 1);
+
+	ops.resize(MaxOps);
+	CalcOp* pOpList = ops.data();
+
+	std::unique_ptr<eCalcOp[]> Stack = std::make_unique<eCalcOp[]>(MaxOps);
+	eCalcOp* pStack = Stack.get();
+	memset(pStack, 0, sizeof(eCalcOp) * MaxOps);
+
+	int nOps = 0;
+	int nStack = 0;
+	const char* pEnd = szFormula + Length;
+	char CurrentToken[MAX_STRING] = { 0 };
+	char* pToken = &CurrentToken[0];
+
+#define OpToList(op)         { pOpList[nOps].Op = op; nOps++; }
+#define ValueToList(val)     { pOpList[nOps].Value = val; nOps++; }
+#define StackEmpty()         (nStack == 0)
+#define StackTop()           (pStack[nStack])
+#define StackPush(op)        { nStack++; pStack[nStack] = op; }
+#define StackPop()           { if (!nStack) { ReportError("Illegal arithmetic in calculation"); return 0; } nStack--;}
+#define HasPrecedence(a,b)   ( CalcOpPrecedence[a] >= CalcOpPrecedence[b])
+#define MoveStack(op) {                                                                        \
+	while (!StackEmpty() && StackTop() != CO_OPENPARENS && HasPrecedence(StackTop(), op)) {    \
+		OpToList(StackTop());                                                                  \
+		StackPop();                                                                            \
+	}                                                                                          \
+}
+#define FinishString()       { if (pToken != &CurrentToken[0]) { *pToken = 0; ValueToList(GetDoubleFromString(CurrentToken, 0)); pToken = &CurrentToken[0]; *pToken=0; }}
+#define NewOp(op)            { FinishString(); MoveStack(op); StackPush(op); }
+#define NextChar(ch)         { *pToken = ch; pToken++; }
+
+	bool WasParen = false;
+	for (const char* pCur = szFormula; pCur < pEnd; pCur++)
+	{
+		switch (*pCur)
+		{
+		case ' ':
+			continue;
+		case '(':
+			FinishString();
+			StackPush(CO_OPENPARENS);
+			break;
+		case ')':
+			FinishString();
+			while (StackTop() != CO_OPENPARENS)
+			{
+				OpToList(StackTop());
+				StackPop();
+			}
+			StackPop();
+			WasParen = true;
+			continue;
+		case '+':
+			if (pCur[1] != '+')
+				NewOp(CO_ADD);
+			break;
+		case '-':
+			if (pCur[1] == '-')
+			{
+				pCur++;
+				NewOp(CO_ADD);
+			}
+			else
+			{
+				if (CurrentToken[0] || WasParen)
+				{
+					NewOp(CO_SUBTRACT);
+				}
+				else
+					NewOp(CO_NEGATE);
+			}
+			break;
+		case '*':
+			NewOp(CO_MULTIPLY);
+			break;
+		case '\\':
+			NewOp(CO_IDIVIDE);
+			break;
+		case '/':
+			NewOp(CO_DIVIDE);
+			break;
+		case '|':
+			if (pCur[1] == '|')
+			{
+				// Logical OR
+				++pCur;
+				NewOp(CO_LOR);
+			}
+			else
+			{
+				// Bitwise OR
+				NewOp(CO_OR);
+			}
+			break;
+		case '%':
+			NewOp(CO_MODULUS);
+			break;
+		case '~':
+			NewOp(CO_NOT);
+			break;
+		case '&':
+			if (pCur[1] == '&')
+			{
+				// Logical AND
+				++pCur;
+				NewOp(CO_LAND);
+			}
+			else
+			{
+				// Bitwise AND
+				NewOp(CO_AND);
+			}
+			break;
+		case '^':
+			if (pCur[1] == '^')
+			{
+				// XOR
+				++pCur;
+				NewOp(CO_XOR);
+			}
+			else
+			{
+				// POWER
+				NewOp(CO_POWER);
+			}
+			break;
+		case '!':
+			if (pCur[1] == '=')
+			{
+				++pCur;
+				NewOp(CO_NOTEQUAL);
+			}
+			else
+			{
+				NewOp(CO_LNOT);
+			}
+			break;
+		case '=':
+			if (pCur[1] == '=')
+			{
+				++pCur;
+				NewOp(CO_EQUAL);
+			}
+			else
+			{
+				//printf("Unparsable: '%c'\n",*pCur);
+				// error
+				return false;
+			}
+			break;
+		case '<':
+			if (pCur[1] == '=')
+			{
+				++pCur;
+				NewOp(CO_NOTGREATER);
+			}
+			else if (pCur[1] == '<')
+			{
+				++pCur;
+				NewOp(CO_SHL);
+			}
+			else
+			{
+				NewOp(CO_LESS);
+			}
+			break;
+		case '>':
+			if (pCur[1] == '=')
+			{
+				++pCur;
+				NewOp(CO_NOTLESS);
+			}
+			else if (pCur[1] == '>')
+			{
+				++pCur;
+				NewOp(CO_SHR);
+			}
+			else
+			{
+				NewOp(CO_GREATER);
+			}
+			break;
+		case '.':
+		case '1':
+		case '2':
+		case '3':
+		case '4':
+		case '5':
+		case '6':
+		case '7':
+		case '8':
+		case '9':
+		case '0':
+			NextChar(*pCur);
+			break;
+		default:
+		{
+			//printf("Unparsable: '%c'\n",*pCur);
+			ReportError("Unparsable in Calculation: '%c'", *pCur);
+			// unparsable
+			return false;
+		}
+		}
+		WasParen = false;
+	}
+	FinishString();
+
+	while (!StackEmpty())
+	{
+		OpToList(StackTop());
+		StackPop();
+	}
+
+#undef OpToList
+#undef ValueToList
+#undef StackEmpty
+#undef StackTop
+#undef StackPush
+#undef StackPop
+#undef HasPrecedence
+#undef MoveStack
+#undef FinishString
+#undef NewOp
+#undef NextChar
+
+	ops.resize(nOps);
+	return true;
+}
+
+inline bool FastCalculate(const char* szFormula, double& Result, CalcErrorFunc ReportError)
+{
+	std::vector<CalcOp> ops;
+	if (!CompileRPN(szFormula, ops, ReportError))
+		return false;
+
+	return EvaluateRPN(ops.data(), static_cast<int>(ops.size()), Result, ReportError);
+}
+
+// Upper-cases a formula and replaces NULL, TRUE and FALSE with numbers of the same length.
+inline void PrepareCalcFormula(char* szFormula)
+{
+	for (char* pCur = szFormula; *pCur; ++pCur)
+		*pCur = static_cast<char>(toupper(static_cast<unsigned char>(*pCur)));
+
+	while (char* pNull = strstr(szFormula, "NULL"))
+	{
+		pNull[0] = '0';
+		pNull[1] = '.';
+		pNull[2] = '0';
+		pNull[3] = '0';
+	}
+
+	while (char* pTrue = strstr(szFormula, "TRUE"))
+	{
+		pTrue[0] = '1';
+		pTrue[1] = '.';
+		pTrue[2] = '0';
+		pTrue[3] = '0';
+	}
+
+	while (char* pFalse = strstr(szFormula, "FALSE"))
+	{
+		pFalse[0] = '0';
+		pFalse[1] = '.';
+		pFalse[2] = '0';
+		pFalse[3] = '0';
+		pFalse[4] = '0';
+	}
+}
+
+// Splits a formula into its shape, which is the formula with each number replaced by '#', and the
+// values of those numbers in order. Numbers end where the tokenizer in CompileRPN ends them, so
+// formulas with the same shape compile to the same program apart from the values of the numbers.
+//
+// szShape needs room for the formula. Returns the count of numbers, of which the first maxValues are
+// written to pValues, or -1 if a number is too long to read here.
+inline int GetFormulaShape(const char* szFormula, char* szShape, double* pValues, int maxValues)
+{
+	char token[64];
+	int tokenLength = 0;
+	int count = 0;
+
+	auto finishToken = [&]()
+	{
+		if (tokenLength == 0)
+			return;
+
+		if (count < maxValues)
+			pValues[count] = GetDoubleFromString(std::string_view(token, tokenLength), 0);
+		++count;
+		tokenLength = 0;
+	};
+
+	for (const char* pCur = szFormula; *pCur; ++pCur)
+	{
+		const char ch = *pCur;
+
+		if ((ch >= '0' && ch <= '9') || ch == '.')
+		{
+			if (tokenLength == sizeof(token))
+				return -1;
+
+			if (tokenLength == 0)
+				*szShape++ = '#';
+			token[tokenLength++] = ch;
+		}
+		else if (ch == ' ')
+		{
+			// spaces don't end a number
+			*szShape++ = ch;
+		}
+		else
+		{
+			finishToken();
+			*szShape++ = ch;
+		}
+	}
+
+	finishToken();
+	*szShape = 0;
+
+	return count;
+}
+
+// Compiled formulas, keyed by shape, so that a formula that is only ever evaluated with different
+// numbers, as conditions are after their variables have been substituted, is only compiled once.
+// The numbers are the inputs of the program, so there is nothing to fold at compile time.
+class CalcProgramCache
+{
+public:
+	explicit CalcProgramCache(size_t capacity)
+		: m_programs(capacity)
+	{
+	}
+
+	// Calculates a formula the same way FastCalculate does, reusing the program of an earlier formula
+	// with the same shape. Formulas that fail to compile aren't kept, so they report their error every
+	// time.
+	bool Calculate(const char* szFormula, double& Result, CalcErrorFunc ReportError)
+	{
+		constexpr int LocalValueCount = 64;
+		double localValues[LocalValueCount];
+
+		const size_t length = strlen(szFormula);
+		char localShape[256];
+		std::unique_ptr<char[]> heapShape;
+
+		char* szShape = localShape;
+		if (length + 1 > sizeof(localShape))
+		{
+			heapShape = std::make_unique<char[]>(length + 1);
+			szShape = heapShape.get();
+		}
+
+		const int count = GetFormulaShape(szFormula, szShape, localValues, LocalValueCount);
+		if (count < 0 || count > LocalValueCount)
+			return FastCalculate(szFormula, Result, ReportError);
+
+		auto program = m_programs.Find(szShape);
+		if (!program)
+		{
+			auto compiled = std::make_shared<std::vector<CalcOp>>();
+			if (!CompileRPN(szFormula, *compiled, ReportError))
+				return false;
+
+			program = m_programs.Insert(szShape, std::move(compiled));
+		}
+
+		return EvaluateRPN(program->data(), static_cast<int>(program->size()), Result, ReportError, localValues);
+	}
+
+	size_t GetProgramCount() const { return m_programs.Size(); }
+
+private:
+	LRUCache<std::vector<CalcOp>> m_programs;
+};
+
+} // namespace mq
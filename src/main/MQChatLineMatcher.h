@@ -0,0 +1,227 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-present MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#pragma once
+
+#include "mq/base/AhoCorasick.h"
+#include "mq/base/String.h"
+
+#include "blech/Blech.h"
+
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Chat line matching
+//
+// Every line of chat is scanned once for all of the text that the channel checks in
+// CheckChatForEvent and the blech events could need. Blech is then only fed lines that contain
+// every literal of at least one of its events, which is all it could ever match.
+
+namespace mq {
+
+enum eChatLiteral
+{
+	ChatLiteral_TellsGuild,
+	ChatLiteral_TellsGroup,
+	ChatLiteral_TellsYou,
+	ChatLiteral_ToldYou,
+	ChatLiteral_OutOfCharacter,
+	ChatLiteral_Shouts,
+	ChatLiteral_Auctions,
+	ChatLiteral_SaysQuote,
+	ChatLiteral_SaysComma,
+	ChatLiteral_TellsRaid,
+	ChatLiteral_YouTold,
+	ChatLiteral_Tells,
+	ChatLiteral_Colon,
+	ChatLiteral_CommaQuote,
+
+	ChatLiteral_Count
+};
+
+inline constexpr std::string_view s_chatLiterals[ChatLiteral_Count] = {
+	" tells the guild, ",
+	" tells the group, ",
+	" tells you, ",
+	" told you, ",
+	" says out of character, '",
+	" shouts, ",
+	" auctions, ",
+	" says '",
+	" says, ",
+	" tells the raid, ",
+	"You told ",
+	" tells ",
+	":",
+	", '",
+};
+
+// The result of scanning a single line. This is kept separate from the matcher because feeding
+// blech can write more chat, which will be scanned before we are done with this line.
+struct MQChatLineMatch
+{
+	const char* szLine = nullptr;
+	size_t firstPos[ChatLiteral_Count];
+	bool feedMQ2Blech = false;
+	bool feedEventBlech = false;
+
+	// Returns the first occurrence of the literal in the line, or nullptr.
+	const char* Find(eChatLiteral literal) const
+	{
+		if (firstPos[literal] == std::string_view::npos)
+			return nullptr;
+
+		return szLine + firstPos[literal];
+	}
+};
+
+class MQChatLineMatcher
+{
+public:
+	// pMQ2Blech and pEventBlech are the blechs that lines are fed to, and either may be null.
+	void Scan(const char* szLine, MQChatLineMatch& match, const Blech* pMQ2Blech, const Blech* pEventBlech)
+	{
+		Prepare(pMQ2Blech, pEventBlech);
+
+		if (++m_scan == 0)
+		{
+			// stamp wrapped around, forget everything we've seen so far.
+			std::fill(m_found.begin(), m_found.end(), 0);
+			m_scan = 1;
+		}
+
+		match.szLine = szLine;
+		std::fill(std::begin(match.firstPos), std::end(match.firstPos), std::string_view::npos);
+
+		m_matcher.Scan(szLine, [&](uint32_t index, size_t offset)
+			{
+				m_found[index] = m_scan;
+
+				// the channel checks are case sensitive and want the first occurrence, like strstr.
+				if (index < ChatLiteral_Count && match.firstPos[index] == std::string_view::npos
+					&& s_chatLiterals[index].compare(0, std::string_view::npos, szLine + offset, s_chatLiterals[index].size()) == 0)
+				{
+					match.firstPos[index] = offset;
+				}
+			});
+
+		match.feedMQ2Blech = CanMatch(pMQ2Blech);
+		match.feedEventBlech = CanMatch(pEventBlech);
+	}
+
+private:
+	struct BlechFilter
+	{
+		const Blech* pBlech = nullptr;
+		unsigned int revision = 0;
+		bool alwaysMatches = false;
+		std::vector<std::vector<uint32_t>> events;
+	};
+
+	// Returns true if any event in the blech could match the last scanned line.
+	bool CanMatch(const Blech* pBlech) const
+	{
+		if (!pBlech)
+			return false;
+
+		for (const BlechFilter& filter : m_filters)
+		{
+			if (filter.pBlech != pBlech)
+				continue;
+
+			if (filter.alwaysMatches)
+				return true;
+
+			for (const auto& literals : filter.events)
+			{
+				if (std::all_of(literals.begin(), literals.end(), [this](uint32_t index) { return m_found[index] == m_scan; }))
+					return true;
+			}
+
+			return false;
+		}
+
+		return true;
+	}
+
+	void Prepare(const Blech* pMQ2Blech, const Blech* pEventBlech)
+	{
+		const Blech* blechs[] = { pMQ2Blech, pEventBlech };
+
+		bool changed = !m_matcher.IsBuilt();
+		for (size_t i = 0; i < std::size(blechs); ++i)
+		{
+			if (m_filters[i].pBlech != blechs[i]
+				|| (blechs[i] && m_filters[i].revision != blechs[i]->GetRevision()))
+			{
+				changed = true;
+			}
+		}
+
+		if (!changed)
+			return;
+
+		m_matcher.Clear();
+		std::unordered_map<std::string, uint32_t> indices;
+
+		auto addLiteral = [&](std::string_view literal)
+		{
+			auto [iter, inserted] = indices.emplace(to_lower_copy(literal), 0);
+			if (inserted)
+				iter->second = m_matcher.AddPattern(literal);
+			return iter->second;
+		};
+
+		for (std::string_view literal : s_chatLiterals)
+			addLiteral(literal);
+
+		for (size_t i = 0; i < std::size(blechs); ++i)
+		{
+			BlechFilter& filter = m_filters[i];
+			filter.pBlech = blechs[i];
+			filter.revision = blechs[i] ? blechs[i]->GetRevision() : 0;
+			filter.alwaysMatches = false;
+			filter.events.clear();
+
+			if (!blechs[i])
+				continue;
+
+			blechs[i]->EnumerateEventLiterals(
+				[&](unsigned int, const std::vector<std::string_view>& literals)
+				{
+					if (literals.empty())
+						filter.alwaysMatches = true;
+
+					auto& indexes = filter.events.emplace_back();
+					for (std::string_view literal : literals)
+						indexes.push_back(addLiteral(literal));
+				});
+		}
+
+		m_matcher.Build();
+		m_found.assign(m_matcher.GetPatternCount(), 0);
+		m_scan = 0;
+	}
+
+	AhoCorasick m_matcher;
+	BlechFilter m_filters[2];
+
+	std::vector<uint32_t> m_found;
+	uint32_t m_scan = 0;
+};
+
+} // namespace mq
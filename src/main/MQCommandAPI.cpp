@@ -21,16 +21,6 @@
 
 namespace mq {
 
-struct MQTimedCommand
-{
-	uint64_t         time;
-	std::string      command;
-	MQPluginHandle   pluginHandle;
-
-	MQTimedCommand*  pLast;
-	MQTimedCommand*  pNext;
-};
-
 struct MQCommand
 {
 	std::string      command;
@@ -45,6 +35,7 @@ struct MQCommand
 };
 
 void PopMacroLoop();
+int GetWhileLoopStart(int closingLine);
 // Defined in MQ2MacroCommands.cpp
 void FailIf(PlayerClient* pChar, const char* szCommand, int pStartLine, bool All);
 
@@ -278,6 +269,8 @@ MQCommandAPI::~MQCommandAPI()
 {
 	RemoveDetour(CEverQuest__InterpretCmd);
 
+	m_commandIndex.Invalidate();
+
 	while (m_pCommands)
 	{
 		MQCommand* pNext = m_pCommands->pNext;
@@ -286,19 +279,15 @@ MQCommandAPI::~MQCommandAPI()
 	}
 
 	m_delayedCommands.clear();
-
-	while (m_pTimedCommands)
-	{
-		MQTimedCommand* pNext = m_pTimedCommands->pNext;
-		delete m_pTimedCommands;
-		m_pTimedCommands = pNext;
-	}
+	m_timedCommands.Clear();
 
 	m_aliases.clear();
 }
 
 void MQCommandAPI::OnPluginUnloaded(MQPlugin* plugin, const MQPluginHandle& pluginHandle)
 {
+	std::scoped_lock lock(m_commandMutex);
+
 	// Remove any commands that were created by this plugin.
 	MQCommand* pCommand = m_pCommands;
 
@@ -318,6 +307,7 @@ void MQCommandAPI::OnPluginUnloaded(MQPlugin* plugin, const MQPluginHandle& plug
 			MQCommand* thisCmd = pCommand;
 			pCommand = pCommand->pNext;
 
+			m_commandIndex.Invalidate();
 			delete thisCmd;
 		}
 		else
@@ -379,51 +369,32 @@ bool MQCommandAPI::DispatchCommand(char* szCommand, char* szArgs, const MQComman
 {
 	std::unique_lock lock(m_commandMutex);
 
-	MQCommand* pCommand = m_pCommands;
-	while (pCommand)
-	{
-		if (pCommand->inGameOnly && gGameState != GAMESTATE_INGAME)
-		{
-			pCommand = pCommand->pNext;
-			continue;
-		}
-
-		// Substring search
-		int Pos = _strnicmp(szCommand, pCommand->command.c_str(), strlen(szCommand));
-		if (Pos < 0)
-		{
-			// command not found
-			break;
-		}
+	// Commands may be abbreviated. An abbreviation resolves to the first command, in sorted order, that it prefixes
+	MQCommand* pCommand = m_commandIndex.Find(m_pCommands, szCommand, gGameState == GAMESTATE_INGAME);
+	if (!pCommand)
+		return false;
 
-		if (Pos == 0)
-		{
-			lock.unlock();
+	lock.unlock();
 
-			// the parser version is 2, or It's not version 2 and we're allowing command parses
-			if (pCommand->parse && (gParserVersion == 2 || (gParserVersion != 2 && bAllowCommandParse)))
-			{
-				ParseMacroParameter(szArgs, MAX_STRING);
-			}
-
-			if (pCommand->eq && eqHandler != nullptr)
-			{
-				strcat_s(szCommand, MAX_STRING, " ");
-				strcat_s(szCommand, MAX_STRING, szArgs);
+	// the parser version is 2, or It's not version 2 and we're allowing command parses
+	if (pCommand->parse && (gParserVersion == 2 || (gParserVersion != 2 && bAllowCommandParse)))
+	{
+		ParseMacroParameter(szArgs, MAX_STRING);
+	}
 
-				eqHandler(pLocalPlayer, szCommand);
-			}
-			else
-			{
-				pCommand->handler(pLocalPlayer, szArgs);
-			}
+	if (pCommand->eq && eqHandler != nullptr)
+	{
+		strcat_s(szCommand, MAX_STRING, " ");
+		strcat_s(szCommand, MAX_STRING, szArgs);
 
-			return true;
-		}
-		pCommand = pCommand->pNext;
+		eqHandler(pLocalPlayer, szCommand);
+	}
+	else
+	{
+		pCommand->handler(pLocalPlayer, szArgs);
 	}
 
-	return false;
+	return true;
 }
 
 bool MQCommandAPI::DispatchBind(char* szCommand, char* szArgs)
@@ -529,7 +500,7 @@ void MQCommandAPI::DoCommand(const char* szLine, bool delayed,
 	{
 		if (pBlock)
 		{
-			const auto loopStart = pBlock->Line.at(pBlock->CurrIndex).LoopStart;
+			const int loopStart = GetWhileLoopStart(pBlock->CurrIndex);
 			if (loopStart != 0)
 			{
 				pBlock->CurrIndex = loopStart;
@@ -614,6 +585,8 @@ bool MQCommandAPI::AddCommand(std::string_view command, MQCommandHandler handler
 {
 	DebugSpew("AddCommand(%.*s)", command.length(), command.data());
 
+	std::scoped_lock lock(m_commandMutex);
+
 	MQCommand* pCommand = new MQCommand;
 	pCommand->command = command;
 	pCommand->pluginHandle = pluginHandle;
@@ -626,6 +599,7 @@ bool MQCommandAPI::AddCommand(std::string_view command, MQCommandHandler handler
 	if (!m_pCommands)
 	{
 		m_pCommands = pCommand;
+		m_commandIndex.Invalidate();
 		return true;
 	}
 
@@ -657,6 +631,7 @@ bool MQCommandAPI::AddCommand(std::string_view command, MQCommandHandler handler
 			pCommand->pLast = pLast;
 			pSearch->pLast = pCommand;
 			pCommand->pNext = pSearch;
+			m_commandIndex.Invalidate();
 			return true;
 		}
 
@@ -667,6 +642,7 @@ bool MQCommandAPI::AddCommand(std::string_view command, MQCommandHandler handler
 	// End of list
 	pLast->pNext = pCommand;
 	pCommand->pLast = pLast;
+	m_commandIndex.Invalidate();
 
 	return true;
 }
@@ -674,6 +650,8 @@ bool MQCommandAPI::AddCommand(std::string_view command, MQCommandHandler handler
 bool MQCommandAPI::RemoveCommand(std::string_view command,
 	const MQPluginHandle& pluginHandle /* = mqplugin::ThisPluginHandle */)
 {
+	std::scoped_lock lock(m_commandMutex);
+
 	MQCommand* pCommand = m_pCommands;
 
 	while (pCommand)
@@ -701,6 +679,8 @@ bool MQCommandAPI::RemoveCommand(std::string_view command,
 				pCommand->pLast->pNext = pCommand->pNext;
 			else
 				m_pCommands = pCommand->pNext;
+
+			m_commandIndex.Invalidate();
 			delete pCommand;
 
 			return true;
@@ -865,7 +845,7 @@ void MQCommandAPI::LoadAliases()
 
 void MQCommandAPI::PulseCommands()
 {
-	if (m_delayedCommands.empty() && !m_pTimedCommands)
+	if (m_delayedCommands.empty() && m_timedCommands.Empty())
 	{
 		return;
 	}
@@ -889,51 +869,17 @@ void MQCommandAPI::PulseCommands()
 	// handle timed commands
 	uint64_t Now = MQGetTickCount64();
 
-	while (m_pTimedCommands && m_pTimedCommands->time <= Now)
-	{
-		MQTimedCommand* pNext = m_pTimedCommands->pNext;
-		DoCommand(m_pTimedCommands->command.c_str(), false, m_pTimedCommands->pluginHandle);
-
-		delete m_pTimedCommands;
-		m_pTimedCommands = pNext;
-	}
+	m_timedCommands.Run(Now, [this](const ScheduledCommand& timedCommand)
+		{
+			DoCommand(timedCommand.command.c_str(), false, timedCommand.pluginHandle);
+		});
 }
 
 void MQCommandAPI::TimedCommand(const char* command, int msDelay, const MQPluginHandle& pluginHandle /* = mqplugin::ThisPluginHandle */)
 {
 	std::scoped_lock lock(m_commandMutex);
 
-	MQTimedCommand* pNew = new MQTimedCommand;
-	pNew->time = msDelay + MQGetTickCount64();
-	pNew->command = command;
-	pNew->pluginHandle = pluginHandle;
-
-	// insert into list
-	if (!m_pTimedCommands || m_pTimedCommands->time >= pNew->time)
-	{
-		pNew->pNext = m_pTimedCommands;
-		pNew->pLast = nullptr;
-		m_pTimedCommands = pNew;
-		return;
-	}
-
-	MQTimedCommand* pLast = m_pTimedCommands;
-	MQTimedCommand* pNode = m_pTimedCommands->pNext;
-
-	while (pNode)
-	{
-		if (pNew->time <= pNode->time)
-		{
-			break;
-		}
-
-		pLast = pNode;
-		pNode = pNode->pNext;
-	}
-
-	pLast->pNext = pNew;
-	pNew->pLast = pLast;
-	pNew->pNext = pNode;
+	m_timedCommands.Schedule(msDelay + MQGetTickCount64(), ScheduledCommand{ command, pluginHandle });
 }
 
 //============================================================================
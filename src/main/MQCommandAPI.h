@@ -20,15 +20,17 @@
 
 #include "mq/base/PluginHandle.h"
 #include "mq/base/String.h"
+#include "mq/base/TimerQueue.h"
 #include "mq/api/CommandAPI.h"
 
+#include "MQCommandIndex.h"
+
 #include <mutex>
 
 namespace mq {
 
 //============================================================================
 
-struct MQTimedCommand;
 struct MQCommand;
 struct MQPlugin;
 
@@ -104,7 +106,15 @@ private:
 	std::vector<DelayedCommand> m_delayedCommands;
 
 	MQCommand* m_pCommands = nullptr;
-	MQTimedCommand* m_pTimedCommands = nullptr;
+
+	struct ScheduledCommand
+	{
+		std::string command;
+		MQPluginHandle pluginHandle;
+	};
+	TimerQueue<ScheduledCommand> m_timedCommands;       // due time in ms, see MQGetTickCount64
+
+	MQCommandIndex<MQCommand> m_commandIndex;
 
 	std::recursive_mutex m_commandMutex;
 };
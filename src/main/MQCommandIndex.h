@@ -0,0 +1,88 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-present MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#pragma once
+
+#include "mq/base/String.h"
+
+#include <string_view>
+
+namespace mq {
+
+// Resolves a command, which may be abbreviated, to the command that it dispatches to: the first one
+// in the sorted command list that it is a prefix of. Every command name and every abbreviation of one
+// is a key, so resolving a command is a single lookup instead of a walk of the list.
+//
+// Command is a node of the sorted command list, with command, inGameOnly and pNext members. Keys are
+// views of the command names, so the index has to be invalidated whenever a command is added or
+// removed. It is rebuilt on the next lookup.
+template <typename Command>
+class MQCommandIndex
+{
+public:
+	// Returns the command that name dispatches to, or nullptr. When not in game, commands that are
+	// in-game only are passed over, and the name goes to the next command that it prefixes.
+	Command* Find(Command* pCommands, std::string_view name, bool inGame)
+	{
+		if (m_dirty)
+			Rebuild(pCommands);
+
+		auto iter = m_index.find(name);
+		if (iter == m_index.end())
+			return nullptr;
+
+		return inGame ? iter->second.command : iter->second.outOfGameCommand;
+	}
+
+	void Invalidate()
+	{
+		m_index.clear();
+		m_dirty = true;
+	}
+
+private:
+	void Rebuild(Command* pCommands)
+	{
+		m_index.clear();
+
+		// The list is sorted, so the first command to claim a prefix is the one that a linear
+		// search for that prefix would have found.
+		for (Command* pCommand = pCommands; pCommand; pCommand = pCommand->pNext)
+		{
+			std::string_view name = pCommand->command;
+
+			for (size_t length = 0; length <= name.length(); ++length)
+			{
+				Resolution& resolution = m_index[name.substr(0, length)];
+
+				if (!resolution.command)
+					resolution.command = pCommand;
+				if (!resolution.outOfGameCommand && !pCommand->inGameOnly)
+					resolution.outOfGameCommand = pCommand;
+			}
+		}
+
+		m_dirty = false;
+	}
+
+	struct Resolution
+	{
+		Command* command = nullptr;
+		Command* outOfGameCommand = nullptr;      // first match that isn't in-game only
+	};
+	ci_unordered::map<std::string_view, Resolution> m_index;
+	bool m_dirty = true;
+};
+
+} // namespace mq
@@ -0,0 +1,397 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-present MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#pragma once
+
+#include <fmt/format.h>
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Tokenization of macro strings and ${...} expressions into the compiled forms that MQDataAPI
+// caches and evaluates. Nothing here looks anything up, so it doesn't depend on the game.
+
+namespace mq {
+
+//============================================================================
+// Compiled data expressions
+
+// The compiled form of the contents of a single ${...} expression. This is the tokenization that
+// ParseMQ2DataPortion performs, flattened into a list of operations so that it only has to
+// happen once per distinct expression.
+struct MQCompiledDataExpression
+{
+	enum class OpType
+	{
+		Evaluate,          // Evaluate Name[Index] against the current result
+		RequireType,       // Fail if there is no current result
+		Cast,              // Cast the current result to the type named by Name
+		End,               // Stop. Succeeds if there is a current result, otherwise reports Name as an error
+		Error,             // Report Name as an error and fail
+	};
+
+	struct Op
+	{
+		OpType Type;
+		std::string Name;
+		std::string Index;
+		bool AllowFunction = false;
+	};
+
+	std::vector<Op> Ops;
+};
+
+inline std::shared_ptr<const MQCompiledDataExpression> CompileDataExpression(std::string_view source)
+{
+	using OpType = MQCompiledDataExpression::OpType;
+
+	auto compiled = std::make_shared<MQCompiledDataExpression>();
+	auto& ops = compiled->Ops;
+
+	// Tokenization is done on a null terminated copy to mirror the original char based parser.
+	std::string buffer{ source.substr(0, source.find('\0')) };
+
+	const char* pPos = buffer.c_str();
+	const char* pStart = pPos;
+	const char* pNameEnd = nullptr;
+	std::string index;
+	bool functionAllowed = false;
+
+	auto currentName = [&]() { return std::string(pStart, pNameEnd ? pNameEnd : pPos); };
+
+	while (true)
+	{
+		if (*pPos == 0)
+		{
+			// end completely. process
+			if (pStart == pPos)
+				ops.push_back({ OpType::End, "Nothing to parse" });
+			else
+				ops.push_back({ OpType::Evaluate, currentName(), index, functionAllowed });
+
+			break;
+		}
+
+		if (*pPos == '(')
+		{
+			if (pStart == pPos)
+			{
+				ops.push_back({ OpType::End, "Encountered typecast without object to cast" });
+				break;
+			}
+
+			ops.push_back({ OpType::Evaluate, currentName(), index });
+			ops.push_back({ OpType::RequireType });
+
+			++pPos;
+			const char* pType = pPos;
+
+			while (*pPos != ')')
+			{
+				if (!*pPos)
+					break;
+				++pPos;
+			}
+
+			if (!*pPos)
+			{
+				ops.push_back({ OpType::Error, "Encountered unmatched parenthesis" });
+				break;
+			}
+
+			ops.push_back({ OpType::Cast, std::string(pType, pPos) });
+
+			if (pPos[1] == '.')
+			{
+				++pPos;
+				pStart = &pPos[1];
+				pNameEnd = nullptr;
+			}
+			else if (!pPos[1])
+			{
+				// the cast always leaves a result, so we're done
+				break;
+			}
+			else
+			{
+				ops.push_back({ OpType::Error, fmt::format("Invalid character found after typecast '){}'", &pPos[1]) });
+				break;
+			}
+		}
+		else if (*pPos == '[')
+		{
+			// index
+			pNameEnd = pPos;
+			++pPos;
+			functionAllowed = true;
+			bool Quote = false;
+			bool BeginParam = true;
+			bool valid = true;
+			index.clear();
+
+			while (true)
+			{
+				if (*pPos == 0)
+				{
+					valid = false;
+					break;
+				}
+
+				if (BeginParam)
+				{
+					BeginParam = false;
+					if (*pPos == '\"')
+					{
+						Quote = true;
+						++pPos;
+						continue;
+					}
+				}
+
+				if (Quote)
+				{
+					if (*pPos == '\"')
+					{
+						if (pPos[1] == ']' || pPos[1] == ',')
+						{
+							Quote = false;
+							++pPos;
+							continue;
+						}
+					}
+				}
+				else
+				{
+					if (*pPos == ']')
+					{
+						if (pPos[1] == '.' || pPos[1] == '(' || pPos[1] == 0)
+							break; // valid end
+					}
+					else if (*pPos == ',')
+						BeginParam = true;
+				}
+
+				index.push_back(*pPos);
+				++pPos;
+			}
+
+			if (!valid)
+			{
+				ops.push_back({ OpType::Error,
+					fmt::format("Unmatched bracket or invalid character following bracket found in index: '{}'", index) });
+				break;
+			}
+		}
+		else if (*pPos == '.')
+		{
+			// end of this one, but more to come!
+			if (pStart == pPos)
+			{
+				ops.push_back({ OpType::End, "Encountered member access without object" });
+				break;
+			}
+
+			ops.push_back({ OpType::Evaluate, currentName(), index });
+
+			pStart = &pPos[1];
+			pNameEnd = nullptr;
+			index.clear();
+		}
+
+		++pPos;
+	}
+
+	return compiled;
+}
+
+
+//============================================================================
+// Compiled macro strings
+
+/**
+ * @fn FindMacroClosingBrace
+ *
+ * @brief Finds the brace that matches from the start position. Returns the match position
+ *
+ * This is a replication of the original logic for finding the matching brace in MQ2.  It does
+ * not allow for escape characters and there is some weird logic to it (for example, quoted
+ * strings only last until a close bracket) but I've duplicated it here for backwards
+ * compatibility.
+ *
+ * This will start at the position specified and try to find the matching closing brace.
+ * If the match has been found, the function will return the location of that match.  If it
+ * cannot be found, returns std::string::npos to match what find() would return.
+ *
+ * This makes the assumption that you'll be calling it on a position just before ${ since
+ * we're trying to match a macro's closing braces and all macro variables start with ${.
+ *
+ * @param strOrigString The string that you would like to check
+ * @param iCurrentPosition The position to start at in the string (allows for starting
+ *        in the middle to get an interior match)
+ *
+ * @return size_t position of the matching brace (or npos if no match found)
+ */
+inline size_t FindMacroClosingBrace(std::string_view strOrigString, size_t iCurrentPosition)
+{
+	// Setup our needed trackers
+	int iBraceTracker = 0; // Track {
+	bool bQuoteTracker = false; // Track "
+	bool bParamTracker = false; // Track parameters ([ & ,)
+
+	// We already know what the first two characters are going to be so let's jump to the new position + 2.
+	iCurrentPosition += 2;
+
+	// Since we skipped the brace, let's increment that.
+	iBraceTracker = 1;
+
+	// Walk through the braces until we find the matching end brace or we reach the end of the string
+	while ((iBraceTracker > 0) && (iCurrentPosition < strOrigString.size()))
+	{
+		// If our last character was a start parameter
+		if (bParamTracker)
+		{
+			// This character isn't a start parameter
+			bParamTracker = false;
+			// If this is a double quote after the parameter, we're going to assume we're in a quoted string
+			if (strOrigString[iCurrentPosition] == '"')
+			{
+				bQuoteTracker = true;
+			}
+		}
+		// If our last character wasn't a start parameter, are we in a quoted string?
+		else if (bQuoteTracker)
+		{
+			// If this character is a quote
+			if (strOrigString[iCurrentPosition] == '"')
+			{
+				// If there is room for another character at the end fo this string and that character is ] or ,
+				if (((iCurrentPosition + 1) < strOrigString.size())
+					&& (strOrigString[iCurrentPosition + 1] == ']' || strOrigString[iCurrentPosition + 1] == ','))
+				{
+					// Assume we're no longer in a quoted string.
+					bQuoteTracker = false;
+				}
+			}
+		}
+		// Otherwise our last character wasn't a parameter, and we're not in a quoted string
+		else
+		{
+			// Decrement for a close brace
+			if (strOrigString[iCurrentPosition] == '}')
+			{
+				iBraceTracker--;
+			}
+			// Increment for an open brace
+			else if (strOrigString[iCurrentPosition] == '{')
+			{
+				iBraceTracker++;
+			}
+			// Check for open parameters
+			else if (strOrigString[iCurrentPosition] == '[' || strOrigString[iCurrentPosition] == ',')
+			{
+				bParamTracker = true;
+			}
+		}
+
+		// Move to the next character
+		iCurrentPosition++;
+	}
+
+	// If we found our end brace, return the position in the string.
+	if (iBraceTracker == 0)
+	{
+		return iCurrentPosition;
+	}
+
+	// If we didn't find our end brace, return npos
+	return std::string::npos;
+}
+
+// A macro string split into literal runs and whole ${...} variables, as tokenized by
+// ModifyMacroString. Variables that don't nest other variables or use ${Parse[...]} carry
+// their compiled expression and are evaluated directly. Anything else goes back through
+// ParseMacroVar, which handles the inside-out evaluation that those require.
+struct MQCompiledMacroString
+{
+	struct Segment
+	{
+		std::string Text;
+		bool Variable = false;
+		std::shared_ptr<const MQCompiledDataExpression> Expression;
+	};
+
+	std::vector<Segment> Segments;
+};
+
+// Splits a macro string into segments. getExpression(std::string_view) returns the compiled
+// expression for the contents of a variable, and is how MQDataAPI shares them through its cache.
+template <typename GetExpression>
+std::shared_ptr<const MQCompiledMacroString> CompileMacroString(std::string_view strOriginal, GetExpression&& getExpression)
+{
+	auto compiled = std::make_shared<MQCompiledMacroString>();
+	auto& segments = compiled->Segments;
+
+	auto addLiteral = [&segments](std::string_view text)
+	{
+		if (text.empty())
+			return;
+
+		if (!segments.empty() && !segments.back().Variable)
+			segments.back().Text.append(text);
+		else
+			segments.push_back({ std::string(text) });
+	};
+
+	size_t iCurrentPosition = 0;
+
+	while (iCurrentPosition != std::string::npos)
+	{
+		const size_t iNewPosition = strOriginal.find("${", iCurrentPosition);
+		if (iNewPosition == std::string::npos)
+		{
+			addLiteral(strOriginal.substr(iCurrentPosition));
+			break;
+		}
+
+		addLiteral(strOriginal.substr(iCurrentPosition, iNewPosition - iCurrentPosition));
+
+		// If we didn't find the matching brace, the rest of the string is left as is
+		const size_t iBracePosition = FindMacroClosingBrace(strOriginal, iNewPosition);
+		if (iBracePosition == std::string::npos)
+		{
+			addLiteral(strOriginal.substr(iNewPosition));
+			break;
+		}
+
+		std::string_view strVar = strOriginal.substr(iNewPosition, iBracePosition - iNewPosition);
+		MQCompiledMacroString::Segment segment{ std::string(strVar), true };
+
+		// "${Parse[" is PARSE_PARAM_BEG
+		if (strVar.find("${Parse[") == std::string::npos
+			&& strVar.find("${", 2) == std::string::npos)
+		{
+			// Strip the ${ and } off, the same as GetMacroVarData does
+			segment.Expression = getExpression(strVar.substr(2, strVar.length() - 3));
+		}
+
+		segments.push_back(std::move(segment));
+		iCurrentPosition = iBracePosition;
+	}
+
+	return compiled;
+}
+
+} // namespace mq
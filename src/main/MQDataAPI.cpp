@@ -16,6 +16,7 @@
 #include "MQ2Main.h"
 
 #include "MQCommandAPI.h"
+#include "MQCompiledExpression.h"
 #include "MQDataAPI.h"
 
 #include "CrashHandler.h"
@@ -57,6 +58,18 @@ struct MQDataTypeRegistration
 
 };
 
+// see GetMacroDataRevision
+static std::atomic<uint32_t> s_macroDataRevision = 0;
+
+// The member that EvaluateResolvedMember is currently evaluating. The owner's own FindMember and
+// FindMethod calls for it are answered from here instead of looking the name up again.
+struct MQPendingMember
+{
+	const MQ2Type* Owner = nullptr;
+	MQTypeMember* Member = nullptr;
+};
+static thread_local MQPendingMember s_pendingMember;
+
 //============================================================================
 // Observed objects (Why are these here under MQDataAPI?)
 
@@ -168,6 +181,9 @@ bool MQDataAPI::AddDataType(MQ2Type& Type, const MQPluginHandle& pluginHandle)
 	TypeRec rec = { &Type, pluginHandle };
 
 	auto result = m_dataTypeMap.emplace(Type.GetName(), rec);
+	if (result.second)
+		++s_macroDataRevision;
+
 	return result.second;
 }
 
@@ -189,6 +205,7 @@ bool MQDataAPI::RemoveDataType(MQ2Type& Type, const MQPluginHandle& pluginHandle
 
 	// The type existed. Erase it.
 	m_dataTypeMap.erase(iter);
+	++s_macroDataRevision;
 	return true;
 }
 
@@ -267,6 +284,8 @@ MQTopLevelObject* MQDataAPI::FindTopLevelObject(const char* szName) const
 
 bool MQDataAPI::AddTypeExtension(const char* szName, MQ2Type* extension, const MQPluginHandle& pluginHandle)
 {
+	std::scoped_lock lock(m_mutex);
+
 	// get the extension record for this type name
 	auto& record = m_typeExtensions[szName];
 
@@ -281,11 +300,14 @@ bool MQDataAPI::AddTypeExtension(const char* szName, MQ2Type* extension, const M
 
 	// insert extension into the record
 	record.push_back(rec);
+	++s_macroDataRevision;
 	return true;
 }
 
 bool MQDataAPI::RemoveTypeExtension(const char* szName, MQ2Type* extension, const MQPluginHandle& pluginHandle)
 {
+	std::scoped_lock lock(m_mutex);
+
 	// check if we have a record for this type name
 	auto iter = m_typeExtensions.find(szName);
 	if (iter == m_typeExtensions.end())
@@ -309,6 +331,7 @@ bool MQDataAPI::RemoveTypeExtension(const char* szName, MQ2Type* extension, cons
 	if (record.empty())
 		m_typeExtensions.erase(iter);
 
+	++s_macroDataRevision;
 	return true;
 }
 
@@ -394,6 +417,93 @@ MQDataAPI::EvaluateResult MQDataAPI::EvaluateMacroDataMember(MQ2Type* type, MQVa
 	return EvaluateResult::Failure;
 }
 
+// Finds the extension of type that EvaluateMacroDataMember would hand the member to. Like there,
+// the extensions of an extension get the first look at a member, before the extension itself.
+bool MQDataAPI::ResolveExtensionMember(MQ2Type* type, const std::string& Member, MQResolvedMember& Result) const
+{
+	auto extIter = m_typeExtensions.find(type->GetName());
+	if (extIter == m_typeExtensions.end())
+		return false;
+
+	for (const ExtensionRec& rec : extIter->second)
+	{
+		MQ2Type* ext = rec.extentionType;
+
+		if (ResolveExtensionMember(ext, Member, Result))
+			return true;
+
+		// extensions only handle the members that they have
+		if (MQTypeMember* pMember = ext->FindMember(Member))
+		{
+			Result.Owner = ext;
+			Result.Member = pMember;
+			Result.Found = true;
+			return true;
+		}
+
+		if (ext->InheritedMember(Member))
+		{
+			Result.Owner = ext;
+			Result.Found = true;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool MQDataAPI::ResolveMacroDataMember(MQ2Type* type, const std::string& Member, MQResolvedMember& Result) const
+{
+	// extensions can be added and removed by plugins while this is looking at them
+	std::scoped_lock lock(m_mutex);
+
+	Result = MQResolvedMember();
+	Result.Type = type;
+
+	// read the revision first, so that a change while we're looking things up invalidates the result
+	Result.Revision = s_macroDataRevision;
+	Result.Exists = FindMacroDataMember(type, Member);
+
+	if (ResolveExtensionMember(type, Member, Result))
+		return Result.Exists;
+
+	// the type itself always gets a chance at the member, even if it doesn't know the name
+	Result.Owner = type;
+	Result.Member = type->FindMember(Member);
+	Result.Found = Result.Member != nullptr || type->InheritedMember(Member);
+
+	if (Result.Member == nullptr)
+		Result.Member = type->FindMethod(Member);
+
+	return Result.Exists;
+}
+
+MQDataAPI::EvaluateResult MQDataAPI::EvaluateResolvedMember(const MQResolvedMember& Resolved, MQVarPtr& VarPtr,
+	MQTypeVar& Result, const char* Member, char* pIndex) const
+{
+	if (Resolved.Owner == nullptr || Resolved.Revision != s_macroDataRevision)
+		return EvaluateMacroDataMember(Resolved.Type, VarPtr, Result, Member, pIndex, false);
+
+	bool success;
+	if (Resolved.Member != nullptr)
+	{
+		// pass the owner its own copy of the name, so that its lookup can be answered from the pending member
+		MQPendingMember previous = std::exchange(s_pendingMember, { Resolved.Owner, Resolved.Member });
+		SCOPE_EXIT(s_pendingMember = previous);
+
+		success = Resolved.Owner->GetMember(std::move(VarPtr), Resolved.Member->Name, pIndex, Result);
+	}
+	else
+	{
+		success = Resolved.Owner->GetMember(std::move(VarPtr), Member, pIndex, Result);
+	}
+
+	if (success)
+		return EvaluateResult::Success;
+
+	return Resolved.Found ? EvaluateResult::Failure : EvaluateResult::NotFound;
+}
+
 static void DumpWarning(const char* pStart, int index)
 {
 	if (MQMacroBlockPtr pBlock = GetCurrentMacroBlock())
@@ -669,307 +779,82 @@ void MQDataAPI::RegisterTopLevelObjects()
 #endif // HAS_KEYRING_WINDOW
 }
 
-bool MQDataAPI::ParseMQ2DataPortion(char* szOriginal, MQTypeVar& Result) const
+//============================================================================
+// Compiled data expressions
+
+std::shared_ptr<const MQCompiledDataExpression> MQDataAPI::GetCompiledDataExpression(std::string_view source) const
 {
+	return m_compiledExpressions.FindOrCreate(source, CompileDataExpression);
+}
+
+bool MQDataAPI::EvaluateCompiledDataExpression(const MQCompiledDataExpression& expr, MQTypeVar& Result) const
+{
+	using OpType = MQCompiledDataExpression::OpType;
+
 	Result.Type = nullptr;
 	Result.Int64 = 0;
 
-	char Index[MAX_STRING] = { 0 };
+	// Members are allowed to modify the index they are given, so each evaluation gets a scratch copy.
+	char Index[MAX_STRING];
 
-	// Find [] before a . or null
-	char* pPos = &szOriginal[0];
-	char* pStart = pPos;
-	char* pIndex = &Index[0];
-	bool Quote = false;
-	bool functionAllowed = false;
-
-	while (true)
+	for (const auto& op : expr.Ops)
 	{
-		if (*pPos == 0)
+		switch (op.Type)
 		{
-			// end completely. process
-			if (pStart == pPos)
-			{
-				if (!Result.Type)
-				{
-					MQ2DataError("Nothing to parse");
-					return false;
-				}
-
-				return true;
-			}
+		case OpType::Evaluate:
+			strncpy_s(Index, op.Index.c_str(), _TRUNCATE);
 
-			if (!EvaluateDataExpression(Result, pStart, pIndex, functionAllowed))
+			if (!EvaluateDataExpression(Result, op.Name.c_str(), Index, op.AllowFunction))
 				return false;
+			break;
 
-			// done processing
-			return true;
-		}
-
-		if (*pPos == '(')
-		{
-			*pPos = 0;
-			if (pStart == pPos)
-			{
-				if (!Result.Type)
-				{
-					MQ2DataError("Encountered typecast without object to cast");
-					return false;
-				}
-
-				return true;
-			}
-			else
-			{
-				if (!EvaluateDataExpression(Result, pStart, pIndex))
-					return false;
-			}
-
+		case OpType::RequireType:
 			if (!Result.Type)
-			{
-				// error
 				return false;
-			}
-
-			*pPos = 0;
-			++pPos;
-			char* pType = pPos;
+			break;
 
-			while (*pPos != ')')
+		case OpType::Cast:
+			if (MQ2Type* pNewType = FindDataType(op.Name.c_str()))
 			{
-				if (!*pPos)
+				if (pNewType == datatypes::pTypeType)
 				{
-					// error
-					MQ2DataError("Encountered unmatched parenthesis");
-					return false;
+					Result.Ptr = Result.Type;
+					Result.Type = datatypes::pTypeType;
+				}
+				else
+				{
+					Result.Type = pNewType;
 				}
-				++pPos;
-			}
-
-			*pPos = 0;
-
-			MQ2Type* pNewType = FindDataType(pType);
-			if (!pNewType)
-			{
-				// error
-				MQ2DataError("Unknown type '%s'", pType);
-				return false;
-			}
-
-			if (pNewType == datatypes::pTypeType)
-			{
-				Result.Ptr = Result.Type;
-				Result.Type = datatypes::pTypeType;
 			}
 			else
 			{
-				Result.Type = pNewType;
+				MQ2DataError("Unknown type '%s'", op.Name.c_str());
+				return false;
 			}
+			break;
 
-			if (pPos[1] == '.')
-			{
-				++pPos;
-				pStart = &pPos[1];
-			}
-			else if (!pPos[1])
-			{
-				//Result.Type->ToString(Result.VarPtr,szCurrent);
-				return true;
-			}
-			else
+		case OpType::End:
+			if (!Result.Type)
 			{
-				MQ2DataError("Invalid character found after typecast ')%s'", &pPos[1]);
+				MQ2DataError("%s", op.Name.c_str());
 				return false;
 			}
-		}
-		else
-		{
-			if (*pPos == '[')
-			{
-				// index
-				*pPos = 0;
-				++pPos;
-				functionAllowed = true;
-				Quote = false;
-				bool BeginParam = true;
-
-				while (true)
-				{
-					if (*pPos == 0)
-					{
-						MQ2DataError("Unmatched bracket or invalid character following bracket found in index: '%s'", pIndex);
-						return false;
-					}
-
-					if (BeginParam)
-					{
-						BeginParam = false;
-						if (*pPos == '\"')
-						{
-							Quote = true;
-							++pPos;
-							continue;
-						}
-					}
-
-					if (Quote)
-					{
-						if (*pPos == '\"')
-						{
-							if (pPos[1] == ']' || pPos[1] == ',')
-							{
-								Quote = false;
-								++pPos;
-								continue;
-							}
-						}
-					}
-					else
-					{
-						if (*pPos == ']')
-						{
-							if (pPos[1] == '.' || pPos[1] == '(' || pPos[1] == 0)
-								break;// valid end
-						}
-						else if (*pPos == ',')
-							BeginParam = true;
-					}
-
-					*pIndex = *pPos;
-					++pIndex;
-					++pPos;
-				}
-
-				*pIndex = 0;
-				pIndex = &Index[0];
-				*pPos = 0;
-			}
-			else
-			{
-				if (*pPos == '.')
-				{
-					// end of this one, but more to come!
-					*pPos = 0;
-					if (pStart == pPos)
-					{
-						if (!Result.Type)
-						{
-							MQ2DataError("Encountered member access without object");
-							return false;
-						}
-
-						return true;
-					}
-
-					if (!EvaluateDataExpression(Result, pStart, pIndex))
-						return false;
+			return true;
 
-					pStart = &pPos[1];
-					Index[0] = 0;
-				}
-			}
+		case OpType::Error:
+			MQ2DataError("%s", op.Name.c_str());
+			return false;
 		}
-		++pPos;
 	}
+
+	return true;
 }
 
-/**
- * @fn FindMacroClosingBrace
- *
- * @brief Finds the brace that matches from the start position. Returns the match position
- *
- * This is a replication of the original logic for finding the matching brace in MQ2.  It does
- * not allow for escape characters and there is some weird logic to it (for example, quoted
- * strings only last until a close bracket) but I've duplicated it here for backwards
- * compatibility.
- *
- * This will start at the position specified and try to find the matching closing brace.
- * If the match has been found, the function will return the location of that match.  If it
- * cannot be found, returns std::string::npos to match what find() would return.
- *
- * This makes the assumption that you'll be calling it on a position just before ${ since
- * we're trying to match a macro's closing braces and all macro variables start with ${.
- *
- * @param strOrigString The string that you would like to check
- * @param iCurrentPosition The position to start at in the string (allows for starting
- *        in the middle to get an interior match)
- *
- * @return size_t position of the matching brace (or npos if no match found)
- */
-size_t FindMacroClosingBrace(std::string_view strOrigString, size_t iCurrentPosition)
+bool MQDataAPI::ParseMQ2DataPortion(char* szOriginal, MQTypeVar& Result) const
 {
-	// Setup our needed trackers
-	int iBraceTracker = 0; // Track {
-	bool bQuoteTracker = false; // Track "
-	bool bParamTracker = false; // Track parameters ([ & ,)
-
-	// We already know what the first two characters are going to be so let's jump to the new position + 2.
-	iCurrentPosition += 2;
-
-	// Since we skipped the brace, let's increment that.
-	iBraceTracker = 1;
-
-	// Walk through the braces until we find the matching end brace or we reach the end of the string
-	while ((iBraceTracker > 0) && (iCurrentPosition < strOrigString.size()))
-	{
-		// If our last character was a start parameter
-		if (bParamTracker)
-		{
-			// This character isn't a start parameter
-			bParamTracker = false;
-			// If this is a double quote after the parameter, we're going to assume we're in a quoted string
-			if (strOrigString[iCurrentPosition] == '"')
-			{
-				bQuoteTracker = true;
-			}
-		}
-		// If our last character wasn't a start parameter, are we in a quoted string?
-		else if (bQuoteTracker)
-		{
-			// If this character is a quote
-			if (strOrigString[iCurrentPosition] == '"')
-			{
-				// If there is room for another character at the end fo this string and that character is ] or ,
-				if (((iCurrentPosition + 1) < strOrigString.size())
-					&& (strOrigString[iCurrentPosition + 1] == ']' || strOrigString[iCurrentPosition + 1] == ','))
-				{
-					// Assume we're no longer in a quoted string.
-					bQuoteTracker = false;
-				}
-			}
-		}
-		// Otherwise our last character wasn't a parameter, and we're not in a quoted string
-		else
-		{
-			// Decrement for a close brace
-			if (strOrigString[iCurrentPosition] == '}')
-			{
-				iBraceTracker--;
-			}
-			// Increment for an open brace
-			else if (strOrigString[iCurrentPosition] == '{')
-			{
-				iBraceTracker++;
-			}
-			// Check for open parameters
-			else if (strOrigString[iCurrentPosition] == '[' || strOrigString[iCurrentPosition] == ',')
-			{
-				bParamTracker = true;
-			}
-		}
-
-		// Move to the next character
-		iCurrentPosition++;
-	}
-
-	// If we found our end brace, return the position in the string.
-	if (iBraceTracker == 0)
-	{
-		return iCurrentPosition;
-	}
+	auto compiled = GetCompiledDataExpression(szOriginal);
 
-	// If we didn't find our end brace, return npos
-	return std::string::npos;
+	return EvaluateCompiledDataExpression(*compiled, Result);
 }
 
 /**
@@ -1314,6 +1199,56 @@ std::string ParseMacroVar(std::string_view strOriginal, const bool bParseOnce =
 	return strReturn;
 }
 
+//============================================================================
+// Compiled macro strings
+
+std::shared_ptr<const MQCompiledMacroString> MQDataAPI::GetCompiledMacroString(std::string_view source) const
+{
+	return m_compiledStrings.FindOrCreate(source,
+		[this](std::string_view str)
+		{
+			return CompileMacroString(str, [this](std::string_view expr) { return GetCompiledDataExpression(expr); });
+		});
+}
+
+std::string MQDataAPI::EvaluateCompiledMacroString(const MQCompiledMacroString& compiled, bool bParseOnce) const
+{
+	std::string strReturn;
+
+	for (const auto& segment : compiled.Segments)
+	{
+		if (!segment.Variable)
+		{
+			strReturn.append(segment.Text);
+		}
+		else if (!segment.Expression)
+		{
+			strReturn.append(ParseMacroVar(segment.Text, bParseOnce));
+		}
+		else
+		{
+			std::string_view strParsedVar = "NULL";
+
+			char szResult[MAX_STRING];
+			MQTypeVar Result;
+
+			if (EvaluateCompiledDataExpression(*segment.Expression, Result)
+				&& Result.Type && Result.Type->ToString(Result.VarPtr, szResult))
+			{
+				strParsedVar = szResult;
+			}
+
+			// If the result contains a ${ and we are not in a parse once then it goes through the parser again
+			if (!bParseOnce && strParsedVar != segment.Text && strParsedVar.find("${") != std::string::npos)
+				strReturn.append(ModifyMacroString(strParsedVar));
+			else
+				strReturn.append(strParsedVar);
+		}
+	}
+
+	return strReturn;
+}
+
 /**
  * @fn ModifyMacroString
  *
@@ -1345,6 +1280,17 @@ std::string ParseMacroVar(std::string_view strOriginal, const bool bParseOnce =
  */
 std::string ModifyMacroString(std::string_view strOriginal, bool bParseOnce, ModifyMacroMode iOperation)
 {
+	if (iOperation == ModifyMacroMode::Default)
+	{
+		// Nothing to parse
+		if (strOriginal.find("${") == std::string::npos)
+			return std::string(strOriginal);
+
+		// Parsing goes through the compiled form of the string, which is tokenized once and cached
+		auto compiled = pDataAPI->GetCompiledMacroString(strOriginal);
+		return pDataAPI->EvaluateCompiledMacroString(*compiled, bParseOnce);
+	}
+
 	// Setup a return variable to track our string being built
 	std::string strReturn;
 
@@ -1676,84 +1622,122 @@ const char* MQ2Type::GetName() const
 
 const char* MQ2Type::GetMemberName(int ID) const
 {
-	for (const auto& pMember : Members)
-	{
-		if (pMember && pMember->ID == ID)
+	return ReadMemberTable([ID](const MemberTable& table) -> const char*
 		{
-			return &pMember->Name[0];
-		}
-	}
+			for (const auto& [name, pMember] : table.Members)
+			{
+				if (pMember->ID == ID)
+				{
+					return &pMember->Name[0];
+				}
+			}
 
-	return nullptr;
+			return nullptr;
+		});
 }
 
 bool MQ2Type::GetMemberID(const char* Name, int& result) const
 {
-	std::scoped_lock lock(m_mutex);
-
-	auto iter = MemberMap.find(Name);
-	if (iter == MemberMap.end())
-		return false;
+	return ReadMemberTable([&](const MemberTable& table)
+		{
+			auto iter = table.Members.find(Name);
+			if (iter == table.Members.end())
+				return false;
 
-	int index = iter->second;
-	result = Members[index]->ID;
-	return true;
+			result = iter->second->ID;
+			return true;
+		});
 }
 
-mq::MQTypeMember* MQ2Type::FindMember(const char* Name)
+void MQ2Type::BuildMemberTable(MemberTable& table) const
 {
-	std::scoped_lock lock(m_mutex);
+	// the maps view these strings, so they can't be allowed to reallocate
+	table.Names.reserve(MemberMap.size() + MethodMap.size());
 
-	auto iter = MemberMap.find(Name);
-	if (iter == MemberMap.end())
-		return nullptr;
+	for (const auto& [name, index] : MemberMap)
+	{
+		table.Names.push_back(name);
+		table.Members.emplace(table.Names.back(), Members[index].get());
+	}
 
-	int index = MemberMap[Name];
-	return Members[index].get();
+	for (const auto& [name, index] : MethodMap)
+	{
+		table.Names.push_back(name);
+		table.Methods.emplace(table.Names.back(), Methods[index].get());
+	}
 }
 
-mq::MQTypeMember* MQ2Type::FindMember(const std::string& Name)
+void MQ2Type::RetireMember(std::unique_ptr<MQTypeMember> member)
 {
-	std::scoped_lock lock(m_mutex);
+	m_removedMembers.push_back(std::move(member));
+}
 
-	auto iter = MemberMap.find(Name);
-	if (iter == MemberMap.end())
-		return nullptr;
+std::unique_ptr<MQTypeMember> MQ2Type::ReviveMember(int ID, const char* Name, uint32_t Type)
+{
+	// Names are compared by address: the name of a retired member may belong to a plugin that has
+	// since been unloaded, so it can't be read.
+	for (auto iter = m_removedMembers.begin(); iter != m_removedMembers.end(); ++iter)
+	{
+		if ((*iter)->ID == ID && (*iter)->Type == Type && (*iter)->Name == Name)
+		{
+			std::unique_ptr<MQTypeMember> member = std::move(*iter);
+			m_removedMembers.erase(iter);
+			return member;
+		}
+	}
 
-	int index = MemberMap[Name];
-	return Members[index].get();
+	return std::make_unique<MQTypeMember>(ID, Name, Type);
 }
 
-mq::MQTypeMember* MQ2Type::FindMethod(const char* Name)
+mq::MQTypeMember* MQ2Type::FindMember(const char* Name)
 {
-	std::scoped_lock lock(m_mutex);
+	if (s_pendingMember.Owner == this && s_pendingMember.Member->Name == Name)
+		return s_pendingMember.Member->Type == 0 ? s_pendingMember.Member : nullptr;
 
-	auto iter = MethodMap.find(Name);
-	if (iter == MethodMap.end())
-		return nullptr;
+	return ReadMemberTable([Name](const MemberTable& table)
+		{
+			auto iter = table.Members.find(Name);
+			return iter != table.Members.end() ? iter->second : nullptr;
+		});
+}
 
-	int index = iter->second;
-	return Methods[index].get();
+mq::MQTypeMember* MQ2Type::FindMember(const std::string& Name)
+{
+	return ReadMemberTable([&Name](const MemberTable& table)
+		{
+			auto iter = table.Members.find(Name);
+			return iter != table.Members.end() ? iter->second : nullptr;
+		});
 }
 
-mq::MQTypeMember* MQ2Type::FindMethod(const std::string& Name)
+mq::MQTypeMember* MQ2Type::FindMethod(const char* Name)
 {
-	std::scoped_lock lock(m_mutex);
+	if (s_pendingMember.Owner == this && s_pendingMember.Member->Name == Name && s_pendingMember.Member->Type != 0)
+		return s_pendingMember.Member;
 
-	auto iter = MethodMap.find(Name);
-	if (iter == MethodMap.end())
-		return nullptr;
+	return ReadMemberTable([Name](const MemberTable& table)
+		{
+			auto iter = table.Methods.find(Name);
+			return iter != table.Methods.end() ? iter->second : nullptr;
+		});
+}
 
-	int index = iter->second;
-	return Methods[index].get();
+mq::MQTypeMember* MQ2Type::FindMethod(const std::string& Name)
+{
+	return ReadMemberTable([&Name](const MemberTable& table)
+		{
+			auto iter = table.Methods.find(Name);
+			return iter != table.Methods.end() ? iter->second : nullptr;
+		});
 }
 
 bool MQ2Type::CanEvaluateMethodOrMember(const std::string& Name)
 {
-	std::scoped_lock lock(m_mutex);
-
-	// exists in method map?
-	return MemberMap.count(Name) != 0 || MethodMap.count(Name) != 0;
+	// exists in member or method map?
+	return ReadMemberTable([&Name](const MemberTable& table)
+		{
+			return table.Members.count(Name) != 0 || table.Methods.count(Name) != 0;
+		});
 }
 
 bool MQ2Type::AddMember(int id, const char* Name)
@@ -1780,8 +1764,10 @@ bool MQ2Type::AddMember(int id, const char* Name)
 		index = static_cast<int>(Members.size()) - 1;
 	}
 
-	Members[index] = std::make_unique<MQTypeMember>(id, Name, 0);
+	Members[index] = ReviveMember(id, Name, 0);
 	MemberMap[Name] = index;
+	m_memberTables.Invalidate();
+	++s_macroDataRevision;
 	return true;
 }
 
@@ -1798,7 +1784,9 @@ bool MQ2Type::RemoveMember(const char* Name)
 
 	if (index < 0)
 		return false;
-	Members[index].reset();
+	RetireMember(std::move(Members[index]));
+	m_memberTables.Invalidate();
+	++s_macroDataRevision;
 	return true;
 }
 
@@ -1826,8 +1814,10 @@ bool MQ2Type::AddMethod(int ID, const char* Name)
 		index = static_cast<int>(Methods.size()) - 1;
 	}
 
-	Methods[index] = std::make_unique<MQTypeMember>(ID, Name, 1);
+	Methods[index] = ReviveMember(ID, Name, 1);
 	MethodMap[Name] = index;
+	m_memberTables.Invalidate();
+	++s_macroDataRevision;
 	return true;
 }
 
@@ -1844,7 +1834,9 @@ bool MQ2Type::RemoveMethod(const char* Name)
 
 	if (index < 0)
 		return false;
-	Methods[index].reset();
+	RetireMember(std::move(Methods[index]));
+	m_memberTables.Invalidate();
+	++s_macroDataRevision;
 	return true;
 }
 
@@ -1896,6 +1888,24 @@ bool FindMacroDataMember(MQ2Type* Type, const std::string& Member)
 	return pDataAPI->FindMacroDataMember(Type, Member);
 }
 
+uint32_t GetMacroDataRevision()
+{
+	return s_macroDataRevision;
+}
+
+bool ResolveMacroDataMember(MQ2Type* Type, const std::string& Member, MQResolvedMember& Result)
+{
+	return pDataAPI->ResolveMacroDataMember(Type, Member, Result);
+}
+
+int EvaluateResolvedMacroDataMember(const MQResolvedMember& Resolved, MQVarPtr VarPtr, MQTypeVar& Result,
+	const char* Member, char* pIndex)
+{
+	auto result = pDataAPI->EvaluateResolvedMember(Resolved, VarPtr, Result, Member, pIndex);
+
+	return MQDataAPI::EvaluateResultToInt(result);
+}
+
 //============================================================================
 
 SGlobalBuffer::SGlobalBuffer()
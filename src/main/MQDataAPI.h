@@ -21,6 +21,7 @@
 #include "mq/base/Common.h"
 #include "mq/base/PluginHandle.h"
 #include "mq/api/MacroAPI.h"
+#include "mq/base/LRUCache.h"
 
 #include <memory>
 #include <unordered_map>
@@ -29,6 +30,10 @@ namespace mq {
 
 //============================================================================
 
+struct MQCompiledDataExpression;
+struct MQCompiledMacroString;
+struct MQMacroStack;
+
 class MQDataAPI
 {
 public:
@@ -65,6 +70,10 @@ public:
 	EvaluateResult EvaluateMacroDataMember(MQ2Type* type, MQVarPtr& VarPtr, MQTypeVar& Result,
 		const std::string& Member, char* pIndex, bool checkFirst) const;
 
+	bool ResolveMacroDataMember(MQ2Type* type, const std::string& Member, MQResolvedMember& Result) const;
+	EvaluateResult EvaluateResolvedMember(const MQResolvedMember& Resolved, MQVarPtr& VarPtr, MQTypeVar& Result,
+		const char* Member, char* pIndex) const;
+
 	bool EvaluateDataExpression(MQTypeVar& Result, const char* pStart, char* pIndex, bool allowFunction = false) const;
 
 	static int EvaluateResultToInt(MQDataAPI::EvaluateResult result)
@@ -86,8 +95,18 @@ public:
 
 	bool ParseMQ2DataPortion(char* szOriginal, MQTypeVar& Result) const;
 
+	// Compiled expressions. Macro strings and data expressions are tokenized once and kept in a
+	// bounded cache keyed by their source text. Names are still resolved at evaluation time, so
+	// entries remain valid as plugins add and remove TLOs and types.
+	std::shared_ptr<const MQCompiledDataExpression> GetCompiledDataExpression(std::string_view source) const;
+	std::shared_ptr<const MQCompiledMacroString> GetCompiledMacroString(std::string_view source) const;
+
+	bool EvaluateCompiledDataExpression(const MQCompiledDataExpression& expr, MQTypeVar& Result) const;
+	std::string EvaluateCompiledMacroString(const MQCompiledMacroString& compiled, bool bParseOnce) const;
+
 private:
 	void RegisterTopLevelObjects();
+	bool ResolveExtensionMember(MQ2Type* type, const std::string& Member, MQResolvedMember& Result) const;
 
 	struct TLORec
 	{
@@ -111,6 +130,9 @@ private:
 	std::unordered_map<std::string, std::vector<ExtensionRec>> m_typeExtensions;
 
 	mutable std::recursive_mutex m_mutex;
+
+	mutable LRUCache<MQCompiledDataExpression> m_compiledExpressions{ 2048 };
+	mutable LRUCache<MQCompiledMacroString> m_compiledStrings{ 1024 };
 };
 
 extern MQDataAPI* pDataAPI;
@@ -129,6 +151,7 @@ bool AddMQ2DataVariableFromData(const char* Name, const char* Index, MQ2Type* pT
 MQDataVar** FindVariableScope(const char* Name);
 bool DeleteMQ2DataVariable(const char* Name);
 void ClearMQ2DataVariables(MQDataVar** ppHead);
+void IndexFrameVariables(MQMacroStack* pStack);
 
 
 } // namespace mq
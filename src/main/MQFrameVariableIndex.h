@@ -0,0 +1,93 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-present MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#pragma once
+
+#include <string_view>
+#include <unordered_map>
+
+namespace mq {
+
+// The parameters and local variables of a macro stack frame by name, so that looking one up doesn't
+// depend on how many the frame has. Keys are the variables' own szName, so nothing is copied.
+// Parameters take precedence over locals of the same name, and within a list the newest variable,
+// at the head, shadows older ones. Var is MQDataVar, or anything with szName and pNext.
+template <typename Var>
+class MQFrameVariableIndex
+{
+public:
+	Var* Find(std::string_view name) const
+	{
+		auto iter = m_variables.find(name);
+		return iter != m_variables.end() ? iter->second : nullptr;
+	}
+
+	void Clear()
+	{
+		m_variables.clear();
+	}
+
+	// Indexes both lists from scratch.
+	void Rebuild(Var* pParameters, Var* pLocals)
+	{
+		m_variables.clear();
+
+		// first one in wins
+		for (Var* pVar = pParameters; pVar; pVar = pVar->pNext)
+			m_variables.emplace(pVar->szName, pVar);
+		for (Var* pVar = pLocals; pVar; pVar = pVar->pNext)
+			m_variables.emplace(pVar->szName, pVar);
+	}
+
+	void Add(Var* pVar, bool isParameter)
+	{
+		if (isParameter)
+			m_variables[pVar->szName] = pVar;
+		else
+			m_variables.emplace(pVar->szName, pVar);
+	}
+
+	// Call before pVar is unlinked and deleted. A variable of the same name that it was shadowing
+	// takes its place.
+	void Remove(Var* pVar, Var* pParameters, Var* pLocals)
+	{
+		auto iter = m_variables.find(pVar->szName);
+		if (iter == m_variables.end() || iter->second != pVar)
+			return;
+
+		m_variables.erase(iter);
+
+		auto shadowed = [pVar](Var* pOther) -> Var*
+			{
+				for (; pOther; pOther = pOther->pNext)
+				{
+					if (pOther != pVar && std::string_view(pOther->szName) == pVar->szName)
+						return pOther;
+				}
+
+				return nullptr;
+			};
+
+		Var* pOther = shadowed(pParameters);
+		if (!pOther)
+			pOther = shadowed(pLocals);
+		if (pOther)
+			m_variables.emplace(pOther->szName, pOther);
+	}
+
+private:
+	std::unordered_map<std::string_view, Var*> m_variables;
+};
+
+} // namespace mq
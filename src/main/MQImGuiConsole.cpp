@@ -24,9 +24,11 @@
 
 #include "imgui/ImGuiTreePanelWindow.h"
 #include "mq/imgui/ConsoleWidget.h"
+#include "mq/base/BatchWriter.h"
 
 #include <imgui/imgui_internal.h>
 
+#include <deque>
 #include <optional>
 #include "sqlite3.h"
 
@@ -328,30 +330,105 @@ std::vector<std::string> InitConsoleDatabase(sqlite3*& db, int process_id)
 	return history;
 }
 
-void AddEntryToDatabase(sqlite3* db, int process_id, const char* entry)
+// Writes console history entries to the database. Entries are queued and written in batches by a
+// background thread so that the main thread never waits on the disk. If the thread can't be used,
+// entries are written as they are added.
+class ConsoleHistoryWriter
 {
-	if (db != nullptr)
+public:
+	ConsoleHistoryWriter(sqlite3* db, int process_id)
+		: m_db(db)
+		, m_processId(process_id)
 	{
-		const char* query = "INSERT INTO entries (entry_timestamp, pid, command) VALUES (strftime('%Y-%m-%d %H:%M:%f', 'now', 'localtime'), ?, ?);";
-		sqlite3_stmt* stmt;
-		if (sqlite3_prepare_v2(db, query, -1, &stmt, nullptr) != SQLITE_OK)
+		const char* query = "INSERT INTO entries (entry_timestamp, pid, command) VALUES (?, ?, ?);";
+		if (sqlite3_prepare_v2(m_db, query, -1, &m_insertStmt, nullptr) != SQLITE_OK)
 		{
-			WriteChatf("MQ Console Error preparing query for console buffer insertion: %s", sqlite3_errmsg(db));
+			WriteChatf("MQ Console Error preparing query for console buffer insertion: %s", sqlite3_errmsg(m_db));
+			m_insertStmt = nullptr;
+			return;
 		}
-		else
+
+		m_writer = std::make_unique<BatchWriter<Entry>>(
+			[this](const std::deque<Entry>& entries) { WriteEntries(entries); },
+			MaxQueuedEntries, sqlite3_threadsafe() != 0);
+	}
+
+	~ConsoleHistoryWriter()
+	{
+		// flushes anything that is still queued
+		m_writer.reset();
+
+		if (m_insertStmt)
 		{
-			sqlite3_bind_int(stmt, 1, process_id);
-			sqlite3_bind_text(stmt, 2, entry, -1, SQLITE_STATIC);
+			sqlite3_finalize(m_insertStmt);
+		}
+	}
 
-			if (sqlite3_step(stmt) != SQLITE_DONE)
+	void Add(const char* command)
+	{
+		if (m_writer)
+		{
+			m_writer->Add(Entry{ GetTimestamp(), command });
+		}
+	}
+
+private:
+	struct Entry
+	{
+		std::string timestamp;
+		std::string command;
+	};
+
+	static constexpr size_t MaxQueuedEntries = 4096;
+
+	// Matches strftime('%Y-%m-%d %H:%M:%f', 'now', 'localtime'), so entries sort the same as before.
+	static std::string GetTimestamp()
+	{
+		SYSTEMTIME time;
+		GetLocalTime(&time);
+
+		return fmt::format("{:04}-{:02}-{:02} {:02}:{:02}:{:02}.{:03}", time.wYear, time.wMonth, time.wDay,
+			time.wHour, time.wMinute, time.wSecond, time.wMilliseconds);
+	}
+
+	// Writes a batch of entries in a single transaction.
+	void WriteEntries(const std::deque<Entry>& entries)
+	{
+		if (entries.empty())
+			return;
+
+		sqlite3_exec(m_db, "BEGIN TRANSACTION;", nullptr, nullptr, nullptr);
+
+		for (const Entry& entry : entries)
+		{
+			sqlite3_bind_text(m_insertStmt, 1, entry.timestamp.c_str(), -1, SQLITE_STATIC);
+			sqlite3_bind_int(m_insertStmt, 2, m_processId);
+			sqlite3_bind_text(m_insertStmt, 3, entry.command.c_str(), -1, SQLITE_STATIC);
+
+			if (sqlite3_step(m_insertStmt) != SQLITE_DONE)
 			{
-				WriteChatf("MQ Console Error inserting into console buffer: %s", sqlite3_errmsg(db));
+				SPDLOG_ERROR("Console buffer insert failed: {}", sqlite3_errmsg(m_db));
 			}
 
-			sqlite3_finalize(stmt);
+			sqlite3_reset(m_insertStmt);
+		}
+
+		sqlite3_clear_bindings(m_insertStmt);
+
+		if (sqlite3_exec(m_db, "COMMIT;", nullptr, nullptr, nullptr) != SQLITE_OK)
+		{
+			SPDLOG_ERROR("Console buffer commit failed: {}", sqlite3_errmsg(m_db));
+			sqlite3_exec(m_db, "ROLLBACK;", nullptr, nullptr, nullptr);
 		}
 	}
-}
+
+	sqlite3* m_db;
+	int m_processId;
+	sqlite3_stmt* m_insertStmt = nullptr;
+
+	std::unique_ptr<BatchWriter<Entry>> m_writer;
+};
+
 //============================================================================
 
 #pragma region ImGui Console
@@ -363,6 +440,7 @@ public:
 	ImVector<const char*> m_commands;
 	std::vector<std::string> m_history;
 	sqlite3* m_db = nullptr;
+	std::unique_ptr<ConsoleHistoryWriter> m_historyWriter;
 	int current_pid = GetCurrentProcessId();
 	int m_historyPos = -1;    // -1: new line, 0..History.Size-1 browsing history.
 	bool m_scrollToBottom = true;
@@ -383,11 +461,20 @@ public:
 		int maxBufferLines = GetPrivateProfileInt("Console", "MaxBufferLines", m_zepConsole->GetMaxBufferLines(), internal_paths::MQini);
 		m_zepConsole->SetMaxBufferLines(maxBufferLines);
 		m_history = InitConsoleDatabase(m_db, current_pid);
+
+		if (m_db != nullptr)
+		{
+			m_historyWriter = std::make_unique<ConsoleHistoryWriter>(m_db, current_pid);
+		}
 	}
 
 	~MQConsole()
 	{
 		ClearLog();
+
+		// flushes any pending history before the database is closed
+		m_historyWriter.reset();
+
 		if (m_db != nullptr)
 		{
 			sqlite3_close(m_db);
@@ -593,7 +680,10 @@ public:
 			}
 		}
 		m_history.emplace_back(commandLine);
-		AddEntryToDatabase(m_db, current_pid, commandLine);
+		if (m_historyWriter)
+		{
+			m_historyWriter->Add(commandLine);
+		}
 
 		// Process command
 		if (ci_equals(commandLine, "clear"))
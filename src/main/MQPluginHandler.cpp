@@ -19,9 +19,11 @@
 
 #include <spdlog/spdlog.h>
 #include <wil/resource.h>
+#include <chrono>
 #include <random>
 
 #include "MQCommandAPI.h"
+#include "MQPulseScheduler.h"
 
 //#define DEBUG_PLUGINS
 
@@ -84,6 +86,15 @@ uint32_t bmCalculate = 0;
 uint32_t bmBeginZone = 0;
 uint32_t bmEndZone = 0;
 
+//----------------------------------------------------------------------------
+// Pulse tasks
+
+// Time that pulse tasks may take in a single pulse. The first task that is due always runs,
+// so a task that takes longer than this on its own still makes progress.
+static constexpr uint64_t PulseTaskFrameBudgetUS = 2000;
+
+static MQPulseScheduler s_pulseScheduler;
+
 //----------------------------------------------------------------------------
 // If true, imgui should not run on plugins.
 extern bool gbManualResetRequired;
@@ -639,6 +650,10 @@ static void ShutdownPlugin(const PluginInfoRec& rec)
 
 	// Perform any additional de-registration as required
 	pCommandAPI->OnPluginUnloaded(pPlugin, rec.handle);
+	{
+		std::scoped_lock lock(s_pluginsMutex);
+		s_pulseScheduler.RemoveOwnedBy(rec.handle.pluginID);
+	}
 }
 
 bool UnloadPlugin(std::string_view pluginName, bool save /* = false */)
@@ -855,6 +870,69 @@ bool PluginsIncomingChat(const char* Line, uint32_t Color)
 	return Ret;
 }
 
+static uint64_t GetPulseTaskTime()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void ReportPulseTask(const MQPulseScheduler::Task& task)
+{
+	WriteChatf("\arPulse task '%s' took %lluus, over its budget of %lluus. It will now run every %llums.",
+		task.name.c_str(), task.lastCost, task.budget, task.GetEffectiveInterval() / 1000);
+}
+
+// Wraps each run of a task in its own benchmark. The benchmark lives as long as the task.
+struct PulseTaskBenchmark
+{
+	explicit PulseTaskBenchmark(const char* name) : id(AddMQ2Benchmark(name)) {}
+	~PulseTaskBenchmark() { RemoveMQ2Benchmark(id); }
+
+	PulseTaskBenchmark(const PulseTaskBenchmark&) = delete;
+	PulseTaskBenchmark& operator=(const PulseTaskBenchmark&) = delete;
+
+	uint32_t id;
+};
+
+MQPulseTaskId AddPulseTask(std::string_view name, MQPulseTaskHandler handler, uint32_t intervalMS, uint32_t budgetUS,
+	const MQPluginHandle& pluginHandle)
+{
+	if (!handler || name.empty())
+		return 0;
+
+	std::scoped_lock lock(s_pluginsMutex);
+
+	MQPlugin* plugin = GetPluginByHandle(pluginHandle);
+	std::string taskName = fmt::format("{}:{}", plugin ? plugin->name : "unknown", name);
+
+	auto benchmark = std::make_shared<PulseTaskBenchmark>(taskName.c_str());
+	MQPulseTaskHandler task = [benchmark, handler = std::move(handler)]()
+	{
+		MQScopedBenchmark bm(benchmark->id);
+		handler();
+	};
+
+	return s_pulseScheduler.Add(std::move(taskName), std::move(task),
+		static_cast<uint64_t>(intervalMS) * 1000, budgetUS, pluginHandle.pluginID);
+}
+
+bool RemovePulseTask(MQPulseTaskId taskId, const MQPluginHandle& pluginHandle)
+{
+	std::scoped_lock lock(s_pluginsMutex);
+
+	return s_pulseScheduler.Remove(taskId, pluginHandle.pluginID);
+}
+
+MQPulseTaskId AddPulseTask(std::string_view name, MQPulseTaskHandler handler, uint32_t intervalMS, uint32_t budgetUS)
+{
+	return AddPulseTask(name, std::move(handler), intervalMS, budgetUS, mqplugin::ThisPluginHandle);
+}
+
+bool RemovePulseTask(MQPulseTaskId taskId)
+{
+	return RemovePulseTask(taskId, mqplugin::ThisPluginHandle);
+}
+
 void PulsePlugins()
 {
 	if (!s_pluginsInitialized)
@@ -873,6 +951,9 @@ void PulsePlugins()
 			if (plugin->Pulse)
 				plugin->Pulse();
 		});
+
+	std::scoped_lock lock(s_pluginsMutex);
+	s_pulseScheduler.Run(PulseTaskFrameBudgetUS, GetPulseTaskTime, ReportPulseTask);
 }
 
 void PluginsZoned()
@@ -1549,6 +1630,11 @@ void ShutdownPlugins()
 	s_pluginsInitialized = false;
 
 	UnloadPlugins();
+
+	{
+		std::scoped_lock lock(s_pluginsMutex);
+		s_pulseScheduler.Clear();
+	}
 	RemoveCommand("/plugin");
 }
 
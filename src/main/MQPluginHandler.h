@@ -18,7 +18,10 @@
 #error This header should only be included from the MQ2Main project
 #endif
 
+#include "mq/api/PluginAPI.h"
+
 #include <cstdint>
+#include <string_view>
 
 namespace eqlib
 {
@@ -54,4 +57,7 @@ void ModulesUpdateImGui();
 void PluginsMacroStart(const char* Name);
 void PluginsMacroStop(const char* Name);
 
+MQPulseTaskId AddPulseTask(std::string_view name, MQPulseTaskHandler handler, uint32_t intervalMS, uint32_t budgetUS, const MQPluginHandle& pluginHandle);
+bool RemovePulseTask(MQPulseTaskId taskId, const MQPluginHandle& pluginHandle);
+
 } // namespace mq
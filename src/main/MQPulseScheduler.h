@@ -0,0 +1,298 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-present MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace mq {
+
+// Runs periodic tasks from the pulse without letting them take more than a fixed amount of time
+// per pulse. Each task asks to run every interval and says how long one run should take. Run starts
+// the due tasks, most overdue first, and skips any task whose expected cost no longer fits in what
+// is left of the pulse's budget. Skipped tasks only become more overdue, so they are first in line
+// on the next pulse. The first task of a pulse always runs, so a task that costs more than the
+// whole budget still makes progress.
+//
+// Every run is timed. A task that goes over its own budget several runs in a row has its interval
+// doubled, up to MaxPenalty times, and is reported the first time that happens. Once it stays under
+// budget for a while the interval is relaxed again.
+//
+// Times are in microseconds, as returned by the clock passed to Run, so the scheduler can be driven
+// by a fake clock.
+class MQPulseScheduler
+{
+public:
+	using TaskId = uint32_t;
+	static constexpr TaskId InvalidTaskId = 0;
+
+	// a penalized task runs at most 8x less often than it asked for
+	static constexpr uint32_t MaxPenalty = 3;
+	static constexpr uint32_t OverrunsBeforePenalty = 3;
+	static constexpr uint32_t RunsBeforeRelief = 16;
+
+	// tasks that want to run every pulse are penalized relative to roughly one frame
+	static constexpr uint64_t MinPenaltyInterval = 16000;
+
+	struct Task
+	{
+		TaskId id = InvalidTaskId;
+		uint64_t owner = 0;
+		std::string name;
+		std::function<void()> handler;
+		uint64_t interval = 0;
+		uint64_t budget = 0;
+
+		uint64_t nextRun = 0;
+		uint64_t estimatedCost = 0;
+		uint64_t lastCost = 0;
+		uint64_t runCount = 0;
+		uint64_t overrunCount = 0;
+		uint32_t penalty = 0;
+		uint32_t consecutiveOverruns = 0;
+		uint32_t consecutiveUnderruns = 0;
+		bool reported = false;
+		bool removed = false;
+
+		uint64_t GetEffectiveInterval() const
+		{
+			if (penalty == 0)
+				return interval;
+
+			return std::max(interval, MinPenaltyInterval) << penalty;
+		}
+	};
+
+	// Adds a task that is due immediately. owner is an opaque value that RemoveOwnedBy matches against.
+	TaskId Add(std::string name, std::function<void()> handler, uint64_t interval, uint64_t budget, uint64_t owner = 0)
+	{
+		if (!handler)
+			return InvalidTaskId;
+
+		auto task = std::make_unique<Task>();
+		task->id = ++m_lastId;
+		task->owner = owner;
+		task->name = std::move(name);
+		task->handler = std::move(handler);
+		task->interval = interval;
+		task->budget = budget;
+		task->estimatedCost = budget;
+
+		m_tasks.push_back(std::move(task));
+		return m_tasks.back()->id;
+	}
+
+	bool Remove(TaskId id, uint64_t owner)
+	{
+		auto iter = std::find_if(m_tasks.begin(), m_tasks.end(),
+			[&](const auto& task) { return task->id == id && task->owner == owner && !task->removed; });
+		if (iter == m_tasks.end())
+			return false;
+
+		RemoveTask(iter);
+		return true;
+	}
+
+	// Removes every task with the given owner. Returns the number of tasks removed.
+	size_t RemoveOwnedBy(uint64_t owner)
+	{
+		size_t count = 0;
+
+		for (auto iter = m_tasks.begin(); iter != m_tasks.end();)
+		{
+			if ((*iter)->owner == owner && !(*iter)->removed)
+			{
+				++count;
+				iter = RemoveTask(iter);
+			}
+			else
+			{
+				++iter;
+			}
+		}
+
+		return count;
+	}
+
+	void Clear()
+	{
+		if (m_running)
+		{
+			for (auto& task : m_tasks)
+				MarkRemoved(*task);
+			m_hasRemoved = true;
+			return;
+		}
+
+		m_tasks.clear();
+	}
+
+	const Task* Find(TaskId id) const
+	{
+		auto iter = std::find_if(m_tasks.begin(), m_tasks.end(),
+			[&](const auto& task) { return task->id == id && !task->removed; });
+
+		return iter == m_tasks.end() ? nullptr : iter->get();
+	}
+
+	size_t Size() const { return m_tasks.size(); }
+	bool Empty() const { return m_tasks.empty(); }
+
+	// Runs the tasks that are due, spending at most frameBudget in them apart from the first one.
+	// clock() returns the current time and report(task) is called when a task is first throttled.
+	// Tasks may add or remove tasks, including themselves, while they run. Returns the number of
+	// tasks that ran.
+	template <typename Clock, typename Report>
+	uint32_t Run(uint64_t frameBudget, Clock&& clock, Report&& report)
+	{
+		if (m_running || m_tasks.empty())
+			return 0;
+
+		const uint64_t now = clock();
+
+		m_due.clear();
+		for (const auto& task : m_tasks)
+		{
+			if (task->nextRun <= now)
+				m_due.push_back(task.get());
+		}
+
+		if (m_due.empty())
+			return 0;
+
+		std::sort(m_due.begin(), m_due.end(), [](const Task* a, const Task* b)
+			{
+				return a->nextRun != b->nextRun ? a->nextRun < b->nextRun : a->id < b->id;
+			});
+
+		m_running = true;
+
+		uint64_t spent = 0;
+		uint32_t ran = 0;
+
+		for (Task* task : m_due)
+		{
+			if (task->removed)
+				continue;
+
+			if (ran > 0 && spent + task->estimatedCost > frameBudget)
+				continue;
+
+			const uint64_t started = clock();
+			m_current = task;
+			task->handler();
+			m_current = nullptr;
+			const uint64_t finished = clock();
+			const uint64_t cost = finished > started ? finished - started : 0;
+
+			spent += cost;
+			++ran;
+
+			UpdateTask(*task, started, cost, report);
+		}
+
+		m_running = false;
+		m_due.clear();
+
+		if (m_hasRemoved)
+		{
+			m_tasks.erase(std::remove_if(m_tasks.begin(), m_tasks.end(),
+				[](const auto& task) { return task->removed; }), m_tasks.end());
+			m_hasRemoved = false;
+		}
+
+		return ran;
+	}
+
+private:
+	using TaskList = std::vector<std::unique_ptr<Task>>;
+
+	// A task can't be destroyed while Run is using it, it might be the one that is running.
+	TaskList::iterator RemoveTask(TaskList::iterator iter)
+	{
+		if (m_running)
+		{
+			MarkRemoved(**iter);
+			m_hasRemoved = true;
+			return ++iter;
+		}
+
+		return m_tasks.erase(iter);
+	}
+
+	// The task itself stays until Run is done with it, but its handler is destroyed right away
+	// unless it is the one running. Handlers belong to plugins, and a task that unloads a plugin
+	// must not leave that plugin's handlers behind to be destroyed after the plugin is gone.
+	void MarkRemoved(Task& task)
+	{
+		task.removed = true;
+
+		if (&task != m_current)
+			task.handler = nullptr;
+	}
+
+	template <typename Report>
+	static void UpdateTask(Task& task, uint64_t started, uint64_t cost, Report& report)
+	{
+		++task.runCount;
+		task.lastCost = cost;
+		task.estimatedCost = (task.estimatedCost * 3 + cost) / 4;
+
+		if (cost > task.budget)
+		{
+			++task.overrunCount;
+			task.consecutiveUnderruns = 0;
+
+			if (++task.consecutiveOverruns >= OverrunsBeforePenalty && task.penalty < MaxPenalty)
+			{
+				++task.penalty;
+				task.consecutiveOverruns = 0;
+
+				if (!task.reported)
+				{
+					task.reported = true;
+					report(static_cast<const Task&>(task));
+				}
+			}
+		}
+		else
+		{
+			task.consecutiveOverruns = 0;
+
+			if (task.penalty > 0 && ++task.consecutiveUnderruns >= RunsBeforeRelief)
+			{
+				--task.penalty;
+				task.consecutiveUnderruns = 0;
+			}
+		}
+
+		// scheduled from when the task actually ran, so a late run doesn't cause a burst of catch up runs
+		task.nextRun = started + task.GetEffectiveInterval();
+	}
+
+	TaskId m_lastId = InvalidTaskId;
+	TaskList m_tasks;
+	std::vector<Task*> m_due;
+	Task* m_current = nullptr;
+	bool m_running = false;
+	bool m_hasRemoved = false;
+};
+
+} // namespace mq
@@ -0,0 +1,345 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-present MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+namespace mq {
+
+// A uniform grid over the x/y plane used to answer nearest and radius queries without visiting
+// every item. Items are kept up to date incrementally: Update moves an item only when it changes
+// cells, and Refresh re-reads every position without touching the items that stayed put.
+template <typename T>
+class MQSpatialGrid
+{
+public:
+	explicit MQSpatialGrid(float cellSize = 100.0f)
+		: m_cellSize(cellSize)
+	{
+	}
+
+	// Inserts an item, or moves it to its new position. Returns true if the item was inserted.
+	bool Update(const T& item, float x, float y)
+	{
+		const uint64_t cell = GetCellKey(x, y);
+
+		auto iter = m_records.find(item);
+		if (iter == m_records.end())
+		{
+			auto& entries = m_cells[cell];
+			m_records.emplace(item, Record{ cell, static_cast<uint32_t>(entries.size()) });
+			entries.push_back({ item, x, y });
+
+			ExtendBounds(x, y);
+			return true;
+		}
+
+		Record& record = iter->second;
+
+		if (record.cell == cell)
+		{
+			Entry& entry = m_cells[cell][record.index];
+			entry.x = x;
+			entry.y = y;
+			return false;
+		}
+
+		RemoveFromCell(record);
+
+		auto& entries = m_cells[cell];
+		record.cell = cell;
+		record.index = static_cast<uint32_t>(entries.size());
+		entries.push_back({ item, x, y });
+
+		ExtendBounds(x, y);
+		return false;
+	}
+
+	bool Remove(const T& item)
+	{
+		auto iter = m_records.find(item);
+		if (iter == m_records.end())
+			return false;
+
+		RemoveFromCell(iter->second);
+		m_records.erase(iter);
+		return true;
+	}
+
+	bool Contains(const T& item) const
+	{
+		return m_records.find(item) != m_records.end();
+	}
+
+	void Clear()
+	{
+		m_cells.clear();
+		m_records.clear();
+		m_hasBounds = false;
+	}
+
+	size_t Size() const { return m_records.size(); }
+	bool Empty() const { return m_records.empty(); }
+
+	// Re-reads the position of every item with getPosition(item, x, y) and moves the ones that
+	// changed cells. Items that stayed in their cell are updated in place.
+	template <typename GetPosition>
+	void Refresh(GetPosition&& getPosition)
+	{
+		m_moved.clear();
+
+		for (auto& [key, entries] : m_cells)
+		{
+			for (Entry& entry : entries)
+			{
+				getPosition(entry.item, entry.x, entry.y);
+
+				if (GetCellKey(entry.x, entry.y) != key)
+					m_moved.push_back(entry);
+			}
+		}
+
+		// moving items can add cells, so it waits until we're done iterating them
+		for (const Entry& entry : m_moved)
+			Update(entry.item, entry.x, entry.y);
+	}
+
+	// Calls callback(item, x, y) for every item within radius of (x, y) on the x/y plane.
+	template <typename Callback>
+	void ForEachInRadius(float x, float y, float radius, Callback&& callback) const
+	{
+		if (m_records.empty())
+			return;
+
+		const float radiusSq = radius * radius;
+		const int minX = std::max(ToCell(x - radius), m_minCellX);
+		const int maxX = std::min(ToCell(x + radius), m_maxCellX);
+		const int minY = std::max(ToCell(y - radius), m_minCellY);
+		const int maxY = std::min(ToCell(y + radius), m_maxCellY);
+
+		// a radius that covers more cells than are occupied is cheaper to answer by visiting all of them
+		if (static_cast<int64_t>(maxX - minX + 1) * (maxY - minY + 1) > static_cast<int64_t>(m_cells.size()))
+		{
+			for (const auto& [key, entries] : m_cells)
+			{
+				for (const Entry& entry : entries)
+				{
+					if (DistanceSquared(x, y, entry) <= radiusSq)
+						callback(entry.item, entry.x, entry.y);
+				}
+			}
+			return;
+		}
+
+		for (int cellY = minY; cellY <= maxY; ++cellY)
+		{
+			for (int cellX = minX; cellX <= maxX; ++cellX)
+			{
+				auto iter = m_cells.find(MakeCellKey(cellX, cellY));
+				if (iter == m_cells.end())
+					continue;
+
+				for (const Entry& entry : iter->second)
+				{
+					if (DistanceSquared(x, y, entry) <= radiusSq)
+						callback(entry.item, entry.x, entry.y);
+				}
+			}
+		}
+	}
+
+	// Visits items in square rings of cells around (x, y), nearest rings first, calling
+	// visit(item). After each ring, done(minDistance) is called with a lower bound on the x/y
+	// distance of every item not yet visited. The search stops when it returns true, or when
+	// every item has been visited, in which case done is called with infinity.
+	template <typename Visitor, typename Done>
+	void VisitNearest(float x, float y, Visitor&& visit, Done&& done) const
+	{
+		constexpr float infinity = std::numeric_limits<float>::infinity();
+
+		if (m_records.empty())
+		{
+			done(infinity);
+			return;
+		}
+
+		const int centerX = ToCell(x);
+		const int centerY = ToCell(y);
+
+		// the largest ring that can contain an item
+		const int maxRing = std::max({
+			std::abs(centerX - m_minCellX), std::abs(m_maxCellX - centerX),
+			std::abs(centerY - m_minCellY), std::abs(m_maxCellY - centerY)
+		});
+
+		auto visitCell = [&](int cellX, int cellY)
+		{
+			auto iter = m_cells.find(MakeCellKey(cellX, cellY));
+			if (iter == m_cells.end())
+				return;
+
+			for (const Entry& entry : iter->second)
+				visit(entry.item);
+		};
+
+		size_t cellsVisited = 0;
+
+		for (int ring = 0; ring <= maxRing; ++ring)
+		{
+			if (ring == 0)
+			{
+				visitCell(centerX, centerY);
+				++cellsVisited;
+			}
+			else
+			{
+				for (int dx = -ring; dx <= ring; ++dx)
+				{
+					visitCell(centerX + dx, centerY - ring);
+					visitCell(centerX + dx, centerY + ring);
+				}
+
+				for (int dy = -ring + 1; dy < ring; ++dy)
+				{
+					visitCell(centerX - ring, centerY + dy);
+					visitCell(centerX + ring, centerY + dy);
+				}
+
+				cellsVisited += 8 * ring;
+			}
+
+			// every cell outside of this ring is at least this far away
+			if (done(ring * m_cellSize))
+				return;
+
+			// once we've probed more cells than are occupied, finish with a single pass over the rest
+			if (cellsVisited > m_cells.size() && ring < maxRing)
+			{
+				for (const auto& [key, entries] : m_cells)
+				{
+					const int cellX = static_cast<int32_t>(key >> 32);
+					const int cellY = static_cast<int32_t>(key & 0xffffffff);
+
+					if (std::max(std::abs(cellX - centerX), std::abs(cellY - centerY)) <= ring)
+						continue;
+
+					for (const Entry& entry : entries)
+						visit(entry.item);
+				}
+
+				break;
+			}
+		}
+
+		done(infinity);
+	}
+
+private:
+	struct Entry
+	{
+		T item;
+		float x;
+		float y;
+	};
+
+	struct Record
+	{
+		uint64_t cell;
+		uint32_t index;
+	};
+
+	// Cell coordinates are clamped well inside of int so that a huge radius (or position) can't
+	// overflow the cast, or the ring arithmetic done with the result.
+	static constexpr float MaxCell = static_cast<float>(1 << 29);
+
+	int ToCell(float value) const
+	{
+		return static_cast<int>(std::clamp(std::floor(value / m_cellSize), -MaxCell, MaxCell));
+	}
+
+	static uint64_t MakeCellKey(int cellX, int cellY)
+	{
+		return (static_cast<uint64_t>(static_cast<uint32_t>(cellX)) << 32) | static_cast<uint32_t>(cellY);
+	}
+
+	uint64_t GetCellKey(float x, float y) const
+	{
+		return MakeCellKey(ToCell(x), ToCell(y));
+	}
+
+	static float DistanceSquared(float x, float y, const Entry& entry)
+	{
+		const float dx = entry.x - x;
+		const float dy = entry.y - y;
+		return dx * dx + dy * dy;
+	}
+
+	void RemoveFromCell(const Record& record)
+	{
+		auto cellIter = m_cells.find(record.cell);
+		auto& entries = cellIter->second;
+
+		// swap the last entry into the removed slot
+		if (record.index != entries.size() - 1)
+		{
+			entries[record.index] = std::move(entries.back());
+			m_records[entries[record.index].item].index = record.index;
+		}
+
+		entries.pop_back();
+
+		if (entries.empty())
+			m_cells.erase(cellIter);
+	}
+
+	// Bounds only ever grow until the grid is cleared. They limit how far searches go.
+	void ExtendBounds(float x, float y)
+	{
+		const int cellX = ToCell(x);
+		const int cellY = ToCell(y);
+
+		if (!m_hasBounds)
+		{
+			m_minCellX = m_maxCellX = cellX;
+			m_minCellY = m_maxCellY = cellY;
+			m_hasBounds = true;
+			return;
+		}
+
+		m_minCellX = std::min(m_minCellX, cellX);
+		m_maxCellX = std::max(m_maxCellX, cellX);
+		m_minCellY = std::min(m_minCellY, cellY);
+		m_maxCellY = std::max(m_maxCellY, cellY);
+	}
+
+	float m_cellSize;
+
+	std::unordered_map<uint64_t, std::vector<Entry>> m_cells;
+	std::unordered_map<T, Record> m_records;
+	std::vector<Entry> m_moved;
+
+	bool m_hasBounds = false;
+	int m_minCellX = 0;
+	int m_maxCellX = 0;
+	int m_minCellY = 0;
+	int m_maxCellY = 0;
+};
+
+} // namespace mq
@@ -21,6 +21,7 @@
 #include "Actor.pb.h"
 
 #include "LuaActor.h"
+#include "LuaActorWire.h"
 #include "LuaThread.h"
 #include "LuaCoroutine.h"
 
@@ -40,119 +41,35 @@ using namespace mq::postoffice;
 
 namespace messaging = proto::lua::actor;
 
-sol::object DeserializeProto(const messaging::Variant& data, sol::state_view s)
-{
-	switch (data.value_case())
-	{
-	case messaging::Variant::ValueCase::kNumber:
-		return sol::make_object(s, data.number());
-	case messaging::Variant::ValueCase::kBoolean:
-		return sol::make_object(s, data.boolean());
-	case messaging::Variant::ValueCase::kStr:
-		return sol::make_object(s, data.str());
-	case messaging::Variant::ValueCase::kTable:
-	{
-		if (data.has_table())
-		{
-			auto table = s.create_table(0, static_cast<int>(data.table().entries().size() + data.table().arr().size()));
-
-			for (const auto& [k, v] : data.table().entries())
-			{
-				table[k] = DeserializeProto(v, s);
-			}
-
-			for (const auto& [k, v] : data.table().arr())
-			{
-				table[k] = DeserializeProto(v, s);
-			}
-
-			return sol::make_object(s, table);
-		}
-		
-		return sol::lua_nil;
-	}
-	case messaging::Variant::ValueCase::kImvec2:
-		return sol::make_object(s, ImVec2(
-			data.imvec2().x(),
-			data.imvec2().y()));
-	case messaging::Variant::ValueCase::kImvec4:
-		return sol::make_object(s, ImVec4(
-			data.imvec4().x(),
-			data.imvec4().y(),
-			data.imvec4().z(),
-			data.imvec4().w()
-		));
-	default:
-		return sol::nil;
-	}
+// LuaActorWire.h writes and reads the payload messages by hand, with its own copy of the field numbers
+static_assert(wire::fields::Variant::kNumberFieldNumber == messaging::Variant::kNumberFieldNumber);
+static_assert(wire::fields::Variant::kBooleanFieldNumber == messaging::Variant::kBooleanFieldNumber);
+static_assert(wire::fields::Variant::kStrFieldNumber == messaging::Variant::kStrFieldNumber);
+static_assert(wire::fields::Variant::kTableFieldNumber == messaging::Variant::kTableFieldNumber);
+static_assert(wire::fields::Variant::kImvec2FieldNumber == messaging::Variant::kImvec2FieldNumber);
+static_assert(wire::fields::Variant::kImvec4FieldNumber == messaging::Variant::kImvec4FieldNumber);
+static_assert(wire::fields::Table::kEntriesFieldNumber == messaging::Table::kEntriesFieldNumber);
+static_assert(wire::fields::Table::kArrFieldNumber == messaging::Table::kArrFieldNumber);
+static_assert(wire::fields::Vec::kXFieldNumber == messaging::ImVec4::kXFieldNumber && wire::fields::Vec::kXFieldNumber == messaging::ImVec2::kXFieldNumber);
+static_assert(wire::fields::Vec::kYFieldNumber == messaging::ImVec4::kYFieldNumber && wire::fields::Vec::kYFieldNumber == messaging::ImVec2::kYFieldNumber);
+static_assert(wire::fields::Vec::kZFieldNumber == messaging::ImVec4::kZFieldNumber);
+static_assert(wire::fields::Vec::kWFieldNumber == messaging::ImVec4::kWFieldNumber);
+
+// The returned buffer is reused by the next call. It only needs to live until the payload is
+// posted, which copies it into the envelope.
+const std::string& SerializePayload(const sol::object& data)
+{
+	static std::string s_buffer;
+
+	s_buffer.clear();
+	wire::Write(s_buffer, data);
+
+	return s_buffer;
 }
 
-messaging::Variant SerializeProto(const sol::object& data)
+sol::object DeserializePayload(std::string_view data, sol::state_view s)
 {
-	messaging::Variant variant;
-
-	switch (data.get_type())
-	{
-	case sol::type::string:
-		variant.set_str(data.as<std::string>());
-		break;
-	case sol::type::number:
-		variant.set_number(data.as<double>());
-		break;
-	case sol::type::boolean:
-		variant.set_boolean(data.as<bool>());
-		break;
-	case sol::type::table:
-	{
-		messaging::Table table;
-		google::protobuf::Map<std::string, messaging::Variant> entries;
-		google::protobuf::Map<uint32_t, messaging::Variant> arr;
-		for (const auto& [k, v] : data.as<sol::table>())
-		{
-			// a limitation of proto: keys can't be messages, so we have to limit it here
-			if (k.is<std::string_view>())
-			{
-				entries[k.as<std::string_view>()] = SerializeProto(v);
-			}
-			else if (k.is<uint32_t>())
-			{
-				arr[k.as<uint32_t>()] = SerializeProto(v);
-			}
-		}
-
-		if (!entries.empty())
-			*table.mutable_entries() = entries;
-
-		if (!arr.empty())
-			*table.mutable_arr() = arr;
-
-		if (!entries.empty() || !arr.empty())
-			*variant.mutable_table() = table;
-		break;
-	}
-	case sol::type::userdata:
-		if (data.is<ImVec2>())
-		{
-			auto vec = data.as<ImVec2>();
-			*variant.mutable_imvec2() = messaging::ImVec2();
-			(*variant.mutable_imvec2()).set_x(vec.x);
-			(*variant.mutable_imvec2()).set_y(vec.y);
-		}
-		else if (data.is<ImVec4>())
-		{
-			auto vec = data.as<ImVec4>();
-			*variant.mutable_imvec4() = messaging::ImVec4();
-			(*variant.mutable_imvec4()).set_x(vec.x);
-			(*variant.mutable_imvec4()).set_y(vec.y);
-			(*variant.mutable_imvec4()).set_z(vec.z);
-			(*variant.mutable_imvec4()).set_w(vec.w);
-		}
-		break;
-	default:
-		break;
-	}
-
-	return variant;
+	return wire::Read(data, s);
 }
 
 
@@ -166,20 +83,17 @@ struct LuaMessage
 {
 	const LuaDropbox* const dropbox;
 	std::shared_ptr<Message> message;
-	messaging::Variant data;
-	bool has_data = false;
 
 	LuaMessage(const LuaDropbox* const dropbox_, const std::shared_ptr<Message>& message_)
 		: dropbox(dropbox_)
 		, message(message_)
 	{
-		has_data = message && message->Payload && data.ParseFromString(*message->Payload);
 	}
 
 	sol::object Get(sol::this_state s)
 	{
-		if (has_data)
-			return DeserializeProto(data, s);
+		if (message && message->Payload)
+			return DeserializePayload(*message->Payload, s);
 
 		return sol::lua_nil;
 	}
@@ -428,7 +342,7 @@ void LuaDropbox::Send(sol::object payload) const
 
 void LuaDropbox::Send(sol::table header, sol::object payload) const
 {
-	m_dropbox.Post(ParseHeader(header), SerializeProto(payload));
+	m_dropbox.Post(ParseHeader(header), SerializePayload(payload));
 }
 
 void LuaDropbox::Send(sol::object payload, sol::function response_callback)
@@ -440,19 +354,18 @@ void LuaDropbox::Send(sol::table header, sol::object payload, sol::function resp
 {
 	// need to create the callback instance before response_callback goes out of scope in lua
 	auto callback = std::make_unique<CallbackInstance>(m_parentThread, response_callback, LuaMessage(this, nullptr));
-	m_dropbox.Post(ParseHeader(header), SerializeProto(payload),
+	m_dropbox.Post(ParseHeader(header), SerializePayload(payload),
 		[callback = callback.release(), this](int status, const std::shared_ptr<Message>& message)
 		{
 			callback->m_status = status;
 			callback->m_message.message = message;
-			callback->m_message.has_data = message && message->Payload && callback->m_message.data.ParseFromString(*message->Payload);
 			m_queue.push_back(std::unique_ptr<CallbackInstance>(callback));
 		});
 }
 
 void LuaDropbox::Reply(const std::shared_ptr<Message>& message, const sol::object& reply, int status) const
 {
-	m_dropbox.PostReply(message, SerializeProto(reply), static_cast<uint8_t>(status));
+	m_dropbox.PostReply(message, SerializePayload(reply), static_cast<uint8_t>(status));
 }
 
 void LuaDropbox::Receive(const std::shared_ptr<Message>& message)
@@ -497,7 +410,7 @@ void Send(sol::object payload)
 void Send(sol::table header, sol::object payload)
 {
 	auto thread = LuaThread::get_from(header.lua_state());
-	postoffice::SendToActor(LuaDropbox::ParseHeader(header, thread, thread ? thread->GetName() : ""), SerializeProto(payload));
+	postoffice::SendToActor(LuaDropbox::ParseHeader(header, thread, thread ? thread->GetName() : ""), SerializePayload(payload));
 }
 
 void Send(sol::object payload, sol::function response_callback)
@@ -512,12 +425,11 @@ void Send(sol::table header, sol::object payload, sol::function response_callbac
 	if (thread)
 	{
 		auto callback = std::make_unique<CallbackInstance>(thread->GetLuaThread(), response_callback, LuaMessage(nullptr, nullptr));
-		postoffice::SendToActor(LuaDropbox::ParseHeader(header, thread, thread->GetName()), SerializeProto(payload),
+		postoffice::SendToActor(LuaDropbox::ParseHeader(header, thread, thread->GetName()), SerializePayload(payload),
 			[callback = callback.release()](int status, const std::shared_ptr<Message>& message)
 			{
 				callback->m_status = status;
 				callback->m_message.message = message;
-				callback->m_message.has_data = message && message->Payload && callback->m_message.data.ParseFromString(*message->Payload);
 				s_queue.push_back(std::unique_ptr<CallbackInstance>(callback));
 			});
 	}
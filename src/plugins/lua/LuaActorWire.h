@@ -0,0 +1,570 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-present MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#pragma once
+
+#include <sol/sol.hpp>
+
+#include "imgui.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+// Actor payloads are Variant messages from Actor.proto. They are written straight from lua values
+// into the protobuf wire format, and read straight back into lua values, rather than going through
+// the generated message classes. That avoids building a copy of every table as a tree of messages
+// on both ends. The bytes are the same as what the generated code reads and writes.
+
+namespace mq::lua::wire {
+
+// Field numbers of the messages in Actor.proto. LuaActor.cpp checks them against the generated code.
+namespace fields {
+
+struct Variant
+{
+	static constexpr uint32_t kNumberFieldNumber = 1;
+	static constexpr uint32_t kBooleanFieldNumber = 5;
+	static constexpr uint32_t kStrFieldNumber = 8;
+	static constexpr uint32_t kTableFieldNumber = 10;
+	static constexpr uint32_t kImvec2FieldNumber = 11;
+	static constexpr uint32_t kImvec4FieldNumber = 12;
+};
+
+struct Table
+{
+	static constexpr uint32_t kEntriesFieldNumber = 1;
+	static constexpr uint32_t kArrFieldNumber = 2;
+};
+
+// ImVec2 and ImVec4 share their field numbers
+struct Vec
+{
+	static constexpr uint32_t kXFieldNumber = 1;
+	static constexpr uint32_t kYFieldNumber = 2;
+	static constexpr uint32_t kZFieldNumber = 3;
+	static constexpr uint32_t kWFieldNumber = 4;
+};
+
+} // namespace fields
+
+enum WireType : uint32_t
+{
+	Varint = 0,
+	Fixed64 = 1,
+	LengthDelimited = 2,
+	Fixed32 = 5,
+};
+
+// map entries are messages with the key and value as fields 1 and 2
+constexpr uint32_t MapKeyField = 1;
+constexpr uint32_t MapValueField = 2;
+
+// nested messages get room for the largest length we write, and are moved back once it is known
+constexpr size_t MaxLengthBytes = 5;
+
+// same as the default recursion limit of the protobuf parser
+constexpr int MaxDepth = 100;
+
+// The tables that are being written, outermost first. A table that contains itself is written
+// as nil where it repeats, so self references can't multiply the output.
+using TablePath = std::vector<const void*>;
+
+inline size_t EncodeVarint(uint64_t value, char* buffer)
+{
+	size_t length = 0;
+	while (value >= 0x80)
+	{
+		buffer[length++] = static_cast<char>(value | 0x80);
+		value >>= 7;
+	}
+	buffer[length++] = static_cast<char>(value);
+
+	return length;
+}
+
+inline void WriteVarint(std::string& out, uint64_t value)
+{
+	char buffer[10];
+	out.append(buffer, EncodeVarint(value, buffer));
+}
+
+inline void WriteTag(std::string& out, uint32_t field, WireType type)
+{
+	WriteVarint(out, (field << 3) | type);
+}
+
+template <typename T>
+inline void WriteFixed(std::string& out, T value)
+{
+	static_assert(std::is_trivially_copyable_v<T>);
+
+	// the wire format is little endian, same as us
+	char buffer[sizeof(T)];
+	memcpy(buffer, &value, sizeof(T));
+	out.append(buffer, sizeof(T));
+}
+
+inline void WriteBytes(std::string& out, uint32_t field, std::string_view bytes)
+{
+	WriteTag(out, field, LengthDelimited);
+	WriteVarint(out, bytes.length());
+	out.append(bytes);
+}
+
+inline size_t BeginMessage(std::string& out, uint32_t field)
+{
+	WriteTag(out, field, LengthDelimited);
+
+	const size_t position = out.size();
+	out.append(MaxLengthBytes, '\0');
+	return position;
+}
+
+inline void EndMessage(std::string& out, size_t position)
+{
+	char buffer[MaxLengthBytes];
+	const size_t length = EncodeVarint(out.size() - position - MaxLengthBytes, buffer);
+
+	out.erase(position + length, MaxLengthBytes - length);
+	memcpy(&out[position], buffer, length);
+}
+
+inline void WriteVariant(std::string& out, const sol::object& data, TablePath& path);
+
+inline void WriteTable(std::string& out, const sol::table& table, TablePath& path)
+{
+	using fields::Table;
+
+	path.push_back(table.pointer());
+
+	const size_t start = out.size();
+	const size_t position = BeginMessage(out, fields::Variant::kTableFieldNumber);
+
+	for (const auto& [k, v] : table)
+	{
+		// a limitation of proto: keys can't be messages, so we have to limit it here
+		if (k.is<std::string_view>())
+		{
+			const size_t entry = BeginMessage(out, Table::kEntriesFieldNumber);
+			WriteBytes(out, MapKeyField, k.as<std::string_view>());
+
+			const size_t value = BeginMessage(out, MapValueField);
+			WriteVariant(out, v, path);
+			EndMessage(out, value);
+
+			EndMessage(out, entry);
+		}
+		else if (k.is<uint32_t>())
+		{
+			const size_t entry = BeginMessage(out, Table::kArrFieldNumber);
+			WriteTag(out, MapKeyField, Varint);
+			WriteVarint(out, k.as<uint32_t>());
+
+			const size_t value = BeginMessage(out, MapValueField);
+			WriteVariant(out, v, path);
+			EndMessage(out, value);
+
+			EndMessage(out, entry);
+		}
+	}
+
+	// empty tables have always been sent as nil
+	if (out.size() == position + MaxLengthBytes)
+		out.resize(start);
+	else
+		EndMessage(out, position);
+
+	path.pop_back();
+}
+
+inline void WriteVariant(std::string& out, const sol::object& data, TablePath& path)
+{
+	using fields::Variant;
+
+	switch (data.get_type())
+	{
+	case sol::type::string:
+		WriteBytes(out, Variant::kStrFieldNumber, data.as<std::string_view>());
+		break;
+	case sol::type::number:
+		WriteTag(out, Variant::kNumberFieldNumber, Fixed64);
+		WriteFixed(out, data.as<double>());
+		break;
+	case sol::type::boolean:
+		WriteTag(out, Variant::kBooleanFieldNumber, Varint);
+		WriteVarint(out, data.as<bool>() ? 1 : 0);
+		break;
+	case sol::type::table:
+		if (path.size() < MaxDepth)
+		{
+			sol::table table = data.as<sol::table>();
+
+			if (std::find(path.begin(), path.end(), table.pointer()) == path.end())
+				WriteTable(out, table, path);
+		}
+		break;
+	case sol::type::userdata:
+		if (data.is<ImVec2>())
+		{
+			auto vec = data.as<ImVec2>();
+			const size_t position = BeginMessage(out, Variant::kImvec2FieldNumber);
+			WriteTag(out, fields::Vec::kXFieldNumber, Fixed32);
+			WriteFixed(out, vec.x);
+			WriteTag(out, fields::Vec::kYFieldNumber, Fixed32);
+			WriteFixed(out, vec.y);
+			EndMessage(out, position);
+		}
+		else if (data.is<ImVec4>())
+		{
+			auto vec = data.as<ImVec4>();
+			const size_t position = BeginMessage(out, Variant::kImvec4FieldNumber);
+			WriteTag(out, fields::Vec::kXFieldNumber, Fixed32);
+			WriteFixed(out, vec.x);
+			WriteTag(out, fields::Vec::kYFieldNumber, Fixed32);
+			WriteFixed(out, vec.y);
+			WriteTag(out, fields::Vec::kZFieldNumber, Fixed32);
+			WriteFixed(out, vec.z);
+			WriteTag(out, fields::Vec::kWFieldNumber, Fixed32);
+			WriteFixed(out, vec.w);
+			EndMessage(out, position);
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+//----------------------------------------------------------------------------
+
+class Reader
+{
+public:
+	explicit Reader(std::string_view data) : m_data(data) {}
+
+	bool AtEnd() const { return m_data.empty(); }
+
+	bool ReadVarint(uint64_t& value)
+	{
+		value = 0;
+		for (uint32_t shift = 0; shift < 64 && !m_data.empty(); shift += 7)
+		{
+			const uint8_t byte = static_cast<uint8_t>(m_data.front());
+			m_data.remove_prefix(1);
+
+			value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+			if ((byte & 0x80) == 0)
+				return true;
+		}
+
+		return false;
+	}
+
+	bool ReadTag(uint32_t& field, uint32_t& type)
+	{
+		uint64_t tag;
+		if (!ReadVarint(tag) || (tag >> 3) == 0 || (tag >> 3) > UINT32_MAX)
+			return false;
+
+		field = static_cast<uint32_t>(tag >> 3);
+		type = static_cast<uint32_t>(tag & 7);
+		return true;
+	}
+
+	template <typename T>
+	bool ReadFixed(T& value)
+	{
+		if (m_data.length() < sizeof(T))
+			return false;
+
+		memcpy(&value, m_data.data(), sizeof(T));
+		m_data.remove_prefix(sizeof(T));
+		return true;
+	}
+
+	bool ReadBytes(std::string_view& bytes)
+	{
+		uint64_t length;
+		if (!ReadVarint(length) || length > m_data.length())
+			return false;
+
+		bytes = m_data.substr(0, static_cast<size_t>(length));
+		m_data.remove_prefix(static_cast<size_t>(length));
+		return true;
+	}
+
+	// fields we don't know are skipped, like the generated code would
+	bool Skip(uint32_t type)
+	{
+		uint64_t varint;
+		std::string_view bytes;
+		uint32_t fixed32;
+		uint64_t fixed64;
+
+		switch (type)
+		{
+		case Varint: return ReadVarint(varint);
+		case Fixed64: return ReadFixed(fixed64);
+		case LengthDelimited: return ReadBytes(bytes);
+		case Fixed32: return ReadFixed(fixed32);
+		default: return false;
+		}
+	}
+
+private:
+	std::string_view m_data;
+};
+
+inline bool ReadVariant(std::string_view data, sol::state_view s, int depth, sol::object& result);
+
+template <typename Vec>
+inline bool ReadVec(std::string_view data, Vec& vec)
+{
+	// the components are fields 1 to 4, in order
+	float* components[] = { &vec.x, &vec.y, nullptr, nullptr };
+	if constexpr (std::is_same_v<Vec, ImVec4>)
+	{
+		components[2] = &vec.z;
+		components[3] = &vec.w;
+	}
+
+	Reader reader(data);
+	while (!reader.AtEnd())
+	{
+		uint32_t field, type;
+		if (!reader.ReadTag(field, type))
+			return false;
+
+		if (type == Fixed32 && field <= 4 && components[field - 1] != nullptr)
+		{
+			if (!reader.ReadFixed(*components[field - 1]))
+				return false;
+		}
+		else if (!reader.Skip(type))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+template <typename Key>
+inline bool ReadMapEntry(std::string_view data, sol::table& table, sol::state_view s, int depth)
+{
+	Key key{};
+	sol::object value = sol::lua_nil;
+
+	Reader reader(data);
+	while (!reader.AtEnd())
+	{
+		uint32_t field, type;
+		if (!reader.ReadTag(field, type))
+			return false;
+
+		if (field == MapKeyField && type == (std::is_same_v<Key, uint32_t> ? Varint : LengthDelimited))
+		{
+			if constexpr (std::is_same_v<Key, uint32_t>)
+			{
+				uint64_t number;
+				if (!reader.ReadVarint(number))
+					return false;
+				key = static_cast<uint32_t>(number);
+			}
+			else
+			{
+				if (!reader.ReadBytes(key))
+					return false;
+			}
+		}
+		else if (field == MapValueField && type == LengthDelimited)
+		{
+			std::string_view bytes;
+			if (!reader.ReadBytes(bytes) || !ReadVariant(bytes, s, depth + 1, value))
+				return false;
+		}
+		else if (!reader.Skip(type))
+		{
+			return false;
+		}
+	}
+
+	table.raw_set(key, value);
+	return true;
+}
+
+inline bool ReadTable(std::string_view data, sol::state_view s, int depth, sol::object& result)
+{
+	using fields::Table;
+
+	// count the entries first, so that the table is created with the right size
+	int arrCount = 0, entriesCount = 0;
+	Reader counter(data);
+	while (!counter.AtEnd())
+	{
+		uint32_t field, type;
+		if (!counter.ReadTag(field, type) || !counter.Skip(type))
+			return false;
+
+		if (field == Table::kArrFieldNumber)
+			++arrCount;
+		else if (field == Table::kEntriesFieldNumber)
+			++entriesCount;
+	}
+
+	sol::table table = s.create_table(arrCount, entriesCount);
+
+	Reader reader(data);
+	while (!reader.AtEnd())
+	{
+		uint32_t field, type;
+		std::string_view bytes;
+		if (!reader.ReadTag(field, type))
+			return false;
+
+		if (field == Table::kEntriesFieldNumber && type == LengthDelimited)
+		{
+			if (!reader.ReadBytes(bytes) || !ReadMapEntry<std::string_view>(bytes, table, s, depth))
+				return false;
+		}
+		else if (field == Table::kArrFieldNumber && type == LengthDelimited)
+		{
+			if (!reader.ReadBytes(bytes) || !ReadMapEntry<uint32_t>(bytes, table, s, depth))
+				return false;
+		}
+		else if (!reader.Skip(type))
+		{
+			return false;
+		}
+	}
+
+	result = table;
+	return true;
+}
+
+inline bool ReadVariant(std::string_view data, sol::state_view s, int depth, sol::object& result)
+{
+	using fields::Variant;
+
+	if (depth > MaxDepth)
+		return false;
+
+	// when more than one of the values is present, the last one wins
+	result = sol::lua_nil;
+
+	Reader reader(data);
+	while (!reader.AtEnd())
+	{
+		uint32_t field, type;
+		if (!reader.ReadTag(field, type))
+			return false;
+
+		std::string_view bytes;
+		bool handled = true;
+
+		switch (field)
+		{
+		case Variant::kNumberFieldNumber:
+			if (type == Fixed64)
+			{
+				double number;
+				if (!reader.ReadFixed(number))
+					return false;
+				result = sol::make_object(s, number);
+			}
+			else handled = false;
+			break;
+		case Variant::kBooleanFieldNumber:
+			if (type == Varint)
+			{
+				uint64_t boolean;
+				if (!reader.ReadVarint(boolean))
+					return false;
+				result = sol::make_object(s, boolean != 0);
+			}
+			else handled = false;
+			break;
+		case Variant::kStrFieldNumber:
+			if (type == LengthDelimited)
+			{
+				if (!reader.ReadBytes(bytes))
+					return false;
+				result = sol::make_object(s, bytes);
+			}
+			else handled = false;
+			break;
+		case Variant::kTableFieldNumber:
+			if (type == LengthDelimited)
+			{
+				if (!reader.ReadBytes(bytes) || !ReadTable(bytes, s, depth, result))
+					return false;
+			}
+			else handled = false;
+			break;
+		case Variant::kImvec2FieldNumber:
+			if (type == LengthDelimited)
+			{
+				ImVec2 vec;
+				if (!reader.ReadBytes(bytes) || !ReadVec(bytes, vec))
+					return false;
+				result = sol::make_object(s, vec);
+			}
+			else handled = false;
+			break;
+		case Variant::kImvec4FieldNumber:
+			if (type == LengthDelimited)
+			{
+				ImVec4 vec;
+				if (!reader.ReadBytes(bytes) || !ReadVec(bytes, vec))
+					return false;
+				result = sol::make_object(s, vec);
+			}
+			else handled = false;
+			break;
+		default:
+			handled = false;
+			break;
+		}
+
+		if (!handled && !reader.Skip(type))
+			return false;
+	}
+
+	return true;
+}
+
+//----------------------------------------------------------------------------
+
+// Appends data to out as a Variant message.
+inline void Write(std::string& out, const sol::object& data)
+{
+	TablePath path;
+	WriteVariant(out, data, path);
+}
+
+// Reads a Variant message. Malformed data reads as nil, like data the generated code fails to parse.
+inline sol::object Read(std::string_view data, sol::state_view s)
+{
+	sol::object result;
+	if (ReadVariant(data, s, 0, result))
+		return result;
+
+	return sol::lua_nil;
+}
+
+} // namespace mq::lua::wire
@@ -0,0 +1,374 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-present MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "pch.h"
+#include "LuaBytecodeCache.h"
+
+#include <fmt/format.h>
+#include <sol/sol.hpp>
+#include <luajit.h>
+
+#include <fstream>
+
+namespace mq::lua {
+
+static uint64_t HashChunk(std::string_view chunkName, std::string_view source)
+{
+	// FNV-1a. The chunk name is part of the key because it is compiled into the bytecode, and
+	// error messages from a shared chunk would otherwise name the wrong file.
+	uint64_t hash = 14695981039346656037ull;
+
+	auto add = [&hash](std::string_view data)
+	{
+		for (char ch : data)
+		{
+			hash ^= static_cast<uint8_t>(ch);
+			hash *= 1099511628211ull;
+		}
+	};
+
+	add(chunkName);
+	add(std::string_view("\0", 1));
+	add(source);
+
+	return hash;
+}
+
+static bool ReadFileContents(const std::filesystem::path& path, uintmax_t size, std::string& contents)
+{
+	std::ifstream stream(path, std::ios::binary);
+	if (!stream.is_open())
+		return false;
+
+	contents.resize(static_cast<size_t>(size));
+	stream.read(contents.data(), static_cast<std::streamsize>(size));
+
+	// the file changed while we were reading it
+	return static_cast<uintmax_t>(stream.gcount()) == size && stream.peek() == std::char_traits<char>::eof();
+}
+
+// Cache files start with this, followed by a line each for the LuaJIT build, the hash of the
+// source and the chunk name, and then the bytecode.
+static constexpr std::string_view s_cacheFileMagic = "MQLJBC 1\n";
+
+static std::string MakeCacheFileHeader(uint64_t hash, const std::string& chunkName)
+{
+	return fmt::format("{}{} {}-bit\n{:016x}\n{}\n", s_cacheFileMagic, LUAJIT_VERSION, sizeof(void*) * 8, hash, chunkName);
+}
+
+static int WriteBytecode(lua_State*, const void* data, size_t size, void* userData)
+{
+	static_cast<std::string*>(userData)->append(static_cast<const char*>(data), size);
+	return 0;
+}
+
+//============================================================================
+
+LuaBytecodeCache& LuaBytecodeCache::Get()
+{
+	static LuaBytecodeCache s_instance;
+	return s_instance;
+}
+
+int LuaBytecodeCache::LoadFile(lua_State* L, const char* path)
+{
+	namespace fs = std::filesystem;
+
+	std::error_code ec;
+	const fs::path filePath{ path };
+
+	const fs::file_time_type lastWriteTime = fs::last_write_time(filePath, ec);
+	const uintmax_t size = ec ? 0 : fs::file_size(filePath, ec);
+
+	// let lua report whatever is wrong with the file
+	if (ec)
+		return luaL_loadfile(L, path);
+
+	const std::string chunkName = fmt::format("@{}", path);
+
+	if (std::optional<uint64_t> hash = FindHash(path, lastWriteTime, size))
+	{
+		if (LoadChunk(L, *hash, chunkName))
+			return 0;
+	}
+
+	std::string source;
+	if (!ReadFileContents(filePath, size, source))
+		return luaL_loadfile(L, path);
+
+	const uint64_t hash = HashChunk(chunkName, source);
+	SetHash(path, lastWriteTime, size, hash);
+
+	if (LoadChunk(L, hash, chunkName))
+		return 0;
+
+	const int status = luaL_loadbuffer(L, source.data(), source.size(), chunkName.c_str());
+	if (status != 0)
+		return status;
+
+	// a file that is already bytecode has nothing to gain from the cache
+	if (!source.empty() && source[0] == '\x1b')
+		return status;
+
+	++m_misses;
+
+	std::string bytecode;
+	if (lua_dump(L, WriteBytecode, &bytecode) == 0 && !bytecode.empty())
+	{
+		StoreChunk(hash, chunkName, std::move(bytecode));
+	}
+
+	return status;
+}
+
+std::optional<uint64_t> LuaBytecodeCache::FindHash(const std::string& path, std::filesystem::file_time_type lastWriteTime, uintmax_t size)
+{
+	std::scoped_lock lock(m_mutex);
+
+	auto iter = m_paths.find(path);
+	if (iter == m_paths.end() || iter->second.lastWriteTime != lastWriteTime || iter->second.size != size)
+		return std::nullopt;
+
+	return iter->second.hash;
+}
+
+void LuaBytecodeCache::SetHash(const std::string& path, std::filesystem::file_time_type lastWriteTime, uintmax_t size, uint64_t hash)
+{
+	std::scoped_lock lock(m_mutex);
+
+	m_paths.insert_or_assign(path, PathRecord{ lastWriteTime, size, hash });
+}
+
+LRUCache<LuaBytecodeCache::Chunk>::value_ptr LuaBytecodeCache::FindChunk(uint64_t hash, const std::string& chunkName)
+{
+	const std::string key = fmt::format("{:016x}", hash);
+
+	if (auto chunk = m_chunks.Find(key))
+	{
+		++m_memoryHits;
+		return chunk;
+	}
+
+	std::filesystem::path cacheFile = GetCacheFilePath(chunkName);
+	if (cacheFile.empty())
+		return nullptr;
+
+	std::error_code ec;
+	const uintmax_t size = std::filesystem::file_size(cacheFile, ec);
+	if (ec || size == 0)
+		return nullptr;
+
+	std::string contents;
+	if (!ReadFileContents(cacheFile, size, contents))
+		return nullptr;
+
+	// Left by another build of LuaJIT, or compiled from an older version of the script
+	const std::string header = MakeCacheFileHeader(hash, chunkName);
+	if (contents.size() <= header.size() || contents.compare(0, header.size(), header) != 0)
+		return nullptr;
+
+	auto chunk = std::make_shared<Chunk>();
+	chunk->bytecode = contents.substr(header.size());
+
+	++m_fileHits;
+	return m_chunks.Insert(key, std::move(chunk));
+}
+
+bool LuaBytecodeCache::LoadChunk(lua_State* L, uint64_t hash, const std::string& chunkName)
+{
+	auto chunk = FindChunk(hash, chunkName);
+	if (!chunk)
+		return false;
+
+	// A damaged cache file fails to load here. The caller then compiles the source again, which
+	// replaces the bad entry.
+	if (luaL_loadbuffer(L, chunk->bytecode.data(), chunk->bytecode.size(), chunkName.c_str()) != 0)
+	{
+		lua_pop(L, 1);
+		return false;
+	}
+
+	return true;
+}
+
+void LuaBytecodeCache::StoreChunk(uint64_t hash, const std::string& chunkName, std::string bytecode)
+{
+	auto chunk = std::make_shared<Chunk>();
+	chunk->bytecode = std::move(bytecode);
+
+	m_chunks.Insert(fmt::format("{:016x}", hash), chunk);
+
+	std::filesystem::path cacheFile = GetCacheFilePath(chunkName);
+	if (cacheFile.empty())
+		return;
+
+	// written to the side and renamed over the old file, so that another process never reads a
+	// partial file
+	std::filesystem::path tempFile = cacheFile;
+	tempFile += fmt::format(".{}.tmp", reinterpret_cast<uintptr_t>(chunk.get()));
+
+	{
+		std::ofstream stream(tempFile, std::ios::binary | std::ios::trunc);
+		if (!stream.is_open())
+			return;
+
+		const std::string header = MakeCacheFileHeader(hash, chunkName);
+		stream.write(header.data(), static_cast<std::streamsize>(header.size()));
+		stream.write(chunk->bytecode.data(), static_cast<std::streamsize>(chunk->bytecode.size()));
+		if (!stream.good())
+		{
+			stream.close();
+
+			std::error_code ec;
+			std::filesystem::remove(tempFile, ec);
+			return;
+		}
+	}
+
+	std::error_code ec;
+	std::filesystem::rename(tempFile, cacheFile, ec);
+	if (ec)
+		std::filesystem::remove(tempFile, ec);
+}
+
+std::filesystem::path LuaBytecodeCache::GetCacheFilePath(const std::string& chunkName) const
+{
+	if (m_cacheDirectory.empty())
+		return {};
+
+	return m_cacheDirectory / fmt::format("{:016x}.ljbc", HashChunk(chunkName, {}));
+}
+
+// Removes files that aren't cache files in the current format, including temporary files left
+// behind by a crash. Files that belong to scripts that no longer exist are small and stay.
+void LuaBytecodeCache::RemoveUnknownCacheFiles() const
+{
+	std::error_code ec;
+	for (const auto& entry : std::filesystem::directory_iterator(m_cacheDirectory, ec))
+	{
+		if (!entry.is_regular_file(ec))
+			continue;
+
+		const std::filesystem::path& path = entry.path();
+		if (path.extension() != ".ljbc" && path.extension() != ".tmp")
+			continue;
+
+		if (path.extension() == ".ljbc")
+		{
+			std::string magic(s_cacheFileMagic.size(), '\0');
+
+			std::ifstream stream(path, std::ios::binary);
+			stream.read(magic.data(), static_cast<std::streamsize>(magic.size()));
+
+			if (stream.gcount() == static_cast<std::streamsize>(magic.size()) && magic == s_cacheFileMagic)
+				continue;
+		}
+
+		std::filesystem::remove(path, ec);
+	}
+}
+
+void LuaBytecodeCache::SetCacheDirectory(const std::string& directory)
+{
+	m_cacheDirectory.clear();
+
+	if (directory.empty())
+		return;
+
+	std::error_code ec;
+	if (!std::filesystem::exists(directory, ec) && !std::filesystem::create_directories(directory, ec))
+		return;
+
+	m_cacheDirectory = directory;
+	RemoveUnknownCacheFiles();
+}
+
+void LuaBytecodeCache::Clear()
+{
+	m_chunks.Clear();
+
+	std::scoped_lock lock(m_mutex);
+	m_paths.clear();
+}
+
+LuaBytecodeCache::Stats LuaBytecodeCache::GetStats() const
+{
+	Stats stats;
+	stats.memoryHits = m_memoryHits;
+	stats.fileHits = m_fileHits;
+	stats.misses = m_misses;
+	return stats;
+}
+
+//============================================================================
+
+// Mirrors the standard Lua file searcher: find the module on package.path, then load it. The
+// package table and the original package.searchpath are upvalues 1 and 2.
+/*static*/ int LuaBytecodeCache::lua_CachedFileLoader(lua_State* L)
+{
+	luaL_checkstring(L, 1);
+
+	lua_getfield(L, lua_upvalueindex(1), "path");
+	if (!lua_isstring(L, -1))
+		return luaL_error(L, "'package.path' must be a string");
+
+	lua_pushvalue(L, lua_upvalueindex(2));
+	lua_pushvalue(L, 1);
+	lua_pushvalue(L, -3);
+	lua_call(L, 2, 2);
+
+	// not found, return the list of files that were tried
+	if (lua_isnil(L, -2))
+		return 1;
+
+	lua_pop(L, 1);
+	const char* fileName = lua_tostring(L, -1);
+
+	if (Get().LoadFile(L, fileName) != 0)
+	{
+		return luaL_error(L, "error loading module '%s' from file '%s':\n\t%s",
+			lua_tostring(L, 1), fileName, lua_tostring(L, -1));
+	}
+
+	return 1;
+}
+
+/*static*/ void LuaBytecodeCache::InstallPackageLoader(lua_State* L)
+{
+	lua_getglobal(L, "package");
+	if (!lua_istable(L, -1))
+	{
+		lua_pop(L, 1);
+		return;
+	}
+
+	lua_getfield(L, -1, "loaders");
+	lua_getfield(L, -2, "searchpath");
+
+	if (!lua_istable(L, -2) || !lua_isfunction(L, -1))
+	{
+		lua_pop(L, 3);
+		return;
+	}
+
+	// the Lua file searcher is the second entry, after package.preload
+	lua_pushvalue(L, -3);
+	lua_pushvalue(L, -2);
+	lua_pushcclosure(L, lua_CachedFileLoader, 2);
+	lua_rawseti(L, -3, 2);
+
+	lua_pop(L, 3);
+}
+
+} // namespace mq::lua
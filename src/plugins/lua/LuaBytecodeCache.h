@@ -0,0 +1,103 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-present MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#pragma once
+
+#include <mq/base/LRUCache.h>
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+struct lua_State;
+
+namespace mq::lua {
+
+// Compiled bytecode of Lua source files, shared by every script that loads them. Chunks are keyed
+// by a hash of the file's contents and its chunk name, so running the same script again, or from
+// another character, loads the bytecode instead of parsing and compiling the source. Each path
+// remembers the last write time and size it had when it was hashed, so an unchanged file isn't
+// even read again.
+//
+// When a cache directory is set, chunks are also written there, and survive reloading the plugin.
+// There is one file per script, overwritten when the script changes, with a header that records the
+// LuaJIT build and the hash of the source it was compiled from. A file whose header doesn't match is
+// compiled again.
+class LuaBytecodeCache
+{
+public:
+	static LuaBytecodeCache& Get();
+
+	// Loads a Lua file as a chunk and pushes it onto the stack. Behaves like luaL_loadfile: returns
+	// 0 on success, otherwise an error code with the error message pushed instead.
+	int LoadFile(lua_State* L, const char* path);
+
+	// Replaces the standard Lua file searcher in package.loaders with one that loads through
+	// this cache. Must be called on a state with the package library open.
+	static void InstallPackageLoader(lua_State* L);
+
+	// An empty directory keeps the cache in memory only.
+	void SetCacheDirectory(const std::string& directory);
+
+	void Clear();
+
+	struct Stats
+	{
+		uint32_t memoryHits = 0;
+		uint32_t fileHits = 0;
+		uint32_t misses = 0;
+	};
+	Stats GetStats() const;
+
+private:
+	struct Chunk
+	{
+		std::string bytecode;
+	};
+
+	struct PathRecord
+	{
+		std::filesystem::file_time_type lastWriteTime;
+		uintmax_t size = 0;
+		uint64_t hash = 0;
+	};
+
+	std::optional<uint64_t> FindHash(const std::string& path, std::filesystem::file_time_type lastWriteTime, uintmax_t size);
+	void SetHash(const std::string& path, std::filesystem::file_time_type lastWriteTime, uintmax_t size, uint64_t hash);
+
+	LRUCache<Chunk>::value_ptr FindChunk(uint64_t hash, const std::string& chunkName);
+	bool LoadChunk(lua_State* L, uint64_t hash, const std::string& chunkName);
+	void StoreChunk(uint64_t hash, const std::string& chunkName, std::string bytecode);
+
+	std::filesystem::path GetCacheFilePath(const std::string& chunkName) const;
+	void RemoveUnknownCacheFiles() const;
+
+	static int lua_CachedFileLoader(lua_State* L);
+
+	LRUCache<Chunk> m_chunks{ 256 };
+
+	std::mutex m_mutex;
+	std::unordered_map<std::string, PathRecord> m_paths;
+	std::filesystem::path m_cacheDirectory;
+
+	std::atomic<uint32_t> m_memoryHits{ 0 };
+	std::atomic<uint32_t> m_fileHits{ 0 };
+	std::atomic<uint32_t> m_misses{ 0 };
+};
+
+} // namespace mq::lua
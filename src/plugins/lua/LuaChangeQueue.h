@@ -0,0 +1,95 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-present MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace mq::lua {
+
+// Collects the spawns or ground items that were added and removed since the last pulse, for the
+// threads that keep a table of them. Changes are only recorded while a thread is subscribed, and are
+// handed to every subscriber at once. Each id keeps only its latest change, nullptr meaning that
+// it was removed.
+template <typename Subscriber, typename T>
+class LuaChangeQueue
+{
+public:
+	using Changes = std::unordered_map<uint32_t, T*>;
+
+	void Subscribe(Subscriber* subscriber)
+	{
+		if (std::find(m_subscribers.begin(), m_subscribers.end(), subscriber) == m_subscribers.end())
+			m_subscribers.push_back(subscriber);
+	}
+
+	void Unsubscribe(Subscriber* subscriber)
+	{
+		m_subscribers.erase(std::remove(m_subscribers.begin(), m_subscribers.end(), subscriber), m_subscribers.end());
+
+		if (m_subscribers.empty())
+			m_changes.clear();
+	}
+
+	void Added(uint32_t id, T* item)
+	{
+		m_owners[id] = item;
+
+		if (!m_subscribers.empty())
+			m_changes[id] = item;
+	}
+
+	void Removed(uint32_t id, T* item)
+	{
+		// An item that took over the id in the meantime stays, even if it was already delivered.
+		// Items that were added before the queue existed have no owner entry, and are removed.
+		auto iter = m_owners.find(id);
+		if (iter != m_owners.end())
+		{
+			if (iter->second != item)
+				return;
+
+			m_owners.erase(iter);
+		}
+
+		if (!m_subscribers.empty())
+			m_changes[id] = nullptr;
+	}
+
+	// Calls deliver(subscriber, changes) for every subscriber, if anything changed.
+	template <typename Callback>
+	void Deliver(Callback&& deliver)
+	{
+		if (m_changes.empty())
+			return;
+
+		for (Subscriber* subscriber : m_subscribers)
+			deliver(*subscriber, m_changes);
+
+		m_changes.clear();
+	}
+
+private:
+	std::vector<Subscriber*> m_subscribers;
+	Changes m_changes;
+
+	// the latest item added with each id, kept whether or not anyone is subscribed, so that a
+	// thread that subscribes later isn't handed the removal of an item that lost its id
+	std::unordered_map<uint32_t, T*> m_owners;
+};
+
+} // namespace mq::lua
@@ -80,6 +80,11 @@ public:
 	std::vector<std::string> luaRequirePaths;
 	std::vector<std::string> dllRequirePaths;
 
+	// How often, in milliseconds, the condition of a waiting mq.delay is called. The default of 0 calls
+	// it every frame. Running binds or events wakes the condition early, since they are what it usually
+	// waits on.
+	uint32_t delayConditionInterval = 0;
+
 private:
 	bool GetScriptLocationInfo(std::string_view script, const std::string& searchDir, ScriptLocationInfo& info) const;
 	bool GetScriptPath(std::string_view script, const std::string& searchDir, ScriptLocationInfo& info) const;
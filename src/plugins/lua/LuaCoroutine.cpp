@@ -156,15 +156,13 @@ void LuaCoroutine::SetDelay(uint64_t time, std::optional<sol::function> conditio
 	{
 		luaThread->DoYield();
 		//lua_yield(coroutine.lua_state(), 0); // only yield from the current coroutine
-		m_delayTime = time;
-		m_delayCondition = condition;
+		m_delay.Start(MQGetTickCount64(), time, std::move(condition), luaThread->GetDelayConditionInterval());
 	}
 }
 
 void LuaCoroutine::ClearDelay()
 {
-	m_delayTime = 0L;
-	m_delayCondition = std::nullopt;
+	m_delay.Clear();
 }
 
 bool LuaCoroutine::ShouldRun()
@@ -174,14 +172,9 @@ bool LuaCoroutine::ShouldRun()
 		return false;
 	}
 
-	// check delayed status
-	if (m_delayTime <= MQGetTickCount64() || CheckCondition(m_delayCondition))
-	{
-		ClearDelay();
-		return true;
-	}
-
-	return false;
+	// check delayed status. Calling the condition means entering lua, so it is only done as often as configured
+	return m_delay.IsOver(MQGetTickCount64(), luaThread->GetDelayConditionInterval(),
+		[this](std::optional<sol::function>& condition) { return CheckCondition(condition); });
 }
 
 } // namespace mq::lua
@@ -15,6 +15,7 @@
 #pragma once
 
 #include "LuaCommon.h"
+#include "LuaDelay.h"
 
 #include <sol/sol.hpp>
 
@@ -28,14 +29,20 @@ struct LuaCoroutine
 
 	sol::coroutine coroutine;
 	sol::thread thread;
-	uint64_t m_delayTime = 0L;
-	std::optional<sol::function> m_delayCondition = std::nullopt;
+	LuaDelay m_delay;
 
 	bool CheckCondition(std::optional<sol::function>& func);
 	void Delay(sol::object delayObj, std::optional<sol::object> conditionObj, sol::state_view s);
 	void SetDelay(uint64_t time, std::optional<sol::function> condition = std::nullopt);
 	void ClearDelay();
 
+	// Makes a waiting delay call its condition on the next frame, regardless of the poll interval.
+	void Wake() { m_delay.Wake(); }
+
+	// True while a delay is waiting and nothing would change that at the given time, so the
+	// coroutine can be skipped without entering lua.
+	bool IsWaiting(uint64_t now) const { return m_delay.IsWaiting(now); }
+
 	bool ShouldRun();
 	CoroutineResult RunCoroutine();
 	CoroutineResult RunCoroutine(const std::vector<std::string>& args);
@@ -0,0 +1,87 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-present MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#pragma once
+
+#include <sol/sol.hpp>
+
+#include <cstdint>
+#include <optional>
+
+namespace mq::lua {
+
+// The wait of an mq.delay: the time at which it ends, and optionally a condition that can end it
+// sooner. Calling the condition means entering lua, so it is only called once every condition
+// interval, or on the next check after Wake. Times are in milliseconds and are passed in by the
+// caller, so nothing here reads the clock.
+class LuaDelay
+{
+public:
+	// Starts waiting until time. The caller has just checked the condition.
+	void Start(uint64_t now, uint64_t time, std::optional<sol::function> condition, uint32_t conditionInterval)
+	{
+		m_time = time;
+		m_condition = std::move(condition);
+		m_nextConditionCheck = now + conditionInterval;
+	}
+
+	void Clear()
+	{
+		m_time = 0L;
+		m_nextConditionCheck = 0L;
+		m_condition = std::nullopt;
+	}
+
+	// Makes a waiting delay call its condition on the next check, regardless of the interval.
+	void Wake() { m_nextConditionCheck = 0L; }
+
+	// True while the delay is waiting and nothing would change that at the given time, so the
+	// coroutine can be skipped without entering lua.
+	bool IsWaiting(uint64_t now) const
+	{
+		return m_time > now && (!m_condition || m_nextConditionCheck > now);
+	}
+
+	// Returns true, and clears the delay, once it is over. checkCondition(std::optional<sol::function>&)
+	// is only called when the condition is due.
+	template <typename CheckCondition>
+	bool IsOver(uint64_t now, uint32_t conditionInterval, CheckCondition&& checkCondition)
+	{
+		if (m_time <= now)
+		{
+			Clear();
+			return true;
+		}
+
+		if (m_condition && m_nextConditionCheck <= now)
+		{
+			m_nextConditionCheck = now + conditionInterval;
+
+			if (checkCondition(m_condition))
+			{
+				Clear();
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+private:
+	uint64_t m_time = 0L;
+	uint64_t m_nextConditionCheck = 0L;
+	std::optional<sol::function> m_condition = std::nullopt;
+};
+
+} // namespace mq::lua
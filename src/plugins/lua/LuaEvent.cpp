@@ -39,8 +39,6 @@ static unsigned int CALLBACK LuaVarProcess(char* VarName, char* Value, size_t Va
 
 LuaEventProcessor::LuaEventProcessor(LuaThread* thread)
 	: m_thread(thread)
-	, m_blech(std::make_unique<Blech>('#', '|', LuaVarProcess))
-	, m_blechStripped(std::make_unique<Blech>('#', '|', LuaVarProcess))
 {
 }
 
@@ -117,87 +115,14 @@ bool LuaEventProcessor::RemoveBind(std::string_view name)
 	return false;
 }
 
-void LuaEventProcessor::Process(std::string_view line)
+void LuaEventProcessor::HandleBlechEvent(LuaEvent* pEvent, const char* line, BLECHVALUE* pValues)
 {
-	if (!m_thread->IsValid())
-		return;
-	if (m_eventDefinitions.empty())
+	// events are matched for every script, only the ones that are running take them
+	if (!m_thread->IsValid() || m_thread->IsPaused())
 		return;
-	if (line.size() >= MAX_STRING)
-		return;
-
-	char line_char[MAX_STRING] = { 0 };
-	char line_char_stripped[MAX_STRING] = { 0 };
-
-	m_currentLineStripped = nullptr;
-	m_currentLine = nullptr;
-
-	// Split event handling by whether we have links in the string or not. If there are no links in
-	// the string then this is much simpler.
-	if (line.find_first_of('\x12') == std::string::npos)
-	{
-		StripMQChat(line, line_char);
-
-		m_currentLineStripped = line_char;
-		m_currentLine = line_char;
-	}
-	else
-	{
-		// We have links in the string. Do the minimal amount of work required based on what kinds of
-		// events have been registered.
-
-		// Check if we need to keep both the stripped and unstripped links.
-		if (!m_blech->IsEmpty() && !m_blechStripped->IsEmpty())
-		{
-			StripMQChat(line, line_char);
-			m_currentLine = line_char;
 
-			CXStr line_str(line);
-			line_str = CleanItemTags(line_str, false);
-			StripMQChat(line_str, line_char_stripped);
-			m_currentLineStripped = line_char_stripped;
-		}
-		else if (!m_blech->IsEmpty())
-		{
-			StripMQChat(line, line_char);
-
-			m_currentLine = line_char;
-			m_currentLineStripped = line_char;
-		}
-		else if (!m_blechStripped->IsEmpty())
-		{
-			CXStr line_str(line);
-			line_str = CleanItemTags(line_str, false);
-			StripMQChat(line_str, line_char_stripped);
-
-			m_currentLineStripped = line_char_stripped;
-			m_currentLine = line_char_stripped;
-		}
-	}
-
-	// since we initialized to 0, we know that any remaining members will be 0, so just in case we
-	// get an overflow, re-set the last character to 0
-	line_char[MAX_STRING - 1] = 0;
-	line_char_stripped[MAX_STRING - 1] = 0;
-
-	if (!m_blech->IsEmpty() && m_currentLine != nullptr)
-	{
-		m_blech->Feed(m_currentLine, MAX_STRING);
-	}
-	if (!m_blechStripped->IsEmpty() && m_currentLineStripped != nullptr)
-	{
-		m_blechStripped->Feed(m_currentLineStripped, MAX_STRING);
-	}
-
-	m_currentLineStripped = nullptr;
-	m_currentLine = nullptr;
-}
-
-void LuaEventProcessor::HandleBlechEvent(LuaEvent* pEvent, BLECHVALUE* pValues)
-{
 	std::vector<std::pair<uint32_t, std::string>> args;
 
-	const char* line = pEvent->KeepLinks() ? m_currentLine : m_currentLineStripped;
 	args.emplace_back(0, line ? line : "");
 
 	auto value = pValues;
@@ -205,7 +130,7 @@ void LuaEventProcessor::HandleBlechEvent(LuaEvent* pEvent, BLECHVALUE* pValues)
 	{
 		auto num = GetIntFromString(value->Name, 0);
 		if (num > 0) // this will skip any '*' instances for me -- it will in fact only Get valid argument positions
-			args.emplace_back(num, value->Value);
+			args.emplace_back(num, std::string(value->Value));
 		value = value->pNext;
 	}
 
@@ -255,6 +180,11 @@ void LuaEventProcessor::RunEvents(LuaThread& thread)
 	if (!thread.ShouldYield()) loop_and_run(thread, m_eventsRunning);
 }
 
+bool LuaEventProcessor::HasWork() const
+{
+	return !m_bindsPending.empty() || !m_bindsRunning.empty() || !m_eventsRunning.empty();
+}
+
 template <typename R>
 static void emplace_running(
 	std::vector<std::shared_ptr<LuaEventFunction>>& running_vec,
@@ -344,6 +274,96 @@ void LuaEventProcessor::HandleBindCallback(LuaBind* bind, const char* args)
 
 //============================================================================
 
+LuaEventMatcher::LuaEventMatcher()
+	: m_blech(std::make_unique<Blech>('#', '|', LuaVarProcess))
+	, m_blechStripped(std::make_unique<Blech>('#', '|', LuaVarProcess))
+{
+}
+
+LuaEventMatcher::~LuaEventMatcher() = default;
+
+LuaEventMatcher& LuaEventMatcher::Get()
+{
+	static LuaEventMatcher s_instance;
+	return s_instance;
+}
+
+void LuaEventMatcher::Process(std::string_view line)
+{
+	if (m_blech->IsEmpty() && m_blechStripped->IsEmpty())
+		return;
+	if (line.size() >= MAX_STRING)
+		return;
+
+	char line_char[MAX_STRING] = { 0 };
+	char line_char_stripped[MAX_STRING] = { 0 };
+
+	m_currentLineStripped = nullptr;
+	m_currentLine = nullptr;
+
+	// Split event handling by whether we have links in the string or not. If there are no links in
+	// the string then this is much simpler.
+	if (line.find_first_of('\x12') == std::string::npos)
+	{
+		StripMQChat(line, line_char);
+
+		m_currentLineStripped = line_char;
+		m_currentLine = line_char;
+	}
+	else
+	{
+		// We have links in the string. Do the minimal amount of work required based on what kinds of
+		// events have been registered.
+
+		// Check if we need to keep both the stripped and unstripped links.
+		if (!m_blech->IsEmpty() && !m_blechStripped->IsEmpty())
+		{
+			StripMQChat(line, line_char);
+			m_currentLine = line_char;
+
+			CXStr line_str(line);
+			line_str = CleanItemTags(line_str, false);
+			StripMQChat(line_str, line_char_stripped);
+			m_currentLineStripped = line_char_stripped;
+		}
+		else if (!m_blech->IsEmpty())
+		{
+			StripMQChat(line, line_char);
+
+			m_currentLine = line_char;
+			m_currentLineStripped = line_char;
+		}
+		else if (!m_blechStripped->IsEmpty())
+		{
+			CXStr line_str(line);
+			line_str = CleanItemTags(line_str, false);
+			StripMQChat(line_str, line_char_stripped);
+
+			m_currentLineStripped = line_char_stripped;
+			m_currentLine = line_char_stripped;
+		}
+	}
+
+	// since we initialized to 0, we know that any remaining members will be 0, so just in case we
+	// get an overflow, re-set the last character to 0
+	line_char[MAX_STRING - 1] = 0;
+	line_char_stripped[MAX_STRING - 1] = 0;
+
+	if (!m_blech->IsEmpty() && m_currentLine != nullptr)
+	{
+		m_blech->Feed(m_currentLine, MAX_STRING);
+	}
+	if (!m_blechStripped->IsEmpty() && m_currentLineStripped != nullptr)
+	{
+		m_blechStripped->Feed(m_currentLineStripped, MAX_STRING);
+	}
+
+	m_currentLineStripped = nullptr;
+	m_currentLine = nullptr;
+}
+
+//============================================================================
+
 void CALLBACK LuaEventCallback(unsigned int ID, void* pData, BLECHVALUE* pValues)
 {
 	if (pData == nullptr)
@@ -351,7 +371,7 @@ void CALLBACK LuaEventCallback(unsigned int ID, void* pData, BLECHVALUE* pValues
 
 	auto def = static_cast<LuaEvent*>(pData);
 
-	def->GetEventProcessor()->HandleBlechEvent(def, pValues);
+	def->GetEventProcessor()->HandleBlechEvent(def, LuaEventMatcher::Get().GetCurrentLine(def->KeepLinks()), pValues);
 }
 
 LuaEvent::LuaEvent(std::string_view name, std::string_view expression,
@@ -369,7 +389,7 @@ LuaEvent::LuaEvent(std::string_view name, std::string_view expression,
 		m_keepLinks = optionsTable.get_or("keepLinks", false);
 	}
 
-	m_blech = m_keepLinks ? &processor->GetBlech() : &processor->GetBlechStripped();
+	m_blech = &LuaEventMatcher::Get().GetBlech(m_keepLinks);
 	m_id = m_blech->AddEvent(m_expression.c_str(), LuaEventCallback, this);
 }
 
@@ -121,11 +121,12 @@ public:
 	bool AddBind(std::string_view name, const sol::function& function);
 	bool RemoveBind(std::string_view name);
 
-	void Process(std::string_view line);
-
 	// this is guaranteed to always run at the exact same time, so we can run binds and events in it
 	void RunEvents(LuaThread& thread);
 
+	// true if RunEvents has binds or events to run
+	bool HasWork() const;
+
 	// we need two separate functions here because we need to be able to run these at separate points, independently
 	void PrepareEvents(const std::vector<std::string>& events);
 	void RemoveEvents(const std::vector<std::string>& events);
@@ -134,18 +135,11 @@ public:
 
 	LuaThread* GetThread() const { return m_thread; }
 
-	void HandleBlechEvent(LuaEvent* event, BLECHVALUE* pValues);
+	void HandleBlechEvent(LuaEvent* event, const char* line, BLECHVALUE* pValues);
 	void HandleBindCallback(LuaBind* bind, const char* args);
 
-	Blech& GetBlech() { return *m_blech; }
-	Blech& GetBlechStripped() { return *m_blechStripped; }
-
 private:
 	LuaThread* m_thread;
-	std::unique_ptr<Blech> m_blech;
-	std::unique_ptr<Blech> m_blechStripped;
-	const char* m_currentLineStripped = nullptr;
-	const char* m_currentLine = nullptr;
 
 	// Events
 	std::vector<std::unique_ptr<LuaEvent>> m_eventDefinitions;
@@ -158,4 +152,33 @@ private:
 	std::vector<std::shared_ptr<LuaEventFunction>> m_bindsRunning;
 };
 
+//----------------------------------------------------------------------------
+
+// Matches chat lines against the events of every script. Each line is cleaned up once and fed to
+// one set of patterns for all scripts, and each match is handed to the processor of the script that
+// owns the event. This keeps the cost of a line independent of the number of running scripts.
+class LuaEventMatcher
+{
+public:
+	static LuaEventMatcher& Get();
+
+	// events that keep links match against the line with its links intact
+	Blech& GetBlech(bool keepLinks) { return keepLinks ? *m_blech : *m_blechStripped; }
+
+	void Process(std::string_view line);
+
+	// The line that is being processed, in the form that events with the given keepLinks setting
+	// were matched against. Only valid while a line is being processed.
+	const char* GetCurrentLine(bool keepLinks) const { return keepLinks ? m_currentLine : m_currentLineStripped; }
+
+private:
+	LuaEventMatcher();
+	~LuaEventMatcher();
+
+	std::unique_ptr<Blech> m_blech;
+	std::unique_ptr<Blech> m_blechStripped;
+	const char* m_currentLineStripped = nullptr;
+	const char* m_currentLine = nullptr;
+};
+
 } // namespace mq::lua
@@ -14,6 +14,7 @@
 
 #include "pch.h"
 #include "LuaThread.h"
+#include "LuaBytecodeCache.h"
 #include "LuaCoroutine.h"
 #include "LuaEvent.h"
 #include "LuaImGui.h"
@@ -58,6 +59,9 @@ static uint32_t NextID()
 std::shared_ptr<mq::lua::LuaThread> GetLuaThreadByPID(int pid);
 void OnLuaThreadDestroyed(LuaThread* thread);
 void OnLuaTLORemoved(MQTopLevelObject* tlo, int pidOwner);
+void SubscribeToSpawns(LuaThread* thread);
+void SubscribeToGroundItems(LuaThread* thread);
+void UnsubscribeLuaThread(LuaThread* thread);
 
 
 // Mapping of TLOs to the pid of the script that created it
@@ -125,6 +129,7 @@ LuaThread::LuaThread(this_is_private&&, LuaEnvironmentSettings* environment)
 
 LuaThread::~LuaThread()
 {
+	UnsubscribeLuaThread(this);
 	RemoveAllDataObjects();
 
 	m_imguiProcessor.reset();
@@ -145,6 +150,7 @@ void LuaThread::Initialize()
 	bindings::RegisterBindings_Bit32(m_globalState);
 
 	m_globalState.add_package_loader(LuaThread::lua_PackageLoader);
+	LuaBytecodeCache::InstallPackageLoader(m_globalState.lua_state());
 }
 
 void LuaThread::EnableImGui()
@@ -309,7 +315,10 @@ std::optional<LuaThreadInfo> LuaThread::StartFile(
 	m_name = locationInfo.canonicalName;
 	m_path = locationInfo.fullPath;
 
-	auto co = m_coroutine->thread.state().load_file(m_path);
+	lua_State* L = m_coroutine->thread.state().lua_state();
+	auto status = static_cast<sol::load_status>(LuaBytecodeCache::Get().LoadFile(L, m_path.c_str()));
+
+	sol::load_result co(L, lua_absindex(L, -1), 1, 1, status);
 	if (!co.valid())
 	{
 		sol::error err = co;
@@ -439,6 +448,14 @@ LuaThread::RunResult LuaThread::RunOnce()
 		return { m_coroutine->thread.status(), std::nullopt };
 	}
 
+	const bool hasEvents = m_eventProcessor && m_eventProcessor->HasWork();
+
+	// a script that is waiting in mq.delay, with no binds or events to run, has nothing to do this frame
+	if (!hasEvents && m_coroutine->IsWaiting(MQGetTickCount64()))
+	{
+		return { m_coroutine->thread.status(), std::nullopt };
+	}
+
 	DataTypeTemp.push_buffer(buffer);
 
 	if (m_eventProcessor)
@@ -450,9 +467,12 @@ LuaThread::RunResult LuaThread::RunOnce()
 	YieldAt(m_turboNum);
 	m_yieldToFrame = false;
 
-	if (m_eventProcessor)
+	if (hasEvents)
 	{
 		m_eventProcessor->RunEvents(*this);
+
+		// binds and events usually change what the delay condition is waiting for
+		m_coroutine->Wake();
 	}
 
 	if (!m_coroutine->ShouldRun())
@@ -631,6 +651,7 @@ sol::table LuaThread::GetSpawnTable()
 	if (m_spawnTable == sol::nil)
 	{
 		m_spawnTable = m_globalState.create_named_table("__spawns");
+		SubscribeToSpawns(this);
 
 		if (pSpawnManager != nullptr)
 		{
@@ -647,19 +668,17 @@ sol::table LuaThread::GetSpawnTable()
 	return m_spawnTable;
 }
 
-void LuaThread::AddSpawn(eqlib::PlayerClient* spawn)
-{
-	if (m_coroutine->coroutine.status() == sol::call_status::yielded && m_spawnTable != sol::nil)
-	{
-		m_spawnTable[spawn->SpawnID] = bindings::lua_MQTypeVar(datatypes::pSpawnType->MakeTypeVar(spawn));
-	}
-}
-
-void LuaThread::RemoveSpawn(eqlib::PlayerClient* spawn)
+void LuaThread::UpdateSpawns(const std::unordered_map<uint32_t, eqlib::PlayerClient*>& changes)
 {
 	if (m_coroutine->coroutine.status() == sol::call_status::yielded && m_spawnTable != sol::nil)
 	{
-		m_spawnTable[spawn->SpawnID] = sol::nil;
+		for (const auto& [spawnId, spawn] : changes)
+		{
+			if (spawn)
+				m_spawnTable[spawnId] = bindings::lua_MQTypeVar(datatypes::pSpawnType->MakeTypeVar(spawn));
+			else
+				m_spawnTable[spawnId] = sol::nil;
+		}
 	}
 }
 
@@ -668,6 +687,7 @@ sol::table LuaThread::GetGroundItemTable()
 	if (m_groundItemTable == sol::nil)
 	{
 		m_groundItemTable = m_globalState.create_named_table("__groundItems");
+		SubscribeToGroundItems(this);
 
 		if (pItemList != nullptr)
 		{
@@ -683,19 +703,17 @@ sol::table LuaThread::GetGroundItemTable()
 	return m_groundItemTable;
 }
 
-void LuaThread::AddGroundItem(eqlib::EQGroundItem* item)
-{
-	if (m_coroutine->coroutine.status() == sol::call_status::yielded && m_groundItemTable != sol::nil)
-	{
-		m_groundItemTable[item->DropID] = bindings::lua_MQTypeVar(datatypes::MQ2GroundType::MakeTypeVar(MQGroundSpawn(item)));
-	}
-}
-
-void LuaThread::RemoveGroundItem(eqlib::EQGroundItem* item)
+void LuaThread::UpdateGroundItems(const std::unordered_map<uint32_t, eqlib::EQGroundItem*>& changes)
 {
 	if (m_coroutine->coroutine.status() == sol::call_status::yielded && m_groundItemTable != sol::nil)
 	{
-		m_groundItemTable[item->DropID] = sol::nil;
+		for (const auto& [dropId, item] : changes)
+		{
+			if (item)
+				m_groundItemTable[dropId] = bindings::lua_MQTypeVar(datatypes::MQ2GroundType::MakeTypeVar(MQGroundSpawn(item)));
+			else
+				m_groundItemTable[dropId] = sol::nil;
+		}
 	}
 }
 
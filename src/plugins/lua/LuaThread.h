@@ -25,6 +25,7 @@
 
 #include <chrono>
 #include <stack>
+#include <unordered_map>
 
 namespace eqlib {
 	class PlayerClient;
@@ -133,6 +134,7 @@ public:
 
 	void InjectMQNamespace();
 	void SetTurbo(uint32_t turboVal) { m_turboNum = turboVal; }
+	uint32_t GetDelayConditionInterval() const { return m_luaEnvironmentSettings->delayConditionInterval; }
 	void SetEvaluateResult(bool evaluate) { m_evaluateResult = evaluate; }
 	bool GetEvaluateResult() const { return m_evaluateResult; }
 
@@ -194,13 +196,13 @@ public:
 		m_namedDependencies.insert(name);
 	}
 
+	// The spawn and ground item tables are built the first time a script asks for them. From then
+	// on the thread receives the changes once per pulse, keyed by id, with nullptr for removals.
 	sol::table GetSpawnTable();
-	void AddSpawn(eqlib::PlayerClient* spawn);
-	void RemoveSpawn(eqlib::PlayerClient* spawn);
+	void UpdateSpawns(const std::unordered_map<uint32_t, eqlib::PlayerClient*>& changes);
 
 	sol::table GetGroundItemTable();
-	void AddGroundItem(eqlib::EQGroundItem* item);
-	void RemoveGroundItem(eqlib::EQGroundItem* item);
+	void UpdateGroundItems(const std::unordered_map<uint32_t, eqlib::EQGroundItem*>& changes);
 
 private:
 	RunResult RunOnce();
@@ -19,6 +19,8 @@
 #include "LuaThread.h"
 #include "LuaEvent.h"
 #include "LuaActor.h"
+#include "LuaBytecodeCache.h"
+#include "LuaChangeQueue.h"
 #include "LuaImGui.h"
 #include "bindings/lua_Bindings.h"
 #include "imgui/ImGuiUtils.h"
@@ -59,6 +61,8 @@ static const std::string KEY_DLL_REQUIRE_PATHS = "dllRequirePaths";
 static const std::string KEY_INFO_GC = "infoGC";
 static const std::string KEY_SQUELCH_STATUS = "squelchStatus";
 static const std::string KEY_SHOW_MENU = "showMenu";
+static const std::string KEY_BYTECODE_CACHE = "bytecodeCache";
+static const std::string KEY_DELAY_CONDITION_INTERVAL = "delayConditionInterval";
 
 // configurable options, defaults provided where needed
 static uint32_t s_turboNum = 500;
@@ -68,6 +72,7 @@ static LuaEnvironmentSettings s_environment;
 static std::chrono::milliseconds s_infoGC = 3600s; // 1 hour
 static bool s_squelchStatus = false;
 static bool s_verboseErrors = true;
+static bool s_bytecodeCache = false;
 
 // this is static and will never change
 static std::string s_configPath = (std::filesystem::path(gPathConfig) / "MQ2Lua.yaml").string();
@@ -80,6 +85,11 @@ static ImGuiFileDialog* s_luaDirDialog = nullptr;
 static ImGuiFileDialog* s_moduleDirDialog = nullptr;
 static imgui::TextEditor* s_luaCodeViewer = nullptr;
 
+// Threads that keep a spawn or ground item table, and the changes they haven't seen yet. Declared
+// before the thread lists so that they outlive the threads, which unsubscribe when destroyed.
+static LuaChangeQueue<LuaThread, PlayerClient> s_spawnChanges;
+static LuaChangeQueue<LuaThread, EQGroundItem> s_groundItemChanges;
+
 // use a vector for s_running because we need to iterate it every pulse, and find only if a command is issued
 std::vector<std::shared_ptr<LuaThread>> s_running;
 std::vector<std::shared_ptr<LuaThread>> s_pending;
@@ -251,6 +261,28 @@ void OnLuaTLORemoved(MQTopLevelObject* tlo, int pidOwner)
 		}), end(s_running));
 }
 
+void SubscribeToSpawns(LuaThread* thread)
+{
+	s_spawnChanges.Subscribe(thread);
+}
+
+void SubscribeToGroundItems(LuaThread* thread)
+{
+	s_groundItemChanges.Subscribe(thread);
+}
+
+void UnsubscribeLuaThread(LuaThread* thread)
+{
+	s_spawnChanges.Unsubscribe(thread);
+	s_groundItemChanges.Unsubscribe(thread);
+}
+
+static void DeliverSpawnChanges()
+{
+	s_spawnChanges.Deliver([](LuaThread& thread, const auto& changes) { thread.UpdateSpawns(changes); });
+	s_groundItemChanges.Deliver([](LuaThread& thread, const auto& changes) { thread.UpdateGroundItems(changes); });
+}
+
 #pragma endregion
 
 #pragma region TLO
@@ -852,6 +884,13 @@ void SetModuleDirName(const std::string& moduleDir)
 	s_configNode[KEY_MODULE_DIR] = s_moduleDirName;
 }
 
+// Compiled scripts are always cached in memory. This also keeps them on disk between sessions.
+static void SetBytecodeCacheEnabled(bool enabled)
+{
+	LuaBytecodeCache::Get().SetCacheDirectory(
+		enabled ? (std::filesystem::path(gPathResources) / "LuaBytecode").string() : std::string());
+}
+
 static void WriteSettings()
 {
 	std::fstream file(s_configPath, std::ios::out);
@@ -888,6 +927,11 @@ static void ReadSettings()
 
 	s_verboseErrors = s_configNode["verboseErrors"].as<bool>(false);
 
+	s_bytecodeCache = s_configNode[KEY_BYTECODE_CACHE].as<bool>(s_bytecodeCache);
+	SetBytecodeCacheEnabled(s_bytecodeCache);
+
+	s_environment.delayConditionInterval = s_configNode[KEY_DELAY_CONDITION_INTERVAL].as<uint32_t>(s_environment.delayConditionInterval);
+
 	std::string tempDirName = s_luaDirName;
 	if (mq::test_and_set(tempDirName, s_configNode[KEY_LUA_DIR].as<std::string>(tempDirName)) || s_environment.luaDir.empty())
 	{
@@ -1566,6 +1610,12 @@ static void DrawLuaSettings()
 		s_configNode["verboseErrors"] = s_verboseErrors;
 	}
 
+	if (ImGui::Checkbox("Keep Compiled Scripts on Disk", &s_bytecodeCache))
+	{
+		s_configNode[KEY_BYTECODE_CACHE] = s_bytecodeCache;
+		SetBytecodeCacheEnabled(s_bytecodeCache);
+	}
+
 	ImGui::NewLine();
 
 	ImGui::Text("Turbo Num:");
@@ -1577,6 +1627,16 @@ static void DrawLuaSettings()
 		s_configNode[KEY_TURBO_NUM] = s_turboNum;
 	}
 
+	ImGui::Text("Delay Condition Interval:");
+	uint32_t interval_selected = s_environment.delayConditionInterval, interval_min = 0U, interval_max = 1000U;
+	ImGui::SetNextItemWidth(-1.0f);
+	if (ImGui::SliderScalar("##delayconditionintervalslider", ImGuiDataType_U32, &interval_selected, &interval_min, &interval_max,
+		interval_selected == 0 ? "Every Frame" : "%u ms", ImGuiSliderFlags_None))
+	{
+		s_environment.delayConditionInterval = interval_selected;
+		s_configNode[KEY_DELAY_CONDITION_INTERVAL] = s_environment.delayConditionInterval;
+	}
+
 
 	ImGui::Text("Lua Directory:");
 	auto dirDisplay = s_configNode[KEY_LUA_DIR].as<std::string>(s_luaDirName);
@@ -1886,6 +1946,9 @@ PLUGIN_API void OnPulse()
 		s_pending.clear();
 	}
 
+	// bring spawn tables up to date before any script looks at them
+	DeliverSpawnChanges();
+
 	s_running.erase(std::remove_if(s_running.begin(), s_running.end(),
 		[](const std::shared_ptr<LuaThread>& thread) -> bool
 		{
@@ -1929,41 +1992,25 @@ PLUGIN_API void OnPulse()
 PLUGIN_API void OnAddSpawn(PlayerClient* spawn)
 {
 	using namespace mq::lua;
-	for (const auto& thread : s_running)
-		thread->AddSpawn(spawn);
-
-	for (const auto& thread : s_pending)
-		thread->AddSpawn(spawn);
+	s_spawnChanges.Added(spawn->SpawnID, spawn);
 }
 
 PLUGIN_API void OnRemoveSpawn(PlayerClient* spawn)
 {
 	using namespace mq::lua;
-	for (const auto& thread : s_running)
-		thread->RemoveSpawn(spawn);
-
-	for (const auto& thread : s_pending)
-		thread->RemoveSpawn(spawn);
+	s_spawnChanges.Removed(spawn->SpawnID, spawn);
 }
 
 PLUGIN_API void OnAddGroundItem(EQGroundItem* item)
 {
 	using namespace mq::lua;
-	for (const auto& thread : s_running)
-		thread->AddGroundItem(item);
-
-	for (const auto& thread : s_pending)
-		thread->AddGroundItem(item);
+	s_groundItemChanges.Added(item->DropID, item);
 }
 
 PLUGIN_API void OnRemoveGroundItem(EQGroundItem* item)
 {
 	using namespace mq::lua;
-	for (const auto& thread : s_running)
-		thread->RemoveGroundItem(item);
-
-	for (const auto& thread : s_pending)
-		thread->RemoveGroundItem(item);
+	s_groundItemChanges.Removed(item->DropID, item);
 }
 
 PLUGIN_API void OnUpdateImGui()
@@ -2253,26 +2300,12 @@ PLUGIN_API void OnUpdateImGui()
 
 PLUGIN_API void OnWriteChatColor(const char* Line, int Color, int Filter)
 {
-	for (const std::shared_ptr<mq::lua::LuaThread>& thread : mq::lua::s_running)
-	{
-		if (thread && !thread->IsPaused())
-		{
-			if (lua::LuaEventProcessor* events = thread->GetEventProcessor())
-				events->Process(Line);
-		}
-	}
+	lua::LuaEventMatcher::Get().Process(Line);
 }
 
 PLUGIN_API bool OnIncomingChat(const char* Line, DWORD Color)
 {
-	for (const std::shared_ptr<mq::lua::LuaThread>& thread : mq::lua::s_running)
-	{
-		if (thread && !thread->IsPaused())
-		{
-			if (lua::LuaEventProcessor* events = thread->GetEventProcessor())
-				events->Process(Line);
-		}
-	}
+	lua::LuaEventMatcher::Get().Process(Line);
 
 	return false;
 }
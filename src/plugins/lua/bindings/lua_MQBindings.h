@@ -76,6 +76,7 @@ public:
 private:
 	MQTypeVar m_self;
 	std::string m_member;
+	MQResolvedMember m_resolved;
 };
 
 //----------------------------------------------------------------------------
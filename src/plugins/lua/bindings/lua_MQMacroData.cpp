@@ -281,6 +281,38 @@ static bool CreateMacroTypeFromLua(sol::object object, MQTypeVar& Dest)
 
 #pragma region Macro Data Bindings
 
+// Members are resolved once per type and name, and reused until the data api reports that types or
+// members have changed. Scripts tend to access the same handful of members over and over again.
+static std::unordered_map<MQ2Type*, std::unordered_map<std::string, MQResolvedMember>> s_resolvedMembers;
+static uint32_t s_resolvedMembersRevision = 0;
+
+// arbitrary limit so that scripts indexing with computed names can't grow the cache without bound
+static constexpr size_t MaxResolvedMembersPerType = 512;
+
+static const MQResolvedMember& ResolveMember(MQ2Type* type, const std::string& member)
+{
+	const uint32_t revision = GetMacroDataRevision();
+	if (revision != s_resolvedMembersRevision)
+	{
+		s_resolvedMembers.clear();
+		s_resolvedMembersRevision = revision;
+	}
+
+	auto& members = s_resolvedMembers[type];
+
+	auto iter = members.find(member);
+	if (iter != members.end())
+		return iter->second;
+
+	if (members.size() >= MaxResolvedMembersPerType)
+		members.clear();
+
+	MQResolvedMember resolved;
+	ResolveMacroDataMember(type, member, resolved);
+
+	return members.emplace(member, resolved).first->second;
+}
+
 lua_MQTypeVar::lua_MQTypeVar(const std::string& str)
 {
 	auto* const type = FindMQ2DataType(str.c_str());
@@ -316,7 +348,14 @@ MQTypeVar lua_MQTypeVar::EvaluateMember(const char* index) const
 	// the ternary in index is because datatypes are all over the place on whether or not they can
 	// accept null pointers. They all seem to agree that an empty string is the same thing, though.
 	MQTypeVar var;
-	if (EvaluateMacroDataMember(m_self.Type, m_self.GetVarPtr(), var, m_member.c_str(), index ? index : "") == 1)
+	int result;
+
+	if (m_resolved.Type == m_self.Type)
+		result = EvaluateResolvedMacroDataMember(m_resolved, m_self.GetVarPtr(), var, m_member.c_str(), index ? index : "");
+	else
+		result = EvaluateMacroDataMember(m_self.Type, m_self.GetVarPtr(), var, m_member.c_str(), index ? index : "");
+
+	if (result == 1)
 		return std::move(var);
 
 	// can't guarantee result didn't Get modified, but we want to return nil if GetMember was false
@@ -377,6 +416,7 @@ sol::object lua_MQTypeVar::Get(sol::stack_object key, sol::this_state L) const
 			// TODO: will need to keep track of extents to allow for access like this: arr[2][1]
 			// would rather return an array with a subset, but that would require slicing and copying the underlying array data
 			var.m_member = "";
+			var.m_resolved = {};
 			var.m_self.Type = arr->GetType();
 			var.m_self.SetVarPtr(arr->GetData(*maybe_index));
 		}
@@ -389,6 +429,7 @@ sol::object lua_MQTypeVar::Get(sol::stack_object key, sol::this_state L) const
 			}
 
 			var.m_member = "";
+			var.m_resolved = {};
 		}
 	}
 	else if (auto maybe_key = key.as<std::optional<std::string_view>>())
@@ -397,9 +438,11 @@ sol::object lua_MQTypeVar::Get(sol::stack_object key, sol::this_state L) const
 		var.m_member = *maybe_key;
 
 		// make sure that the macro data member even exists if we have the type info
-		if (var.m_self.Type && !FindMacroDataMember(var.m_self.Type, var.m_member))
+		if (var.m_self.Type)
 		{
-			return sol::object(L, sol::in_place, sol::lua_nil);
+			var.m_resolved = ResolveMember(var.m_self.Type, var.m_member);
+			if (!var.m_resolved.Exists)
+				return sol::object(L, sol::in_place, sol::lua_nil);
 		}
 	}
 
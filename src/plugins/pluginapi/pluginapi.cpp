@@ -81,6 +81,19 @@ mq::MQTopLevelObject* mq::FindTopLevelObject(const char* szName)
 //============================================================================
 //============================================================================
 
+mq::MQPulseTaskId mq::AddPulseTask(std::string_view name, MQPulseTaskHandler handler, uint32_t intervalMS, uint32_t budgetUS)
+{
+	return mqplugin::MainInterface->AddPulseTask(name, std::move(handler), intervalMS, budgetUS, mqplugin::ThisPluginHandle);
+}
+
+bool mq::RemovePulseTask(MQPulseTaskId taskId)
+{
+	return mqplugin::MainInterface->RemovePulseTask(taskId, mqplugin::ThisPluginHandle);
+}
+
+//============================================================================
+//============================================================================
+
 void mq::postoffice::DropboxAPI::Post(const mq::postoffice::Address& address, const std::string& data, const ResponseCallbackAPI& callback) const
 {
 	mqplugin::MainInterface->SendToActor(Dropbox, address, data, callback, mqplugin::ThisPluginHandle);
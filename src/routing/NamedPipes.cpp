@@ -90,6 +90,7 @@ bool PipeMessage::Parse(std::unique_ptr<uint8_t[]> buffer, size_t length)
 			return false;
 
 		m_buffer = std::move(buffer);
+		m_sharedBuffer.reset();
 		m_valid = true;
 		return true;
 	}
@@ -125,6 +126,7 @@ void PipeMessage::Init(const void* data, size_t length)
 
 	// initialize buffer and header
 	m_buffer = std::make_unique<uint8_t[]>(m_bufferLength);
+	m_sharedBuffer.reset();
 	m_header = reinterpret_cast<MQMessageHeader*>(m_buffer.get());
 
 	if (data && length > 0)
@@ -155,6 +157,23 @@ void PipeMessage::Init(const MQMessageHeader& header, const void* data, size_t l
 	m_valid = true;
 }
 
+PipeMessagePtr PipeMessage::Share()
+{
+	// the header and data don't move, so m_header stays valid
+	if (m_buffer)
+		m_sharedBuffer = std::move(m_buffer);
+
+	auto message = std::make_unique<PipeMessage>();
+	message->m_sharedBuffer = m_sharedBuffer;
+	message->m_bufferLength = m_bufferLength;
+	message->m_header = m_header;
+	message->m_dataOffset = m_dataOffset;
+	message->m_valid = m_valid;
+	message->m_connection = m_connection;
+
+	return message;
+}
+
 int PipeMessage::GetConnectionId() const
 {
 	if (auto connection = m_connection.lock())
@@ -440,7 +459,9 @@ void PipeConnection::InternalSendMessage(PipeMessagePtr&& message,
 		return;
 	}
 
-	if (message->GetSequenceId() == 0)
+	// a shared buffer may be in the middle of being written to another connection, so leave its header
+	// alone. Only simple messages are shared, and they don't need a sequence id.
+	if (message->GetSequenceId() == 0 && !message->IsShared())
 		message->SetSequenceId(m_nextSequenceId++);
 	message->SetConnection(shared_from_this());
 
@@ -1052,12 +1073,10 @@ void NamedPipeServer::SendMessage(int connectionId, MQMessageId messageId, const
 
 void NamedPipeServer::BroadcastMessage(PipeMessagePtr&& message)
 {
+	// every connection gets a reference to the same buffer
 	for (const auto& connection : m_connections)
 	{
-		// force the copy here instead of downstream (because we only want to do this in broadcast)
-		connection->SendMessage(
-			std::make_unique<PipeMessage>(*message->GetHeader(), message->get(), message->size())
-		);
+		connection->SendMessage(message->Share());
 	}
 }
 
@@ -46,6 +46,9 @@ class PipeConnection;
 // to separate the header from the message, since different clients are going
 // to have different headers (maybe..?)
 
+class PipeMessage;
+using PipeMessagePtr = std::unique_ptr<PipeMessage>;
+
 class PipeMessage
 {
 	friend class PipeConnection;
@@ -97,10 +100,15 @@ public:
 	}
 
 	template <typename T = void>
-	const T* get() const { return reinterpret_cast<T*>(m_buffer.get() + m_dataOffset); }
+	const T* get() const { return reinterpret_cast<const T*>(buffer() + m_dataOffset); }
 
 	size_t size() const { return m_header ? m_header->messageLength : 0; }
 
+	// Creates another message that refers to this message's buffer instead of copying it. Both
+	// messages must be treated as read-only from then on. Used to send one message to many connections.
+	PipeMessagePtr Share();
+	bool IsShared() const { return m_sharedBuffer != nullptr; }
+
 	uint32_t GetSequenceId() const { return m_header ? m_header->sequenceId : 0; }
 	void SetSequenceId(uint32_t sequenceId) { if (m_header) m_header->sequenceId = sequenceId; }
 
@@ -115,11 +123,12 @@ public:
 private:
 	void SetConnection(std::shared_ptr<PipeConnection> connection) { m_connection = connection; }
 
-	const uint8_t* buffer() const { return m_buffer.get(); }
+	const uint8_t* buffer() const { return m_buffer ? m_buffer.get() : m_sharedBuffer.get(); }
 	size_t buffer_size() const { return m_bufferLength; }
 
 private:
 	std::unique_ptr<uint8_t[]> m_buffer;
+	std::shared_ptr<uint8_t[]> m_sharedBuffer; // replaces m_buffer once the message is shared
 	size_t m_bufferLength = 0;
 	MQMessageHeader* m_header = nullptr;
 	size_t m_dataOffset = 0;
@@ -128,7 +137,6 @@ private:
 
 	std::weak_ptr<PipeConnection> m_connection;
 };
-using PipeMessagePtr = std::unique_ptr<PipeMessage>;
 
 using PipeMessageResponseCb = std::function<void(int status, PipeMessagePtr&& message)>;
 
@@ -0,0 +1,165 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-present MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "UnitTest.h"
+
+#include "mq/base/BatchWriter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace mq;
+
+namespace {
+
+constexpr int EntryCount = 100000;
+
+// Something the size of a console command, that a sink can tell the order of.
+std::string MakeEntry(int index)
+{
+	return "/echo " + std::to_string(index);
+}
+
+int GetIndex(const std::string& entry)
+{
+	return std::stoi(entry.substr(6));
+}
+
+// Collects what was written. While closed, writes wait for it to open, like a disk that has stalled.
+class Sink
+{
+public:
+	explicit Sink(bool open = true)
+		: m_open(open)
+	{
+	}
+
+	void Write(const std::deque<std::string>& entries)
+	{
+		std::unique_lock lock(m_mutex);
+		m_opened.wait(lock, [this]() { return m_open; });
+
+		++batches;
+		for (const std::string& entry : entries)
+			written.push_back(GetIndex(entry));
+		writerThread = std::this_thread::get_id();
+	}
+
+	void Open()
+	{
+		{
+			std::scoped_lock lock(m_mutex);
+			m_open = true;
+		}
+
+		m_opened.notify_all();
+	}
+
+	// only read these once the writer is gone
+	std::vector<int> written;
+	int batches = 0;
+	std::thread::id writerThread;
+
+private:
+	std::mutex m_mutex;
+	std::condition_variable m_opened;
+	bool m_open;
+};
+
+} // namespace
+
+TEST_CASE("BatchWriter writes every entry in order, in batches")
+{
+	Sink sink;
+
+	{
+		BatchWriter<std::string> writer([&](const auto& entries) { sink.Write(entries); }, EntryCount);
+		CHECK(writer.IsThreaded());
+
+		for (int i = 0; i < EntryCount; ++i)
+			writer.Add(MakeEntry(i));
+
+		CHECK(writer.GetDroppedCount() == 0);
+	}
+
+	CHECK(sink.written.size() == EntryCount);
+	CHECK(std::is_sorted(sink.written.begin(), sink.written.end()));
+	CHECK(sink.batches < EntryCount);
+	CHECK(sink.writerThread != std::this_thread::get_id());
+}
+
+TEST_CASE("BatchWriter writes from Add when it has no thread")
+{
+	Sink sink;
+	BatchWriter<std::string> writer([&](const auto& entries) { sink.Write(entries); }, 16, false);
+	CHECK(!writer.IsThreaded());
+
+	writer.Add(MakeEntry(1));
+	writer.Add(MakeEntry(2));
+
+	CHECK(sink.written == std::vector<int>({ 1, 2 }));
+	CHECK(sink.writerThread == std::this_thread::get_id());
+}
+
+// 100k entries go in while the writer is stuck on the disk. Add must neither wait for the writer nor
+// get slower as entries are dropped, and the newest entries are the ones that get written.
+TEST_CASE("BatchWriter enqueue cost stays constant while the writer is stalled")
+{
+	constexpr int ChunkSize = 10000;
+	constexpr int ChunkCount = EntryCount / ChunkSize;
+	constexpr size_t MaxQueued = 4096;
+
+	using Clock = std::chrono::steady_clock;
+	std::vector<double> bestChunk(ChunkCount, 1e300);
+
+	for (int round = 0; round < 3; ++round)
+	{
+		Sink sink(false);
+		size_t dropped = 0;
+
+		{
+			BatchWriter<std::string> writer([&](const auto& entries) { sink.Write(entries); }, MaxQueued);
+
+			for (int chunk = 0; chunk < ChunkCount; ++chunk)
+			{
+				const auto start = Clock::now();
+				for (int i = chunk * ChunkSize; i < (chunk + 1) * ChunkSize; ++i)
+					writer.Add(MakeEntry(i));
+
+				const double elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+				bestChunk[chunk] = std::min(bestChunk[chunk], elapsed / ChunkSize);
+			}
+
+			dropped = writer.GetDroppedCount();
+			sink.Open();
+		}
+
+		// whatever the writer grabbed before it stalled, plus the queue that was left at the end
+		CHECK(sink.written.size() + dropped == EntryCount);
+		CHECK(sink.written.size() <= 2 * MaxQueued);
+		CHECK(std::is_sorted(sink.written.begin(), sink.written.end()));
+		CHECK(!sink.written.empty() && sink.written.back() == EntryCount - 1);
+	}
+
+	const auto [fastest, slowest] = std::minmax_element(bestChunk.begin(), bestChunk.end());
+	CHECK(*slowest < *fastest * 3);
+
+	printf("  enqueue: %.1f ns/entry fastest chunk, %.1f ns/entry slowest chunk\n", *fastest, *slowest);
+}
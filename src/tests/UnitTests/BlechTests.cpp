@@ -0,0 +1,204 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-present MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "UnitTest.h"
+
+#include <windows.h>
+#include "../../../contrib/Blech/Blech.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Recorder
+{
+	std::vector<std::string> calls;
+
+	static void CALLBACK Callback(unsigned int ID, void* pData, PBLECHVALUE pValues)
+	{
+		std::string call = std::to_string(ID);
+		for (PBLECHVALUE pValue = pValues; pValue; pValue = pValue->pNext)
+		{
+			call += " ";
+			call += pValue->Name;
+			call += "=";
+			call += pValue->Value;
+		}
+
+		static_cast<Recorder*>(pData)->calls.push_back(std::move(call));
+	}
+};
+
+unsigned int FeedLine(Blech& blech, const char* line)
+{
+	char buffer[2048];
+	strcpy_s(buffer, line);
+	return blech.Feed(buffer);
+}
+
+unsigned int s_counted = 0;
+
+void CALLBACK CountingCallback(unsigned int, void*, PBLECHVALUE pValues)
+{
+	++s_counted;
+	for (PBLECHVALUE pValue = pValues; pValue; pValue = pValue->pNext)
+		s_counted += static_cast<unsigned int>(pValue->Value.length());
+}
+
+} // namespace
+
+TEST_CASE("Blech matches lines and captures variables")
+{
+	Recorder recorder;
+	Blech blech('#');
+
+	const unsigned int tell = blech.AddEvent("#1# tells you, '#2#'", Recorder::Callback, &recorder);
+	const unsigned int hi = blech.AddEvent("#1# tells you, 'hi'", Recorder::Callback, &recorder);
+	const unsigned int coins = blech.AddEvent("You have #*# coins", Recorder::Callback, &recorder);
+	const unsigned int slain = blech.AddEvent("You have been slain", Recorder::Callback, &recorder);
+	const unsigned int loot = blech.AddEvent("--#1# has looted #2#.--", Recorder::Callback, &recorder);
+
+	CHECK(FeedLine(blech, "Bob tells you, 'hi'") == 2);
+	CHECK(recorder.calls.size() == 2);
+	CHECK(std::count(recorder.calls.begin(), recorder.calls.end(), std::to_string(tell) + " 1=Bob 2=hi") == 1);
+	CHECK(std::count(recorder.calls.begin(), recorder.calls.end(), std::to_string(hi) + " 1=Bob") == 1);
+
+	recorder.calls.clear();
+	CHECK(FeedLine(blech, "you have 15 COINS") == 1);
+	CHECK(recorder.calls.size() == 1 && recorder.calls[0] == std::to_string(coins) + " *=15");
+
+	recorder.calls.clear();
+	CHECK(FeedLine(blech, "You have been slain") == 1);
+	CHECK(recorder.calls.size() == 1 && recorder.calls[0] == std::to_string(slain));
+
+	recorder.calls.clear();
+	CHECK(FeedLine(blech, "--Alice has looted a Rusty Dagger.--") == 1);
+	CHECK(recorder.calls.size() == 1 && recorder.calls[0] == std::to_string(loot) + " 1=Alice 2=a Rusty Dagger");
+
+	recorder.calls.clear();
+	CHECK(FeedLine(blech, "You have been hit") == 0);
+	CHECK(FeedLine(blech, "Bob says, 'hi'") == 0);
+	CHECK(recorder.calls.empty());
+}
+
+TEST_CASE("Blech removes events and reuses their nodes")
+{
+	Recorder recorder;
+	Blech blech('#');
+
+	const unsigned int first = blech.AddEvent("The #1# hits you", Recorder::Callback, &recorder);
+	const unsigned int second = blech.AddEvent("The #1# misses you", Recorder::Callback, &recorder);
+
+	CHECK(blech.RemoveEvent(first));
+	CHECK(!blech.RemoveEvent(first));
+
+	CHECK(FeedLine(blech, "The orc hits you") == 0);
+	CHECK(FeedLine(blech, "The orc misses you") == 1);
+	CHECK(recorder.calls.size() == 1 && recorder.calls[0] == std::to_string(second) + " 1=orc");
+
+	recorder.calls.clear();
+	const unsigned int third = blech.AddEvent("The #1# hits you hard", Recorder::Callback, &recorder);
+	CHECK(FeedLine(blech, "The gnoll hits you hard") == 1);
+	CHECK(recorder.calls.size() == 1 && recorder.calls[0] == std::to_string(third) + " 1=gnoll");
+
+	blech.Reset();
+	CHECK(blech.IsEmpty());
+	CHECK(FeedLine(blech, "The orc misses you") == 0);
+}
+
+TEST_CASE("Blech does not allocate while feeding")
+{
+	Blech blech('#');
+	blech.AddEvent("#1# tells you, '#2#'", CountingCallback);
+	blech.AddEvent("#1# tells you, 'hi'", CountingCallback);
+	blech.AddEvent("You have #*# coins", CountingCallback);
+	blech.AddEvent("You have been slain", CountingCallback);
+
+	char tell[] = "Bob tells you, 'hi'";
+	char coins[] = "You have 5 coins";
+	char slain[] = "You have been slain";
+	char miss[] = "Nothing matches this line";
+
+	// the first feeds size the scratch buffers
+	blech.Feed(tell);
+	blech.Feed(coins);
+	blech.Feed(slain);
+	blech.Feed(miss);
+
+	s_counted = 0;
+	const size_t before = mq::test::GetAllocationCount();
+
+	for (int i = 0; i < 100; ++i)
+	{
+		blech.Feed(tell);
+		blech.Feed(coins);
+		blech.Feed(slain);
+		blech.Feed(miss);
+	}
+
+	CHECK(mq::test::GetAllocationCount() == before);
+
+	// tell: 1 + "Bob" + "hi", hi: 1 + "Bob", coins: 1 + "5", slain: 1
+	CHECK(s_counted == 100 * (6 + 4 + 2 + 1));
+}
+
+namespace {
+
+struct Nested
+{
+	Blech* blech = nullptr;
+	std::vector<std::string> calls;
+	unsigned int removeID = 0;
+
+	static void CALLBACK Outer(unsigned int, void* pData, PBLECHVALUE pValues)
+	{
+		Nested* nested = static_cast<Nested*>(pData);
+
+		// a callback can feed the same instance, and its own values stay valid
+		FeedLine(*nested->blech, "inner says bye");
+		nested->calls.push_back("outer " + std::string(pValues->Value));
+
+		if (nested->removeID)
+			nested->blech->RemoveEvent(nested->removeID);
+	}
+
+	static void CALLBACK Inner(unsigned int, void* pData, PBLECHVALUE pValues)
+	{
+		static_cast<Nested*>(pData)->calls.push_back("inner " + std::string(pValues->Value));
+	}
+};
+
+} // namespace
+
+TEST_CASE("Blech callbacks can feed and remove events")
+{
+	Blech blech('#');
+	Nested nested;
+	nested.blech = &blech;
+
+	nested.removeID = blech.AddEvent("outer says #1#", Nested::Outer, &nested);
+	blech.AddEvent("inner says #1#", Nested::Inner, &nested);
+
+	CHECK(FeedLine(blech, "outer says hello") == 1);
+	CHECK(nested.calls.size() == 2);
+	CHECK(nested.calls[0] == "inner bye");
+	CHECK(nested.calls[1] == "outer hello");
+
+	// the outer event removed itself
+	nested.calls.clear();
+	CHECK(FeedLine(blech, "outer says hello") == 0);
+	CHECK(nested.calls.empty());
+}
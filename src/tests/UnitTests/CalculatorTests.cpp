@@ -0,0 +1,277 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-present MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "UnitTest.h"
+
+#include "main/MQCalculator.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace mq;
+
+namespace {
+
+int s_errors = 0;
+
+void CountError(const char*, ...)
+{
+	++s_errors;
+}
+
+struct Outcome
+{
+	bool success;
+	double result;
+	int errors;
+};
+
+Outcome RunUncached(const std::string& formula)
+{
+	std::string buffer = formula;
+	PrepareCalcFormula(buffer.data());
+
+	s_errors = 0;
+	double result = 0;
+	bool success = FastCalculate(buffer.c_str(), result, CountError);
+	return { success, result, s_errors };
+}
+
+Outcome RunCached(CalcProgramCache& cache, const std::string& formula)
+{
+	std::string buffer = formula;
+	PrepareCalcFormula(buffer.data());
+
+	s_errors = 0;
+	double result = 0;
+	bool success = cache.Calculate(buffer.c_str(), result, CountError);
+	return { success, result, s_errors };
+}
+
+bool SameOutcome(const Outcome& a, const Outcome& b)
+{
+	if (a.success != b.success || a.errors != b.errors)
+		return false;
+	if (!a.success)
+		return true;
+
+	return std::memcmp(&a.result, &b.result, sizeof(double)) == 0
+		|| (std::isnan(a.result) && std::isnan(b.result));
+}
+
+std::string RandomNumber(std::mt19937& random)
+{
+	switch (random() % 8)
+	{
+	case 0: return std::to_string(random() % 10);
+	case 1: return std::to_string(random() % 1000);
+	case 2: return std::to_string(random() % 100) + "." + std::to_string(random() % 100);
+	case 3: return "." + std::to_string(random() % 10);
+	case 4: return std::to_string(random() % 10) + " " + std::to_string(random() % 10);
+	case 5: return "0";
+	case 6: return (random() % 2) ? "TRUE" : "FALSE";
+	default: return "NULL";
+	}
+}
+
+// Builds a formula out of numbers, operators, parentheses and spaces. Most are well formed, but
+// nothing stops the generator from producing malformed ones, which have to fail the same way too.
+std::string RandomFormula(std::mt19937& random, int depth = 0)
+{
+	static const char* s_binaryOps[] = {
+		"+", "-", "*", "/", "\\", "%", "^", "^^", "&", "&&", "|", "||", "==", "!=", "<", "<=", ">",
+		">=", "<<", ">>", "--", "=",
+	};
+	static const char* s_unaryOps[] = { "-", "!", "~" };
+	static const char* s_spaces[] = { "", "", " ", "  " };
+
+	std::string formula;
+
+	if (depth < 3 && random() % 3 == 0)
+		formula = "(" + RandomFormula(random, depth + 1) + ")";
+	else
+		formula = RandomNumber(random);
+
+	if (random() % 6 == 0)
+		formula = s_unaryOps[random() % std::size(s_unaryOps)] + formula;
+
+	const int terms = random() % 4;
+	for (int i = 0; i < terms; ++i)
+	{
+		formula += s_spaces[random() % std::size(s_spaces)];
+		formula += s_binaryOps[random() % std::size(s_binaryOps)];
+		formula += s_spaces[random() % std::size(s_spaces)];
+
+		if (depth < 3 && random() % 4 == 0)
+			formula += "(" + RandomFormula(random, depth + 1) + ")";
+		else
+			formula += RandomNumber(random);
+	}
+
+	if (random() % 50 == 0)
+		formula.insert(random() % (formula.size() + 1), 1, "()x"[random() % 3]);
+
+	return formula;
+}
+
+// Gives every number in a formula a new random value, keeping its shape.
+std::string Revalue(std::mt19937& random, const std::string& formula)
+{
+	std::string result;
+	bool inNumber = false;
+
+	for (char ch : formula)
+	{
+		if ((ch >= '0' && ch <= '9') || ch == '.')
+		{
+			if (!inNumber)
+			{
+				result += (random() % 4 == 0) ? "0" : std::to_string(random() % 500);
+				inNumber = true;
+			}
+		}
+		else
+		{
+			if (ch != ' ')
+				inNumber = false;
+			result += ch;
+		}
+	}
+
+	return result;
+}
+
+} // namespace
+
+TEST_CASE("CalcProgramCache matches the uncached evaluator on simple formulas")
+{
+	CalcProgramCache cache(16);
+
+	const char* formulas[] = {
+		"1+2*3", "(1+2)*3", "10\\3", "10%3", "2^10", "-5+3", "!0", "~0", "1<<4", "256>>2",
+		"5 > 3 && 2 < 1", "TRUE || FALSE", "NULL == 0", "1 2 + 3", "(1)-2", "1--2", "5/0", "5%0",
+		"", "(", ")", "1+", "1=2", "abc", "(1)(2)(3)(4)",
+	};
+
+	for (const char* formula : formulas)
+	{
+		CHECK(SameOutcome(RunUncached(formula), RunCached(cache, formula)));
+
+		// again, from the cache
+		CHECK(SameOutcome(RunUncached(formula), RunCached(cache, formula)));
+	}
+
+	double result = 0;
+	CHECK(cache.Calculate("1+2*3", result, CountError) && result == 7);
+	CHECK(cache.Calculate("4+5*6", result, CountError) && result == 34);
+}
+
+TEST_CASE("CalcProgramCache compiles each shape once")
+{
+	CalcProgramCache cache(16);
+	double result = 0;
+
+	CHECK(cache.Calculate("1 < 2", result, CountError) && result == 1);
+	CHECK(cache.Calculate("30 < 2", result, CountError) && result == 0);
+	CHECK(cache.Calculate("3.5 < 20.25", result, CountError) && result == 1);
+	CHECK(cache.GetProgramCount() == 1);
+
+	CHECK(cache.Calculate("1 > 2", result, CountError) && result == 0);
+	CHECK(cache.GetProgramCount() == 2);
+
+	// failures aren't kept
+	CHECK(!cache.Calculate("1 = 2", result, CountError));
+	CHECK(cache.GetProgramCount() == 2);
+}
+
+TEST_CASE("CalcProgramCache matches the uncached evaluator on fuzzed formulas")
+{
+	std::mt19937 random(1234);
+	CalcProgramCache cache(64);
+
+	int mismatches = 0;
+	for (int i = 0; i < 20000; ++i)
+	{
+		const std::string formula = RandomFormula(random);
+
+		// the same shape with different values, as a condition sees from pulse to pulse
+		for (int j = 0; j < 4; ++j)
+		{
+			const std::string revalued = j == 0 ? formula : Revalue(random, formula);
+
+			if (!SameOutcome(RunUncached(revalued), RunCached(cache, revalued)))
+			{
+				if (++mismatches <= 5)
+					printf("  mismatch: %s\n", revalued.c_str());
+			}
+		}
+	}
+
+	CHECK(mismatches == 0);
+}
+
+TEST_CASE("CalcProgramCache benchmark")
+{
+	const char* formulas[] = {
+		"123 > 50 && 7 != 0",
+		"(45 * 100) \\ 300 < 20 || 1 == 0",
+		"1.00 && 0.00 || 25 >= 30",
+	};
+
+	constexpr int Iterations = 20000;
+	CalcProgramCache cache(16);
+	double total = 0;
+
+	using Clock = std::chrono::steady_clock;
+
+	auto uncachedStart = Clock::now();
+	for (int i = 0; i < Iterations; ++i)
+	{
+		for (const char* formula : formulas)
+		{
+			double result = 0;
+			FastCalculate(formula, result, CountError);
+			total += result;
+		}
+	}
+	auto uncachedTime = Clock::now() - uncachedStart;
+
+	const size_t allocations = test::GetAllocationCount();
+
+	auto cachedStart = Clock::now();
+	for (int i = 0; i < Iterations; ++i)
+	{
+		for (const char* formula : formulas)
+		{
+			double result = 0;
+			cache.Calculate(formula, result, CountError);
+			total -= result;
+		}
+	}
+	auto cachedTime = Clock::now() - cachedStart;
+
+	// only the first time each shape is seen compiles and allocates
+	CHECK(test::GetAllocationCount() - allocations <= std::size(formulas) * 8);
+	CHECK(total == 0);
+
+	const double calculations = static_cast<double>(Iterations) * std::size(formulas);
+	printf("  uncached: %.1f ns/formula, cached: %.1f ns/formula\n",
+		std::chrono::duration<double, std::nano>(uncachedTime).count() / calculations,
+		std::chrono::duration<double, std::nano>(cachedTime).count() / calculations);
+}
@@ -0,0 +1,278 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-present MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "UnitTest.h"
+
+#include <windows.h>
+#include "main/MQChatLineMatcher.h"
+
+#include <cstring>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace mq;
+
+namespace {
+
+struct Recorder
+{
+	std::vector<std::string> calls;
+
+	static void CALLBACK Callback(unsigned int ID, void* pData, PBLECHVALUE pValues)
+	{
+		std::string call = std::to_string(ID);
+		for (PBLECHVALUE pValue = pValues; pValue; pValue = pValue->pNext)
+		{
+			call += " ";
+			call += pValue->Name;
+			call += "=";
+			call += pValue->Value;
+		}
+
+		static_cast<Recorder*>(pData)->calls.push_back(std::move(call));
+	}
+};
+
+void FeedLine(Blech& blech, const std::string& line)
+{
+	char buffer[2048];
+	strcpy_s(buffer, line.c_str());
+	blech.Feed(buffer);
+}
+
+// Builds chat lines out of the pieces that the channel checks and the events look for, in the
+// places they usually appear and in places they don't, with the case of some of them changed.
+std::string RandomChatLine(std::mt19937& random)
+{
+	static const char* s_names[] = { "Bob", "Soandso", "a gnoll pup", "You", "Xyz`s warder" };
+	static const char* s_channels[] = {
+		" tells the guild, '", " tells the group, '", " tells you, '", " told you, '",
+		" says out of character, '", " shouts, '", " auctions, '", " says '", " says, '",
+		" tells the raid, '", " tells general:1, '", " tells raid:3, '", " tells you: '",
+	};
+	static const char* s_messages[] = {
+		"hi", "Hail, Bob", "inc", "You have been slain", "tells you, no", "[MQ2] done",
+		"Your target is out of range", "WTS: rusty sword", "you told me, 'x'", ":", ", '",
+		"loot #1# here", "says '", "The gnoll says, 'hi'", "",
+	};
+	static const char* s_noise[] = {
+		"You have been slain by a gnoll!", "[MQ2] pulled", "You told Bob, 'hi'",
+		"--Bob has looted a Rusty Sword.--", "Your spell fizzles!", "You have 15 coins",
+	};
+
+	std::string line;
+
+	switch (random() % 4)
+	{
+	case 0:
+		line = s_noise[random() % std::size(s_noise)];
+		break;
+
+	default:
+		line = s_names[random() % std::size(s_names)];
+		line += s_channels[random() % std::size(s_channels)];
+		line += s_messages[random() % std::size(s_messages)];
+		if (random() % 4 != 0)
+			line += "'";
+		break;
+	}
+
+	// say the same thing twice, so that only the first occurrence counts
+	if (random() % 8 == 0)
+		line += line;
+
+	// shouting
+	if (random() % 6 == 0)
+	{
+		for (char& ch : line)
+		{
+			if (random() % 2 == 0)
+				ch = static_cast<char>(toupper(static_cast<unsigned char>(ch)));
+		}
+	}
+
+	return line;
+}
+
+// An event with a literal that only turns up in some of the generated lines.
+std::string RandomEvent(std::mt19937& random)
+{
+	static const char* s_events[] = {
+		"#1# tells you, '#2#'", "#*#You have been slain#*#", "[MQ2] #1#", "#1# says, 'Hail, #2#'",
+		"Your target is out of range#*#", "--#1# has looted #2#.--", "#1# tells #2#:#3#, '#4#'",
+		"#*#spell fizzles#*#", "You have #1# coins", "#1# auctions, 'WTS#*#", "#*#gnoll#*#",
+		"#1# tells the guild, '#2#'", "#*#inc#*#", "You told #1#, '#2#'",
+	};
+
+	return s_events[random() % std::size(s_events)];
+}
+
+} // namespace
+
+TEST_CASE("MQChatLineMatcher finds the same text as strstr")
+{
+	MQChatLineMatcher matcher;
+	MQChatLineMatch match;
+
+	const char* lines[] = {
+		"Bob tells you, 'hi'",
+		"Bob tells you, 'Bob tells you, 'hi''",
+		"BOB TELLS YOU, 'HI'",
+		"Bob tells general:1, 'hi'",
+		"You told Bob, 'hi'",
+		"",
+	};
+
+	for (const char* line : lines)
+	{
+		matcher.Scan(line, match, nullptr, nullptr);
+
+		for (int i = 0; i < ChatLiteral_Count; ++i)
+		{
+			const std::string literal(s_chatLiterals[i]);
+			CHECK(match.Find(static_cast<eChatLiteral>(i)) == strstr(line, literal.c_str()));
+		}
+
+		CHECK(!match.feedMQ2Blech);
+		CHECK(!match.feedEventBlech);
+	}
+}
+
+TEST_CASE("MQChatLineMatcher only skips lines that blech would not have matched")
+{
+	std::mt19937 random(4321);
+
+	Recorder fedEverything;
+	Recorder fedMatches;
+	Blech mq2Blech('#');
+	Blech eventBlech('#');
+
+	// The same events, fed every line as before and fed only the lines that the matcher picks
+	struct Event
+	{
+		Blech* pBlech;
+		unsigned int everythingID;
+		unsigned int matchesID;
+	};
+	std::vector<Event> events;
+	Blech mq2BlechMatches('#');
+	Blech eventBlechMatches('#');
+
+	auto addEvent = [&](bool mq2)
+	{
+		const std::string text = RandomEvent(random);
+		Blech& everything = mq2 ? mq2Blech : eventBlech;
+		Blech& matches = mq2 ? mq2BlechMatches : eventBlechMatches;
+
+		events.push_back({ &everything,
+			everything.AddEvent(text.c_str(), Recorder::Callback, &fedEverything),
+			matches.AddEvent(text.c_str(), Recorder::Callback, &fedMatches) });
+	};
+
+	for (int i = 0; i < 4; ++i)
+	{
+		addEvent(true);
+		addEvent(false);
+	}
+
+	MQChatLineMatcher matcher;
+	MQChatLineMatch match;
+
+	int mismatches = 0;
+	int skipped = 0;
+
+	for (int i = 0; i < 20000; ++i)
+	{
+		// events come and go while the macro runs
+		if (i % 500 == 499)
+		{
+			const size_t index = random() % events.size();
+			const bool mq2 = events[index].pBlech == &mq2Blech;
+
+			(mq2 ? mq2Blech : eventBlech).RemoveEvent(events[index].everythingID);
+			(mq2 ? mq2BlechMatches : eventBlechMatches).RemoveEvent(events[index].matchesID);
+			events.erase(events.begin() + index);
+
+			addEvent(random() % 2 == 0);
+		}
+
+		const std::string line = RandomChatLine(random);
+
+		fedEverything.calls.clear();
+		FeedLine(mq2Blech, line);
+		FeedLine(eventBlech, line);
+
+		fedMatches.calls.clear();
+		matcher.Scan(line.c_str(), match, &mq2BlechMatches, &eventBlechMatches);
+
+		bool same = true;
+		for (int literal = 0; literal < ChatLiteral_Count; ++literal)
+		{
+			const std::string text(s_chatLiterals[literal]);
+			const char* expected = strstr(line.c_str(), text.c_str());
+			const char* found = match.Find(static_cast<eChatLiteral>(literal));
+
+			// compare offsets, since the line may be copied before the channel checks look at it
+			if ((expected == nullptr) != (found == nullptr)
+				|| (expected && expected - line.c_str() != found - match.szLine))
+			{
+				same = false;
+			}
+		}
+
+		if (match.feedMQ2Blech)
+			FeedLine(mq2BlechMatches, line);
+		if (match.feedEventBlech)
+			FeedLine(eventBlechMatches, line);
+
+		skipped += !match.feedMQ2Blech + !match.feedEventBlech;
+
+		// ids are handed out the same way by both pairs of blechs, so the calls compare directly
+		if (!same || fedEverything.calls != fedMatches.calls)
+		{
+			if (++mismatches <= 5)
+				printf("  mismatch: %s\n", line.c_str());
+		}
+	}
+
+	CHECK(mismatches == 0);
+
+	// and the point of it all: most lines don't need to go to blech at all
+	CHECK(skipped > 20000);
+}
+
+TEST_CASE("MQChatLineMatcher feeds every line to an event with no text")
+{
+	Recorder recorder;
+	Blech blech('#');
+	blech.AddEvent("#*#", Recorder::Callback, &recorder);
+
+	MQChatLineMatcher matcher;
+	MQChatLineMatch match;
+
+	matcher.Scan("anything at all", match, nullptr, &blech);
+	CHECK(!match.feedMQ2Blech);
+	CHECK(match.feedEventBlech);
+
+	blech.Reset();
+	blech.AddEvent("#*#slain#*#", Recorder::Callback, &recorder);
+
+	matcher.Scan("anything at all", match, nullptr, &blech);
+	CHECK(!match.feedEventBlech);
+
+	matcher.Scan("You have been SLAIN", match, nullptr, &blech);
+	CHECK(match.feedEventBlech);
+}
@@ -0,0 +1,323 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-present MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "UnitTest.h"
+
+#include "loader/ClientDirectory.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+// The parts of proto::routing::Address that the directory looks at.
+class FakeAddress
+{
+public:
+	FakeAddress(std::optional<std::string> account, std::optional<std::string> server, std::optional<std::string> character)
+		: m_account(std::move(account))
+		, m_server(std::move(server))
+		, m_character(std::move(character))
+	{
+	}
+
+	bool has_account() const { return m_account.has_value(); }
+	const std::string& account() const { return *m_account; }
+	bool has_server() const { return m_server.has_value(); }
+	const std::string& server() const { return *m_server; }
+	bool has_character() const { return m_character.has_value(); }
+	const std::string& character() const { return *m_character; }
+
+private:
+	std::optional<std::string> m_account;
+	std::optional<std::string> m_server;
+	std::optional<std::string> m_character;
+};
+
+using Payload = std::shared_ptr<const std::string>;
+
+// Stands in for the named pipe server: one connection per client, each of which keeps what it was
+// sent. A payload is shared the way PipeMessage::Share shares one buffer between messages.
+class FakePipeTransport
+{
+public:
+	explicit FakePipeTransport(const ClientDirectory& clients)
+	{
+		for (const auto& [pid, _] : clients)
+			m_connections[pid].reserve(64);
+	}
+
+	void Send(uint32_t pid, Payload payload)
+	{
+		m_connections[pid].push_back(std::move(payload));
+	}
+
+	const std::vector<Payload>& GetReceived(uint32_t pid) { return m_connections[pid]; }
+
+	void Clear()
+	{
+		for (auto& [_, received] : m_connections)
+			received.clear();
+	}
+
+private:
+	std::unordered_map<uint32_t, std::vector<Payload>> m_connections;
+};
+
+// How broadcasts were routed before: every client is compared against the address, and every
+// recipient gets its own copy of the message.
+void RouteByScan(const ClientDirectory& clients, const FakeAddress& address, const std::string& message,
+	FakePipeTransport& transport)
+{
+	for (const auto& [pid, id] : clients)
+	{
+		if (ClientDirectory::IsRecipient(address, id))
+			transport.Send(pid, std::make_shared<const std::string>(message));
+	}
+}
+
+// How the post office routes them now.
+void RouteByIndex(const ClientDirectory& clients, const FakeAddress& address, const Payload& message,
+	FakePipeTransport& transport)
+{
+	clients.ForEachRecipient(address, [&](uint32_t pid)
+		{
+			transport.Send(pid, message);
+			return true;
+		});
+}
+
+std::vector<uint32_t> ScanRecipients(const ClientDirectory& clients, const FakeAddress& address)
+{
+	std::vector<uint32_t> result;
+	for (const auto& [pid, id] : clients)
+	{
+		if (ClientDirectory::IsRecipient(address, id))
+			result.push_back(pid);
+	}
+
+	std::sort(result.begin(), result.end());
+	return result;
+}
+
+std::vector<uint32_t> IndexRecipients(const ClientDirectory& clients, const FakeAddress& address)
+{
+	std::vector<uint32_t> result;
+	clients.ForEachRecipient(address, [&](uint32_t pid) { result.push_back(pid); return true; });
+
+	std::sort(result.begin(), result.end());
+	return result;
+}
+
+std::string RandomCase(std::mt19937& random, std::string text)
+{
+	for (char& ch : text)
+	{
+		if (random() % 3 == 0)
+			ch = static_cast<char>(toupper(static_cast<unsigned char>(ch)));
+	}
+
+	return text;
+}
+
+const char* s_accounts[] = { "alpha", "bravo", "charlie", "delta", "echo", "" };
+const char* s_servers[] = { "bristle", "firiona", "test", "" };
+
+std::string CharacterName(int index)
+{
+	return "toon" + std::to_string(index);
+}
+
+// A 54 box setup: characters from a handful of accounts, spread across a few servers.
+void AddBoxes(ClientDirectory& clients, int count = 54)
+{
+	for (int i = 0; i < count; ++i)
+	{
+		clients.Set({ static_cast<uint32_t>(1000 + i), s_accounts[i % 5], s_servers[i % 3], CharacterName(i) });
+	}
+}
+
+FakeAddress RandomAddress(std::mt19937& random)
+{
+	std::optional<std::string> account, server, character;
+
+	if (random() % 2 == 0)
+		account = RandomCase(random, s_accounts[random() % std::size(s_accounts)]);
+	if (random() % 2 == 0)
+		server = RandomCase(random, s_servers[random() % std::size(s_servers)]);
+	if (random() % 3 == 0)
+		character = RandomCase(random, CharacterName(random() % 70));
+
+	return FakeAddress(account, server, character);
+}
+
+} // namespace
+
+TEST_CASE("ClientDirectory finds the same recipients as a scan of every client")
+{
+	std::mt19937 random(909);
+	ClientDirectory clients;
+	AddBoxes(clients);
+
+	int mismatches = 0;
+	for (int i = 0; i < 20000; ++i)
+	{
+		// clients come, go and change characters while messages are being routed
+		const uint32_t pid = 1000 + random() % 70;
+		switch (random() % 8)
+		{
+		case 0:
+			if (auto iter = clients.find(pid); iter != clients.end())
+				clients.Remove(iter);
+			break;
+
+		case 1:
+			clients.Set({ pid, s_accounts[random() % std::size(s_accounts)], s_servers[random() % std::size(s_servers)],
+				CharacterName(random() % 70) });
+			break;
+
+		default:
+			break;
+		}
+
+		const FakeAddress address = RandomAddress(random);
+		const std::vector<uint32_t> expected = ScanRecipients(clients, address);
+
+		uint32_t recipient = 0;
+		const int count = clients.CountRecipients(address, recipient);
+
+		if (IndexRecipients(clients, address) != expected
+			|| count != static_cast<int>(std::min<size_t>(expected.size(), 2))
+			|| (count == 1 && recipient != expected[0]))
+		{
+			++mismatches;
+		}
+	}
+
+	CHECK(mismatches == 0);
+}
+
+TEST_CASE("ClientDirectory replaces and removes identities")
+{
+	ClientDirectory clients;
+
+	CHECK(clients.Set({ 1, "alpha", "bristle", "toon1" }));
+	CHECK(!clients.Set({ 1, "alpha", "bristle", "toon2" }));
+	CHECK(clients.size() == 1);
+
+	CHECK(IndexRecipients(clients, FakeAddress(std::nullopt, std::nullopt, "toon1")).empty());
+	CHECK(IndexRecipients(clients, FakeAddress(std::nullopt, std::nullopt, "TOON2")) == std::vector<uint32_t>({ 1 }));
+
+	clients.Remove(clients.find(1));
+	CHECK(clients.size() == 0);
+	CHECK(IndexRecipients(clients, FakeAddress("alpha", std::nullopt, std::nullopt)).empty());
+	CHECK(IndexRecipients(clients, FakeAddress(std::nullopt, std::nullopt, std::nullopt)).empty());
+}
+
+TEST_CASE("ClientDirectory broadcasts share one payload over a fake pipe transport")
+{
+	ClientDirectory clients;
+	AddBoxes(clients);
+
+	FakePipeTransport transport(clients);
+	const std::string message(1024, 'x');
+
+	// everyone on one server
+	const FakeAddress address(std::nullopt, "Firiona", std::nullopt);
+	const std::vector<uint32_t> recipients = ScanRecipients(clients, address);
+	CHECK(recipients.size() == 18);
+
+	size_t allocations = mq::test::GetAllocationCount();
+	RouteByScan(clients, address, message, transport);
+	const size_t scanAllocations = mq::test::GetAllocationCount() - allocations;
+
+	for (uint32_t pid : recipients)
+		CHECK(transport.GetReceived(pid).size() == 1);
+	transport.Clear();
+
+	const Payload payload = std::make_shared<const std::string>(message);
+
+	allocations = mq::test::GetAllocationCount();
+	RouteByIndex(clients, address, payload, transport);
+	const size_t indexAllocations = mq::test::GetAllocationCount() - allocations;
+
+	// every recipient got the same buffer, and nobody else got anything
+	for (const auto& [pid, _] : clients)
+	{
+		const auto& received = transport.GetReceived(pid);
+		const bool isRecipient = std::binary_search(recipients.begin(), recipients.end(), pid);
+
+		CHECK(received.size() == (isRecipient ? 1u : 0u));
+		CHECK(received.empty() || received[0] == payload);
+	}
+
+	CHECK(payload.use_count() == static_cast<long>(recipients.size()) + 1);
+
+	// a copy per recipient before, nothing now
+	CHECK(scanAllocations >= recipients.size());
+	CHECK(indexAllocations == 0);
+}
+
+TEST_CASE("ClientDirectory broadcast routing benchmark")
+{
+	ClientDirectory clients;
+	AddBoxes(clients);
+
+	FakePipeTransport transport(clients);
+	const std::string message(1024, 'x');
+	const Payload payload = std::make_shared<const std::string>(message);
+
+	const FakeAddress addresses[] = {
+		FakeAddress(std::nullopt, "firiona", std::nullopt),
+		FakeAddress("Bravo", std::nullopt, std::nullopt),
+		FakeAddress(std::nullopt, std::nullopt, "Toon17"),
+		FakeAddress("charlie", "test", std::nullopt),
+	};
+
+	constexpr int Iterations = 2000;
+	using Clock = std::chrono::steady_clock;
+
+	auto scanStart = Clock::now();
+	for (int i = 0; i < Iterations; ++i)
+	{
+		for (const FakeAddress& address : addresses)
+			RouteByScan(clients, address, message, transport);
+		transport.Clear();
+	}
+	auto scanTime = Clock::now() - scanStart;
+
+	auto indexStart = Clock::now();
+	for (int i = 0; i < Iterations; ++i)
+	{
+		for (const FakeAddress& address : addresses)
+			RouteByIndex(clients, address, payload, transport);
+		transport.Clear();
+	}
+	auto indexTime = Clock::now() - indexStart;
+
+	CHECK(indexTime < scanTime);
+
+	const double broadcasts = static_cast<double>(Iterations) * std::size(addresses);
+	printf("  scan and copy: %.1f ns/broadcast, index and share: %.1f ns/broadcast\n",
+		std::chrono::duration<double, std::nano>(scanTime).count() / broadcasts,
+		std::chrono::duration<double, std::nano>(indexTime).count() / broadcasts);
+}
@@ -0,0 +1,220 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-present MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "UnitTest.h"
+
+#include "main/MQCommandIndex.h"
+
+#include <cctype>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace mq;
+
+namespace {
+
+struct TestCommand
+{
+	std::string command;
+	bool inGameOnly = false;
+	bool eq = false;
+	TestCommand* pNext = nullptr;
+};
+
+class CommandList
+{
+public:
+	// Inserts in sorted order, the same way MQCommandAPI::AddCommand does
+	bool Add(std::string_view command, bool inGameOnly, bool eq = false)
+	{
+		auto pCommand = std::make_unique<TestCommand>();
+		pCommand->command = command;
+		pCommand->inGameOnly = inGameOnly;
+		pCommand->eq = eq;
+
+		TestCommand** ppLink = &m_pCommands;
+		while (*ppLink)
+		{
+			int compare = ci_string_compare(pCommand->command, (*ppLink)->command);
+			if (compare == 0 && !(*ppLink)->eq)
+				return false;
+			if (compare <= 0)
+				break;
+
+			ppLink = &(*ppLink)->pNext;
+		}
+
+		pCommand->pNext = *ppLink;
+		*ppLink = pCommand.get();
+		m_commands.push_back(std::move(pCommand));
+		return true;
+	}
+
+	void Remove(std::string_view command)
+	{
+		for (TestCommand** ppLink = &m_pCommands; *ppLink; ppLink = &(*ppLink)->pNext)
+		{
+			if (ci_equals((*ppLink)->command, command))
+			{
+				*ppLink = (*ppLink)->pNext;
+				return;
+			}
+		}
+	}
+
+	TestCommand* Head() const { return m_pCommands; }
+
+private:
+	TestCommand* m_pCommands = nullptr;
+	std::vector<std::unique_ptr<TestCommand>> m_commands;
+};
+
+// _strnicmp, including the terminator when one string is shorter than count
+int CompareNoCase(const char* a, const char* b, size_t count)
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		const int ca = std::tolower(static_cast<unsigned char>(a[i]));
+		const int cb = std::tolower(static_cast<unsigned char>(b[i]));
+
+		if (ca != cb)
+			return ca - cb;
+		if (ca == 0)
+			break;
+	}
+
+	return 0;
+}
+
+// The walk that DispatchCommand did before the index
+TestCommand* LinearFind(TestCommand* pCommands, const std::string& name, bool inGame)
+{
+	for (TestCommand* pCommand = pCommands; pCommand; pCommand = pCommand->pNext)
+	{
+		if (pCommand->inGameOnly && !inGame)
+			continue;
+
+		const int pos = CompareNoCase(name.c_str(), pCommand->command.c_str(), name.length());
+		if (pos < 0)
+			break;
+		if (pos == 0)
+			return pCommand;
+	}
+
+	return nullptr;
+}
+
+bool MatchesLinearFind(MQCommandIndex<TestCommand>& index, const CommandList& list, const std::string& name)
+{
+	return index.Find(list.Head(), name, true) == LinearFind(list.Head(), name, true)
+		&& index.Find(list.Head(), name, false) == LinearFind(list.Head(), name, false);
+}
+
+} // namespace
+
+TEST_CASE("Command index resolves abbreviations like the list walk")
+{
+	CommandList list;
+	list.Add("/who", true);
+	list.Add("/whofilter", true);
+	list.Add("/whotarget", true);
+	list.Add("/where", true);
+	list.Add("/while", false);
+	list.Add("/windowstate", false);
+	list.Add("/target", true);
+	list.Add("/tell", false, true);
+	list.Add("/TELL", false);
+	list.Add("/timed", false);
+
+	MQCommandIndex<TestCommand> index;
+
+	CHECK(index.Find(list.Head(), "/whot", true)->command == "/whotarget");
+	CHECK(index.Find(list.Head(), "/WH", true)->command == "/where");
+	CHECK(index.Find(list.Head(), "/whe", false) == nullptr);
+	CHECK(index.Find(list.Head(), "/w", false)->command == "/while");
+	CHECK(index.Find(list.Head(), "/who", false) == nullptr);
+	CHECK(index.Find(list.Head(), "/tell", true)->command == "/TELL");
+	CHECK(index.Find(list.Head(), "/x", true) == nullptr);
+	CHECK(index.Find(list.Head(), "/whotargets", true) == nullptr);
+
+	const char* queries[] = {
+		"", "/", "/w", "/wh", "/who", "/WHO", "/whof", "/whe", "/wi", "/t", "/ta", "/te", "/ti",
+		"/tell", "/timed", "/timedx", "/u", "a", "/whotarget", "/WhoTarget",
+	};
+
+	for (const char* query : queries)
+		CHECK(MatchesLinearFind(index, list, query));
+
+	// removing commands leaves views into freed names, so the index is rebuilt
+	list.Remove("/who");
+	list.Remove("/while");
+	index.Invalidate();
+
+	for (const char* query : queries)
+		CHECK(MatchesLinearFind(index, list, query));
+}
+
+TEST_CASE("Command index matches the list walk for generated commands")
+{
+	std::mt19937 random(1234);
+	const char alphabet[] = "/aAbB_z";
+
+	auto randomName = [&](size_t maxLength)
+	{
+		std::string name;
+		const size_t length = std::uniform_int_distribution<size_t>(1, maxLength)(random);
+		for (size_t i = 0; i < length; ++i)
+			name += alphabet[std::uniform_int_distribution<size_t>(0, sizeof(alphabet) - 2)(random)];
+		return name;
+	};
+
+	for (int round = 0; round < 20; ++round)
+	{
+		CommandList list;
+		std::vector<std::string> names;
+
+		for (int i = 0; i < 60; ++i)
+		{
+			std::string name = randomName(6);
+			if (list.Add(name, random() % 2 == 0, random() % 8 == 0))
+				names.push_back(name);
+		}
+
+		MQCommandIndex<TestCommand> index;
+		int mismatches = 0;
+
+		for (const std::string& name : names)
+		{
+			for (size_t length = 0; length <= name.length() + 1; ++length)
+			{
+				std::string query = name.substr(0, length);
+				if (length > name.length())
+					query += 'a';
+
+				if (!MatchesLinearFind(index, list, query))
+					++mismatches;
+			}
+		}
+
+		for (int i = 0; i < 200; ++i)
+		{
+			if (!MatchesLinearFind(index, list, randomName(7)))
+				++mismatches;
+		}
+
+		CHECK(mismatches == 0);
+	}
+}
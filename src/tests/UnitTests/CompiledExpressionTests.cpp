@@ -0,0 +1,747 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-present MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "UnitTest.h"
+
+#include "mq/base/Common.h"
+#include "mq/base/LRUCache.h"
+#include "main/MQCompiledExpression.h"
+
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace mq;
+
+namespace {
+
+//============================================================================
+// Stub data types and top-level objects
+
+struct StubType;
+
+struct StubVar
+{
+	const StubType* Type = nullptr;
+	const void* Ptr = nullptr;
+	int64_t Int = 0;
+};
+
+using StubMember = bool(*)(StubVar& Var, const char* Index);
+
+// Stubs are looked up with a linear search, so that the benchmark mostly measures the parser.
+struct StubMemberEntry
+{
+	const char* Name;
+	StubMember Function;
+};
+
+using StubMembers = std::vector<StubMemberEntry>;
+
+StubMember FindStubMember(const StubMembers& members, const char* Name)
+{
+	for (const StubMemberEntry& entry : members)
+	{
+		if (strcmp(entry.Name, Name) == 0)
+			return entry.Function;
+	}
+
+	return nullptr;
+}
+
+struct StubType
+{
+	const char* Name;
+	bool (*ToString)(const StubVar& Var, char* Destination);
+	StubMembers Members;
+};
+
+struct StubBuff
+{
+	const char* Name;
+	int Duration;
+};
+
+struct StubSpawn
+{
+	const char* Name;
+	int Level;
+	int PctHPs;
+	int Distance;
+	StubBuff Buffs[3];
+};
+
+const StubSpawn s_spawns[] = {
+	{ "Fippy", 60, 87, 0, { { "Spirit of Wolf", 3600 }, { "Clarity", 1200 }, { "Aegolism", 9000 } } },
+	{ "a_decaying_skeleton", 2, 45, 38, { { "Chill", 6 } } },
+	{ "Guard_Leafrunner", 45, 100, 120, {} },
+};
+
+bool StringToString(const StubVar& Var, char* Destination)
+{
+	// the stub strings are all short
+	const char* str = static_cast<const char*>(Var.Ptr);
+	memcpy(Destination, str, strlen(str) + 1);
+	return true;
+}
+
+bool IntToString(const StubVar& Var, char* Destination)
+{
+	*std::to_chars(Destination, Destination + MAX_STRING - 1, Var.Int).ptr = 0;
+	return true;
+}
+
+bool BuffToString(const StubVar& Var, char* Destination)
+{
+	return StringToString({ nullptr, static_cast<const StubBuff*>(Var.Ptr)->Name }, Destination);
+}
+
+bool SpawnToString(const StubVar& Var, char* Destination)
+{
+	return StringToString({ nullptr, static_cast<const StubSpawn*>(Var.Ptr)->Name }, Destination);
+}
+
+StubType s_stringType{ "string", StringToString };
+StubType s_intType{ "int", IntToString };
+StubType s_buffType{ "buff", BuffToString };
+StubType s_spawnType{ "spawn", SpawnToString };
+
+bool SetInt(StubVar& Var, int64_t Value)
+{
+	Var.Type = &s_intType;
+	Var.Int = Value;
+	return true;
+}
+
+bool SetString(StubVar& Var, const char* Value)
+{
+	Var.Type = &s_stringType;
+	Var.Ptr = Value;
+	return true;
+}
+
+bool SetSpawn(StubVar& Var, const char* Name)
+{
+	for (const StubSpawn& spawn : s_spawns)
+	{
+		if (!*Name || strcmp(spawn.Name, Name) == 0)
+		{
+			Var.Type = &s_spawnType;
+			Var.Ptr = &spawn;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+const StubSpawn& AsSpawn(const StubVar& Var) { return *static_cast<const StubSpawn*>(Var.Ptr); }
+const StubBuff& AsBuff(const StubVar& Var) { return *static_cast<const StubBuff*>(Var.Ptr); }
+
+void RegisterStubTypes()
+{
+	if (!s_spawnType.Members.empty())
+		return;
+
+	s_spawnType.Members = {
+		{ "Name", [](StubVar& Var, const char*) { return SetString(Var, AsSpawn(Var).Name); } },
+		{ "Level", [](StubVar& Var, const char*) { return SetInt(Var, AsSpawn(Var).Level); } },
+		{ "PctHPs", [](StubVar& Var, const char*) { return SetInt(Var, AsSpawn(Var).PctHPs); } },
+		{ "Distance", [](StubVar& Var, const char*) { return SetInt(Var, AsSpawn(Var).Distance); } },
+		{ "Buff", [](StubVar& Var, const char* Index)
+			{
+				const StubSpawn& spawn = AsSpawn(Var);
+				const int slot = (Index[0] >= '1' && Index[0] <= '9' && !Index[1]) ? Index[0] - '0' : 0;
+
+				for (int i = 0; i < 3; ++i)
+				{
+					const StubBuff& buff = spawn.Buffs[i];
+					if (buff.Name && (slot == i + 1 || strcmp(buff.Name, Index) == 0))
+					{
+						Var.Type = &s_buffType;
+						Var.Ptr = &buff;
+						return true;
+					}
+				}
+
+				return false;
+			}
+		},
+	};
+
+	s_buffType.Members = {
+		{ "Name", [](StubVar& Var, const char*) { return SetString(Var, AsBuff(Var).Name); } },
+		{ "Duration", [](StubVar& Var, const char*) { return SetInt(Var, AsBuff(Var).Duration); } },
+	};
+
+	s_stringType.Members = {
+		{ "Length", [](StubVar& Var, const char*) { return SetInt(Var, strlen(static_cast<const char*>(Var.Ptr))); } },
+	};
+}
+
+const StubMembers s_topLevelObjects = {
+	{ "Me", [](StubVar& Var, const char*) { return SetSpawn(Var, "Fippy"); } },
+	{ "Target", [](StubVar& Var, const char*) { return SetSpawn(Var, "a_decaying_skeleton"); } },
+	{ "Spawn", [](StubVar& Var, const char* Index) { return SetSpawn(Var, Index); } },
+};
+
+int s_errors = 0;
+
+void StubDataError()
+{
+	++s_errors;
+}
+
+bool StubEvaluateDataExpression(StubVar& Result, const char* Name, const char* Index)
+{
+	if (!Result.Type)
+	{
+		StubMember tlo = FindStubMember(s_topLevelObjects, Name);
+		if (!tlo)
+		{
+			StubDataError();
+			return false;
+		}
+
+		return tlo(Result, Index);
+	}
+
+	StubMember member = FindStubMember(Result.Type->Members, Name);
+	if (!member)
+	{
+		StubDataError();
+		return false;
+	}
+
+	return member(Result, Index);
+}
+
+const StubType* StubFindDataType(const char* Name)
+{
+	for (const StubType* type : { &s_stringType, &s_intType, &s_buffType, &s_spawnType })
+	{
+		if (strcmp(type->Name, Name) == 0)
+			return type;
+	}
+
+	return nullptr;
+}
+
+//============================================================================
+// The parser as it was before compilation: ModifyMacroString, ParseMacroVar, GetMacroVarData
+// and ParseMQ2DataPortion re-scanning the text on every call.
+
+std::string LegacyModifyMacroString(std::string_view strOriginal);
+
+bool LegacyParseDataPortion(char* szOriginal, StubVar& Result)
+{
+	Result = {};
+
+	char Index[MAX_STRING] = { 0 };
+
+	char* pPos = &szOriginal[0];
+	char* pStart = pPos;
+	char* pIndex = &Index[0];
+	bool Quote = false;
+
+	while (true)
+	{
+		if (*pPos == 0)
+		{
+			if (pStart == pPos)
+			{
+				if (!Result.Type)
+				{
+					StubDataError();
+					return false;
+				}
+
+				return true;
+			}
+
+			return StubEvaluateDataExpression(Result, pStart, pIndex);
+		}
+
+		if (*pPos == '(')
+		{
+			*pPos = 0;
+			if (pStart == pPos)
+			{
+				if (!Result.Type)
+				{
+					StubDataError();
+					return false;
+				}
+
+				return true;
+			}
+
+			if (!StubEvaluateDataExpression(Result, pStart, pIndex))
+				return false;
+
+			if (!Result.Type)
+				return false;
+
+			++pPos;
+			char* pType = pPos;
+
+			while (*pPos != ')')
+			{
+				if (!*pPos)
+				{
+					StubDataError();
+					return false;
+				}
+				++pPos;
+			}
+
+			*pPos = 0;
+
+			const StubType* pNewType = StubFindDataType(pType);
+			if (!pNewType)
+			{
+				StubDataError();
+				return false;
+			}
+
+			Result.Type = pNewType;
+
+			if (pPos[1] == '.')
+			{
+				++pPos;
+				pStart = &pPos[1];
+			}
+			else if (!pPos[1])
+			{
+				return true;
+			}
+			else
+			{
+				StubDataError();
+				return false;
+			}
+		}
+		else if (*pPos == '[')
+		{
+			*pPos = 0;
+			++pPos;
+			Quote = false;
+			bool BeginParam = true;
+
+			while (true)
+			{
+				if (*pPos == 0)
+				{
+					StubDataError();
+					return false;
+				}
+
+				if (BeginParam)
+				{
+					BeginParam = false;
+					if (*pPos == '\"')
+					{
+						Quote = true;
+						++pPos;
+						continue;
+					}
+				}
+
+				if (Quote)
+				{
+					if (*pPos == '\"')
+					{
+						if (pPos[1] == ']' || pPos[1] == ',')
+						{
+							Quote = false;
+							++pPos;
+							continue;
+						}
+					}
+				}
+				else
+				{
+					if (*pPos == ']')
+					{
+						if (pPos[1] == '.' || pPos[1] == '(' || pPos[1] == 0)
+							break;
+					}
+					else if (*pPos == ',')
+						BeginParam = true;
+				}
+
+				*pIndex = *pPos;
+				++pIndex;
+				++pPos;
+			}
+
+			*pIndex = 0;
+			pIndex = &Index[0];
+			*pPos = 0;
+		}
+		else if (*pPos == '.')
+		{
+			*pPos = 0;
+			if (pStart == pPos)
+			{
+				if (!Result.Type)
+				{
+					StubDataError();
+					return false;
+				}
+
+				return true;
+			}
+
+			if (!StubEvaluateDataExpression(Result, pStart, pIndex))
+				return false;
+
+			pStart = &pPos[1];
+			Index[0] = 0;
+		}
+
+		++pPos;
+	}
+}
+
+std::string LegacyGetMacroVarData(std::string_view strVarToParse)
+{
+	std::string strReturn = "NULL";
+
+	if (strVarToParse.substr(0, 2) == "${"
+		&& strVarToParse.substr(strVarToParse.length() - 1) == "}")
+	{
+		strVarToParse = strVarToParse.substr(2, strVarToParse.length() - 3);
+
+		std::string currentStr{ strVarToParse };
+		currentStr.resize(MAX_STRING);
+
+		StubVar Result;
+		if (LegacyParseDataPortion(&currentStr[0], Result) && Result.Type && Result.Type->ToString(Result, &currentStr[0]))
+		{
+			strReturn = currentStr.erase(currentStr.find('\0'));
+		}
+	}
+
+	return strReturn;
+}
+
+std::string LegacyParseMacroVar(std::string_view strOriginal)
+{
+	std::string strReturn{ strOriginal };
+	size_t iCurrentPosition = strReturn.length();
+
+	while (iCurrentPosition > 0)
+	{
+		const size_t iPosition = strReturn.rfind("${", iCurrentPosition - 1);
+		if (iPosition == std::string::npos)
+			break;
+
+		const size_t iCloseBrace = FindMacroClosingBrace(strReturn, iPosition);
+		if (iCloseBrace != std::string::npos)
+		{
+			std::string strVarToParse = strReturn.substr(iPosition, iCloseBrace - iPosition);
+			std::string strParsedVar = LegacyGetMacroVarData(strVarToParse);
+
+			if (strVarToParse != strParsedVar)
+			{
+				if (strParsedVar.find("${") != std::string::npos)
+					strParsedVar = LegacyModifyMacroString(strParsedVar);
+
+				strReturn.replace(iPosition, iCloseBrace - iPosition, strParsedVar);
+			}
+		}
+
+		iCurrentPosition = iPosition;
+	}
+
+	return strReturn;
+}
+
+std::string LegacyModifyMacroString(std::string_view strOriginal)
+{
+	std::string strReturn;
+	size_t iCurrentPosition = 0;
+
+	while (iCurrentPosition != std::string::npos)
+	{
+		const size_t iNewPosition = strOriginal.find("${", iCurrentPosition);
+		if (iNewPosition == std::string::npos)
+		{
+			strReturn += strOriginal.substr(iCurrentPosition);
+			break;
+		}
+
+		strReturn += strOriginal.substr(iCurrentPosition, iNewPosition - iCurrentPosition);
+
+		const size_t iBracePosition = FindMacroClosingBrace(strOriginal, iNewPosition);
+		if (iBracePosition == std::string::npos)
+		{
+			strReturn += strOriginal.substr(iNewPosition);
+			break;
+		}
+
+		strReturn.append(LegacyParseMacroVar(strOriginal.substr(iNewPosition, iBracePosition - iNewPosition)));
+		iCurrentPosition = iBracePosition;
+	}
+
+	return strReturn;
+}
+
+//============================================================================
+// The compiled path, as MQDataAPI runs it: cached compiled strings and expressions, evaluated
+// against the same stubs.
+
+class StubDataAPI
+{
+public:
+	std::string ModifyMacroString(std::string_view strOriginal) const
+	{
+		if (strOriginal.find("${") == std::string::npos)
+			return std::string(strOriginal);
+
+		auto compiled = m_compiledStrings.FindOrCreate(strOriginal,
+			[this](std::string_view str)
+			{
+				return CompileMacroString(str, [this](std::string_view expr)
+					{
+						return m_compiledExpressions.FindOrCreate(expr, CompileDataExpression);
+					});
+			});
+
+		return EvaluateCompiledMacroString(*compiled);
+	}
+
+	size_t GetExpressionCount() const { return m_compiledExpressions.Size(); }
+
+private:
+	std::string EvaluateCompiledMacroString(const MQCompiledMacroString& compiled) const
+	{
+		std::string strReturn;
+
+		for (const auto& segment : compiled.Segments)
+		{
+			if (!segment.Variable)
+			{
+				strReturn.append(segment.Text);
+			}
+			else if (!segment.Expression)
+			{
+				strReturn.append(LegacyParseMacroVar(segment.Text));
+			}
+			else
+			{
+				std::string_view strParsedVar = "NULL";
+
+				char szResult[MAX_STRING];
+				StubVar Result;
+
+				if (EvaluateCompiledDataExpression(*segment.Expression, Result)
+					&& Result.Type && Result.Type->ToString(Result, szResult))
+				{
+					strParsedVar = szResult;
+				}
+
+				if (strParsedVar != segment.Text && strParsedVar.find("${") != std::string::npos)
+					strReturn.append(ModifyMacroString(strParsedVar));
+				else
+					strReturn.append(strParsedVar);
+			}
+		}
+
+		return strReturn;
+	}
+
+	bool EvaluateCompiledDataExpression(const MQCompiledDataExpression& expr, StubVar& Result) const
+	{
+		using OpType = MQCompiledDataExpression::OpType;
+
+		Result = {};
+		char Index[MAX_STRING];
+
+		for (const auto& op : expr.Ops)
+		{
+			switch (op.Type)
+			{
+			case OpType::Evaluate:
+				// the same scratch copy as strncpy_s(Index, op.Index.c_str(), _TRUNCATE)
+				if (op.Index.size() < MAX_STRING)
+					memcpy(Index, op.Index.c_str(), op.Index.size() + 1);
+				else
+					Index[op.Index.copy(Index, MAX_STRING - 1)] = 0;
+
+				if (!StubEvaluateDataExpression(Result, op.Name.c_str(), Index))
+					return false;
+				break;
+
+			case OpType::RequireType:
+				if (!Result.Type)
+					return false;
+				break;
+
+			case OpType::Cast:
+				if (const StubType* pNewType = StubFindDataType(op.Name.c_str()))
+				{
+					Result.Type = pNewType;
+				}
+				else
+				{
+					StubDataError();
+					return false;
+				}
+				break;
+
+			case OpType::End:
+				if (!Result.Type)
+				{
+					StubDataError();
+					return false;
+				}
+				return true;
+
+			case OpType::Error:
+				StubDataError();
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	mutable LRUCache<MQCompiledDataExpression> m_compiledExpressions{ 2048 };
+	mutable LRUCache<MQCompiledMacroString> m_compiledStrings{ 1024 };
+};
+
+// The kind of strings a HUD evaluates every frame: mostly one value per element, with a label.
+const char* s_hudStrings[] = {
+	"${Me.Name}",
+	"HP: ${Me.PctHPs}%",
+	"${Target.Name}",
+	"${Target.PctHPs}%",
+	"Dist: ${Target.Distance}",
+	"${Me.Name} (${Me.Level})",
+	"${Me.Buff[1].Name}: ${Me.Buff[1].Duration}",
+	"SoW: ${Me.Buff[Spirit of Wolf].Duration} Aego: ${Me.Buff[\"Aegolism\"].Duration}",
+	"${Spawn[Guard_Leafrunner].Name} L${Spawn[Guard_Leafrunner].Level}",
+	"${Target.Name.Length} ${Me(spawn).Level} ${Target.Buff[1](buff).Name}",
+};
+
+} // namespace
+
+TEST_CASE("Compiled macro strings match the uncompiled parser")
+{
+	RegisterStubTypes();
+	StubDataAPI dataAPI;
+
+	std::vector<std::string> strings(std::begin(s_hudStrings), std::end(s_hudStrings));
+	strings.insert(strings.end(), {
+		"", "no variables", "${", "${Me.Name", "}${Me.Name}}", "${}", "${Me.}", "${.Name}", "${Missing}",
+		"${Me.Missing}", "${Me.Buff[9].Name}", "${Me.Buff[1.Name}", "${Me(int}", "${Me(missing)}",
+		"${Me(int)x}", "${(int)}", "${Spawn[${Target.Name}].Level}", "${Spawn[${Spawn[Fippy].Name}].Level}",
+		"${Me.Buff[${Me.Buff[2].Name}].Duration} and ${Me.Name}", "${Spawn[\"a_decaying_skeleton\"].Name}",
+	});
+
+	for (const std::string& str : strings)
+	{
+		// twice, so that the second one comes from the cache
+		for (int i = 0; i < 2; ++i)
+		{
+			s_errors = 0;
+			const std::string legacy = LegacyModifyMacroString(str);
+			const int legacyErrors = s_errors;
+
+			s_errors = 0;
+			const std::string compiled = dataAPI.ModifyMacroString(str);
+
+			CHECK(legacy == compiled);
+			CHECK(legacyErrors == s_errors);
+
+			if (legacy != compiled)
+				printf("  mismatch: '%s' -> '%s' / '%s'\n", str.c_str(), legacy.c_str(), compiled.c_str());
+		}
+	}
+
+	CHECK(dataAPI.ModifyMacroString("${Me.Name} (${Me.Level}) HP: ${Me.PctHPs}%") == "Fippy (60) HP: 87%");
+	CHECK(dataAPI.ModifyMacroString(s_hudStrings[7]) == "SoW: 3600 Aego: 9000");
+	CHECK(dataAPI.ModifyMacroString("${Spawn[${Target.Name}].Level}") == "2");
+}
+
+TEST_CASE("Compiled macro strings share expressions")
+{
+	RegisterStubTypes();
+	StubDataAPI dataAPI;
+
+	dataAPI.ModifyMacroString("${Me.Name} ${Me.Level}");
+	dataAPI.ModifyMacroString("[${Me.Level}] ${Me.Name}");
+	CHECK(dataAPI.GetExpressionCount() == 2);
+}
+
+TEST_CASE("Compiled macro string benchmark")
+{
+	RegisterStubTypes();
+	StubDataAPI dataAPI;
+
+	// Each side takes its best of several rounds, so that a hiccup in one round doesn't decide it.
+	constexpr int Rounds = 5;
+	constexpr int Iterations = 5000;
+
+	using Clock = std::chrono::steady_clock;
+	Clock::duration legacyTime = Clock::duration::max();
+	Clock::duration compiledTime = Clock::duration::max();
+	size_t legacyAllocations = 0;
+	size_t compiledAllocations = 0;
+	size_t legacyLength = 0;
+	size_t compiledLength = 0;
+
+	for (int round = 0; round < Rounds; ++round)
+	{
+		size_t allocations = test::GetAllocationCount();
+		auto legacyStart = Clock::now();
+		for (int i = 0; i < Iterations; ++i)
+		{
+			for (const char* str : s_hudStrings)
+				legacyLength += LegacyModifyMacroString(str).length();
+		}
+		legacyTime = std::min(legacyTime, Clock::now() - legacyStart);
+		legacyAllocations += test::GetAllocationCount() - allocations;
+
+		allocations = test::GetAllocationCount();
+		auto compiledStart = Clock::now();
+		for (int i = 0; i < Iterations; ++i)
+		{
+			for (const char* str : s_hudStrings)
+				compiledLength += dataAPI.ModifyMacroString(str).length();
+		}
+		compiledTime = std::min(compiledTime, Clock::now() - compiledStart);
+		compiledAllocations += test::GetAllocationCount() - allocations;
+	}
+
+	CHECK(legacyLength == compiledLength);
+
+	const double strings = static_cast<double>(Iterations) * std::size(s_hudStrings);
+	const double legacyNs = std::chrono::duration<double, std::nano>(legacyTime).count() / strings;
+	const double compiledNs = std::chrono::duration<double, std::nano>(compiledTime).count() / strings;
+
+	printf("  uncompiled: %.1f ns/string, %.1f allocations/string\n", legacyNs, legacyAllocations / (strings * Rounds));
+	printf("  compiled:   %.1f ns/string, %.1f allocations/string (%.1fx)\n", compiledNs,
+		compiledAllocations / (strings * Rounds), legacyNs / compiledNs);
+
+	// Timings on a shared machine are noisy, so the time check leaves some room. The allocations
+	// are exact: a compiled string only allocates for a result that doesn't fit in place.
+	CHECK(legacyNs >= 3 * compiledNs);
+	CHECK(legacyAllocations >= 10 * compiledAllocations);
+}
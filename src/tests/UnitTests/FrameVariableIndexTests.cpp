@@ -0,0 +1,204 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-present MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "UnitTest.h"
+
+#include "main/MQFrameVariableIndex.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace mq;
+
+namespace {
+
+// The parts of MQDataVar that a frame's index looks at.
+struct TestVar
+{
+	char szName[64];
+	TestVar* pNext = nullptr;
+};
+
+// A stack frame with its two variable lists. New variables go on the head of a list, as they do
+// in MQ2DataVars.
+class TestFrame
+{
+public:
+	TestVar* AddParameter(const char* name) { return Add(Parameters, name, true); }
+	TestVar* AddLocal(const char* name) { return Add(LocalVariables, name, false); }
+
+	void Delete(TestVar* pVar)
+	{
+		Index.Remove(pVar, Parameters, LocalVariables);
+
+		for (TestVar** ppVar : { &Parameters, &LocalVariables })
+		{
+			for (; *ppVar; ppVar = &(*ppVar)->pNext)
+			{
+				if (*ppVar == pVar)
+				{
+					*ppVar = pVar->pNext;
+					return;
+				}
+			}
+		}
+	}
+
+	// The lookup that FindMacroVariable did before frames were indexed.
+	TestVar* FindByScan(const char* name) const
+	{
+		for (TestVar* pVar = Parameters; pVar; pVar = pVar->pNext)
+		{
+			if (!strcmp(pVar->szName, name))
+				return pVar;
+		}
+
+		for (TestVar* pVar = LocalVariables; pVar; pVar = pVar->pNext)
+		{
+			if (!strcmp(pVar->szName, name))
+				return pVar;
+		}
+
+		return nullptr;
+	}
+
+	TestVar* Parameters = nullptr;
+	TestVar* LocalVariables = nullptr;
+	MQFrameVariableIndex<TestVar> Index;
+
+private:
+	TestVar* Add(TestVar*& pHead, const char* name, bool isParameter)
+	{
+		auto& pVar = m_storage.emplace_back(std::make_unique<TestVar>());
+		snprintf(pVar->szName, sizeof(pVar->szName), "%s", name);
+
+		pVar->pNext = pHead;
+		pHead = pVar.get();
+		Index.Add(pVar.get(), isParameter);
+		return pVar.get();
+	}
+
+	std::vector<std::unique_ptr<TestVar>> m_storage;
+};
+
+// Builds a frame with the given number of locals and a few parameters.
+void FillFrame(TestFrame& frame, int localCount)
+{
+	for (int i = 0; i < 4; ++i)
+		frame.AddParameter(("Param" + std::to_string(i)).c_str());
+
+	for (int i = 0; i < localCount; ++i)
+		frame.AddLocal(("LocalVariable" + std::to_string(i)).c_str());
+}
+
+using Clock = std::chrono::steady_clock;
+
+// Time per lookup of a mix of names from every part of the frame, best of a few rounds.
+template <typename Lookup>
+double TimeLookups(const std::vector<std::string>& names, Lookup&& lookup)
+{
+	constexpr int Iterations = 2000;
+	double best = 1e300;
+	size_t found = 0;
+
+	for (int round = 0; round < 5; ++round)
+	{
+		auto start = Clock::now();
+		for (int i = 0; i < Iterations; ++i)
+		{
+			for (const std::string& name : names)
+				found += lookup(name.c_str()) != nullptr;
+		}
+
+		const double elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+		best = std::min(best, elapsed / (static_cast<double>(Iterations) * names.size()));
+	}
+
+	CHECK(found == 5 * Iterations * names.size());
+	return best;
+}
+
+std::vector<std::string> SampleNames(int localCount)
+{
+	std::vector<std::string> names = { "Param0", "Param3" };
+	for (int i = 0; i < 8; ++i)
+		names.push_back("LocalVariable" + std::to_string(i * (localCount - 1) / 7));
+	return names;
+}
+
+} // namespace
+
+TEST_CASE("MQFrameVariableIndex finds what a scan of the frame finds")
+{
+	TestFrame frame;
+	FillFrame(frame, 50);
+
+	// a local and a parameter with the same name: the parameter wins whichever came first
+	frame.AddLocal("Shared");
+	TestVar* pParam = frame.AddParameter("Shared");
+	TestVar* pShared2 = frame.AddParameter("Shared2");
+	TestVar* pLocal = frame.AddLocal("Shared2");
+
+	for (const char* name : { "Param0", "Param3", "LocalVariable0", "LocalVariable49", "Shared", "Shared2", "Missing", "" })
+		CHECK(frame.Index.Find(name) == frame.FindByScan(name));
+
+	CHECK(frame.Index.Find("Shared") == pParam);
+	CHECK(frame.Index.Find("Shared2") == pShared2);
+
+	// deleting the variable in the index lets the one it shadowed back in
+	frame.Delete(pParam);
+	CHECK(frame.Index.Find("Shared") != nullptr);
+	CHECK(frame.Index.Find("Shared") == frame.FindByScan("Shared"));
+
+	// deleting one that was shadowed leaves the index alone
+	frame.Delete(pLocal);
+	CHECK(frame.Index.Find("Shared2") == pShared2);
+
+	frame.Index.Rebuild(frame.Parameters, frame.LocalVariables);
+	for (const char* name : { "Param1", "LocalVariable25", "Shared", "Shared2" })
+		CHECK(frame.Index.Find(name) == frame.FindByScan(name));
+
+	frame.Index.Clear();
+	CHECK(frame.Index.Find("Param1") == nullptr);
+}
+
+// A sub with 200 locals resolves its variables as fast as one with 10. Without the index, the cost
+// grows with every local that is declared before the one being looked up.
+TEST_CASE("MQFrameVariableIndex benchmark with 200 locals")
+{
+	TestFrame smallFrame;
+	FillFrame(smallFrame, 10);
+
+	TestFrame largeFrame;
+	FillFrame(largeFrame, 200);
+
+	const std::vector<std::string> smallNames = SampleNames(10);
+	const std::vector<std::string> largeNames = SampleNames(200);
+
+	const double smallIndexed = TimeLookups(smallNames, [&](const char* name) { return smallFrame.Index.Find(name); });
+	const double largeIndexed = TimeLookups(largeNames, [&](const char* name) { return largeFrame.Index.Find(name); });
+	const double smallScan = TimeLookups(smallNames, [&](const char* name) { return smallFrame.FindByScan(name); });
+	const double largeScan = TimeLookups(largeNames, [&](const char* name) { return largeFrame.FindByScan(name); });
+
+	CHECK(largeIndexed < smallIndexed * 2);
+	CHECK(largeIndexed * 5 < largeScan);
+
+	printf("  10 locals: indexed %.1f ns, scan %.1f ns; 200 locals: indexed %.1f ns, scan %.1f ns\n",
+		smallIndexed, smallScan, largeIndexed, largeScan);
+}
@@ -0,0 +1,199 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-present MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "UnitTest.h"
+
+#include "mq/utils/LatencyHistogram.h"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <random>
+#include <vector>
+
+using namespace mq;
+
+namespace {
+
+// Frame timings: mostly a few hundred microseconds, with a long tail of hitches.
+std::vector<uint64_t> MakeTimings(uint32_t seed, size_t count)
+{
+	std::mt19937 random(seed);
+	std::lognormal_distribution<double> timing(6.0, 1.2);
+
+	std::vector<uint64_t> values;
+	values.reserve(count);
+	for (size_t i = 0; i < count; ++i)
+		values.push_back(static_cast<uint64_t>(timing(random)));
+
+	return values;
+}
+
+// The value that LatencyHistogram::GetPercentile looks for, from the sorted values.
+uint64_t ExactPercentile(const std::vector<uint64_t>& sorted, double percentile)
+{
+	uint64_t target = static_cast<uint64_t>(percentile / 100.0 * sorted.size() + 0.5);
+	target = std::clamp<uint64_t>(target, 1, sorted.size());
+	return sorted[target - 1];
+}
+
+// A reported percentile is the top of the bucket that the exact value is in.
+bool IsWithinBucket(uint64_t reported, uint64_t exact)
+{
+	return reported >= exact && reported <= exact + exact / LatencyHistogram::SubBucketCount;
+}
+
+} // namespace
+
+TEST_CASE("LatencyHistogram buckets cover every value")
+{
+	std::mt19937 random(5);
+	std::vector<uint64_t> values;
+
+	for (uint64_t value = 0; value < 70000; ++value)
+		values.push_back(value);
+	for (int i = 0; i < 10000; ++i)
+		values.push_back(random() % LatencyHistogram::MaxValue);
+	values.push_back(LatencyHistogram::MaxValue);
+
+	uint32_t lastIndex = 0;
+	int mismatches = 0;
+
+	for (uint64_t value : values)
+	{
+		const uint32_t index = LatencyHistogram::GetBucketIndex(value);
+		const uint64_t lower = LatencyHistogram::GetBucketLowerBound(index);
+		const uint64_t upper = LatencyHistogram::GetBucketUpperBound(index);
+
+		if (index >= LatencyHistogram::BucketCount
+			|| value < lower || value > upper
+			|| upper - lower > value / LatencyHistogram::SubBucketCount
+			|| (value < LatencyHistogram::SubBucketCount && index != value)
+			|| (value < 70000 && index < lastIndex))
+		{
+			++mismatches;
+		}
+
+		if (value < 70000)
+			lastIndex = index;
+	}
+
+	CHECK(mismatches == 0);
+	CHECK(LatencyHistogram::GetBucketIndex(LatencyHistogram::MaxValue) == LatencyHistogram::BucketCount - 1);
+
+	// adjacent buckets meet without a gap
+	for (uint32_t index = 1; index < LatencyHistogram::BucketCount; ++index)
+		CHECK(LatencyHistogram::GetBucketLowerBound(index) == LatencyHistogram::GetBucketUpperBound(index - 1) + 1);
+}
+
+TEST_CASE("LatencyHistogram percentiles are within a bucket of the exact values")
+{
+	std::vector<uint64_t> values = MakeTimings(17, 100000);
+
+	auto histogram = std::make_unique<LatencyHistogram>();
+	for (uint64_t value : values)
+		histogram->Record(value);
+
+	std::sort(values.begin(), values.end());
+
+	CHECK(histogram->GetCount() == values.size());
+	CHECK(histogram->GetMin() == values.front());
+	CHECK(histogram->GetMax() == values.back());
+
+	uint64_t total = 0;
+	for (uint64_t value : values)
+		total += value;
+	CHECK(histogram->GetTotal() == total);
+
+	for (double percentile : { 0.0, 1.0, 50.0, 90.0, 99.0, 99.9, 100.0 })
+		CHECK(IsWithinBucket(histogram->GetPercentile(percentile), ExactPercentile(values, percentile)));
+
+	CHECK(histogram->GetPercentile(100) == values.back());
+	CHECK(histogram->GetPercentile(250) == values.back());
+	CHECK(histogram->GetPercentile(-5) == histogram->GetPercentile(0));
+}
+
+TEST_CASE("LatencyHistogram percentiles of two windows match a merged histogram")
+{
+	const std::vector<uint64_t> previousValues = MakeTimings(1, 30000);
+	const std::vector<uint64_t> currentValues = MakeTimings(2, 5000);
+
+	auto previous = std::make_unique<LatencyHistogram>();
+	auto current = std::make_unique<LatencyHistogram>();
+	auto all = std::make_unique<LatencyHistogram>();
+
+	for (uint64_t value : previousValues)
+	{
+		previous->Record(value);
+		all->Record(value);
+	}
+
+	for (uint64_t value : currentValues)
+	{
+		current->Record(value);
+		all->Record(value);
+	}
+
+	auto merged = std::make_unique<LatencyHistogram>(*previous);
+	merged->Merge(*current);
+
+	CHECK(merged->GetCount() == all->GetCount());
+	CHECK(merged->GetTotal() == all->GetTotal());
+	CHECK(merged->GetMin() == all->GetMin());
+	CHECK(merged->GetMax() == all->GetMax());
+
+	for (double percentile : { 0.0, 50.0, 90.0, 99.0, 100.0 })
+	{
+		CHECK(merged->GetPercentile(percentile) == all->GetPercentile(percentile));
+		CHECK(LatencyHistogram::GetPercentile(percentile, *previous, *current) == all->GetPercentile(percentile));
+	}
+
+	// either window can be empty
+	auto empty = std::make_unique<LatencyHistogram>();
+	CHECK(LatencyHistogram::GetPercentile(99, *empty, *current) == current->GetPercentile(99));
+	CHECK(LatencyHistogram::GetPercentile(99, *previous, *empty) == previous->GetPercentile(99));
+	CHECK(LatencyHistogram::GetPercentile(99, *empty, *empty) == 0);
+}
+
+TEST_CASE("LatencyHistogram clamps, resets and reports empty")
+{
+	auto histogram = std::make_unique<LatencyHistogram>();
+
+	CHECK(histogram->GetCount() == 0);
+	CHECK(histogram->GetMin() == 0);
+	CHECK(histogram->GetMax() == 0);
+	CHECK(histogram->GetMean() == 0.0);
+	CHECK(histogram->GetPercentile(50) == 0);
+
+	histogram->Record(0);
+	histogram->Record(7);
+	histogram->Record(uint64_t{ 1 } << 40);
+
+	CHECK(histogram->GetMin() == 0);
+	CHECK(histogram->GetMax() == LatencyHistogram::MaxValue);
+	CHECK(histogram->GetPercentile(50) == 7);
+	CHECK(histogram->GetPercentile(100) == LatencyHistogram::MaxValue);
+	CHECK(std::abs(histogram->GetMean() - (7.0 + LatencyHistogram::MaxValue) / 3) < 1.0);
+
+	histogram->Reset();
+	CHECK(histogram->GetCount() == 0);
+	CHECK(histogram->GetTotal() == 0);
+	CHECK(histogram->GetMax() == 0);
+	CHECK(histogram->GetPercentile(99) == 0);
+
+	histogram->Record(1000);
+	CHECK(histogram->GetMin() == 1000);
+	CHECK(histogram->GetPercentile(0) == 1000);
+	CHECK(histogram->GetPercentile(100) == 1000);
+}
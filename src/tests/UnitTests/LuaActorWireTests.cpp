@@ -0,0 +1,186 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-present MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "UnitTest.h"
+
+#include "plugins/lua/LuaActorWire.h"
+
+#include <string>
+
+using namespace mq::lua;
+
+namespace {
+
+std::string Encode(const sol::object& value)
+{
+	std::string out;
+	wire::Write(out, value);
+	return out;
+}
+
+// Compares two lua values, recursing into tables
+bool DeepEqual(sol::state& lua, const sol::object& a, const sol::object& b)
+{
+	static const char* script = R"(
+		local function equal(a, b)
+			if type(a) ~= type(b) then return false end
+			if type(a) ~= 'table' then return a == b end
+			for k, v in pairs(a) do
+				if not equal(v, b[k]) then return false end
+			end
+			for k in pairs(b) do
+				if a[k] == nil then return false end
+			end
+			return true
+		end
+		return equal
+	)";
+
+	sol::function equal = lua.script(script);
+	return equal(a, b);
+}
+
+} // namespace
+
+TEST_CASE("Lua actor payloads are written in the protobuf wire format")
+{
+	sol::state lua;
+
+	// field 8 (str), length delimited
+	CHECK(Encode(sol::make_object(lua, "hi")) == std::string("\x42\x02hi", 4));
+
+	// field 5 (boolean), varint
+	CHECK(Encode(sol::make_object(lua, true)) == std::string("\x28\x01", 2));
+
+	// field 1 (number), fixed64 double
+	CHECK(Encode(sol::make_object(lua, 1.5)) == std::string("\x09\x00\x00\x00\x00\x00\x00\xf8\x3f", 9));
+
+	// field 10 (table) holding field 1 (entries) { key = "x", value = { str = "y" } }
+	sol::table named = lua.create_table();
+	named["x"] = "y";
+	CHECK(Encode(named) == std::string("\x52\x0a\x0a\x08\x0a\x01x\x12\x03\x42\x01y", 12));
+
+	// field 10 (table) holding field 2 (arr) { key = 1, value = { str = "y" } }
+	sol::table array = lua.create_table();
+	array[1] = "y";
+	CHECK(Encode(array) == std::string("\x52\x09\x12\x07\x08\x01\x12\x03\x42\x01y", 11));
+
+	// empty tables and unsupported types are sent as nil
+	CHECK(Encode(lua.create_table()).empty());
+	CHECK(Encode(sol::make_object(lua, sol::lua_nil)).empty());
+}
+
+TEST_CASE("Lua actor payloads round trip")
+{
+	sol::state lua;
+	lua.open_libraries(sol::lib::base);
+
+	sol::object value = lua.script(R"(
+		return {
+			1, 2.5, -3, "four", true, false,
+			name = "value",
+			[100] = "sparse",
+			nested = { deeper = { list = { "a", "b", "c" }, flag = true } },
+			["with spaces"] = 0.1,
+		}
+	)");
+
+	sol::object result = wire::Read(Encode(value), lua);
+	CHECK(result.is<sol::table>());
+	CHECK(DeepEqual(lua, value, result));
+
+	sol::object vec2 = wire::Read(Encode(sol::make_object(lua, ImVec2(1.0f, -2.0f))), lua);
+	CHECK(vec2.is<ImVec2>());
+	CHECK(vec2.as<ImVec2>().x == 1.0f && vec2.as<ImVec2>().y == -2.0f);
+
+	sol::object vec4 = wire::Read(Encode(sol::make_object(lua, ImVec4(1.0f, 2.0f, 3.0f, 4.0f))), lua);
+	CHECK(vec4.is<ImVec4>());
+	CHECK(vec4.as<ImVec4>().z == 3.0f && vec4.as<ImVec4>().w == 4.0f);
+}
+
+TEST_CASE("Lua actor payloads write self references as nil")
+{
+	sol::state lua;
+	lua.open_libraries(sol::lib::base);
+
+	// without tracking, every level doubles the output until the depth limit
+	sol::table table = lua.script(R"(
+		local t = { name = "t" }
+		t.a = t
+		t.b = t
+		t.child = { parent = t, value = 1 }
+		return t
+	)");
+
+	sol::object result = wire::Read(Encode(table), lua);
+	CHECK(result.is<sol::table>());
+
+	sol::table decoded = result.as<sol::table>();
+	CHECK(decoded["name"].get<std::string>() == "t");
+	CHECK(decoded["a"].get_type() == sol::type::lua_nil);
+	CHECK(decoded["b"].get_type() == sol::type::lua_nil);
+	CHECK(decoded["child"]["value"].get<int>() == 1);
+	CHECK(decoded["child"]["parent"].get_type() == sol::type::lua_nil);
+
+	// a table that is only shared, not nested in itself, is written everywhere it appears
+	sol::table shared = lua.script(R"(
+		local s = { value = 1 }
+		return { first = s, second = s }
+	)");
+
+	sol::table sharedResult = wire::Read(Encode(shared), lua).as<sol::table>();
+	CHECK(sharedResult["first"]["value"].get<int>() == 1);
+	CHECK(sharedResult["second"]["value"].get<int>() == 1);
+}
+
+TEST_CASE("Lua actor payloads stop at the nesting limit")
+{
+	sol::state lua;
+	lua.open_libraries(sol::lib::base);
+
+	sol::table deep = lua.script(R"(
+		local root = { value = 0 }
+		local current = root
+		for i = 1, 200 do
+			current.next = { value = i }
+			current = current.next
+		end
+		return root
+	)");
+
+	sol::object result = wire::Read(Encode(deep), lua);
+	CHECK(result.is<sol::table>());
+
+	int levels = 0;
+	sol::object current = result;
+	while (current.is<sol::table>())
+	{
+		++levels;
+		current = current.as<sol::table>().get<sol::object>("next");
+	}
+
+	CHECK(levels == wire::MaxDepth);
+}
+
+TEST_CASE("Malformed Lua actor payloads read as nil")
+{
+	sol::state lua;
+
+	const std::string valid = Encode(sol::make_object(lua, "hello"));
+
+	CHECK(wire::Read(valid, lua).as<std::string>() == "hello");
+	CHECK(wire::Read(valid.substr(0, valid.size() - 1), lua).get_type() == sol::type::lua_nil);
+	CHECK(wire::Read(std::string("\xff\xff\xff", 3), lua).get_type() == sol::type::lua_nil);
+	CHECK(wire::Read("", lua).get_type() == sol::type::lua_nil);
+}
@@ -0,0 +1,220 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-present MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "UnitTest.h"
+
+#include "plugins/lua/LuaBytecodeCache.h"
+
+#include <sol/sol.hpp>
+#include <luajit.h>
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+using namespace mq::lua;
+namespace fs = std::filesystem;
+
+namespace {
+
+// A scratch directory with a script and a cache directory in it, removed afterwards.
+class ScratchDirectory
+{
+public:
+	explicit ScratchDirectory(const char* name)
+		: m_root(fs::temp_directory_path() / name)
+	{
+		std::error_code ec;
+		fs::remove_all(m_root, ec);
+		fs::create_directories(GetCacheDirectory());
+	}
+
+	~ScratchDirectory()
+	{
+		std::error_code ec;
+		fs::remove_all(m_root, ec);
+	}
+
+	std::string GetScriptPath() const { return (m_root / "script.lua").string(); }
+	fs::path GetCacheDirectory() const { return m_root / "cache"; }
+
+	void WriteScript(const std::string& source) const
+	{
+		std::ofstream stream(GetScriptPath(), std::ios::binary | std::ios::trunc);
+		stream << source;
+	}
+
+	std::vector<fs::path> GetCacheFiles() const
+	{
+		std::vector<fs::path> files;
+		for (const auto& entry : fs::directory_iterator(GetCacheDirectory()))
+			files.push_back(entry.path());
+		return files;
+	}
+
+private:
+	fs::path m_root;
+};
+
+// Loads the script through the cache and runs it, returning the number it returns, or -1.
+double RunScript(LuaBytecodeCache& cache, const std::string& path)
+{
+	sol::state lua;
+	lua_State* L = lua.lua_state();
+
+	if (cache.LoadFile(L, path.c_str()) != 0)
+	{
+		lua_pop(L, 1);
+		return -1;
+	}
+
+	if (lua_pcall(L, 0, 1, 0) != 0)
+	{
+		lua_pop(L, 1);
+		return -1;
+	}
+
+	const double result = lua_tonumber(L, -1);
+	lua_pop(L, 1);
+	return result;
+}
+
+std::string ReadFile(const fs::path& path)
+{
+	std::ifstream stream(path, std::ios::binary);
+	return std::string(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+}
+
+void WriteFile(const fs::path& path, const std::string& contents)
+{
+	std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+	stream << contents;
+}
+
+} // namespace
+
+TEST_CASE("LuaBytecodeCache compiles on a miss and reuses the chunk after")
+{
+	ScratchDirectory scratch("mq_lua_bytecode_miss");
+	scratch.WriteScript("return 6 * 7");
+
+	LuaBytecodeCache cache;
+	cache.SetCacheDirectory(scratch.GetCacheDirectory().string());
+
+	CHECK(RunScript(cache, scratch.GetScriptPath()) == 42);
+	CHECK(cache.GetStats().misses == 1);
+	CHECK(scratch.GetCacheFiles().size() == 1);
+
+	CHECK(RunScript(cache, scratch.GetScriptPath()) == 42);
+	CHECK(cache.GetStats().misses == 1);
+	CHECK(cache.GetStats().memoryHits == 1);
+}
+
+TEST_CASE("LuaBytecodeCache loads chunks written by an earlier session")
+{
+	ScratchDirectory scratch("mq_lua_bytecode_file");
+	scratch.WriteScript("return 6 * 7");
+
+	{
+		LuaBytecodeCache cache;
+		cache.SetCacheDirectory(scratch.GetCacheDirectory().string());
+		CHECK(RunScript(cache, scratch.GetScriptPath()) == 42);
+	}
+
+	LuaBytecodeCache cache;
+	cache.SetCacheDirectory(scratch.GetCacheDirectory().string());
+
+	CHECK(RunScript(cache, scratch.GetScriptPath()) == 42);
+	CHECK(cache.GetStats().fileHits == 1);
+	CHECK(cache.GetStats().misses == 0);
+}
+
+TEST_CASE("LuaBytecodeCache replaces the chunk of a script that changed")
+{
+	ScratchDirectory scratch("mq_lua_bytecode_change");
+
+	LuaBytecodeCache cache;
+	cache.SetCacheDirectory(scratch.GetCacheDirectory().string());
+
+	// each version has a different size, so it is noticed even within the file time resolution
+	std::string padding;
+	for (int version = 1; version <= 10; ++version)
+	{
+		padding += " ";
+		scratch.WriteScript("return " + std::to_string(version) + padding);
+
+		CHECK(RunScript(cache, scratch.GetScriptPath()) == version);
+	}
+
+	CHECK(cache.GetStats().misses == 10);
+
+	// one file per script, however often it changes
+	CHECK(scratch.GetCacheFiles().size() == 1);
+
+	LuaBytecodeCache nextSession;
+	nextSession.SetCacheDirectory(scratch.GetCacheDirectory().string());
+	CHECK(RunScript(nextSession, scratch.GetScriptPath()) == 10);
+	CHECK(nextSession.GetStats().fileHits == 1);
+}
+
+TEST_CASE("LuaBytecodeCache ignores files from another LuaJIT build")
+{
+	ScratchDirectory scratch("mq_lua_bytecode_header");
+	scratch.WriteScript("return 6 * 7");
+
+	{
+		LuaBytecodeCache cache;
+		cache.SetCacheDirectory(scratch.GetCacheDirectory().string());
+		CHECK(RunScript(cache, scratch.GetScriptPath()) == 42);
+	}
+
+	const fs::path cacheFile = scratch.GetCacheFiles().at(0);
+	std::string contents = ReadFile(cacheFile);
+
+	const size_t version = contents.find(LUAJIT_VERSION);
+	CHECK(version != std::string::npos);
+	if (version == std::string::npos)
+		return;
+
+	contents[version] = 'X';
+	WriteFile(cacheFile, contents);
+
+	LuaBytecodeCache cache;
+	cache.SetCacheDirectory(scratch.GetCacheDirectory().string());
+
+	CHECK(RunScript(cache, scratch.GetScriptPath()) == 42);
+	CHECK(cache.GetStats().fileHits == 0);
+	CHECK(cache.GetStats().misses == 1);
+
+	// and the file was rewritten for this build
+	CHECK(ReadFile(cacheFile).find(LUAJIT_VERSION) != std::string::npos);
+}
+
+TEST_CASE("LuaBytecodeCache removes files that aren't cache files")
+{
+	ScratchDirectory scratch("mq_lua_bytecode_prune");
+
+	WriteFile(scratch.GetCacheDirectory() / "0123456789abcdef.ljbc", "\x1bLJ old format");
+	WriteFile(scratch.GetCacheDirectory() / "0123456789abcdef.ljbc.1234.tmp", "partial");
+	WriteFile(scratch.GetCacheDirectory() / "readme.txt", "not ours");
+
+	LuaBytecodeCache cache;
+	cache.SetCacheDirectory(scratch.GetCacheDirectory().string());
+
+	const auto files = scratch.GetCacheFiles();
+	CHECK(files.size() == 1);
+	CHECK(!files.empty() && files[0].filename() == "readme.txt");
+}
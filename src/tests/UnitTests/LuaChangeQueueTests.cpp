@@ -0,0 +1,196 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-present MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "UnitTest.h"
+
+#include "plugins/lua/LuaChangeQueue.h"
+
+#include <memory>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+using namespace mq::lua;
+
+namespace {
+
+struct Item
+{
+	uint32_t id;
+};
+
+// Stands in for a thread's spawn table
+struct Table
+{
+	std::unordered_map<uint32_t, Item*> items;
+	int deliveries = 0;
+};
+
+using Queue = LuaChangeQueue<Table, Item>;
+
+void Deliver(Queue& queue)
+{
+	queue.Deliver([](Table& table, const Queue::Changes& changes)
+	{
+		++table.deliveries;
+
+		for (const auto& [id, item] : changes)
+		{
+			if (item)
+				table.items[id] = item;
+			else
+				table.items.erase(id);
+		}
+	});
+}
+
+} // namespace
+
+TEST_CASE("Lua change queue only records changes while subscribed")
+{
+	Queue queue;
+	Table table;
+	Item a{ 1 };
+
+	queue.Added(a.id, &a);
+	Deliver(queue);
+	CHECK(table.deliveries == 0);
+
+	queue.Subscribe(&table);
+	queue.Subscribe(&table);
+
+	// nothing changed, so nobody is called
+	Deliver(queue);
+	CHECK(table.deliveries == 0);
+
+	queue.Added(a.id, &a);
+	Deliver(queue);
+	CHECK(table.deliveries == 1);
+	CHECK(table.items.size() == 1 && table.items[1] == &a);
+
+	// the last subscriber leaving drops what was collected
+	queue.Removed(a.id, &a);
+	queue.Unsubscribe(&table);
+	queue.Subscribe(&table);
+	Deliver(queue);
+	CHECK(table.deliveries == 1);
+}
+
+TEST_CASE("Lua change queue keeps the latest change for each id")
+{
+	Queue queue;
+	Table table;
+	queue.Subscribe(&table);
+
+	Item a{ 5 }, b{ 5 }, c{ 6 };
+
+	// added and removed within one pulse
+	queue.Added(c.id, &c);
+	queue.Removed(c.id, &c);
+
+	// b takes over a's id before a is removed
+	table.items[a.id] = &a;
+	queue.Added(b.id, &b);
+	queue.Removed(a.id, &a);
+
+	Deliver(queue);
+	CHECK(table.deliveries == 1);
+	CHECK(table.items.size() == 1);
+	CHECK(table.items[5] == &b);
+
+	// d takes over b's id, and b is only removed a pulse later
+	Item d{ 5 };
+	queue.Added(d.id, &d);
+	Deliver(queue);
+	queue.Removed(b.id, &b);
+	Deliver(queue);
+	CHECK(table.deliveries == 2);
+	CHECK(table.items.size() == 1 && table.items[5] == &d);
+
+	queue.Removed(d.id, &d);
+	Deliver(queue);
+	CHECK(table.items.empty());
+}
+
+TEST_CASE("Lua change queue keeps subscribers in step with the items")
+{
+	std::mt19937 random(4321);
+
+	std::vector<std::unique_ptr<Item>> items;
+	std::vector<Item*> live;
+
+	// what a table built right now would hold: the latest item added for each id, while it exists
+	std::unordered_map<uint32_t, Item*> expected;
+
+	Queue queue;
+	Table tables[3];
+	bool subscribed[3] = {};
+	int mismatches = 0;
+
+	for (int step = 0; step < 20000; ++step)
+	{
+		const int action = std::uniform_int_distribution<int>(0, 99)(random);
+
+		if (action < 45 || live.empty())
+		{
+			// ids are reused, sometimes before the old item is gone
+			items.push_back(std::make_unique<Item>(Item{ std::uniform_int_distribution<uint32_t>(1, 40)(random) }));
+			Item* item = items.back().get();
+
+			live.push_back(item);
+			expected[item->id] = item;
+			queue.Added(item->id, item);
+		}
+		else if (action < 90)
+		{
+			const size_t index = std::uniform_int_distribution<size_t>(0, live.size() - 1)(random);
+			Item* item = live[index];
+			live.erase(live.begin() + index);
+
+			auto iter = expected.find(item->id);
+			if (iter != expected.end() && iter->second == item)
+				expected.erase(iter);
+			queue.Removed(item->id, item);
+		}
+		else if (action < 95)
+		{
+			// a thread builds its table from the current items, then follows the changes
+			const int index = std::uniform_int_distribution<int>(0, 2)(random);
+			if (!subscribed[index])
+			{
+				tables[index].items = expected;
+				queue.Subscribe(&tables[index]);
+				subscribed[index] = true;
+			}
+		}
+		else if (action < 97)
+		{
+			const int index = std::uniform_int_distribution<int>(0, 2)(random);
+			queue.Unsubscribe(&tables[index]);
+			subscribed[index] = false;
+		}
+		else
+		{
+			Deliver(queue);
+
+			for (int index = 0; index < 3; ++index)
+			{
+				if (subscribed[index] && tables[index].items != expected)
+					++mismatches;
+			}
+		}
+	}
+
+	CHECK(mismatches == 0);
+}
@@ -0,0 +1,198 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-present MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "UnitTest.h"
+
+#include "plugins/lua/LuaDelay.h"
+
+#include <sol/sol.hpp>
+
+#include <optional>
+#include <vector>
+
+using namespace mq::lua;
+
+namespace {
+
+constexpr uint64_t FrameTime = 16;
+constexpr int ThreadCount = 50;
+
+// A farm of scripts sitting in mq.delay, on a fake clock. Each frame, every delay that is still
+// going is looked at the way LuaThread::RunOnce does: skipped while it is waiting, and otherwise
+// asked whether it is over, which may call its condition in lua.
+class DelayFarm
+{
+public:
+	explicit DelayFarm(uint32_t conditionInterval)
+		: m_conditionInterval(conditionInterval)
+		, m_delays(ThreadCount)
+		, m_ended(ThreadCount, false)
+	{
+		m_lua.script(R"(
+			calls = 0
+			ready = false
+			function condition()
+				calls = calls + 1
+				return ready
+			end
+		)");
+	}
+
+	// Every script calls mq.delay(duration) or mq.delay(duration, condition).
+	void Start(uint64_t duration, bool withCondition)
+	{
+		std::optional<sol::function> condition;
+		if (withCondition)
+			condition = m_lua.get<sol::function>("condition");
+
+		for (int i = 0; i < ThreadCount; ++i)
+		{
+			m_delays[i].Start(m_now, m_now + duration, condition, m_conditionInterval);
+			m_ended[i] = false;
+		}
+	}
+
+	// Advances the clock by a frame and returns how many delays ended in it.
+	int RunFrame()
+	{
+		m_now += FrameTime;
+		int ended = 0;
+
+		for (int i = 0; i < ThreadCount; ++i)
+		{
+			if (m_ended[i])
+				continue;
+
+			if (m_delays[i].IsWaiting(m_now))
+			{
+				++m_skipped;
+				continue;
+			}
+
+			if (m_delays[i].IsOver(m_now, m_conditionInterval,
+				[](std::optional<sol::function>& condition) { return condition->call<bool>(); }))
+			{
+				m_ended[i] = true;
+				++ended;
+			}
+		}
+
+		return ended;
+	}
+
+	void WakeAll()
+	{
+		for (LuaDelay& delay : m_delays)
+			delay.Wake();
+	}
+
+	void SetReady(bool ready) { m_lua["ready"] = ready; }
+	int GetConditionCalls() { return m_lua.get<int>("calls"); }
+	int GetSkipped() const { return m_skipped; }
+	uint64_t GetNow() const { return m_now; }
+
+private:
+	sol::state m_lua;
+	uint32_t m_conditionInterval;
+	uint64_t m_now = 1000000;
+	std::vector<LuaDelay> m_delays;
+	std::vector<bool> m_ended;
+	int m_skipped = 0;
+};
+
+} // namespace
+
+TEST_CASE("LuaDelay time delays wake on expiry without entering lua")
+{
+	DelayFarm farm(0);
+	const uint64_t expiry = farm.GetNow() + 1000;
+	farm.Start(1000, false);
+
+	int frames = 0;
+	int ended = 0;
+	while (ended == 0)
+	{
+		ended = farm.RunFrame();
+		++frames;
+	}
+
+	// all of them, on the first frame at or past the expiry, and skipped on every frame before it
+	CHECK(ended == ThreadCount);
+	CHECK(farm.GetNow() >= expiry);
+	CHECK(farm.GetNow() < expiry + FrameTime);
+	CHECK(farm.GetSkipped() == (frames - 1) * ThreadCount);
+	CHECK(farm.GetConditionCalls() == 0);
+}
+
+TEST_CASE("LuaDelay conditions are called every frame with no interval")
+{
+	DelayFarm farm(0);
+	farm.Start(60000, true);
+
+	for (int frame = 0; frame < 100; ++frame)
+		CHECK(farm.RunFrame() == 0);
+
+	CHECK(farm.GetConditionCalls() == 100 * ThreadCount);
+	CHECK(farm.GetSkipped() == 0);
+
+	farm.SetReady(true);
+	CHECK(farm.RunFrame() == ThreadCount);
+}
+
+// 50 idle scripts in mq.delay(60000, condition) for ten seconds of 60fps frames. With an interval,
+// lua is only entered once per interval per script instead of every frame.
+TEST_CASE("LuaDelay conditions are polled at the interval on a fake clock")
+{
+	constexpr uint32_t Interval = 250;
+	constexpr int Frames = 625;
+
+	DelayFarm farm(Interval);
+	farm.Start(60000, true);
+
+	for (int frame = 0; frame < Frames; ++frame)
+		CHECK(farm.RunFrame() == 0);
+
+	const int elapsed = Frames * FrameTime;
+	CHECK(farm.GetConditionCalls() <= ThreadCount * (elapsed / Interval + 1));
+	CHECK(farm.GetConditionCalls() >= ThreadCount * (elapsed / Interval / 2));
+	CHECK(farm.GetSkipped() + farm.GetConditionCalls() == Frames * ThreadCount);
+
+	// once the condition is true, each script notices within an interval
+	farm.SetReady(true);
+	const uint64_t readyTime = farm.GetNow();
+
+	int ended = 0;
+	while (ended < ThreadCount && farm.GetNow() < readyTime + 10 * Interval)
+		ended += farm.RunFrame();
+
+	CHECK(ended == ThreadCount);
+	CHECK(farm.GetNow() <= readyTime + Interval + FrameTime);
+}
+
+TEST_CASE("LuaDelay wake checks the condition on the next frame")
+{
+	DelayFarm farm(60000);
+	farm.Start(120000, true);
+
+	for (int frame = 0; frame < 10; ++frame)
+		CHECK(farm.RunFrame() == 0);
+	CHECK(farm.GetConditionCalls() == 0);
+
+	// a bind or event ran, and it changed what the scripts are waiting for
+	farm.SetReady(true);
+	farm.WakeAll();
+
+	CHECK(farm.RunFrame() == ThreadCount);
+	CHECK(farm.GetConditionCalls() == ThreadCount);
+}
@@ -0,0 +1,65 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-present MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "UnitTest.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+static size_t s_allocations = 0;
+
+void* operator new(size_t size)
+{
+	++s_allocations;
+
+	if (void* p = malloc(size ? size : 1))
+		return p;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+size_t mq::test::GetAllocationCount()
+{
+	return s_allocations;
+}
+
+// Runs every registered test, or only the ones whose name contains the first argument.
+int main(int argc, char* argv[])
+{
+	const char* filter = argc > 1 ? argv[1] : nullptr;
+
+	int failedTests = 0;
+	int ranTests = 0;
+
+	for (const mq::test::TestCase& testCase : mq::test::GetTestCases())
+	{
+		if (filter && !strstr(testCase.name, filter))
+			continue;
+
+		printf("%s\n", testCase.name);
+
+		const int failures = mq::test::GetFailureCount();
+		testCase.func();
+		++ranTests;
+
+		if (mq::test::GetFailureCount() != failures)
+			++failedTests;
+	}
+
+	printf("\n%d of %d tests passed\n", ranTests - failedTests, ranTests);
+	return failedTests;
+}
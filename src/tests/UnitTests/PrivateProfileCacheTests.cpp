@@ -0,0 +1,263 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-present MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "UnitTest.h"
+
+#include "mq/base/PrivateProfileCache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+using namespace mq;
+
+namespace {
+
+std::string GetTestIniPath(const char* name)
+{
+	char tempPath[MAX_PATH] = { 0 };
+	::GetTempPathA(MAX_PATH, tempPath);
+
+	return std::string(tempPath) + name;
+}
+
+void WriteFile(const std::string& path, const char* contents)
+{
+	std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+	stream << contents;
+}
+
+void SetLastWriteTime(const std::string& path, const FILETIME& time)
+{
+	HANDLE hFile = ::CreateFileA(path.c_str(), FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE,
+		nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (hFile != INVALID_HANDLE_VALUE)
+	{
+		::SetFileTime(hFile, nullptr, nullptr, &time);
+		::CloseHandle(hFile);
+	}
+}
+
+// Sets the last write time to now, minus the given number of seconds
+FILETIME SetLastWriteTime(const std::string& path, int secondsAgo)
+{
+	FILETIME time;
+	::GetSystemTimeAsFileTime(&time);
+
+	ULARGE_INTEGER value;
+	value.LowPart = time.dwLowDateTime;
+	value.HighPart = time.dwHighDateTime;
+	value.QuadPart -= static_cast<uint64_t>(secondsAgo) * 10'000'000;
+	time.dwLowDateTime = value.LowPart;
+	time.dwHighDateTime = value.HighPart;
+
+	SetLastWriteTime(path, time);
+	return time;
+}
+
+constexpr const char* Missing = "<missing>";
+constexpr const char* Uncached = "<uncached>";
+
+// The cached value of a key, Missing if there is no such key, or Uncached if the cache couldn't
+// answer the lookup.
+std::string Lookup(PrivateProfileCache& cache, const char* section, const char* key, const std::string& path)
+{
+	std::string result = Uncached;
+
+	cache.Lookup(section, key, path.c_str(), [&](const std::string_view* value)
+		{
+			result = value ? std::string(*value) : Missing;
+		});
+
+	return result;
+}
+
+} // namespace
+
+TEST_CASE("PrivateProfileCache follows the profile API parsing rules")
+{
+	const std::string path = GetTestIniPath("mq_unittest_parse.ini");
+	WriteFile(path,
+		"orphan=1\r\n"
+		"[Settings]\r\n"
+		"  Name =  \"quoted value\"  \r\n"
+		"name=second\r\n"
+		"Single='x'\r\n"
+		"Empty=\r\n"
+		"NoEquals\r\n"
+		"[settings]\r\n"
+		"Other=ignored\r\n");
+
+	PrivateProfileCache cache;
+
+	CHECK(Lookup(cache, "SETTINGS", "NAME", path) == "quoted value");
+	CHECK(Lookup(cache, "Settings", "Single", path) == "x");
+	CHECK(Lookup(cache, "Settings", "Empty", path) == "");
+	CHECK(Lookup(cache, "Settings", "NoEquals", path) == "");
+
+	// only the first section of a given name is searched
+	CHECK(Lookup(cache, "Settings", "Other", path) == Missing);
+	CHECK(Lookup(cache, "Missing", "Name", path) == Missing);
+
+	// relative paths and unnamed sections or keys go to the Windows API
+	CHECK(Lookup(cache, "Settings", "Name", "mq_unittest_parse.ini") == Uncached);
+	CHECK(Lookup(cache, "", "Name", path) == Uncached);
+	CHECK(Lookup(cache, "Settings", "", path) == Uncached);
+
+	std::remove(path.c_str());
+}
+
+TEST_CASE("PrivateProfileCache rereads a file when its timestamp or size changes")
+{
+	const std::string path = GetTestIniPath("mq_unittest_change.ini");
+	PrivateProfileCache cache;
+
+	WriteFile(path, "[A]\r\nKey=one\r\n");
+	SetLastWriteTime(path, 60);
+	CHECK(Lookup(cache, "A", "Key", path) == "one");
+
+	WriteFile(path, "[A]\r\nKey=three\r\n");
+	SetLastWriteTime(path, 30);
+	CHECK(Lookup(cache, "A", "Key", path) == "three");
+
+	std::remove(path.c_str());
+	CHECK(Lookup(cache, "A", "Key", path) == Missing);
+
+	WriteFile(path, "[A]\r\nKey=four\r\n");
+	CHECK(Lookup(cache, "A", "Key", path) == "four");
+
+	std::remove(path.c_str());
+}
+
+TEST_CASE("PrivateProfileCache doesn't trust a recently written file")
+{
+	// Another module writes the file again without going through this cache, and the write lands
+	// with the same timestamp and size.
+	const std::string path = GetTestIniPath("mq_unittest_recent.ini");
+	PrivateProfileCache cache;
+
+	WriteFile(path, "[A]\r\nKey=one\r\n");
+	const FILETIME writeTime = SetLastWriteTime(path, 0);
+	CHECK(Lookup(cache, "A", "Key", path) == "one");
+
+	WriteFile(path, "[A]\r\nKey=two\r\n");
+	SetLastWriteTime(path, writeTime);
+	CHECK(Lookup(cache, "A", "Key", path) == "two");
+
+	std::remove(path.c_str());
+}
+
+TEST_CASE("PrivateProfileCache Invalidate drops a settled file")
+{
+	// A settled file is trusted as long as its timestamp and size match, so a write from this
+	// module with the same timestamp and size relies on Invalidate.
+	const std::string path = GetTestIniPath("mq_unittest_invalidate.ini");
+	PrivateProfileCache cache;
+
+	WriteFile(path, "[A]\r\nKey=one\r\n");
+	const FILETIME writeTime = SetLastWriteTime(path, 60);
+	CHECK(Lookup(cache, "A", "Key", path) == "one");
+
+	WriteFile(path, "[A]\r\nKey=two\r\n");
+	SetLastWriteTime(path, writeTime);
+	CHECK(Lookup(cache, "A", "Key", path) == "one");
+
+	cache.Invalidate(path.c_str());
+	CHECK(Lookup(cache, "A", "Key", path) == "two");
+
+	std::remove(path.c_str());
+}
+
+TEST_CASE("PrivateProfileCache drops the least recently used files")
+{
+	// Room for three files. Whether a file is still cached shows in whether a rewrite with the same
+	// timestamp and size is seen, as in the Invalidate test.
+	PrivateProfileCache cache(3);
+
+	std::string paths[4];
+	FILETIME writeTimes[4];
+	for (int i = 0; i < 4; ++i)
+	{
+		paths[i] = GetTestIniPath(("mq_unittest_lru" + std::to_string(i) + ".ini").c_str());
+		WriteFile(paths[i], "[A]\r\nKey=one\r\n");
+		writeTimes[i] = SetLastWriteTime(paths[i], 60);
+	}
+
+	CHECK(Lookup(cache, "A", "Key", paths[0]) == "one");
+	CHECK(Lookup(cache, "A", "Key", paths[1]) == "one");
+	CHECK(Lookup(cache, "A", "Key", paths[2]) == "one");
+	CHECK(Lookup(cache, "A", "Key", paths[0]) == "one");
+	CHECK(cache.GetFileCount() == 3);
+
+	// the fourth file pushes out the second, which is the one used least recently
+	CHECK(Lookup(cache, "A", "Key", paths[3]) == "one");
+	CHECK(cache.GetFileCount() == 3);
+
+	for (int i = 0; i < 4; ++i)
+	{
+		WriteFile(paths[i], "[A]\r\nKey=two\r\n");
+		SetLastWriteTime(paths[i], writeTimes[i]);
+	}
+
+	CHECK(Lookup(cache, "A", "Key", paths[0]) == "one");
+	CHECK(Lookup(cache, "A", "Key", paths[1]) == "two");
+	CHECK(cache.GetFileCount() == 3);
+
+	for (const std::string& path : paths)
+		std::remove(path.c_str());
+}
+
+TEST_CASE("PrivateProfileCache stays under its byte limit")
+{
+	constexpr const char* Contents = "[Section]\r\nKey=value\r\n";
+	const size_t fileSize = strlen(Contents);
+
+	// room for two of the small files
+	PrivateProfileCache cache(64, fileSize * 2 + fileSize / 2);
+
+	std::string paths[3];
+	for (int i = 0; i < 3; ++i)
+	{
+		paths[i] = GetTestIniPath(("mq_unittest_bytes" + std::to_string(i) + ".ini").c_str());
+		WriteFile(paths[i], Contents);
+		SetLastWriteTime(paths[i], 60);
+
+		CHECK(Lookup(cache, "Section", "Key", paths[i]) == "value");
+	}
+
+	CHECK(cache.GetFileCount() == 2);
+	CHECK(cache.GetCachedBytes() == fileSize * 2);
+
+	// a file larger than the whole limit is still answered, but isn't kept
+	const std::string largePath = GetTestIniPath("mq_unittest_bytes_large.ini");
+	WriteFile(largePath, (std::string(Contents) + "Padding=" + std::string(fileSize * 3, 'x') + "\r\n").c_str());
+	SetLastWriteTime(largePath, 60);
+
+	CHECK(Lookup(cache, "Section", "Key", largePath) == "value");
+	CHECK(cache.GetFileCount() == 2);
+	CHECK(cache.GetCachedBytes() == fileSize * 2);
+
+	cache.Invalidate(paths[2].c_str());
+	CHECK(cache.GetFileCount() == 1);
+	CHECK(cache.GetCachedBytes() == fileSize);
+
+	cache.Clear();
+	CHECK(cache.GetFileCount() == 0);
+	CHECK(cache.GetCachedBytes() == 0);
+
+	for (const std::string& path : paths)
+		std::remove(path.c_str());
+	std::remove(largePath.c_str());
+}
@@ -0,0 +1,175 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-present MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "UnitTest.h"
+
+#include "main/MQPulseScheduler.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace mq;
+
+namespace {
+
+// A clock that only moves when a task says it has spent time
+struct FakeClock
+{
+	uint64_t now = 0;
+
+	uint64_t operator()() const { return now; }
+};
+
+void IgnoreReport(const MQPulseScheduler::Task&) {}
+
+} // namespace
+
+TEST_CASE("MQPulseScheduler destroys the handlers of tasks removed during Run")
+{
+	MQPulseScheduler scheduler;
+	FakeClock clock;
+
+	constexpr uint64_t PluginA = 1;
+	constexpr uint64_t PluginB = 2;
+
+	auto stateB = std::make_shared<int>(0);
+	bool ranB = false;
+	bool releasedDuringRun = false;
+
+	// A runs first, and unloads plugin B, whose tasks are due later in the same pulse.
+	scheduler.Add("A", [&]()
+		{
+			CHECK(stateB.use_count() == 3);
+			CHECK(scheduler.RemoveOwnedBy(PluginB) == 2);
+
+			// B's handlers, and what they captured, are gone before we return to the plugin unload
+			releasedDuringRun = stateB.use_count() == 1;
+		}, 0, 1000, PluginA);
+
+	scheduler.Add("B1", [&ranB, stateB]() { ranB = true; }, 0, 1000, PluginB);
+	scheduler.Add("B2", [&ranB, stateB]() { ranB = true; }, 0, 1000, PluginB);
+
+	CHECK(scheduler.Run(10000, clock, IgnoreReport) == 1);
+	CHECK(releasedDuringRun);
+	CHECK(!ranB);
+	CHECK(scheduler.Size() == 1);
+}
+
+TEST_CASE("MQPulseScheduler keeps a task's handler alive while it removes itself")
+{
+	MQPulseScheduler scheduler;
+	FakeClock clock;
+
+	auto state = std::make_shared<int>(0);
+	std::weak_ptr<int> weakState = state;
+	MQPulseScheduler::TaskId id = MQPulseScheduler::InvalidTaskId;
+
+	id = scheduler.Add("self", [&scheduler, &id, state]()
+		{
+			CHECK(scheduler.Remove(id, 0));
+
+			// still safe to use our captures after removing ourselves
+			CHECK(*state == 0);
+		}, 0, 1000);
+
+	state.reset();
+	CHECK(!weakState.expired());
+
+	CHECK(scheduler.Run(10000, clock, IgnoreReport) == 1);
+	CHECK(weakState.expired());
+	CHECK(scheduler.Empty());
+}
+
+TEST_CASE("MQPulseScheduler Clear during Run releases the other handlers")
+{
+	MQPulseScheduler scheduler;
+	FakeClock clock;
+
+	auto state = std::make_shared<int>(0);
+	std::weak_ptr<int> weakState = state;
+	bool releasedDuringRun = false;
+	int runs = 0;
+
+	scheduler.Add("clear", [&]()
+		{
+			++runs;
+			scheduler.Clear();
+			releasedDuringRun = weakState.expired();
+		}, 0, 1000);
+	scheduler.Add("other", [&runs, state]() { ++runs; }, 0, 1000);
+	state.reset();
+
+	CHECK(scheduler.Run(10000, clock, IgnoreReport) == 1);
+	CHECK(runs == 1);
+	CHECK(releasedDuringRun);
+	CHECK(scheduler.Empty());
+}
+
+TEST_CASE("MQPulseScheduler stays within the frame budget, most overdue first")
+{
+	MQPulseScheduler scheduler;
+	FakeClock clock{ 1000 };
+	std::vector<std::string> ran;
+
+	auto addTask = [&](const char* name, uint64_t cost)
+	{
+		scheduler.Add(name, [&, name, cost]() { ran.push_back(name); clock.now += cost; }, 0, cost);
+	};
+
+	addTask("a", 600);
+	addTask("b", 600);
+	addTask("c", 300);
+
+	// a always runs. b doesn't fit in what is left of the budget, but c does.
+	CHECK(scheduler.Run(1000, clock, IgnoreReport) == 2);
+	CHECK((ran == std::vector<std::string>{ "a", "c" }));
+
+	// b is now the most overdue
+	ran.clear();
+	CHECK(scheduler.Run(1000, clock, IgnoreReport) == 2);
+	CHECK((ran == std::vector<std::string>{ "b", "c" }));
+}
+
+TEST_CASE("MQPulseScheduler penalizes tasks that keep going over budget")
+{
+	MQPulseScheduler scheduler;
+	FakeClock clock;
+	int reports = 0;
+
+	const auto id = scheduler.Add("slow", [&]() { clock.now += 5000; }, 1000, 100);
+	auto report = [&](const MQPulseScheduler::Task&) { ++reports; };
+
+	for (uint32_t i = 0; i < MQPulseScheduler::OverrunsBeforePenalty; ++i)
+	{
+		clock.now += 100000;
+		scheduler.Run(10000, clock, report);
+	}
+
+	const MQPulseScheduler::Task* task = scheduler.Find(id);
+	CHECK(task != nullptr);
+	CHECK(task->penalty == 1);
+	CHECK(task->GetEffectiveInterval() == MQPulseScheduler::MinPenaltyInterval * 2);
+	CHECK(reports == 1);
+
+	// penalties stop at MaxPenalty, and are only reported once
+	for (int i = 0; i < 20; ++i)
+	{
+		clock.now += 1000000;
+		scheduler.Run(10000, clock, report);
+	}
+
+	CHECK(task->penalty == MQPulseScheduler::MaxPenalty);
+	CHECK(reports == 1);
+}
@@ -0,0 +1,143 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-present MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "UnitTest.h"
+
+#include "mq/base/Signal.h"
+
+#include <string>
+
+using namespace mq;
+
+TEST_CASE("Signal calls every connection in order")
+{
+	Signal<int> signal;
+	std::string calls;
+
+	auto first = signal.Connect([&](int value) { calls += "a" + std::to_string(value); });
+	auto second = signal.Connect([&](int value) { calls += "b" + std::to_string(value); });
+
+	signal(1);
+	CHECK(calls == "a1b1");
+
+	CHECK(second.Disconnect());
+	CHECK(!second.Disconnect());
+	CHECK(!second.IsConnected());
+	CHECK(first.IsConnected());
+
+	calls.clear();
+	signal(2);
+	CHECK(calls == "a2");
+}
+
+TEST_CASE("Signal callbacks can connect and disconnect while it is emitted")
+{
+	Signal<> signal;
+	std::string calls;
+
+	Signal<>::Connection self, later, added;
+
+	self = signal.Connect([&]()
+	{
+		calls += "s";
+		self.Disconnect();
+		later.Disconnect();
+
+		// connected during the emit, so only called from the next one
+		added = signal.Connect([&]() { calls += "n"; });
+	});
+	later = signal.Connect([&]() { calls += "l"; });
+	auto stays = signal.Connect([&]() { calls += "t"; });
+
+	signal();
+	CHECK(calls == "st");
+
+	calls.clear();
+	signal();
+	CHECK(calls == "tn");
+}
+
+TEST_CASE("Signal can be emitted from its own callbacks")
+{
+	Signal<int> signal;
+	std::string calls;
+
+	Signal<int>::Connection outer;
+	outer = signal.Connect([&](int depth)
+	{
+		calls += "o" + std::to_string(depth);
+		if (depth == 0)
+		{
+			signal(1);
+
+			// disconnected by the nested emit, but not removed until this one is done
+			CHECK(!outer.IsConnected());
+		}
+		else
+		{
+			outer.Disconnect();
+		}
+	});
+	auto inner = signal.Connect([&](int depth) { calls += "i" + std::to_string(depth); });
+
+	signal(0);
+	CHECK(calls == "o0o1i1i0");
+
+	calls.clear();
+	signal(0);
+	CHECK(calls == "i0");
+}
+
+TEST_CASE("Signal does not allocate while it is emitted")
+{
+	Signal<int> signal;
+	int total = 0;
+
+	auto first = signal.Connect([&](int value) { total += value; });
+	auto second = signal.Connect([&](int value) { total += value * 2; });
+
+	const size_t before = mq::test::GetAllocationCount();
+
+	for (int i = 0; i < 100; ++i)
+		signal(1);
+
+	CHECK(mq::test::GetAllocationCount() == before);
+	CHECK(total == 300);
+}
+
+TEST_CASE("Signal DisconnectAll reports whether anything was connected")
+{
+	Signal<> signal;
+	int calls = 0;
+
+	CHECK(!signal.DisconnectAll());
+
+	auto connection = signal.Connect([&]() { ++calls; });
+	{
+		Signal<>::ScopedConnection scoped = signal.Connect([&]() { calls += 10; });
+
+		signal();
+		CHECK(calls == 11);
+	}
+
+	signal();
+	CHECK(calls == 12);
+
+	CHECK(signal.DisconnectAll());
+	CHECK(!connection.IsConnected());
+	CHECK(!signal.DisconnectAll());
+
+	signal();
+	CHECK(calls == 12);
+}
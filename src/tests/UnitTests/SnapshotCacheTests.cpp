@@ -0,0 +1,246 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-present MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "UnitTest.h"
+
+#include "mq/base/SnapshotCache.h"
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+using namespace mq;
+
+namespace {
+
+// A mutex that counts how many times it was locked, to check which reads go through the lock.
+struct CountingMutex
+{
+	void lock() { m_mutex.lock(); ++locks; }
+	void unlock() { m_mutex.unlock(); }
+
+	std::mutex m_mutex;
+	int locks = 0;
+};
+
+struct Member
+{
+	int ID;
+	std::string Name;
+};
+
+// The shape of MQ2Type: members owned by the type, and a snapshot of name -> member views.
+struct MemberTable
+{
+	std::vector<std::string> Names;
+	std::unordered_map<std::string_view, Member*> Members;
+};
+
+class TestType
+{
+public:
+	explicit TestType(int memberCount)
+	{
+		for (int i = 0; i < memberCount; ++i)
+			Add(i, "Member" + std::to_string(i));
+	}
+
+	void Add(int id, const std::string& name)
+	{
+		std::scoped_lock lock(m_mutex);
+
+		m_members.push_back(std::make_unique<Member>(Member{ id, name }));
+		m_memberMap[name] = static_cast<int>(m_members.size()) - 1;
+		m_tables.Invalidate();
+	}
+
+	void Remove(const std::string& name)
+	{
+		std::scoped_lock lock(m_mutex);
+
+		auto iter = m_memberMap.find(name);
+		m_retired.push_back(std::move(m_members[iter->second]));
+		m_memberMap.erase(iter);
+		m_tables.Invalidate();
+	}
+
+	Member* Find(std::string_view name) const
+	{
+		return m_tables.Read(m_mutex,
+			[this](MemberTable& table)
+			{
+				table.Names.reserve(m_memberMap.size());
+
+				for (const auto& [memberName, index] : m_memberMap)
+				{
+					table.Names.push_back(memberName);
+					table.Members.emplace(table.Names.back(), m_members[index].get());
+				}
+			},
+			[name](const MemberTable& table)
+			{
+				auto iter = table.Members.find(name);
+				return iter != table.Members.end() ? iter->second : nullptr;
+			});
+	}
+
+	// The lookup that MQ2Type used to do: build a string, lock, then look up the index and the member.
+	Member* FindLocked(const char* name) const
+	{
+		std::string key = name;
+		std::scoped_lock lock(m_mutex);
+
+		auto iter = m_memberMap.find(key);
+		return iter != m_memberMap.end() ? m_members[iter->second].get() : nullptr;
+	}
+
+	size_t GetSnapshotCount() const
+	{
+		std::scoped_lock lock(m_mutex);
+		return m_tables.GetSnapshotCount();
+	}
+
+	mutable CountingMutex m_mutex;
+
+private:
+	std::vector<std::unique_ptr<Member>> m_members;
+	std::vector<std::unique_ptr<Member>> m_retired;
+	std::unordered_map<std::string, int> m_memberMap;
+	SnapshotCache<MemberTable> m_tables;
+};
+
+} // namespace
+
+TEST_CASE("SnapshotCache reads without locking once built")
+{
+	TestType type(10);
+
+	CHECK(type.Find("Member3")->ID == 3);
+	const int locks = type.m_mutex.locks;
+
+	for (int i = 0; i < 100; ++i)
+		CHECK(type.Find("Member" + std::to_string(i % 10))->ID == i % 10);
+	CHECK(type.Find("Missing") == nullptr);
+
+	CHECK(type.m_mutex.locks == locks);
+	CHECK(type.GetSnapshotCount() == 1);
+}
+
+TEST_CASE("SnapshotCache rebuilds after invalidation")
+{
+	TestType type(3);
+
+	CHECK(type.Find("Added") == nullptr);
+	type.Add(100, "Added");
+	CHECK(type.Find("Added")->ID == 100);
+
+	type.Remove("Member1");
+	CHECK(type.Find("Member1") == nullptr);
+	CHECK(type.Find("Member2")->ID == 2);
+	CHECK(type.GetSnapshotCount() == 3);
+}
+
+TEST_CASE("SnapshotCache keeps members found in a replaced snapshot alive")
+{
+	TestType type(3);
+
+	// A reader that found the member before it was removed still holds it
+	Member* member = type.Find("Member0");
+	type.Remove("Member0");
+
+	CHECK(type.Find("Member0") == nullptr);
+	CHECK(member->ID == 0);
+	CHECK(member->Name == "Member0");
+}
+
+TEST_CASE("SnapshotCache falls back to the lock after too many snapshots")
+{
+	TestType type(2);
+
+	for (int i = 0; i < 40; ++i)
+	{
+		type.Add(1000 + i, "Added" + std::to_string(i));
+		CHECK(type.Find("Added" + std::to_string(i))->ID == 1000 + i);
+		CHECK(type.Find("Member1")->ID == 1);
+	}
+
+	CHECK(type.GetSnapshotCount() == 16);
+
+	// Reads of the private copy go through the lock, and still see every change
+	const int locks = type.m_mutex.locks;
+	CHECK(type.Find("Added39")->ID == 1039);
+	CHECK(type.m_mutex.locks == locks + 1);
+
+	type.Remove("Added39");
+	CHECK(type.Find("Added39") == nullptr);
+	CHECK(type.Find("Added38")->ID == 1038);
+	CHECK(type.GetSnapshotCount() == 16);
+}
+
+// About as many types and members as the built-in datatypes register, looked up round robin the way
+// a busy macro evaluates members of different types.
+TEST_CASE("SnapshotCache member lookup benchmark")
+{
+	constexpr int TypeCount = 60;
+	constexpr int MemberCount = 50;
+	constexpr int Iterations = 20;
+
+	std::vector<std::unique_ptr<TestType>> types;
+	for (int i = 0; i < TypeCount; ++i)
+		types.push_back(std::make_unique<TestType>(MemberCount));
+
+	std::vector<std::string> names;
+	for (int i = 0; i < MemberCount; ++i)
+		names.push_back("Member" + std::to_string(i));
+
+	using Clock = std::chrono::steady_clock;
+	int found = 0;
+
+	auto lockedStart = Clock::now();
+	for (int iteration = 0; iteration < Iterations; ++iteration)
+		for (const auto& type : types)
+			for (const std::string& name : names)
+				found += type->FindLocked(name.c_str()) != nullptr;
+	auto lockedTime = Clock::now() - lockedStart;
+
+	for (const auto& type : types)
+		type->Find(names[0]);
+
+	int locks = 0;
+	for (const auto& type : types)
+		locks += type->m_mutex.locks;
+
+	auto snapshotStart = Clock::now();
+	for (int iteration = 0; iteration < Iterations; ++iteration)
+		for (const auto& type : types)
+			for (const std::string& name : names)
+				found += type->Find(name.c_str()) != nullptr;
+	auto snapshotTime = Clock::now() - snapshotStart;
+
+	int snapshotLocks = 0;
+	for (const auto& type : types)
+		snapshotLocks += type->m_mutex.locks;
+
+	CHECK(found == 2 * Iterations * TypeCount * MemberCount);
+	CHECK(snapshotLocks == locks);
+
+	const double lookups = static_cast<double>(Iterations) * TypeCount * MemberCount;
+	printf("  locked: %.1f ns/lookup, snapshot: %.1f ns/lookup\n",
+		std::chrono::duration<double, std::nano>(lockedTime).count() / lookups,
+		std::chrono::duration<double, std::nano>(snapshotTime).count() / lookups);
+}
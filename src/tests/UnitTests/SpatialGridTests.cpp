@@ -0,0 +1,197 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-present MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "UnitTest.h"
+
+#include "main/MQSpatialGrid.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+using namespace mq;
+
+namespace {
+
+struct Point
+{
+	float x;
+	float y;
+	bool alive;
+};
+
+// Random points spread over a zone sized area, with a cluster around the origin
+std::vector<Point> MakePoints(std::mt19937& rng, int count)
+{
+	std::uniform_real_distribution<float> wide(-5000.0f, 5000.0f);
+	std::normal_distribution<float> cluster(0.0f, 150.0f);
+
+	std::vector<Point> points;
+	for (int i = 0; i < count; ++i)
+	{
+		if (i % 3 == 0)
+			points.push_back({ cluster(rng), cluster(rng), true });
+		else
+			points.push_back({ wide(rng), wide(rng), true });
+	}
+
+	return points;
+}
+
+std::vector<int> RadiusFromGrid(const MQSpatialGrid<int>& grid, float x, float y, float radius)
+{
+	std::vector<int> result;
+	grid.ForEachInRadius(x, y, radius, [&](int item, float, float) { result.push_back(item); });
+
+	std::sort(result.begin(), result.end());
+	return result;
+}
+
+std::vector<int> RadiusFromScan(const std::vector<Point>& points, float x, float y, float radius)
+{
+	std::vector<int> result;
+	for (int i = 0; i < static_cast<int>(points.size()); ++i)
+	{
+		const Point& point = points[i];
+		const float dx = point.x - x;
+		const float dy = point.y - y;
+
+		if (point.alive && dx * dx + dy * dy <= radius * radius)
+			result.push_back(i);
+	}
+
+	return result;
+}
+
+// The Nth nearest item by searching outwards through the grid, the same way NthNearestSpawn does
+int NthNearestFromGrid(const MQSpatialGrid<int>& grid, const std::vector<Point>& points, float x, float y, int nth)
+{
+	std::vector<std::pair<float, int>> found;
+	auto distSq = [&](int item) { return (points[item].x - x) * (points[item].x - x) + (points[item].y - y) * (points[item].y - y); };
+
+	grid.VisitNearest(x, y,
+		[&](int item) { found.emplace_back(distSq(item), item); },
+		[&](float minDistance)
+		{
+			if (nth > static_cast<int>(found.size()))
+				return false;
+
+			std::nth_element(found.begin(), found.begin() + (nth - 1), found.end());
+			return found[nth - 1].first <= minDistance * minDistance;
+		});
+
+	if (nth > static_cast<int>(found.size()))
+		return -1;
+
+	std::nth_element(found.begin(), found.begin() + (nth - 1), found.end());
+	return found[nth - 1].second;
+}
+
+int NthNearestFromScan(const std::vector<Point>& points, float x, float y, int nth)
+{
+	std::vector<std::pair<float, int>> found;
+	for (int i = 0; i < static_cast<int>(points.size()); ++i)
+	{
+		if (points[i].alive)
+			found.emplace_back((points[i].x - x) * (points[i].x - x) + (points[i].y - y) * (points[i].y - y), i);
+	}
+
+	if (nth > static_cast<int>(found.size()))
+		return -1;
+
+	std::nth_element(found.begin(), found.begin() + (nth - 1), found.end());
+	return found[nth - 1].second;
+}
+
+} // namespace
+
+TEST_CASE("MQSpatialGrid radius and nearest queries match a linear scan")
+{
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> coord(-6000.0f, 6000.0f);
+	std::uniform_real_distribution<float> step(-300.0f, 300.0f);
+	std::uniform_int_distribution<int> coin(0, 9);
+
+	std::vector<Point> points = MakePoints(rng, 2000);
+
+	MQSpatialGrid<int> grid;
+	for (int i = 0; i < static_cast<int>(points.size()); ++i)
+		grid.Update(i, points[i].x, points[i].y);
+
+	CHECK(grid.Size() == points.size());
+
+	const float radii[] = { 0.0f, 25.0f, 100.0f, 250.0f, 1000.0f, 20000.0f };
+
+	for (int round = 0; round < 20; ++round)
+	{
+		// move, remove and re-add some of the points, the way spawns come and go between pulses
+		for (int i = 0; i < static_cast<int>(points.size()); ++i)
+		{
+			Point& point = points[i];
+			const int roll = coin(rng);
+
+			if (roll < 4)
+			{
+				point.x += step(rng);
+				point.y += step(rng);
+			}
+			else if (roll == 4 && point.alive)
+			{
+				point.alive = false;
+				CHECK(grid.Remove(i));
+			}
+			else if (roll == 5 && !point.alive)
+			{
+				point.alive = true;
+				point.x = coord(rng);
+				point.y = coord(rng);
+				CHECK(grid.Update(i, point.x, point.y));
+			}
+		}
+
+		grid.Refresh([&](int item, float& x, float& y)
+			{
+				x = points[item].x;
+				y = points[item].y;
+			});
+
+		for (int query = 0; query < 10; ++query)
+		{
+			const float x = coord(rng);
+			const float y = coord(rng);
+
+			for (float radius : radii)
+				CHECK(RadiusFromGrid(grid, x, y, radius) == RadiusFromScan(points, x, y, radius));
+
+			for (int nth : { 1, 2, 10, 100 })
+				CHECK(NthNearestFromGrid(grid, points, x, y, nth) == NthNearestFromScan(points, x, y, nth));
+		}
+	}
+}
+
+TEST_CASE("MQSpatialGrid handles radii and positions far outside of the grid")
+{
+	MQSpatialGrid<int> grid;
+	grid.Update(1, 10.0f, 10.0f);
+	grid.Update(2, -1.0e18f, 1.0e18f);
+
+	CHECK(RadiusFromGrid(grid, 0.0f, 0.0f, 1.0e15f).size() == 1);
+	CHECK(RadiusFromGrid(grid, 0.0f, 0.0f, 1.0e19f).size() == 2);
+	CHECK(RadiusFromGrid(grid, 1.0e18f, 1.0e18f, 100.0f).empty());
+
+	std::vector<Point> points = { { 0, 0, false }, { 10.0f, 10.0f, true }, { -1.0e18f, 1.0e18f, true } };
+	CHECK(NthNearestFromGrid(grid, points, 1.0e18f, -1.0e18f, 1) == 1);
+	CHECK(NthNearestFromGrid(grid, points, 0.0f, 0.0f, 2) == 2);
+	CHECK(NthNearestFromGrid(grid, points, 0.0f, 0.0f, 3) == -1);
+}
@@ -0,0 +1,133 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-present MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "UnitTest.h"
+
+#include "mq/base/TimerQueue.h"
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace mq;
+
+TEST_CASE("TimerQueue runs values in due order, and ties in the order they were scheduled")
+{
+	TimerQueue<std::string> queue;
+	queue.Schedule(30, "c");
+	queue.Schedule(10, "a1");
+	queue.Schedule(20, "b");
+	queue.Schedule(10, "a2");
+	queue.Schedule(10, "a3");
+
+	std::vector<std::string> ran;
+	auto record = [&](const std::string& value) { ran.push_back(value); };
+
+	queue.Run(9, record);
+	CHECK(ran.empty());
+
+	queue.Run(10, record);
+	CHECK((ran == std::vector<std::string>{ "a1", "a2", "a3" }));
+
+	queue.Run(100, record);
+	CHECK((ran == std::vector<std::string>{ "a1", "a2", "a3", "b", "c" }));
+	CHECK(queue.Empty());
+}
+
+TEST_CASE("TimerQueue skips cancelled values")
+{
+	TimerQueue<int> queue;
+	const auto first = queue.Schedule(5, 1);
+	const auto second = queue.Schedule(5, 2);
+	queue.Schedule(6, 3);
+
+	CHECK(queue.Cancel(second));
+	CHECK(!queue.Cancel(second));
+	CHECK(queue.IsPending(first));
+	CHECK(!queue.IsPending(second));
+	CHECK(queue.Size() == 2);
+
+	std::vector<int> ran;
+	queue.Run(10, [&](int value) { ran.push_back(value); });
+
+	CHECK((ran == std::vector<int>{ 1, 3 }));
+	CHECK(!queue.IsPending(first));
+	CHECK(!queue.Cancel(first));
+}
+
+TEST_CASE("TimerQueue callbacks can schedule and cancel timers")
+{
+	TimerQueue<int> queue;
+	TimerQueue<int>::TimerId later = queue.Schedule(50, 99);
+	queue.Schedule(1, 1);
+
+	std::vector<int> ran;
+	queue.Run(10, [&](int value)
+		{
+			ran.push_back(value);
+
+			if (value == 1)
+			{
+				queue.Cancel(later);
+				queue.Schedule(5, 2);   // already due, runs during this Run
+				queue.Schedule(11, 3);  // not due yet
+			}
+		});
+
+	CHECK((ran == std::vector<int>{ 1, 2 }));
+	CHECK(queue.Size() == 1);
+
+	queue.Run(11, [&](int value) { ran.push_back(value); });
+	CHECK((ran == std::vector<int>{ 1, 2, 3 }));
+}
+
+TEST_CASE("TimerQueue matches a simulated clock when timers are rescheduled repeatedly")
+{
+	// Models macro timers being reset over and over, which cancels and reschedules their entries.
+	constexpr int TimerCount = 50;
+
+	std::mt19937 rng(42);
+	std::uniform_int_distribution<int> duration(1, 40);
+	std::uniform_int_distribution<int> pick(0, TimerCount - 1);
+
+	TimerQueue<int> queue;
+	std::vector<TimerQueue<int>::TimerId> ids(TimerCount, TimerQueue<int>::InvalidTimerId);
+	std::vector<uint64_t> due(TimerCount, 0);
+
+	for (uint64_t now = 1; now <= 2000; ++now)
+	{
+		for (int i = 0; i < 5; ++i)
+		{
+			const int timer = pick(rng);
+			queue.Cancel(ids[timer]);
+
+			due[timer] = now + duration(rng);
+			ids[timer] = queue.Schedule(due[timer], timer);
+		}
+
+		std::vector<int> expected;
+		for (int timer = 0; timer < TimerCount; ++timer)
+		{
+			if (due[timer] == now)
+				expected.push_back(timer);
+		}
+
+		std::vector<int> ran;
+		queue.Run(now, [&](int timer) { ran.push_back(timer); });
+
+		std::sort(ran.begin(), ran.end());
+		CHECK(ran == expected);
+	}
+}
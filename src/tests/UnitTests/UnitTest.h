@@ -0,0 +1,75 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-present MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#pragma once
+
+#include <cstdio>
+#include <vector>
+
+// A minimal test harness for the parts of MacroQuest that don't need the game client to run.
+// Tests register themselves with TEST_CASE and report failures with CHECK. Main.cpp runs them all
+// and returns the number of failed tests.
+
+namespace mq::test {
+
+struct TestCase
+{
+	const char* name;
+	void (*func)();
+};
+
+inline std::vector<TestCase>& GetTestCases()
+{
+	static std::vector<TestCase> s_testCases;
+	return s_testCases;
+}
+
+inline int& GetFailureCount()
+{
+	static int s_failures = 0;
+	return s_failures;
+}
+
+struct TestRegistrar
+{
+	TestRegistrar(const char* name, void (*func)())
+	{
+		GetTestCases().push_back({ name, func });
+	}
+};
+
+// The number of allocations made through operator new so far. Main.cpp counts them, so that tests
+// can check that a path doesn't allocate.
+size_t GetAllocationCount();
+
+inline void ReportFailure(const char* expression, const char* file, int line)
+{
+	printf("  FAILED: %s (%s:%d)\n", expression, file, line);
+	++GetFailureCount();
+}
+
+} // namespace mq::test
+
+#define TEST_CONCAT2(a, b) a##b
+#define TEST_CONCAT(a, b) TEST_CONCAT2(a, b)
+
+#define TEST_CASE_IMPL(name, func, registrar) \
+	static void func(); \
+	static mq::test::TestRegistrar registrar(name, &func); \
+	static void func()
+
+#define TEST_CASE(name) TEST_CASE_IMPL(name, TEST_CONCAT(TestCase_, __LINE__), TEST_CONCAT(TestRegistrar_, __LINE__))
+
+#define CHECK(expression) \
+	do { if (!(expression)) mq::test::ReportFailure(#expression, __FILE__, __LINE__); } while (0)